@@ -0,0 +1,23 @@
+#!/bin/sh
+# allocs.sh - Counts heap allocations made by hsh on a large generated script.
+#
+# Usage: bench/allocs.sh [lines]
+# The shell under test is taken from $HSH (default: ./hsh). The script
+# only contains assignments so the numbers reflect lexing and parsing.
+
+HSH=${HSH:-./hsh}
+CC=${CC:-gcc}
+LINES=${1:-100000}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+"$CC" -shared -fPIC -O2 -o "$DIR/malloc_count.so" \
+	"$(dirname "$0")/malloc_count.c" || exit 1
+
+awk -v n="$LINES" 'BEGIN {
+	for (i = 0; i < n; i++)
+		printf "A=%d B=\"quoted %d\" C=plain; D=x && E=y || F=z\n", i, i
+}' >"$DIR/script.sh"
+
+printf '%d lines: ' "$LINES"
+LD_PRELOAD="$DIR/malloc_count.so" "$HSH" "$DIR/script.sh"
@@ -0,0 +1,51 @@
+#!/bin/sh
+# builtins.sh - Compares builtin execution with a fork per command.
+#
+# Usage: bench/builtins.sh [iterations]
+# Runs an unrolled loop body of test, echo, printf, true and : once with
+# the builtins and once with the same utilities named by absolute path,
+# which forces a fork and exec for each of them.
+# The shell under test is taken from $HSH (default: ./hsh).
+
+HSH=${HSH:-./hsh}
+COUNT=${1:-2000}
+BUILTIN=$(mktemp)
+EXTERNAL=$(mktemp)
+trap 'rm -f "$BUILTIN" "$EXTERNAL"' EXIT
+
+# which - Prints the first executable named $1 found in PATH.
+which()
+{
+	IFS=:
+	for dir in $PATH; do
+		if [ -f "$dir/$1" ] && [ -x "$dir/$1" ]; then
+			printf '%s\n' "$dir/$1"
+			break
+		fi
+	done
+	unset IFS
+}
+
+body='test 1 -lt 2 && echo iteration && printf "%s\n" body && true && :'
+yes "$body" | head -n "$COUNT" >"$BUILTIN"
+external=$(printf '%s\n' "$body" | sed \
+	-e "s#^test #$(which test) #" \
+	-e "s#echo #$(which echo) #" \
+	-e "s#printf #$(which printf) #" \
+	-e "s#true#$(which true)#" \
+	-e "s#:\$#$(which true)#")
+yes "$external" | head -n "$COUNT" >"$EXTERNAL"
+
+run()
+{
+	start=$(date +%s%N)
+	"$HSH" --no-cache "$2" >/dev/null
+	end=$(date +%s%N)
+	awk -v what="$1" -v n="$((COUNT * 5))" -v ns="$((end - start))" 'BEGIN {
+		printf "%-8s %d commands in %.1f ms: %.0f commands/sec\n",
+		       what, n, ns / 1e6, n / (ns / 1e9)
+	}'
+}
+
+run builtin "$BUILTIN"
+run fork "$EXTERNAL"
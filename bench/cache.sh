@@ -0,0 +1,81 @@
+#!/bin/sh
+# cache.sh - Measures what the script cache costs and what it saves.
+#
+# Usage: bench/cache.sh [rounds]
+# Generates some workloads of bench/run.sh and prints, for each, the
+# size of the script and of its compiled image, and the best of [rounds]
+# (default 5) wall times of three runs: with --no-cache, a cold miss
+# (the cache is emptied first, so the script is parsed, run and
+# compiled) and a hit. An image that would be more than twice the size
+# of its script is not written: its size is shown as "-" and its hits
+# are misses. The shell under test is taken from $HSH (default: ./hsh).
+
+HSH=${HSH:-./hsh}
+ROUNDS=${1:-5}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+HSH_CACHE_DIR="$DIR/cache"
+export HSH_CACHE_DIR
+
+# workload - Writes the script of a workload.
+# $1: Name of the workload; $2: number of lines; $3: awk program
+# printing line i.
+workload()
+{
+	awk -v n="$2" "BEGIN { for (i = 0; i < n; i++) { $3 } }" \
+		>"$DIR/$1.sh"
+	printf '%s\n' "$1" >>"$DIR/workloads"
+}
+
+workload parse 50000 \
+	'print ": one \"two three\" '\''four'\'' \"\" '\'\'' && : five six || : seven " i'
+workload tokens 2000 \
+	's = ":"; for (j = 0; j < 256; j++) s = s " word" j; print s'
+workload assign 50000 \
+	'print "A=" i " B=two C='\''three four'\'' D=\"five six\" E=" i " :"'
+workload expand 20000 \
+	'if (!i) print "A=alpha B=\"beta gamma\" L=\"a b c d e f g h\""
+	 print ": $A \"$B\" ${C:-default} $L x$A \"${B}\"y $? $# \"$L\" " i'
+workload redirect 20000 'print "echo line " i " >>/dev/null 2>&1"'
+workload short 1 'print ": one two"'
+
+# sample - Prints the wall time of one run in nanoseconds.
+# $@: The command to run.
+sample()
+{
+	start=$(date +%s%N)
+	"$@" >/dev/null 2>&1
+	end=$(date +%s%N)
+	echo $((end - start))
+}
+
+# best - Prints the shortest of the times read, in milliseconds.
+best()
+{
+	sort -n | awk 'NR == 1 { printf "%.1f", $1 / 1e6 }'
+}
+
+printf '%-10s %10s %10s %10s %10s %10s\n' \
+	workload script image no-cache miss hit
+while read -r name; do
+	script="$DIR/$name.sh"
+	nocache=$(i=0
+		while [ "$i" -lt "$ROUNDS" ]; do
+			sample "$HSH" --no-cache "$script"
+			i=$((i + 1))
+		done | best)
+	miss=$(i=0
+		while [ "$i" -lt "$ROUNDS" ]; do
+			rm -rf "$HSH_CACHE_DIR"
+			sample "$HSH" "$script"
+			i=$((i + 1))
+		done | best)
+	image=$(wc -c "$HSH_CACHE_DIR"/*.hshc 2>/dev/null | awk '{ print $1 }')
+	hit=$(i=0
+		while [ "$i" -lt "$ROUNDS" ]; do
+			sample "$HSH" "$script"
+			i=$((i + 1))
+		done | best)
+	printf '%-10s %10d %10s %10s %10s %10s\n' "$name" \
+		"$(wc -c <"$script")" "${image:--}" "$nocache" "$miss" "$hit"
+done <"$DIR/workloads"
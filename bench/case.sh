@@ -0,0 +1,82 @@
+#!/bin/sh
+# case.sh - Measures the cost of a case command with many arms.
+#
+# Usage: bench/case.sh [arms] [runs] [rounds]
+# Runs a while loop of [runs] rounds (default 20000) over a case command
+# of [arms] arms (default 500) whose last arm matches, three ways: arms
+# of literal words, arms of glob patterns such as `w12.*|*.w12`, and a
+# `:` body instead of the case command. The time of the `:` loop is
+# taken off the others, so each line gives the median over the [rounds]
+# (default 5) of the time one case command takes. dash and bash run the
+# same scripts for reference. The shell under test is taken from $HSH
+# (default: ./hsh).
+
+HSH=${HSH:-./hsh}
+ARMS=${1:-500}
+COUNT=${2:-20000}
+ROUNDS=${3:-5}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+# script - Writes a loop of COUNT rounds running a case command.
+# $1: Name of the script; $2: the subject; $3: a printf format giving an
+# arm's patterns from its number, or nothing for a `:` body.
+script()
+{
+	{
+		printf 'i=0\nwhile [ "$i" -lt %d ]; do\n' "$COUNT"
+		if [ -n "$3" ]; then
+			printf '\tcase %s in\n' "$2"
+			arm=0
+			while [ "$arm" -lt "$ARMS" ]; do
+				printf "\t$3) : ;;\n" "$arm" "$arm"
+				arm=$((arm + 1))
+			done
+			printf '\tesac\n'
+		else
+			printf '\t:\n'
+		fi
+		printf '\ti=$((i + 1))\ndone\n'
+	} >"$DIR/$1.sh"
+}
+
+last=$((ARMS - 1))
+script inline
+script literal "w$last" 'w%d|x%d'
+script glob "w$last.c" 'w%d.*|*.w%d'
+
+# run - Prints the time, in nanoseconds, of one run of a script.
+# $1: Name of the script; the rest: the shell running it.
+run()
+{
+	name=$1
+	shift
+	start=$(date +%s%N)
+	"$@" "$DIR/$name.sh"
+	end=$(date +%s%N)
+	echo "$((end - start))"
+}
+
+# The shells take turns in every round, so drift in the machine's load
+# affects them alike.
+round=0
+while [ "$round" -lt "$ROUNDS" ]; do
+	for shell in hsh dash bash; do
+		if [ "$shell" = hsh ]; then
+			cmd="$HSH --no-cache"
+		elif ! cmd=$(command -v "$shell"); then
+			continue
+		fi
+		inline=$(run inline $cmd)
+		echo "${shell}_literal $(($(run literal $cmd) - inline))"
+		echo "${shell}_glob $(($(run glob $cmd) - inline))"
+	done
+	round=$((round + 1))
+done | sort -k1,1 -k2n | awk -v n="$COUNT" '
+	{ ns[$1, ++count[$1]] = $2 }
+	END {
+		for (label in count) {
+			median = ns[label, int((count[label] + 1) / 2)]
+			printf "%-13s %9.1f ns per case\n", label, median / n
+		}
+	}' | sort
@@ -0,0 +1,34 @@
+#!/bin/sh
+# compare.sh - Compares two result files written by bench/run.sh.
+#
+# Usage: bench/compare.sh old.json new.json
+# Prints the median of every workload, shell and micro-benchmark found
+# in both files, and the change from the old to the new one. Changes
+# beyond the threshold (default 5%, set with $THRESHOLD) are marked.
+
+if [ $# -ne 2 ]; then
+	echo "Usage: $0 old.json new.json" >&2
+	exit 2
+fi
+
+# medians - Prints "key median" for every result of a file.
+medians()
+{
+	sed -n \
+		-e 's/^{"workload":"\([^"]*\)","shell":"\([^"]*\)".*"median_ms":\([0-9.]*\).*/\2\/\1 \3/p' \
+		-e 's/^{"micro":"\([^"]*\)","input":"\([^"]*\)","median_ns":\([0-9.]*\).*/\1\/\2 \3/p' \
+		"$1"
+}
+
+OLD=$(mktemp)
+trap 'rm -f "$OLD"' EXIT
+medians "$1" >"$OLD"
+medians "$2" | awk -v threshold="${THRESHOLD:-5}" '
+	NR == FNR { old[$1] = $2; next }
+	($1 in old) && old[$1] > 0 {
+		change = ($2 - old[$1]) / old[$1] * 100
+		mark = change > threshold ? "slower" : \
+		       change < -threshold ? "faster" : ""
+		printf "%-28s %12.3f %12.3f %+7.1f%% %s\n", \
+		       $1, old[$1], $2, change, mark
+	}' "$OLD" -
@@ -0,0 +1,48 @@
+#!/bin/sh
+# exec.sh - Measures the latency of `hsh -c 'program args'`.
+#
+# Usage: bench/exec.sh [count] [rounds]
+# Starts the shell count times in a row with a one-command string, once
+# as is, where the program replaces the shell, and once with a trailing
+# `:`, which keeps the shell around to spawn the program and wait for
+# it. dash runs the same strings for reference. Each line gives the
+# median over the rounds of the time per invocation, program included.
+# The shell under test is taken from $HSH (default: ./hsh).
+
+HSH=${HSH:-./hsh}
+COUNT=${1:-2000}
+ROUNDS=${2:-5}
+
+# run - Prints the time, in nanoseconds, of count invocations of a shell.
+run()
+{
+	i=0
+	start=$(date +%s%N)
+	while [ "$i" -lt "$COUNT" ]; do
+		"$@"
+		i=$((i + 1))
+	done
+	end=$(date +%s%N)
+	echo "$((end - start))"
+}
+
+# The variants take turns in every round, so drift in the machine's
+# load affects them alike.
+round=0
+while [ "$round" -lt "$ROUNDS" ]; do
+	echo "hsh_exec $(run "$HSH" -c '/bin/true x')"
+	echo "hsh_fork+wait $(run "$HSH" -c '/bin/true x; :')"
+	if command -v dash >/dev/null; then
+		echo "dash_exec $(run dash -c '/bin/true x')"
+		echo "dash_fork+wait $(run dash -c '/bin/true x; :')"
+	fi
+	round=$((round + 1))
+done | sort -k1,1 -k2n | awk -v n="$COUNT" '
+	{ ns[$1, ++count[$1]] = $2 }
+	END {
+		for (label in count) {
+			median = ns[label, int((count[label] + 1) / 2)]
+			printf "%-16s %8.1f us per invocation\n", label,
+			       median / n / 1e3
+		}
+	}' | sort
@@ -0,0 +1,168 @@
+/*
+ * expand_bench.c - Measures expand_simple() on expansion-heavy commands.
+ *
+ * Build: make bench/expand_bench
+ * Usage: bench/expand_bench [rounds]
+ *
+ * Every input is parsed once; each round then expands its command a
+ * batch of times. One JSON object per input is printed, with the median
+ * and 99th percentile of the per-command time over all rounds and the
+ * fields produced per second at the median.
+ */
+#include <expand.h>
+#include <lexer.h>
+#include <parser.h>
+#include <shell.h>
+#include <arena.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BATCH 1000
+
+/**
+ * now - Reads the monotonic clock.
+ *
+ * Return: The current time in nanoseconds.
+ */
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * compare - Orders two samples for qsort().
+ * @a: The first sample.
+ * @b: The second sample.
+ *
+ * Return: A negative, zero or positive value as a is below, equal to or
+ * above b.
+ */
+static int compare(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * repeat - Builds a command of a word repeated many times.
+ * @word: The word, with its leading blank.
+ * @count: Number of copies.
+ *
+ * Return: ": " followed by the copies and a newline, or NULL on failure.
+ */
+static char *repeat(const char *word, int count)
+{
+	size_t length = strlen(word);
+	char *line = malloc(length * count + 3);
+
+	if (!line)
+		return NULL;
+	line[0] = ':';
+	for (int i = 0; i < count; i++)
+		memcpy(line + 1 + length * i, word, length);
+	strcpy(line + 1 + length * count, "\n");
+	return line;
+}
+
+/**
+ * run - Times the expansion of one command.
+ * @shell: Pointer to the shell state.
+ * @name: Label of the input.
+ * @line: The command, on a single line.
+ * @rounds: Number of rounds.
+ */
+static void run(ShellState *shell, const char *name, const char *line,
+		int rounds)
+{
+	double *samples = malloc(sizeof(double) * rounds);
+	double start, median, p99;
+	SimpleCommand simple;
+	NodeIndex root;
+	size_t length;
+
+	if (!line || !samples) {
+		fprintf(stderr, "Error: malloc failed\n");
+		free(samples);
+		return;
+	}
+	arena_reset(shell->arena);
+	ast_reset(&shell->ast);
+	root = parse(shell, tokenize_line(shell, line, &length));
+	if (root == AST_NONE || shell->ast.nodes[root].type != CMD_SIMPLE) {
+		fprintf(stderr, "%s: input does not parse\n", name);
+		shell->had_error = false;
+		free(samples);
+		return;
+	}
+
+	for (int r = 0; r < rounds; r++) {
+		start = now();
+		for (int i = 0; i < BATCH; i++) {
+			/* Forget the last command, as the executor does. */
+			shell->expansion.node = NULL;
+			expand_simple(shell, &shell->ast,
+				      &shell->ast.nodes[root], &simple);
+		}
+		samples[r] = (now() - start) / BATCH;
+	}
+	qsort(samples, rounds, sizeof(double), compare);
+	median = samples[rounds / 2];
+	p99 = samples[(rounds * 99 + 99) / 100 - 1];
+	printf("{\"micro\":\"expand\",\"input\":\"%s\",\"median_ns\":%.1f,"
+	       "\"p99_ns\":%.1f,\"lines_per_sec\":%.0f,"
+	       "\"fields_per_sec\":%.0f}\n",
+	       name, median, p99, 1e9 / median, simple.argc * 1e9 / median);
+	free(samples);
+}
+
+int main(int argc, char **argv)
+{
+	int rounds = argc > 1 ? atoi(argv[1]) : 200;
+	ShellState *shell = shell_init(argv[0], false);
+	char *params[] = { "one", "two words", "three", NULL };
+	char *lines[3];
+
+	if (!shell) {
+		fprintf(stderr, "Error: malloc failed\n");
+		return 1;
+	}
+	if (rounds < 1)
+		rounds = 1;
+	shell->params = params;
+	shell->param_count = 3;
+	if (!vars_set(&shell->vars, "A=alpha", 0) ||
+	    !vars_set(&shell->vars, "B=beta gamma", 0) ||
+	    !vars_set(&shell->vars,
+		      "LIST=a b c d e f g h i j k l m n o p q r s t u v w x y z "
+		      "0 1 2 3 4 5 6 7 8 9 a b c d e f g h i j k l m n o p q r "
+		      "s t u v w x y z 0 1",
+		      0)) {
+		fprintf(stderr, "Error: malloc failed\n");
+		shell_free(shell);
+		return 1;
+	}
+	lines[0] = repeat(" $A", 64);
+	lines[1] = repeat(" \"${B}\"", 64);
+	lines[2] = repeat(" ${UNSET:-default}", 64);
+
+	run(shell, "literal", ": a b c d e f g h 'i j' \"k l\" m n o p\n",
+	    rounds);
+	run(shell, "mixed", ": a $A b \"$B\" c ${C:-d} e 'f' $? $$ $1 g\n",
+	    rounds);
+	run(shell, "vars64", lines[0], rounds);
+	run(shell, "quoted64", lines[1], rounds);
+	run(shell, "default64", lines[2], rounds);
+	run(shell, "split64", ": $LIST\n", rounds);
+	run(shell, "params", ": \"$@\" $* \"$*\" $# ${2}\n", rounds);
+
+	for (int i = 0; i < 3; i++)
+		free(lines[i]);
+	shell_free(shell);
+	return 0;
+}
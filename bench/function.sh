@@ -0,0 +1,68 @@
+#!/bin/sh
+# function.sh - Measures the cost of calling a shell function.
+#
+# Usage: bench/function.sh [calls] [rounds]
+# Runs a while loop of [calls] rounds (default 200000) three ways: with
+# a `:` body, calling a function whose body is `:`, and calling one with
+# three arguments that it reads back. The time of the `:` loop is taken
+# off the others, so each line gives the median over the rounds of the
+# time one call adds. dash and bash run the same scripts for reference.
+# The shell under test is taken from $HSH (default: ./hsh).
+
+HSH=${HSH:-./hsh}
+COUNT=${1:-200000}
+ROUNDS=${2:-5}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+# script - Writes a loop of COUNT rounds running a command.
+# $1: Name of the script; $2: the command.
+script()
+{
+	{
+		printf 'f() { :; }\n'
+		printf 'g() { : "$1" "$2" "$3"; }\n'
+		printf 'i=0\nwhile [ "$i" -lt %d ]; do\n' "$COUNT"
+		printf '\t%s\n\ti=$((i + 1))\ndone\n' "$2"
+	} >"$DIR/$1.sh"
+}
+
+script inline ':'
+script call 'f'
+script args 'g one two three'
+
+# run - Prints the time, in nanoseconds, of one run of a script.
+# $1: Name of the script; the rest: the shell running it.
+run()
+{
+	name=$1
+	shift
+	start=$(date +%s%N)
+	"$@" "$DIR/$name.sh"
+	end=$(date +%s%N)
+	echo "$((end - start))"
+}
+
+# The shells take turns in every round, so drift in the machine's load
+# affects them alike.
+round=0
+while [ "$round" -lt "$ROUNDS" ]; do
+	for shell in hsh dash bash; do
+		if [ "$shell" = hsh ]; then
+			cmd="$HSH --no-cache"
+		elif ! cmd=$(command -v "$shell"); then
+			continue
+		fi
+		inline=$(run inline $cmd)
+		echo "${shell}_call $(($(run call $cmd) - inline))"
+		echo "${shell}_args $(($(run args $cmd) - inline))"
+	done
+	round=$((round + 1))
+done | sort -k1,1 -k2n | awk -v n="$COUNT" '
+	{ ns[$1, ++count[$1]] = $2 }
+	END {
+		for (label in count) {
+			median = ns[label, int((count[label] + 1) / 2)]
+			printf "%-10s %8.1f ns per call\n", label, median / n
+		}
+	}' | sort
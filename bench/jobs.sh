@@ -0,0 +1,29 @@
+#!/bin/sh
+# jobs.sh - Measures starting and reaping many concurrent background jobs.
+#
+# Usage: bench/jobs.sh [count] [seconds]
+# Starts count sleeps of the given length in the background, then waits
+# for all of them, under hsh and under every other shell in $SHELLS.
+# The shell under test is taken from $HSH (default: ./hsh).
+
+HSH=${HSH:-./hsh}
+COUNT=${1:-5000}
+SLEEP=${2:-1}
+SHELLS=${SHELLS:-"dash bash"}
+SCRIPT=$(mktemp)
+trap 'rm -f "$SCRIPT"' EXIT
+
+yes "/bin/sleep $SLEEP &" | head -n "$COUNT" >"$SCRIPT"
+echo wait >>"$SCRIPT"
+
+for sh in "$HSH" $SHELLS; do
+	command -v "$sh" >/dev/null 2>&1 || continue
+	start=$(date +%s%N)
+	"$sh" "$SCRIPT"
+	end=$(date +%s%N)
+	awk -v sh="$sh" -v n="$COUNT" -v s="$SLEEP" -v ns="$((end - start))" \
+	'BEGIN {
+		printf "%-8s %d jobs of %ss: %.1f ms, %.1f ms over the sleep\n",
+		       sh, n, s, ns / 1e6, ns / 1e6 - s * 1000
+	}'
+done
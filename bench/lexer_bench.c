@@ -0,0 +1,102 @@
+/*
+ * lexer_bench.c - Measures tokenize() throughput on synthetic inputs.
+ *
+ * Build: make bench/lexer_bench
+ * Usage: bench/lexer_bench [megabytes]
+ */
+#include <lexer.h>
+#include <shell.h>
+#include <arena.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * generate - Fills a buffer by repeating a line.
+ * @line: The line to repeat.
+ * @size: Approximate size of the result in bytes.
+ *
+ * Return: The NUL terminated buffer, or NULL on failure.
+ */
+static char *generate(const char *line, size_t size)
+{
+	size_t length = strlen(line), count = size / length + 1;
+	char *buffer = malloc(count * length + 1);
+
+	if (!buffer)
+		return NULL;
+	for (size_t i = 0; i < count; i++)
+		memcpy(buffer + i * length, line, length);
+	buffer[count * length] = '\0';
+	return buffer;
+}
+
+/**
+ * now - Reads the monotonic clock.
+ *
+ * Return: The current time in seconds.
+ */
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * run - Tokenizes one input repeatedly and prints the throughput.
+ * @shell: Pointer to the shell state.
+ * @name: Label of the input.
+ * @line: The line the input is made of.
+ * @size: Size of the input in bytes.
+ */
+static void run(ShellState *shell, const char *name, const char *line,
+		size_t size)
+{
+	char *input = generate(line, size);
+	double start, elapsed;
+	int rounds = 5;
+
+	if (!input) {
+		fprintf(stderr, "Error: malloc failed\n");
+		return;
+	}
+
+	start = now();
+	for (int i = 0; i < rounds; i++) {
+		arena_reset(shell->arena);
+		tokenize(shell, input);
+	}
+	elapsed = now() - start;
+	printf("%-16s %8.1f MB/s\n", name,
+	       strlen(input) * (double)rounds / elapsed / 1e6);
+	free(input);
+}
+
+int main(int argc, char **argv)
+{
+	size_t size = (argc > 1 ? strtoul(argv[1], NULL, 10) : 16) << 20;
+	ShellState *shell = shell_init(argv[0], false);
+
+	if (!shell) {
+		fprintf(stderr, "Error: malloc failed\n");
+		return 1;
+	}
+
+	run(shell, "long words",
+	    "/usr/local/share/some/really/long/path/component/file.txt "
+	    "--a-rather-long-option-name=with-an-equally-long-value "
+	    "another_fairly_long_identifier_like_argument\n",
+	    size);
+	run(shell, "short words", "a b c d e f g h i j k l m n o p q r s t\n",
+	    size);
+	run(shell, "heavy quoting",
+	    "echo 'single quoted' \"double quoted\" mixed'q'\"u\"o'te' "
+	    "A=\"assign ment\"\n",
+	    size);
+
+	shell_free(shell);
+	return 0;
+}
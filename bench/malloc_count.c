@@ -0,0 +1,46 @@
+/*
+ * malloc_count.c - LD_PRELOAD shim counting heap allocations of a process.
+ *
+ * Build: gcc -shared -fPIC -O2 -o malloc_count.so bench/malloc_count.c
+ * The totals are written to stderr when the process exits.
+ */
+#include <stddef.h>
+#include <stdio.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static unsigned long allocations;
+static unsigned long frees;
+
+void *malloc(size_t size)
+{
+	allocations++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	allocations++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	allocations++;
+	return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+	if (ptr)
+		frees++;
+	__libc_free(ptr);
+}
+
+__attribute__((destructor)) static void report(void)
+{
+	fprintf(stderr, "allocations: %lu, frees: %lu\n", allocations, frees);
+}
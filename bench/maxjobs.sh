@@ -0,0 +1,59 @@
+#!/bin/sh
+# maxjobs.sh - Shows background throughput under HSH_MAXJOBS and make -j.
+#
+# Usage: bench/maxjobs.sh [work]
+# Submits 1, 2, 4 and 8 times as many CPU-bound background jobs as there
+# are slots, first with HSH_MAXJOBS set to the number of slots and then
+# with hsh run by `make -j<slots>`, so its jobs take jobserver tokens.
+# There are as many slots as cores, but at least 2, since make -j1 runs
+# no jobserver. Each line gives the jobs finished per second and the
+# largest number that ever ran at once, which should stay at the number
+# of slots.
+# The shell under test is taken from $HSH (default: ./hsh).
+
+HSH=${HSH:-./hsh}
+WORK=${1:-50000}
+SLOTS=$(nproc)
+[ "$SLOTS" -lt 2 ] && SLOTS=2
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+# job - The command line of one job: it logs its start and end around a
+# busy loop.
+job="/bin/sh -c 'echo + >>$DIR/log; i=0; while [ \$i -lt $WORK ]; do i=\$((i+1)); done; echo - >>$DIR/log' &"
+
+case $HSH in
+/*) ;;
+*) HSH=$PWD/$HSH ;;
+esac
+printf 'all:\n\t+@%s %s\n' "$HSH" "$DIR/script" >"$DIR/Makefile"
+
+# report - Prints throughput and peak concurrency of the last run.
+report()
+{
+	awk -v mode="$1" -v n="$2" -v ns="$3" '
+		/\+/ { if (++running > peak) peak = running }
+		/-/ { running-- }
+		END {
+			printf "%-9s %4d jobs: %7.1f jobs/sec, at most %d at once\n",
+			       mode, n, n / (ns / 1e9), peak
+		}' "$DIR/log"
+}
+
+for factor in 1 2 4 8; do
+	count=$((SLOTS * factor))
+	yes "$job" | head -n "$count" >"$DIR/script"
+	echo wait >>"$DIR/script"
+
+	: >"$DIR/log"
+	start=$(date +%s%N)
+	HSH_MAXJOBS=$SLOTS "$HSH" "$DIR/script"
+	end=$(date +%s%N)
+	report maxjobs "$count" "$((end - start))"
+
+	: >"$DIR/log"
+	start=$(date +%s%N)
+	make -s -j"$SLOTS" -C "$DIR" >/dev/null
+	end=$(date +%s%N)
+	report jobserver "$count" "$((end - start))"
+done
@@ -0,0 +1,151 @@
+/*
+ * parser_bench.c - Measures tokenize_line() and parse() separately.
+ *
+ * Build: make bench/parser_bench
+ * Usage: bench/parser_bench [rounds]
+ *
+ * Every round tokenizes a batch of copies of one line, then parses the
+ * token lists, timing the two phases on their own. One JSON object per
+ * input and phase is printed, with the median and 99th percentile of
+ * the per-line time over all rounds.
+ */
+#include <lexer.h>
+#include <parser.h>
+#include <shell.h>
+#include <arena.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BATCH 1000
+
+/**
+ * now - Reads the monotonic clock.
+ *
+ * Return: The current time in nanoseconds.
+ */
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * compare - Orders two samples for qsort().
+ * @a: The first sample.
+ * @b: The second sample.
+ *
+ * Return: A negative, zero or positive value as a is below, equal to or
+ * above b.
+ */
+static int compare(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * report - Prints the statistics of one phase as a JSON object.
+ * @name: Label of the input.
+ * @phase: "tokenize" or "parse".
+ * @samples: Nanoseconds per line of every round; sorted in place.
+ * @rounds: Number of samples.
+ */
+static void report(const char *name, const char *phase, double *samples,
+		   int rounds)
+{
+	double median, p99;
+
+	qsort(samples, rounds, sizeof(double), compare);
+	median = samples[rounds / 2];
+	p99 = samples[(rounds * 99 + 99) / 100 - 1];
+	printf("{\"micro\":\"%s\",\"input\":\"%s\",\"median_ns\":%.1f,"
+	       "\"p99_ns\":%.1f,\"lines_per_sec\":%.0f}\n",
+	       phase, name, median, p99, 1e9 / median);
+}
+
+/**
+ * run - Times the tokenizing and parsing of one line.
+ * @shell: Pointer to the shell state.
+ * @name: Label of the input.
+ * @line: The line, without semicolons so it is a single command.
+ * @rounds: Number of rounds.
+ */
+static void run(ShellState *shell, const char *name, const char *line,
+		int rounds)
+{
+	double *lexing = malloc(sizeof(double) * rounds);
+	double *parsing = malloc(sizeof(double) * rounds);
+	Token **tokens = malloc(sizeof(Token *) * BATCH);
+	double start;
+	size_t length;
+
+	if (!lexing || !parsing || !tokens) {
+		fprintf(stderr, "Error: malloc failed\n");
+		free(lexing);
+		free(parsing);
+		free(tokens);
+		return;
+	}
+
+	for (int r = 0; r < rounds; r++) {
+		arena_reset(shell->arena);
+		start = now();
+		for (int i = 0; i < BATCH; i++)
+			tokens[i] = tokenize_line(shell, line, &length);
+		lexing[r] = (now() - start) / BATCH;
+
+		start = now();
+		for (int i = 0; i < BATCH; i++) {
+			ast_reset(&shell->ast);
+			parse(shell, tokens[i]);
+		}
+		parsing[r] = (now() - start) / BATCH;
+		if (shell->had_error || shell->fatal_error) {
+			fprintf(stderr, "%s: input does not parse\n", name);
+			shell->had_error = false;
+			rounds = 0;
+		}
+	}
+	if (rounds) {
+		report(name, "tokenize", lexing, rounds);
+		report(name, "parse", parsing, rounds);
+	}
+	free(lexing);
+	free(parsing);
+	free(tokens);
+}
+
+int main(int argc, char **argv)
+{
+	int rounds = argc > 1 ? atoi(argv[1]) : 200;
+	ShellState *shell = shell_init(argv[0], false);
+
+	if (!shell) {
+		fprintf(stderr, "Error: malloc failed\n");
+		return 1;
+	}
+	if (rounds < 1)
+		rounds = 1;
+
+	run(shell, "simple", "ls -l /usr/local/bin\n", rounds);
+	run(shell, "logical",
+	    ": one \"two three\" 'four' && : five six || : seven\n", rounds);
+	run(shell, "pipeline",
+	    "cat file | grep -v x | sort | uniq -c | sort -rn | head -n 10\n",
+	    rounds);
+	run(shell, "assignments",
+	    "A=1 B=two C='three four' D=\"five $x\" E=6 env\n", rounds);
+	run(shell, "tokens",
+	    ": a b c d e f g h i j k l m n o p q r s t u v w x y z "
+	    "a b c d e f g h i j k l m n o p q r s t u v w x y z "
+	    "a b c d e f g h i j k l m n o p q r s t u v w x y z\n",
+	    rounds);
+
+	shell_free(shell);
+	return 0;
+}
@@ -0,0 +1,126 @@
+#!/bin/sh
+# run.sh - Runs the benchmark workloads and prints the results as JSON.
+#
+# Usage: bench/run.sh [runs]
+# Every workload is a generated script run by ./hsh (with and without
+# its script cache) and by dash and bash when they are installed. Each
+# shell runs each script once to warm up and then [runs] times (default
+# 10); the median and 99th percentile wall time and the lines executed
+# per second at the median are reported. The results of
+# bench/parser_bench and bench/expand_bench are included when they have
+# been built.
+#
+# One result is printed per line, so two runs can be compared with
+# bench/compare.sh. `make bench` writes them to bench.json.
+# The shell under test is taken from $HSH (default: ./hsh).
+
+HSH=${HSH:-./hsh}
+RUNS=${1:-10}
+BENCH=$(dirname "$0")
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+HSH_CACHE_DIR="$DIR/cache"
+export HSH_CACHE_DIR
+
+# workload - Writes the script of a workload.
+# $1: Name of the workload; $2: number of lines; $3: awk program
+# printing line i.
+workload()
+{
+	awk -v n="$2" "BEGIN { for (i = 0; i < n; i++) { $3 } }" \
+		>"$DIR/$1.sh"
+	printf '%s %s\n' "$1" "$2" >>"$DIR/workloads"
+}
+
+workload fork 2000 'print "/bin/true"'
+workload pipeline 200 \
+	'print "/bin/echo " i " | /bin/cat | /bin/cat | /bin/cat | /bin/cat | /bin/cat | /bin/cat | /bin/cat"'
+workload parse 50000 \
+	'print ": one \"two three\" '\''four'\'' \"\" '\'\'' && : five six || : seven " i'
+workload tokens 2000 \
+	's = ":"; for (j = 0; j < 256; j++) s = s " word" j; print s'
+workload assign 50000 \
+	'print "A=" i " B=two C='\''three four'\'' D=\"five six\" E=" i " :"'
+workload expand 20000 \
+	'if (!i) print "A=alpha B=\"beta gamma\" L=\"a b c d e f g h\""
+	 print ": $A \"$B\" ${C:-default} $L x$A \"${B}\"y $? $# \"$L\" " i'
+workload subst 20000 \
+	'print "A=$(pwd) B=\"$(printf %s " i ")\" C=$(echo a b)"'
+workload subst_fork 1000 'print "A=$(/bin/echo " i ")"'
+workload heredoc 1000 \
+	'print "/bin/cat <<EOF"
+	 for (j = 0; j < 20; j++) print "line " j " of " i " in $HOME"
+	 print "EOF"'
+workload heredoc_large 20 \
+	'print "/bin/cat <<'\''EOF'\''"
+	 for (j = 0; j < 4000; j++) print "line " j " of a large body " i
+	 print "EOF"'
+workload redirect 20000 'print "echo line " i " >>/dev/null 2>&1"'
+
+# The loop is parsed once and runs its condition and body 200000 times
+# each, which count as the lines executed.
+printf 'i=0\nwhile [ "$i" -lt 200000 ]; do\n\ti=$((i + 1))\ndone\n' \
+	>"$DIR/while.sh"
+printf 'while 400000\n' >>"$DIR/workloads"
+
+# sample - Prints the wall time of one run in nanoseconds.
+# $@: The command to run.
+sample()
+{
+	start=$(date +%s%N)
+	"$@" >/dev/null 2>&1
+	end=$(date +%s%N)
+	echo $((end - start))
+}
+
+# measure - Runs every workload with one shell and prints its results.
+# $1: Label of the shell; the rest: the command running a script.
+measure()
+{
+	label=$1
+	shift
+	while read -r name lines; do
+		printf '%s %s\n' "$label" "$name" >&2
+		"$@" "$DIR/$name.sh" >/dev/null 2>&1
+		i=0
+		while [ "$i" -lt "$RUNS" ]; do
+			sample "$@" "$DIR/$name.sh"
+			i=$((i + 1))
+		done | sort -n | awk -v shell="$label" -v workload="$name" \
+			-v lines="$lines" '
+			{ ns[NR] = $1 }
+			END {
+				median = ns[int(NR / 2) + 1]
+				p99 = ns[int((NR * 99 + 99) / 100)]
+				printf "{\"workload\":\"%s\",\"shell\":\"%s\",", \
+				       workload, shell
+				printf "\"lines\":%d,\"runs\":%d,", lines, NR
+				printf "\"median_ms\":%.3f,\"p99_ms\":%.3f,", \
+				       median / 1e6, p99 / 1e6
+				printf "\"lines_per_sec\":%.0f}\n", \
+				       lines / (median / 1e9)
+			}'
+	done <"$DIR/workloads"
+}
+
+# results - Prints every result, separated by commas.
+results()
+{
+	measure hsh "$HSH" --no-cache
+	measure hsh-cached "$HSH"
+	for shell in dash bash; do
+		path=$(command -v "$shell") && measure "$shell" "$path"
+	done
+	for micro in parser_bench expand_bench; do
+		if [ -x "$BENCH/$micro" ]; then
+			printf '%s\n' "$micro" >&2
+			"$BENCH/$micro"
+		fi
+	done
+}
+
+printf '{"commit":"%s","date":"%s","runs":%d,"results":[\n' \
+	"$(git -C "$BENCH" rev-parse --short HEAD 2>/dev/null)" \
+	"$(date -u +%Y-%m-%dT%H:%M:%SZ)" "$RUNS"
+results | sed '$!s/$/,/'
+printf ']}\n'
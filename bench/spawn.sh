@@ -0,0 +1,51 @@
+#!/bin/sh
+# spawn.sh - Measures how many external commands per second hsh starts.
+#
+# Usage: bench/spawn.sh [count] [rounds]
+# Runs a script of [count] /bin/true lines (default 5000) [rounds] times
+# (default 3) and reports the best round. The shell under test is taken
+# from $HSH (default: ./hsh). When $BASE names another build, such as
+# the one before posix_spawn(), it runs the same script in turn with
+# $HSH in every round and is reported next to it:
+#
+#   git worktree add /tmp/hsh-base 3d76428 && make -C /tmp/hsh-base
+#   BASE=/tmp/hsh-base/hsh bench/spawn.sh
+
+HSH=${HSH:-./hsh}
+COUNT=${1:-5000}
+ROUNDS=${2:-3}
+SCRIPT=$(mktemp)
+trap 'rm -f "$SCRIPT"' EXIT
+
+if [ -n "$BASE" ] && [ ! -x "$BASE" ]; then
+	echo "$0: $BASE: not an executable" >&2
+	exit 2
+fi
+
+yes /bin/true | head -n "$COUNT" >"$SCRIPT"
+
+# run - Prints the label and the time, in nanoseconds, of one run.
+# $1: Label; $2: the shell.
+run()
+{
+	start=$(date +%s%N)
+	"$2" <"$SCRIPT"
+	end=$(date +%s%N)
+	echo "$1 $((end - start))"
+}
+
+# The shells take turns in every round, so drift in the machine's load
+# affects them alike.
+round=0
+while [ "$round" -lt "$ROUNDS" ]; do
+	[ -n "$BASE" ] && run base "$BASE"
+	run hsh "$HSH"
+	round=$((round + 1))
+done | awk -v n="$COUNT" '
+	!($1 in best) || $2 < best[$1] { best[$1] = $2 }
+	END {
+		for (label in best)
+			printf "%-4s %d commands in %.1f ms: %.0f commands/sec\n",
+			       label, n, best[label] / 1e6,
+			       n / (best[label] / 1e9)
+	}' | sort
@@ -0,0 +1,136 @@
+#include <alias.h>
+#include <lexer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * alias_free - Frees an alias.
+ * @value: The alias.
+ */
+void alias_free(void *value)
+{
+	Alias *alias = value;
+
+	free(alias->tokens);
+	free(alias->value);
+	free(alias);
+}
+
+/**
+ * alias_tokenize - Lexes the value of an alias once and for all.
+ * @shell: Pointer to the shell state.
+ * @alias: The alias, whose value is set.
+ *
+ * The tokens are lexed into the shell's arena, then copied into an
+ * array of their own so they outlive the line defining the alias.
+ * Newlines become semicolons, as a line must not end inside an alias.
+ * The lexer has already reported a value that does not lex.
+ *
+ * Return: true on success, false if the value does not lex.
+ */
+static bool alias_tokenize(ShellState *shell, Alias *alias)
+{
+	Token *tokens = tokenize(shell, alias->value), *token;
+	size_t i = 0;
+
+	if (shell->had_error || shell->fatal_error) {
+		shell->had_error = false;
+		return false;
+	}
+	for (token = tokens; token; token = token->next)
+		alias->count++;
+	alias->tokens = malloc(sizeof(Token) * (alias->count + 1));
+	if (!alias->tokens) {
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+		return false;
+	}
+	for (token = tokens; token; token = token->next) {
+		alias->tokens[i] = *token;
+		alias->tokens[i].next = NULL;
+		if (token->type == TOKEN_EOL)
+			alias->tokens[i].type = TOKEN_SEMICOLON;
+		i++;
+	}
+	return true;
+}
+
+/**
+ * alias_define - Defines an alias, replacing any of the same name.
+ * @shell: Pointer to the shell state.
+ * @name: The name of the alias.
+ * @value: The text the name stands for.
+ *
+ * Return: true on success, false if @value does not lex or on
+ * allocation failure, after reporting why.
+ */
+bool alias_define(ShellState *shell, const char *name, const char *value)
+{
+	Alias *alias = calloc(1, sizeof(Alias));
+
+	if (!alias || !(alias->value = strdup(value))) {
+		free(alias);
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+		return false;
+	}
+	alias->length = strlen(value);
+	alias->blank = alias->length && (value[alias->length - 1] == ' ' ||
+					 value[alias->length - 1] == '\t');
+	if (!alias_tokenize(shell, alias)) {
+		alias_free(alias);
+		return false;
+	}
+	if (!table_insert(shell->aliases, name, alias)) {
+		alias_free(alias);
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+		return false;
+	}
+	shell->alias_generation++;
+	return true;
+}
+
+/**
+ * alias_find - Looks up an alias.
+ * @shell: Pointer to the shell state.
+ * @name: The name, not necessarily NUL terminated.
+ * @length: Length of @name.
+ *
+ * Return: The alias, or NULL if there is none of that name.
+ */
+Alias *alias_find(ShellState *shell, const char *name, size_t length)
+{
+	TableEntry *entry;
+
+	if (!shell->aliases->count)
+		return NULL;
+	entry = table_find_n(shell->aliases, name, length);
+	return entry ? entry->value : NULL;
+}
+
+/**
+ * alias_remove - Removes an alias.
+ * @shell: Pointer to the shell state.
+ * @name: The name of the alias.
+ *
+ * Return: true if it was removed, false if there was none.
+ */
+bool alias_remove(ShellState *shell, const char *name)
+{
+	if (!table_remove(shell->aliases, name))
+		return false;
+	shell->alias_generation++;
+	return true;
+}
+
+/**
+ * alias_clear - Removes every alias.
+ * @shell: Pointer to the shell state.
+ */
+void alias_clear(ShellState *shell)
+{
+	table_clear(shell->aliases);
+	shell->alias_generation++;
+}
@@ -0,0 +1,199 @@
+#include <arena.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE 8192
+
+/**
+ * arena_align - Rounds a size up to the strictest fundamental alignment.
+ * @size: The size to round.
+ *
+ * Return: The rounded size.
+ */
+static size_t arena_align(size_t size)
+{
+	size_t align = _Alignof(max_align_t);
+
+	return (size + align - 1) & ~(align - 1);
+}
+
+/**
+ * arena_block_new - Allocates an empty arena block.
+ * @capacity: Number of usable bytes in the block.
+ *
+ * Return: Pointer to the new block, or NULL on failure.
+ */
+static ArenaBlock *arena_block_new(size_t capacity)
+{
+	ArenaBlock *block = malloc(sizeof(ArenaBlock) + capacity);
+	if (!block)
+		return NULL;
+
+	block->next = NULL;
+	block->capacity = capacity;
+	block->used = 0;
+	return block;
+}
+
+/**
+ * arena_new - Creates an arena with a single empty block.
+ *
+ * Return: Pointer to the new arena, or NULL on failure.
+ */
+Arena *arena_new(void)
+{
+	Arena *arena = malloc(sizeof(Arena));
+	if (!arena)
+		return NULL;
+
+	arena->first = arena_block_new(ARENA_BLOCK_SIZE);
+	if (!arena->first) {
+		free(arena);
+		return NULL;
+	}
+	arena->current = arena->first;
+	arena->last = NULL;
+	return arena;
+}
+
+/**
+ * arena_free - Frees an arena and every block it owns.
+ * @arena: The arena to free.
+ */
+void arena_free(Arena *arena)
+{
+	if (!arena)
+		return;
+
+	ArenaBlock *block = arena->first;
+	while (block) {
+		ArenaBlock *next = block->next;
+		free(block);
+		block = next;
+	}
+	free(arena);
+}
+
+/**
+ * arena_reset - Releases every allocation made from an arena at once.
+ * @arena: The arena to reset.
+ *
+ * Blocks are kept for reuse; each one is marked empty only when the
+ * allocator moves onto it again.
+ */
+void arena_reset(Arena *arena)
+{
+	arena->current = arena->first;
+	arena->first->used = 0;
+	arena->last = NULL;
+}
+
+/**
+ * arena_alloc - Allocates memory from an arena.
+ * @arena: The arena to allocate from.
+ * @size: Number of bytes to allocate.
+ *
+ * Return: Pointer to suitably aligned memory, or NULL on failure.
+ */
+void *arena_alloc(Arena *arena, size_t size)
+{
+	ArenaBlock *block = arena->current;
+	void *ptr;
+
+	size = arena_align(size);
+	while (block->used + size > block->capacity) {
+		if (!block->next) {
+			size_t capacity = size > ARENA_BLOCK_SIZE ?
+						  size :
+						  ARENA_BLOCK_SIZE;
+			block->next = arena_block_new(capacity);
+			if (!block->next)
+				return NULL;
+		}
+		block = block->next;
+		block->used = 0;
+	}
+
+	ptr = (char *)block->data + block->used;
+	block->used += size;
+	arena->current = block;
+	arena->last = ptr;
+	return ptr;
+}
+
+/**
+ * arena_grow - Resizes the most recent allocation of an arena.
+ * @arena: The arena owning @ptr.
+ * @ptr: The allocation to grow, or NULL to allocate.
+ * @old_size: Current size of @ptr.
+ * @new_size: Requested size.
+ *
+ * The allocation is extended in place when it is the last one in its
+ * block, and copied to fresh arena memory otherwise.
+ *
+ * Return: Pointer to the resized memory, or NULL on failure.
+ */
+void *arena_grow(Arena *arena, void *ptr, size_t old_size, size_t new_size)
+{
+	if (ptr && ptr == arena->last) {
+		ArenaBlock *block = arena->current;
+		size_t offset = (char *)ptr - (char *)block->data;
+		size_t needed = arena_align(new_size);
+
+		if (offset + needed <= block->capacity) {
+			block->used = offset + needed;
+			return ptr;
+		}
+	}
+
+	void *fresh = arena_alloc(arena, new_size);
+	if (fresh && ptr)
+		memcpy(fresh, ptr, old_size < new_size ? old_size : new_size);
+	return fresh;
+}
+
+/**
+ * arena_strndup - Copies a string into an arena.
+ * @arena: The arena to allocate from.
+ * @str: The string to copy.
+ * @length: Number of bytes of @str to copy.
+ *
+ * Return: The NUL terminated copy, or NULL on failure.
+ */
+char *arena_strndup(Arena *arena, const char *str, size_t length)
+{
+	char *copy = arena_alloc(arena, length + 1);
+	if (!copy)
+		return NULL;
+
+	memcpy(copy, str, length);
+	copy[length] = '\0';
+	return copy;
+}
+
+/**
+ * arena_mark - Records the current position of an arena.
+ * @arena: The arena.
+ *
+ * Return: The position, to be passed to arena_rewind().
+ */
+ArenaMark arena_mark(const Arena *arena)
+{
+	return (ArenaMark){ .block = arena->current,
+			    .used = arena->current->used };
+}
+
+/**
+ * arena_rewind - Releases every allocation made since a position.
+ * @arena: The arena.
+ * @mark: A position taken with arena_mark() since the last reset.
+ *
+ * As with arena_reset(), the blocks past the position are kept and
+ * reused.
+ */
+void arena_rewind(Arena *arena, ArenaMark mark)
+{
+	arena->current = mark.block;
+	mark.block->used = mark.used;
+	arena->last = NULL;
+}
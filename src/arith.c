@@ -0,0 +1,416 @@
+#include <arith.h>
+#include <arena.h>
+#include <utils.h>
+#include <vars.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * State of the evaluation of one arithmetic expression. skip counts the
+ * operands being parsed only, on the side of a && || or ?: that is not
+ * taken: they neither assign nor fail on a division by zero.
+ */
+typedef struct Arith {
+	ShellState *shell;
+	const char *text;
+	const char *p;
+	int skip;
+	bool failed;
+} Arith;
+
+/*
+ * The binary operators, longest first where one is the prefix of
+ * another, with their precedence: the higher, the tighter it binds.
+ */
+static const struct {
+	const char *op;
+	int precedence;
+} arith_ops[] = {
+	{ "||", 1 }, { "&&", 2 }, { "==", 6 }, { "!=", 6 }, { "<=", 7 },
+	{ ">=", 7 }, { "<<", 8 }, { ">>", 8 }, { "|", 3 },  { "^", 4 },
+	{ "&", 5 },  { "<", 7 },  { ">", 7 },  { "+", 9 },  { "-", 9 },
+	{ "*", 10 }, { "/", 10 }, { "%", 10 },
+};
+
+static intmax_t arith_assign(Arith *a);
+
+/**
+ * arith_error - Reports a malformed expression, once.
+ * @a: The evaluation state.
+ * @message: Description of the problem.
+ *
+ * Return: 0, so callers can return the result directly.
+ */
+static intmax_t arith_error(Arith *a, const char *message)
+{
+	if (!a->failed) {
+		fprintf(stderr, "%s: %d: arithmetic expression: %s: \"%s\"\n",
+			a->shell->name, a->shell->line_number, message,
+			a->text);
+		a->shell->had_error = true;
+	}
+	a->failed = true;
+	return 0;
+}
+
+/**
+ * arith_blanks - Skips the blanks at the current position.
+ * @a: The evaluation state.
+ */
+static void arith_blanks(Arith *a)
+{
+	while (*a->p == ' ' || *a->p == '\t' || *a->p == '\n')
+		a->p++;
+}
+
+/**
+ * arith_name_length - Measures the variable name at a position.
+ * @p: The text.
+ *
+ * Return: Length of the name, or 0 if there is none.
+ */
+static size_t arith_name_length(const char *p)
+{
+	size_t n = 0;
+
+	while (p[n] == '_' || (p[n] >= 'a' && p[n] <= 'z') ||
+	       (p[n] >= 'A' && p[n] <= 'Z') ||
+	       (n && p[n] >= '0' && p[n] <= '9'))
+		n++;
+	return n;
+}
+
+/**
+ * arith_variable - Reads the value of a variable as a number.
+ * @a: The evaluation state.
+ * @name: The name.
+ * @length: Length of @name.
+ *
+ * Return: The value, 0 if the variable is unset or empty.
+ */
+static intmax_t arith_variable(Arith *a, const char *name, size_t length)
+{
+	const char *value = vars_get_n(&a->shell->vars, name, length);
+	char *end;
+	intmax_t number;
+
+	if (!value || !*value)
+		return 0;
+	number = strtoimax(value, &end, 0);
+	if (end == value || *end)
+		return arith_error(a, "bad number");
+	return number;
+}
+
+/**
+ * arith_store - Assigns a number to a variable.
+ * @a: The evaluation state.
+ * @name: The name.
+ * @length: Length of @name.
+ * @value: The number.
+ */
+static void arith_store(Arith *a, const char *name, size_t length,
+			intmax_t value)
+{
+	char *assignment = arena_alloc(a->shell->arena, length + 24);
+
+	if (!assignment) {
+		fprintf(stderr, "Error: malloc failed\n");
+		a->shell->fatal_error = true;
+		a->failed = true;
+		return;
+	}
+	snprintf(assignment, length + 24, "%.*s=%jd", (int)length, name, value);
+	if (!vars_set(&a->shell->vars, assignment, 0)) {
+		fprintf(stderr, "Error: malloc failed\n");
+		a->shell->fatal_error = true;
+		a->failed = true;
+	}
+}
+
+/**
+ * arith_apply - Applies a binary operator.
+ * @a: The evaluation state.
+ * @op: The operator.
+ * @length: Length of @op.
+ * @left: The left operand.
+ * @right: The right operand.
+ *
+ * Sums, differences, products and shifts wrap around instead of
+ * overflowing.
+ *
+ * Return: The result.
+ */
+static intmax_t arith_apply(Arith *a, const char *op, size_t length,
+			    intmax_t left, intmax_t right)
+{
+	uintmax_t l = left, r = right;
+
+	if (length == 2) {
+		switch (*op) {
+		case '=':
+			return left == right;
+		case '!':
+			return left != right;
+		case '<':
+			return op[1] == '=' ? left <= right :
+					      (intmax_t)(l << (r & 63));
+		case '>':
+			return op[1] == '=' ? left >= right : left >> (r & 63);
+		case '&':
+			return left && right;
+		default:
+			return left || right;
+		}
+	}
+	switch (*op) {
+	case '|':
+		return left | right;
+	case '^':
+		return left ^ right;
+	case '&':
+		return left & right;
+	case '<':
+		return left < right;
+	case '>':
+		return left > right;
+	case '+':
+		return (intmax_t)(l + r);
+	case '-':
+		return (intmax_t)(l - r);
+	case '*':
+		return (intmax_t)(l * r);
+	}
+	if (!right)
+		return a->skip ? 0 : arith_error(a, "division by zero");
+	if (right == -1)
+		return *op == '/' ? (intmax_t)(0 - l) : 0;
+	return *op == '/' ? left / right : left % right;
+}
+
+/**
+ * arith_primary - Evaluates a number, a variable or a parenthesized
+ *                 expression.
+ * @a: The evaluation state.
+ *
+ * Return: The value.
+ */
+static intmax_t arith_primary(Arith *a)
+{
+	const char *start;
+	char *end;
+	intmax_t value;
+	size_t length;
+
+	arith_blanks(a);
+	start = a->p;
+	if (*start == '(') {
+		a->p++;
+		value = arith_assign(a);
+		arith_blanks(a);
+		if (*a->p != ')')
+			return arith_error(a, "expecting ')'");
+		a->p++;
+		return value;
+	}
+	if (*start >= '0' && *start <= '9') {
+		value = strtoimax(start, &end, 0);
+		a->p = end;
+		if (arith_name_length(end) || (*end >= '0' && *end <= '9'))
+			return arith_error(a, "bad number");
+		return value;
+	}
+	length = arith_name_length(start);
+	if (!length)
+		return arith_error(a, "expecting primary");
+	a->p += length;
+	return arith_variable(a, start, length);
+}
+
+/**
+ * arith_unary - Evaluates an operand with its unary operators.
+ * @a: The evaluation state.
+ *
+ * Return: The value.
+ */
+static intmax_t arith_unary(Arith *a)
+{
+	arith_blanks(a);
+	switch (*a->p) {
+	case '+':
+		a->p++;
+		return arith_unary(a);
+	case '-':
+		a->p++;
+		return (intmax_t)(0 - (uintmax_t)arith_unary(a));
+	case '!':
+		a->p++;
+		return !arith_unary(a);
+	case '~':
+		a->p++;
+		return ~arith_unary(a);
+	default:
+		return arith_primary(a);
+	}
+}
+
+/**
+ * arith_operator - Finds the binary operator at a position.
+ * @p: The text.
+ *
+ * Return: Index of the operator in arith_ops, or -1 if there is none.
+ */
+static int arith_operator(const char *p)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(arith_ops); i++) {
+		if (!strncmp(p, arith_ops[i].op, strlen(arith_ops[i].op)))
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * arith_binary - Evaluates operands joined by binary operators.
+ * @a: The evaluation state.
+ * @precedence: The lowest precedence of an operator to take.
+ *
+ * The right operand of && or || is only parsed when the left one
+ * decides the result.
+ *
+ * Return: The value.
+ */
+static intmax_t arith_binary(Arith *a, int precedence)
+{
+	intmax_t left = arith_unary(a), right;
+	const char *op;
+	size_t length;
+	bool decided;
+	int i;
+
+	for (;;) {
+		arith_blanks(a);
+		i = arith_operator(a->p);
+		if (i < 0 || arith_ops[i].precedence < precedence)
+			return left;
+		op = arith_ops[i].op;
+		length = strlen(op);
+		a->p += length;
+		decided = length == 2 &&
+			  ((*op == '&' && !left) || (*op == '|' && left));
+		a->skip += decided;
+		right = arith_binary(a, arith_ops[i].precedence + 1);
+		a->skip -= decided;
+		left = decided ? *op == '|' :
+				 arith_apply(a, op, length, left, right);
+	}
+}
+
+/**
+ * arith_ternary - Evaluates a conditional expression.
+ * @a: The evaluation state.
+ *
+ * Return: The value.
+ */
+static intmax_t arith_ternary(Arith *a)
+{
+	intmax_t condition = arith_binary(a, 1), then, otherwise;
+
+	arith_blanks(a);
+	if (*a->p != '?')
+		return condition;
+	a->p++;
+	a->skip += !condition;
+	then = arith_assign(a);
+	a->skip -= !condition;
+	arith_blanks(a);
+	if (*a->p != ':')
+		return arith_error(a, "expecting ':'");
+	a->p++;
+	a->skip += !!condition;
+	otherwise = arith_ternary(a);
+	a->skip -= !!condition;
+	return condition ? then : otherwise;
+}
+
+/**
+ * arith_assign_length - Measures the assignment operator at a position.
+ * @p: The text.
+ *
+ * Return: Length of the operator, or 0 if there is none.
+ */
+static size_t arith_assign_length(const char *p)
+{
+	if (*p == '=')
+		return p[1] != '=';
+	if ((*p == '<' || *p == '>') && p[1] == *p && p[2] == '=')
+		return 3;
+	if (*p && strchr("+-*/%&^|", *p) && p[1] == '=')
+		return 2;
+	return 0;
+}
+
+/**
+ * arith_assign - Evaluates an expression, assignments included.
+ * @a: The evaluation state.
+ *
+ * Assignments bind right to left, and `name op= value` applies op to
+ * the variable and the value.
+ *
+ * Return: The value.
+ */
+static intmax_t arith_assign(Arith *a)
+{
+	const char *name;
+	size_t length, op;
+	intmax_t value;
+
+	arith_blanks(a);
+	name = a->p;
+	length = arith_name_length(name);
+	if (length) {
+		a->p += length;
+		arith_blanks(a);
+		op = arith_assign_length(a->p);
+		if (op) {
+			const char *text = a->p;
+
+			a->p += op;
+			value = arith_assign(a);
+			if (op > 1)
+				value = arith_apply(
+					a, text, op - 1,
+					arith_variable(a, name, length), value);
+			if (!a->skip && !a->failed)
+				arith_store(a, name, length, value);
+			return value;
+		}
+		a->p = name;
+	}
+	return arith_ternary(a);
+}
+
+/**
+ * arith_eval - Evaluates the expression of a $((...)) expansion.
+ * @shell: Pointer to the shell state.
+ * @text: The expression, its parameters already expanded.
+ * @value: Receives the value.
+ *
+ * Numbers are decimal, octal with a leading 0 or hexadecimal with a
+ * leading 0x; variables may be named without a '$'. The operators are
+ * those of C but for ++, -- and the comma, with the same precedence.
+ *
+ * Return: true on success, false after reporting a malformed expression
+ * or a division by zero.
+ */
+bool arith_eval(ShellState *shell, const char *text, intmax_t *value)
+{
+	Arith a = { .shell = shell, .text = text, .p = text };
+
+	arith_blanks(&a);
+	*value = *a.p ? arith_assign(&a) : 0;
+	arith_blanks(&a);
+	if (*a.p)
+		arith_error(&a, "expecting EOF");
+	return !a.failed;
+}
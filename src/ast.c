@@ -0,0 +1,601 @@
+#include <ast.h>
+#include <match.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AST_INITIAL_CAPACITY 64
+
+/**
+ * ast_reserve - Makes room for more elements in one of the AST's arrays.
+ * @array: Pointer to the array.
+ * @capacity: Pointer to the number of allocated elements.
+ * @count: Number of elements in use.
+ * @extra: Number of elements needed beyond @count.
+ * @size: Size of one element.
+ *
+ * Return: true on success, false on allocation failure or overflow.
+ */
+static bool ast_reserve(void **array, uint32_t *capacity, uint32_t count,
+			uint32_t extra, size_t size)
+{
+	size_t needed = (size_t)count + extra;
+	size_t grown = *capacity ? *capacity : AST_INITIAL_CAPACITY;
+
+	if (needed <= *capacity)
+		return true;
+	if (needed >= AST_NONE)
+		return false;
+	while (grown < needed)
+		grown *= 2;
+	if (grown >= AST_NONE)
+		grown = AST_NONE - 1;
+
+	void *resized = realloc(*array, grown * size);
+	if (!resized)
+		return false;
+	*array = resized;
+	*capacity = grown;
+	return true;
+}
+
+/**
+ * ast_free - Frees the arrays of an AST.
+ * @ast: The AST to free.
+ */
+void ast_free(Ast *ast)
+{
+	ast_free_matchers(ast);
+	free(ast->matchers);
+	free(ast->nodes);
+	free(ast->words);
+	free(ast->refs);
+	free(ast->redirects);
+	memset(ast, 0, sizeof(Ast));
+}
+
+/**
+ * ast_reset - Empties an AST while keeping its arrays for reuse.
+ * @ast: The AST to reset.
+ */
+void ast_reset(Ast *ast)
+{
+	ast->node_count = 0;
+	ast->word_count = 0;
+	ast->ref_count = 0;
+	ast->redirect_count = 0;
+	ast_free_matchers(ast);
+}
+
+/**
+ * ast_free_matchers - Frees the compiled patterns of an AST's case
+ *                     commands, and gives up their slots.
+ * @ast: The AST.
+ */
+void ast_free_matchers(Ast *ast)
+{
+	for (uint32_t i = 0; i < ast->case_count; i++)
+		match_free(ast->matchers[i]);
+	ast->case_count = 0;
+}
+
+/**
+ * ast_case_slot - Gives a case command a slot for its matcher.
+ * @ast: The AST holding the command.
+ *
+ * Return: The slot, or AST_NO_SLOT if the slots ran out or on
+ * allocation failure, for a command whose patterns are compiled every
+ * time it runs.
+ */
+static uint16_t ast_case_slot(Ast *ast)
+{
+	if (ast->case_count >= AST_NO_SLOT ||
+	    !ast_reserve((void **)&ast->matchers, &ast->case_capacity,
+			 ast->case_count, 1, sizeof(struct CaseMatcher *)))
+		return AST_NO_SLOT;
+	ast->matchers[ast->case_count] = NULL;
+	return ast->case_count++;
+}
+
+/**
+ * ast_add_node - Appends a node to an AST.
+ * @ast: The AST to append to.
+ * @node: The node to copy.
+ *
+ * Return: Index of the new node, or AST_NONE on allocation failure.
+ */
+NodeIndex ast_add_node(Ast *ast, const Node *node)
+{
+	if (!ast_reserve((void **)&ast->nodes, &ast->node_capacity,
+			 ast->node_count, 1, sizeof(Node)))
+		return AST_NONE;
+	ast->nodes[ast->node_count] = *node;
+	if (node->type == CMD_CASE)
+		ast->nodes[ast->node_count].slot = ast_case_slot(ast);
+	return ast->node_count++;
+}
+
+/**
+ * ast_add_word - Appends a word, or a NULL terminator, to the word pool.
+ * @ast: The AST to append to.
+ * @word: The word to append, or NULL.
+ *
+ * Return: Index of the word, or AST_NONE on allocation failure.
+ */
+uint32_t ast_add_word(Ast *ast, char *word)
+{
+	if (!ast_reserve((void **)&ast->words, &ast->word_capacity,
+			 ast->word_count, 1, sizeof(char *)))
+		return AST_NONE;
+	ast->words[ast->word_count] = word;
+	return ast->word_count++;
+}
+
+/**
+ * ast_add_refs - Appends a list of node indices to the reference pool.
+ * @ast: The AST to append to.
+ * @refs: The node indices to copy.
+ * @count: Number of indices.
+ *
+ * Return: Index of the first copied reference, or AST_NONE on failure.
+ */
+uint32_t ast_add_refs(Ast *ast, const NodeIndex *refs, uint32_t count)
+{
+	uint32_t first = ast->ref_count;
+
+	if (!ast_reserve((void **)&ast->refs, &ast->ref_capacity,
+			 ast->ref_count, count, sizeof(NodeIndex)))
+		return AST_NONE;
+	memcpy(ast->refs + first, refs, sizeof(NodeIndex) * count);
+	ast->ref_count += count;
+	return first;
+}
+
+/**
+ * ast_add_redirect - Appends a redirection to the redirection pool.
+ * @ast: The AST to append to.
+ * @redirect: The redirection to copy.
+ *
+ * Return: Index of the redirection, or AST_NONE on allocation failure.
+ */
+uint32_t ast_add_redirect(Ast *ast, const Redirect *redirect)
+{
+	if (!ast_reserve((void **)&ast->redirects, &ast->redirect_capacity,
+			 ast->redirect_count, 1, sizeof(Redirect)))
+		return AST_NONE;
+	ast->redirects[ast->redirect_count] = *redirect;
+	return ast->redirect_count++;
+}
+
+/**
+ * ast_simple - Describes a simple command node with pointers.
+ * @ast: The AST holding the node.
+ * @node: A CMD_SIMPLE node.
+ * @simple: Receives the command's argv, envp and redirections.
+ *
+ * The vectors point straight into the word pool, so nothing is copied.
+ */
+void ast_simple(const Ast *ast, const Node *node, SimpleCommand *simple)
+{
+	simple->argc = node->as.simple.argc;
+	simple->argv = ast->words + node->as.simple.argv;
+	simple->envp = ast->words + node->as.simple.envp;
+	simple->redirects = ast->redirects + node->as.simple.redirects;
+	simple->targets = ast->words + node->as.simple.targets;
+	simple->subst_status = -1;
+}
+
+/**
+ * ast_copy_word - Copies a word, or a NULL terminator, into an AST.
+ * @dst: The AST to append to.
+ * @word: The word, or NULL.
+ * @arena: Holds the copy of the word's text.
+ *
+ * Return: Index of the copy in @dst, or AST_NONE on allocation failure.
+ */
+static uint32_t ast_copy_word(Ast *dst, const char *word, Arena *arena)
+{
+	char *copy = NULL;
+
+	if (word && !(copy = arena_strndup(arena, word, strlen(word))))
+		return AST_NONE;
+	return ast_add_word(dst, copy);
+}
+
+/**
+ * ast_copy_vector - Copies a NULL terminated vector of words.
+ * @dst: The AST to append to.
+ * @src: The AST holding the vector.
+ * @first: Index of the vector's first word in @src.
+ * @arena: Holds the copies of the words' text.
+ *
+ * Return: Index of the copy in @dst, or AST_NONE on allocation failure.
+ */
+static uint32_t ast_copy_vector(Ast *dst, const Ast *src, uint32_t first,
+				Arena *arena)
+{
+	uint32_t copy = dst->word_count;
+
+	for (char **word = src->words + first;; word++) {
+		if (ast_copy_word(dst, *word, arena) == AST_NONE)
+			return AST_NONE;
+		if (!*word)
+			return copy;
+	}
+}
+
+/**
+ * ast_copy_refs - Copies the commands of a reference list.
+ * @dst: The AST to append to.
+ * @src: The AST holding the list.
+ * @first: Index of the list's first reference in @src.
+ * @count: Number of commands in the list.
+ * @arena: Holds the copies of the words' text.
+ *
+ * Return: Index of the copied list in @dst, or AST_NONE on allocation
+ * failure.
+ */
+static uint32_t ast_copy_refs(Ast *dst, const Ast *src, uint32_t first,
+			      uint32_t count, Arena *arena)
+{
+	NodeIndex *refs = arena_alloc(arena, sizeof(NodeIndex) * count);
+
+	if (!refs)
+		return AST_NONE;
+	for (uint32_t i = 0; i < count; i++) {
+		refs[i] = ast_copy(dst, src, src->refs[first + i], arena);
+		if (refs[i] == AST_NONE)
+			return AST_NONE;
+	}
+	return ast_add_refs(dst, refs, count);
+}
+
+/**
+ * ast_copy_child - Copies a command a node may do without.
+ * @dst: The AST to append to.
+ * @src: The AST holding the command.
+ * @index: Index of the command in @src, or AST_NONE; set to the index
+ *         of the copy.
+ * @arena: Holds the copies of the words' text.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool ast_copy_child(Ast *dst, const Ast *src, NodeIndex *index,
+			   Arena *arena)
+{
+	if (*index == AST_NONE)
+		return true;
+	*index = ast_copy(dst, src, *index, arena);
+	return *index != AST_NONE;
+}
+
+/**
+ * ast_copy - Copies a command and everything below it into another AST.
+ * @dst: The AST to append to.
+ * @src: The AST holding the command.
+ * @index: Index of the command's node in @src.
+ * @arena: Holds the copies of the words' text.
+ *
+ * The copy stays valid after @src and the memory its words live in are
+ * gone, so a command can outlive the line it was parsed from.
+ *
+ * Return: Index of the copy in @dst, or AST_NONE on allocation failure.
+ */
+NodeIndex ast_copy(Ast *dst, const Ast *src, NodeIndex index, Arena *arena)
+{
+	Node node = src->nodes[index];
+	uint32_t i, redirect;
+
+	switch (node.type) {
+	case CMD_SIMPLE:
+		node.as.simple.envp = ast_copy_vector(
+			dst, src, node.as.simple.envp, arena);
+		node.as.simple.argv = ast_copy_vector(
+			dst, src, node.as.simple.argv, arena);
+		if (node.as.simple.envp == AST_NONE ||
+		    node.as.simple.argv == AST_NONE)
+			return AST_NONE;
+		redirect = dst->redirect_count;
+		for (i = 0; src->words[node.as.simple.targets + i]; i++) {
+			if (ast_add_redirect(dst, &src->redirects[
+				    node.as.simple.redirects + i]) == AST_NONE)
+				return AST_NONE;
+		}
+		node.as.simple.redirects = redirect;
+		node.as.simple.targets = ast_copy_vector(
+			dst, src, node.as.simple.targets, arena);
+		if (node.as.simple.targets == AST_NONE)
+			return AST_NONE;
+		break;
+	case CMD_PIPE:
+		node.as.pipeline.stages =
+			ast_copy_refs(dst, src, node.as.pipeline.stages,
+				      node.as.pipeline.count, arena);
+		if (node.as.pipeline.stages == AST_NONE)
+			return AST_NONE;
+		break;
+	case CMD_LIST:
+		node.as.list.items = ast_copy_refs(
+			dst, src, node.as.list.items, node.as.list.count, arena);
+		if (node.as.list.items == AST_NONE)
+			return AST_NONE;
+		break;
+	case CMD_IF:
+	case CMD_WHILE:
+	case CMD_UNTIL:
+		if (!ast_copy_child(dst, src, &node.as.branch.condition,
+				    arena) ||
+		    !ast_copy_child(dst, src, &node.as.branch.body, arena) ||
+		    !ast_copy_child(dst, src, &node.as.branch.otherwise, arena))
+			return AST_NONE;
+		break;
+	case CMD_FOR:
+		node.as.loop.name =
+			ast_copy_vector(dst, src, node.as.loop.name, arena);
+		if (node.as.loop.name == AST_NONE ||
+		    !ast_copy_child(dst, src, &node.as.loop.words, arena) ||
+		    !ast_copy_child(dst, src, &node.as.loop.body, arena))
+			return AST_NONE;
+		break;
+	case CMD_CASE:
+		node.as.cases.word =
+			ast_copy_vector(dst, src, node.as.cases.word, arena);
+		if (node.as.cases.word == AST_NONE)
+			return AST_NONE;
+		node.as.cases.arms = ast_copy_refs(dst, src, node.as.cases.arms,
+						   node.as.cases.count, arena);
+		if (node.as.cases.arms == AST_NONE)
+			return AST_NONE;
+		break;
+	case CMD_ARM:
+		node.as.arm.patterns =
+			ast_copy_vector(dst, src, node.as.arm.patterns, arena);
+		if (node.as.arm.patterns == AST_NONE ||
+		    !ast_copy_child(dst, src, &node.as.arm.body, arena))
+			return AST_NONE;
+		break;
+	case CMD_FUNCTION:
+		node.as.function.name = ast_copy_vector(
+			dst, src, node.as.function.name, arena);
+		if (node.as.function.name == AST_NONE ||
+		    !ast_copy_child(dst, src, &node.as.function.body, arena))
+			return AST_NONE;
+		break;
+	default:
+		node.as.binary.left = ast_copy(dst, src, node.as.binary.left,
+					       arena);
+		if (node.as.binary.left == AST_NONE)
+			return AST_NONE;
+		node.as.binary.right = ast_copy(dst, src, node.as.binary.right,
+						arena);
+		if (node.as.binary.right == AST_NONE)
+			return AST_NONE;
+		break;
+	}
+	return ast_add_node(dst, &node);
+}
+
+/**
+ * ast_append - Appends text to a description, truncating it to fit.
+ * @buffer: The description.
+ * @size: Size of @buffer.
+ * @length: Length of the description so far.
+ * @text: The text to append.
+ *
+ * Return: The new untruncated length of the description.
+ */
+static size_t ast_append(char *buffer, size_t size, size_t length,
+			 const char *text)
+{
+	size_t n = strlen(text);
+
+	if (length + 1 < size) {
+		size_t room = size - length - 1;
+		size_t copied = n < room ? n : room;
+
+		memcpy(buffer + length, text, copied);
+		buffer[length + copied] = '\0';
+	}
+	return length + n;
+}
+
+static size_t ast_format_node(const Ast *ast, NodeIndex index, char *buffer,
+			      size_t size, size_t length);
+
+/**
+ * ast_format_words - Appends a NULL terminated vector of words.
+ * @words: The words.
+ * @separator: Text put between two words.
+ * @buffer: The description.
+ * @size: Size of @buffer.
+ * @length: Length of the description so far.
+ *
+ * Return: The new untruncated length of the description.
+ */
+static size_t ast_format_words(char **words, const char *separator,
+			       char *buffer, size_t size, size_t length)
+{
+	for (; *words; words++) {
+		length = ast_append(buffer, size, length, *words);
+		if (words[1])
+			length = ast_append(buffer, size, length, separator);
+	}
+	return length;
+}
+
+/**
+ * ast_format_body - Appends a command between two reserved words.
+ * @ast: The AST holding the command.
+ * @index: Index of the command's node.
+ * @open: The text before the command.
+ * @close: The text after the command.
+ * @buffer: The description.
+ * @size: Size of @buffer.
+ * @length: Length of the description so far.
+ *
+ * Return: The new untruncated length of the description.
+ */
+static size_t ast_format_body(const Ast *ast, NodeIndex index,
+			      const char *open, const char *close,
+			      char *buffer, size_t size, size_t length)
+{
+	length = ast_append(buffer, size, length, open);
+	if (index != AST_NONE)
+		length = ast_format_node(ast, index, buffer, size, length);
+	return ast_append(buffer, size, length, close);
+}
+
+/**
+ * ast_format_compound - Appends the description of a compound command.
+ * @ast: The AST holding the command.
+ * @node: The command's node.
+ * @buffer: The description.
+ * @size: Size of @buffer.
+ * @length: Length of the description so far.
+ *
+ * Return: The new untruncated length of the description.
+ */
+static size_t ast_format_compound(const Ast *ast, const Node *node,
+				  char *buffer, size_t size, size_t length)
+{
+	const Node *arm;
+
+	switch (node->type) {
+	case CMD_IF:
+		length = ast_format_body(ast, node->as.branch.condition, "if ",
+					 "; ", buffer, size, length);
+		length = ast_format_body(ast, node->as.branch.body, "then ",
+					 "; ", buffer, size, length);
+		if (node->as.branch.otherwise != AST_NONE)
+			length = ast_format_body(ast, node->as.branch.otherwise,
+						 "else ", "; ", buffer, size,
+						 length);
+		return ast_append(buffer, size, length, "fi");
+	case CMD_WHILE:
+	case CMD_UNTIL:
+		length = ast_format_body(ast, node->as.branch.condition,
+					 node->type == CMD_WHILE ? "while " :
+								   "until ",
+					 "; ", buffer, size, length);
+		return ast_format_body(ast, node->as.branch.body, "do ",
+				       "; done", buffer, size, length);
+	case CMD_FOR:
+		length = ast_append(buffer, size, length, "for ");
+		length = ast_append(buffer, size, length,
+				    ast->words[node->as.loop.name]);
+		if (node->as.loop.words != AST_NONE) {
+			length = ast_append(buffer, size, length, " in ");
+			length = ast_format_node(ast, node->as.loop.words,
+						 buffer, size, length);
+		}
+		return ast_format_body(ast, node->as.loop.body, "; do ",
+				       "; done", buffer, size, length);
+	case CMD_CASE:
+		length = ast_append(buffer, size, length, "case ");
+		length = ast_append(buffer, size, length,
+				    ast->words[node->as.cases.word]);
+		length = ast_append(buffer, size, length, " in ");
+		for (uint32_t i = 0; i < node->as.cases.count; i++) {
+			arm = &ast->nodes[ast->refs[node->as.cases.arms + i]];
+			length = ast_format_words(ast->words +
+							  arm->as.arm.patterns,
+						  " | ", buffer, size, length);
+			length = ast_format_body(ast, arm->as.arm.body, ") ",
+						 ";; ", buffer, size, length);
+		}
+		return ast_append(buffer, size, length, "esac");
+	case CMD_FUNCTION:
+		length = ast_append(buffer, size, length,
+				    ast->words[node->as.function.name]);
+		return ast_format_body(ast, node->as.function.body, "() { ",
+				       "; }", buffer, size, length);
+	default:
+		return length;
+	}
+}
+
+/**
+ * ast_format_node - Appends the description of a command.
+ * @ast: The AST holding the command.
+ * @index: Index of the command's node.
+ * @buffer: The description.
+ * @size: Size of @buffer.
+ * @length: Length of the description so far.
+ *
+ * Return: The new untruncated length of the description.
+ */
+static size_t ast_format_node(const Ast *ast, NodeIndex index, char *buffer,
+			      size_t size, size_t length)
+{
+	const Node *node = &ast->nodes[index];
+	const char *op = " && ";
+
+	switch (node->type) {
+	case CMD_SIMPLE:
+		for (char **word = ast->words + node->as.simple.envp; *word;
+		     word++) {
+			length = ast_append(buffer, size, length, *word);
+			if (word[1] || node->as.simple.argc)
+				length = ast_append(buffer, size, length, " ");
+		}
+		return ast_format_words(ast->words + node->as.simple.argv, " ",
+					buffer, size, length);
+	case CMD_PIPE:
+		for (uint32_t i = 0; i < node->as.pipeline.count; i++) {
+			if (i)
+				length = ast_append(buffer, size, length, " | ");
+			length = ast_format_node(
+				ast, ast->refs[node->as.pipeline.stages + i],
+				buffer, size, length);
+		}
+		return length;
+	case CMD_LIST:
+		for (uint32_t i = 0; i < node->as.list.count; i++) {
+			if (i)
+				length = ast_append(buffer, size, length, "; ");
+			length = ast_format_node(
+				ast, ast->refs[node->as.list.items + i], buffer,
+				size, length);
+		}
+		return length;
+	case CMD_IF:
+	case CMD_WHILE:
+	case CMD_UNTIL:
+	case CMD_FOR:
+	case CMD_CASE:
+	case CMD_FUNCTION:
+		return ast_format_compound(ast, node, buffer, size, length);
+	case CMD_REDIRECT:
+		return ast_format_node(ast, node->as.binary.left, buffer, size,
+				       length);
+	case CMD_OR:
+		op = " || ";
+		break;
+	case CMD_BACKGROUND:
+		op = " & ";
+		break;
+	}
+	length = ast_format_node(ast, node->as.binary.left, buffer, size,
+				 length);
+	length = ast_append(buffer, size, length, op);
+	return ast_format_node(ast, node->as.binary.right, buffer, size,
+			       length);
+}
+
+/**
+ * ast_format - Describes a command in shell syntax.
+ * @ast: The AST holding the command.
+ * @index: Index of the command's node.
+ * @buffer: Receives the description, truncated to fit.
+ * @size: Size of @buffer.
+ *
+ * Quoting is not reproduced; the text is only meant for messages such
+ * as job listings.
+ *
+ * Return: The length of the full description, as snprintf() does.
+ */
+size_t ast_format(const Ast *ast, NodeIndex index, char *buffer, size_t size)
+{
+	if (size)
+		buffer[0] = '\0';
+	return ast_format_node(ast, index, buffer, size, 0);
+}
@@ -1,29 +1,1103 @@
 #include <stddef.h>
 #include <utils.h>
+#include <alias.h>
 #include <command.h>
 #include <shell.h>
 #include <builtins.h>
+#include <cmdhash.h>
+#include <function.h>
+#include <jobs.h>
+#include <scan.h>
+#include <table.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+/*
+ * pure builtins only read the shell state, so a command substitution
+ * made of them may run in the shell itself instead of a subshell.
+ */
 typedef struct {
 	char *arg;
 	int (*func)(ShellState *, SimpleCommand *, bool);
+	bool pure;
 } builtin_t;
 
-static builtin_t builtins[] = {
-	{ "cd", NULL },
-	{ "exit", NULL },
+/**
+ * print_hashed - Prints the location of a remembered command.
+ * @entry: The command hash table entry.
+ * @ctx: Unused.
+ */
+static void print_hashed(TableEntry *entry, void *ctx)
+{
+	(void)ctx;
+	if (entry->value)
+		printf("%s\n", (char *)entry->value);
+}
+
+/**
+ * builtin_hash - Remembers or reports the location of commands.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed.
+ * @is_background: Unused.
+ *
+ * With no operands every remembered location still valid for the
+ * current PATH is printed, `-r` forgets them all, and each operand is
+ * looked up and remembered.
+ *
+ * Return: 0 on success, 1 if a command could not be found.
+ */
+static int builtin_hash(ShellState *shell, SimpleCommand *command,
+			bool is_background)
+{
+	int status = 0, i = 1;
+
+	(void)is_background;
+	if (command->argc > 1 && !strcmp(command->argv[1], "-r")) {
+		cmdhash_clear(shell);
+		i++;
+	} else if (command->argc == 1) {
+		cmdhash_sync(shell);
+		table_each(shell->commands, print_hashed, NULL);
+		return 0;
+	}
+
+	for (; i < command->argc; i++) {
+		char *name = command->argv[i];
+
+		if (strchr(name, '/'))
+			continue;
+		cmdhash_forget(shell, name);
+		if (!cmdhash_lookup(shell, name)) {
+			if (shell->fatal_error)
+				return 1;
+			fprintf(stderr, "%s: hash: %s: not found\n",
+				shell->name, name);
+			cmdhash_forget(shell, name);
+			status = 1;
+		}
+	}
+	return status;
+}
+
+/**
+ * builtin_true - Does nothing, successfully.
+ * @shell: Unused.
+ * @command: Unused.
+ * @is_background: Unused.
+ *
+ * Also serves as `:`.
+ *
+ * Return: Always 0.
+ */
+static int builtin_true(ShellState *shell, SimpleCommand *command,
+			bool is_background)
+{
+	(void)shell;
+	(void)command;
+	(void)is_background;
+	return 0;
+}
+
+/**
+ * builtin_false - Does nothing, unsuccessfully.
+ * @shell: Unused.
+ * @command: Unused.
+ * @is_background: Unused.
+ *
+ * Return: Always 1.
+ */
+static int builtin_false(ShellState *shell, SimpleCommand *command,
+			 bool is_background)
+{
+	(void)shell;
+	(void)command;
+	(void)is_background;
+	return 1;
+}
+
+/**
+ * echo_escapes - Writes a string with its backslash escapes expanded.
+ * @str: The string to write.
+ *
+ * Return: false if a `\c` escape ended all output, true otherwise.
+ */
+static bool echo_escapes(const char *str)
+{
+	static const char from[] = "\\abefnrtv";
+	static const char to[] = "\\\a\b\033\f\n\r\t\v";
+
+	for (; *str; str++) {
+		const char *match;
+		int value = 0, digits = 0;
+
+		if (*str != '\\' || !str[1]) {
+			putchar(*str);
+			continue;
+		}
+		str++;
+		if ((match = strchr(from, *str))) {
+			putchar(to[match - from]);
+		} else if (*str == 'c') {
+			return false;
+		} else if (*str == '0') {
+			for (; digits < 3 && str[1] >= '0' && str[1] <= '7';
+			     digits++)
+				value = value * 8 + *++str - '0';
+			putchar(value);
+		} else if (*str == 'x' && isxdigit((unsigned char)str[1])) {
+			for (; digits < 2 && isxdigit((unsigned char)str[1]);
+			     digits++) {
+				int c = tolower((unsigned char)*++str);
+				value = value * 16 +
+					(isdigit(c) ? c - '0' : c - 'a' + 10);
+			}
+			putchar(value);
+		} else {
+			putchar('\\');
+			putchar(*str);
+		}
+	}
+	return true;
+}
+
+/**
+ * builtin_output - Ends the output of a builtin, reporting write errors.
+ * @shell: Pointer to the shell state.
+ * @name: Name of the builtin.
+ * @status: Exit status of the builtin if its output was written.
+ *
+ * Standard output is flushed, so a full disk or a closed pipe shows up
+ * on the command that wrote to it, as it would for a program.
+ *
+ * Return: @status, or 1 after reporting a write error.
+ */
+int builtin_output(ShellState *shell, const char *name, int status)
+{
+	if (!fflush(stdout) && !ferror(stdout))
+		return status;
+	fprintf(stderr, "%s: %d: %s: I/O error\n", shell->name,
+		shell->line_number, name);
+	clearerr(stdout);
+	return 1;
+}
+
+/**
+ * builtin_echo - Writes its arguments separated by spaces.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed.
+ * @is_background: Unused.
+ *
+ * Options match the echo(1) that hsh used to run: `-n` drops the
+ * trailing newline, `-e` enables and `-E` disables backslash escapes.
+ *
+ * Return: 0 on success, 1 if the output could not be written.
+ */
+static int builtin_echo(ShellState *shell, SimpleCommand *command,
+			bool is_background)
+{
+	bool newline = true, escapes = false;
+	int i = 1;
+
+	(void)is_background;
+	for (; i < command->argc; i++) {
+		const char *arg = command->argv[i];
+
+		if (arg[0] != '-' || !arg[1] || arg[strspn(arg + 1, "neE") + 1])
+			break;
+		for (arg++; *arg; arg++) {
+			if (*arg == 'n')
+				newline = false;
+			else
+				escapes = *arg == 'e';
+		}
+	}
+
+	for (bool first = true; i < command->argc; i++, first = false) {
+		if (!first)
+			putchar(' ');
+		if (!escapes)
+			fputs(command->argv[i], stdout);
+		else if (!echo_escapes(command->argv[i]))
+			return builtin_output(shell, "echo", 0);
+	}
+	if (newline)
+		putchar('\n');
+	return builtin_output(shell, "echo", 0);
+}
+
+/**
+ * pwd_logical - Checks whether $PWD names the current directory.
+ * @pwd: The value of PWD, or NULL.
+ *
+ * Return: true if @pwd is an absolute path to the current directory
+ * without "." or ".." components, false otherwise.
+ */
+static bool pwd_logical(const char *pwd)
+{
+	struct stat a, b;
+
+	if (!pwd || *pwd != '/' || strstr(pwd, "/./") || strstr(pwd, "/../"))
+		return false;
+	size_t len = strlen(pwd);
+	if ((len >= 2 && !strcmp(pwd + len - 2, "/.")) ||
+	    (len >= 3 && !strcmp(pwd + len - 3, "/..")))
+		return false;
+	return !stat(pwd, &a) && !stat(".", &b) && a.st_dev == b.st_dev &&
+	       a.st_ino == b.st_ino;
+}
+
+/**
+ * builtin_pwd - Writes the path of the current directory.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed.
+ * @is_background: Unused.
+ *
+ * With `-L` (the default) $PWD is written when it still names the
+ * current directory; `-P` always writes the physical path.
+ *
+ * Return: 0 on success, 1 on failure, 2 on usage errors.
+ */
+static int builtin_pwd(ShellState *shell, SimpleCommand *command,
+		       bool is_background)
+{
+	bool physical = false;
+	char cwd[PATH_MAX];
+	const char *pwd = vars_get(&shell->vars, "PWD");
+
+	(void)is_background;
+	for (int i = 1; i < command->argc; i++) {
+		if (!strcmp(command->argv[i], "-P")) {
+			physical = true;
+		} else if (!strcmp(command->argv[i], "-L")) {
+			physical = false;
+		} else {
+			fprintf(stderr, "%s: pwd: %s: invalid option\n",
+				shell->name, command->argv[i]);
+			return 2;
+		}
+	}
+
+	if (!physical && pwd_logical(pwd)) {
+		puts(pwd);
+		return builtin_output(shell, "pwd", 0);
+	}
+	if (!getcwd(cwd, sizeof(cwd))) {
+		fprintf(stderr, "%s: pwd: %s\n", shell->name, strerror(errno));
+		return 1;
+	}
+	puts(cwd);
+	return builtin_output(shell, "pwd", 0);
+}
+
+/**
+ * cd_canonical - Removes the "." and ".." components of an absolute path.
+ * @path: The path, rewritten in place.
+ *
+ * A ".." drops the component before it without looking at what the
+ * components name, as `cd -L` does; repeated slashes are merged.
+ */
+static void cd_canonical(char *path)
+{
+	char *in = path, *out = path;
+	size_t length;
+
+	while (*in) {
+		while (*in == '/')
+			in++;
+		length = strcspn(in, "/");
+		if (length == 2 && in[0] == '.' && in[1] == '.') {
+			while (out > path && *--out != '/')
+				;
+		} else if (length && !(length == 1 && *in == '.')) {
+			*out++ = '/';
+			memmove(out, in, length);
+			out += length;
+		}
+		in += length;
+	}
+	if (out == path)
+		*out++ = '/';
+	*out = '\0';
+}
+
+/**
+ * cd_logical - Builds the path `cd -L` changes to.
+ * @dir: The operand.
+ * @pwd: The current directory, or NULL if it is unknown.
+ *
+ * Return: The canonical path, allocated with malloc(), or NULL if @dir
+ * is relative to an unknown directory or on allocation failure.
+ */
+static char *cd_logical(const char *dir, const char *pwd)
+{
+	size_t base = *dir == '/' ? 0 : pwd ? strlen(pwd) + 1 : 0;
+	size_t size = strlen(dir) + 1;
+	char *path;
+
+	if (*dir != '/' && !pwd)
+		return NULL;
+	path = malloc(base + size);
+	if (!path)
+		return NULL;
+	if (base) {
+		memcpy(path, pwd, base - 1);
+		path[base - 1] = '/';
+	}
+	memcpy(path + base, dir, size);
+	cd_canonical(path);
+	return path;
+}
+
+/**
+ * cd_set - Sets PWD or OLDPWD.
+ * @shell: Pointer to the shell state.
+ * @name: Name of the variable.
+ * @value: The value.
+ *
+ * Return: true on success, false on allocation failure, after
+ * reporting it.
+ */
+static bool cd_set(ShellState *shell, const char *name, const char *value)
+{
+	size_t length = strlen(name), size = strlen(value);
+	char *assignment = malloc(length + size + 2);
+	bool ok = assignment != NULL;
+
+	if (ok) {
+		memcpy(assignment, name, length);
+		assignment[length] = '=';
+		memcpy(assignment + length + 1, value, size + 1);
+		ok = vars_set(&shell->vars, assignment, 0);
+		free(assignment);
+	}
+	if (!ok) {
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+	}
+	return ok;
+}
+
+/**
+ * builtin_cd - Changes the current directory.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed: `cd [-L|-P] [dir]`.
+ * @is_background: Unused.
+ *
+ * dir defaults to $HOME, and `-` stands for $OLDPWD, the new directory
+ * then being written. With `-L` (the default) dir is taken relative to
+ * $PWD and its ".." components drop the component before them; `-P`
+ * resolves it against the physical directory instead. PWD and OLDPWD
+ * are updated.
+ *
+ * Return: 0 on success, 1 if the new directory could not be written,
+ * 2 if it could not be changed to or on usage errors.
+ */
+static int builtin_cd(ShellState *shell, SimpleCommand *command,
+		      bool is_background)
+{
+	const char *pwd = vars_get(&shell->vars, "PWD"), *dir;
+	char cwd[PATH_MAX], old[PATH_MAX], *path = NULL;
+	bool physical = false, print = false;
+	int i = 1;
+
+	(void)is_background;
+	for (; i < command->argc && command->argv[i][0] == '-' &&
+	       command->argv[i][1]; i++) {
+		if (!strcmp(command->argv[i], "--")) {
+			i++;
+			break;
+		} else if (!strcmp(command->argv[i], "-P")) {
+			physical = true;
+		} else if (!strcmp(command->argv[i], "-L")) {
+			physical = false;
+		} else {
+			fprintf(stderr, "%s: %d: cd: Illegal option %s\n",
+				shell->name, shell->line_number,
+				command->argv[i]);
+			return 2;
+		}
+	}
+	dir = i < command->argc ? command->argv[i] :
+				  vars_get(&shell->vars, "HOME");
+	if (!dir)
+		return 0;
+	if (!strcmp(dir, "-")) {
+		dir = vars_get(&shell->vars, "OLDPWD");
+		dir = dir ? dir : ".";
+		print = true;
+	}
+
+	if (!pwd_logical(pwd))
+		pwd = getcwd(old, sizeof(old));
+	if (!physical)
+		path = cd_logical(dir, pwd);
+	if (path ? chdir(path) : chdir(dir)) {
+		fprintf(stderr, "%s: %d: cd: can't cd to %s\n", shell->name,
+			shell->line_number, dir);
+		free(path);
+		return 2;
+	}
+	if (!path && !getcwd(cwd, sizeof(cwd)))
+		strcpy(cwd, dir);
+	if ((pwd && !cd_set(shell, "OLDPWD", pwd)) ||
+	    !cd_set(shell, "PWD", path ? path : cwd)) {
+		free(path);
+		return 1;
+	}
+	free(path);
+	if (!print)
+		return 0;
+	puts(vars_get(&shell->vars, "PWD"));
+	return builtin_output(shell, "cd", 0);
+}
+
+/**
+ * compare_entries - Orders two table entries by key for qsort().
+ * @a: Pointer to the first entry.
+ * @b: Pointer to the second entry.
+ *
+ * Return: A negative, zero or positive value as a sorts before, with
+ * or after b.
+ */
+static int compare_entries(const void *a, const void *b)
+{
+	return strcmp((*(TableEntry *const *)a)->key,
+		      (*(TableEntry *const *)b)->key);
+}
+
+typedef struct {
+	TableEntry **entries;
+	size_t count;
+} entry_list_t;
+
+/**
+ * collect_exported - Adds the entry of an exported variable to a list.
+ * @entry: The variable's table entry.
+ * @ctx: The list, with room for every variable.
+ */
+static void collect_exported(TableEntry *entry, void *ctx)
+{
+	entry_list_t *list = ctx;
+
+	if (((Var *)entry->value)->flags & VAR_EXPORT)
+		list->entries[list->count++] = entry;
+}
+
+/**
+ * print_quoted - Writes a string in single quotes.
+ * @str: The string.
+ *
+ * Single quotes inside @str are written as '\''.
+ */
+static void print_quoted(const char *str)
+{
+	putchar('\'');
+	for (; *str; str++) {
+		if (*str == '\'')
+			fputs("'\\''", stdout);
+		else
+			putchar(*str);
+	}
+	putchar('\'');
+}
+
+/**
+ * print_exported - Lists the exported variables in a form that can be
+ *                  read back.
+ * @shell: Pointer to the shell state.
+ *
+ * Return: 0 on success, 1 on allocation failure.
+ */
+static int print_exported(ShellState *shell)
+{
+	entry_list_t list = { 0 };
+
+	list.entries = malloc(sizeof(TableEntry *) *
+			      (shell->vars.table->count + 1));
+	if (!list.entries) {
+		fprintf(stderr, "Error: malloc failed\n");
+		return 1;
+	}
+	table_each(shell->vars.table, collect_exported, &list);
+	qsort(list.entries, list.count, sizeof(TableEntry *), compare_entries);
+	for (size_t i = 0; i < list.count; i++) {
+		Var *var = list.entries[i]->value;
+
+		printf("export %s", list.entries[i]->key);
+		if (var->assignment) {
+			putchar('=');
+			print_quoted(var->value);
+		}
+		putchar('\n');
+	}
+	free(list.entries);
+	return 0;
+}
 
+/**
+ * builtin_export - Marks variables for the environment of programs.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed.
+ * @is_background: Unused.
+ *
+ * Each operand is a name, or an assignment that also sets the variable.
+ * Without operands, or with `-p`, the exported variables are listed.
+ *
+ * Return: 0 on success, 1 if a name was invalid.
+ */
+static int builtin_export(ShellState *shell, SimpleCommand *command,
+			  bool is_background)
+{
+	int status = 0, i = 1;
+
+	(void)is_background;
+	if (i < command->argc && !strcmp(command->argv[i], "-p"))
+		i++;
+	if (i == command->argc)
+		return print_exported(shell);
+
+	for (; i < command->argc; i++) {
+		char *arg = command->argv[i];
+		char *equals = strchr(arg, '=');
+		size_t length = equals ? (size_t)(equals - arg) : strlen(arg);
+		bool ok;
+
+		if (!vars_valid_name(arg, length)) {
+			fprintf(stderr, "%s: export: %s: bad variable name\n",
+				shell->name, arg);
+			status = 1;
+			continue;
+		}
+		ok = equals ? vars_set(&shell->vars, arg, VAR_EXPORT) :
+			      vars_export(&shell->vars, arg);
+		if (!ok) {
+			fprintf(stderr, "Error: malloc failed\n");
+			shell->fatal_error = true;
+			return 1;
+		}
+	}
+	return status;
+}
+
+/**
+ * builtin_unset - Removes variables.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed.
+ * @is_background: Unused.
+ *
+ * With `-f` the names are those of functions, otherwise of variables;
+ * `-v` is accepted and changes nothing.
+ *
+ * Return: 0 on success, 1 if a name was invalid.
+ */
+static int builtin_unset(ShellState *shell, SimpleCommand *command,
+			 bool is_background)
+{
+	int status = 0, i = 1;
+	bool functions = false;
+
+	(void)is_background;
+	if (i < command->argc && (!strcmp(command->argv[i], "-v") ||
+				  !strcmp(command->argv[i], "-f")))
+		functions = command->argv[i++][1] == 'f';
+	for (; i < command->argc; i++) {
+		char *name = command->argv[i];
+
+		if (functions) {
+			function_remove(shell, name);
+			continue;
+		}
+		if (!vars_valid_name(name, strlen(name))) {
+			fprintf(stderr, "%s: unset: %s: bad variable name\n",
+				shell->name, name);
+			status = 1;
+			continue;
+		}
+		vars_unset(&shell->vars, name);
+	}
+	return status;
+}
+
+/**
+ * collect_entry - Adds a table entry to a list.
+ * @entry: The entry.
+ * @ctx: The list, with room for every entry.
+ */
+static void collect_entry(TableEntry *entry, void *ctx)
+{
+	entry_list_t *list = ctx;
+
+	list->entries[list->count++] = entry;
+}
+
+/**
+ * print_alias - Writes an alias in a form that can be read back.
+ * @name: The name of the alias.
+ * @alias: The alias.
+ */
+static void print_alias(const char *name, const Alias *alias)
+{
+	printf("%s=", name);
+	print_quoted(alias->value);
+	putchar('\n');
+}
+
+/**
+ * print_aliases - Lists every alias, sorted by name.
+ * @shell: Pointer to the shell state.
+ *
+ * Return: 0 on success, 1 on allocation failure.
+ */
+static int print_aliases(ShellState *shell)
+{
+	entry_list_t list = { 0 };
+
+	list.entries = malloc(sizeof(TableEntry *) *
+			      (shell->aliases->count + 1));
+	if (!list.entries) {
+		fprintf(stderr, "Error: malloc failed\n");
+		return 1;
+	}
+	table_each(shell->aliases, collect_entry, &list);
+	qsort(list.entries, list.count, sizeof(TableEntry *), compare_entries);
+	for (size_t i = 0; i < list.count; i++)
+		print_alias(list.entries[i]->key, list.entries[i]->value);
+	free(list.entries);
+	return 0;
+}
+
+/**
+ * valid_alias_name - Checks if a string can name an alias.
+ * @name: The string.
+ * @length: Length of @name.
+ *
+ * Return: true if @name is a plain word without quotes, '$' or '/'.
+ */
+static bool valid_alias_name(const char *name, size_t length)
+{
+	if (!length)
+		return false;
+	for (size_t i = 0; i < length; i++) {
+		if ((char_class[(unsigned char)name[i]] & CC_WORD_STOP) ||
+		    name[i] == '/')
+			return false;
+	}
+	return true;
+}
+
+/**
+ * builtin_alias - Defines or lists aliases.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed.
+ * @is_background: Unused.
+ *
+ * Each NAME=value operand defines an alias, taking effect from the next
+ * line read; each NAME operand prints one. Without operands every
+ * alias is listed.
+ *
+ * Return: 0 on success, 1 if an alias was not found or not defined.
+ */
+static int builtin_alias(ShellState *shell, SimpleCommand *command,
+			 bool is_background)
+{
+	int status = 0;
+
+	(void)is_background;
+	if (command->argc == 1)
+		return print_aliases(shell);
+
+	for (int i = 1; i < command->argc; i++) {
+		char *arg = command->argv[i];
+		char *equals = strchr(arg, '=');
+		size_t length = equals ? (size_t)(equals - arg) : strlen(arg);
+		Alias *alias;
+		char *name;
+
+		if (!equals) {
+			alias = alias_find(shell, arg, length);
+			if (alias) {
+				print_alias(arg, alias);
+				continue;
+			}
+			fprintf(stderr, "%s: alias: %s not found\n",
+				shell->name, arg);
+			status = 1;
+			continue;
+		}
+		if (!valid_alias_name(arg, length)) {
+			fprintf(stderr, "%s: alias: %.*s: invalid alias name\n",
+				shell->name, (int)length, arg);
+			status = 1;
+			continue;
+		}
+		name = strndup(arg, length);
+		if (!name) {
+			fprintf(stderr, "Error: malloc failed\n");
+			shell->fatal_error = true;
+			return 1;
+		}
+		if (!alias_define(shell, name, equals + 1))
+			status = 1;
+		free(name);
+		if (shell->fatal_error)
+			return 1;
+	}
+	return status;
+}
+
+/**
+ * builtin_unalias - Removes aliases.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed.
+ * @is_background: Unused.
+ *
+ * `-a` removes every alias.
+ *
+ * Return: 0 on success, 1 if an alias was not found.
+ */
+static int builtin_unalias(ShellState *shell, SimpleCommand *command,
+			   bool is_background)
+{
+	int status = 0;
+
+	(void)is_background;
+	if (command->argc > 1 && !strcmp(command->argv[1], "-a")) {
+		alias_clear(shell);
+		return 0;
+	}
+	for (int i = 1; i < command->argc; i++) {
+		if (!alias_remove(shell, command->argv[i])) {
+			fprintf(stderr, "%s: unalias: %s not found\n",
+				shell->name, command->argv[i]);
+			status = 1;
+		}
+	}
+	return status;
+}
+
+/**
+ * builtin_jobs - Lists the background jobs.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed.
+ * @is_background: Unused.
+ *
+ * Jobs reported as done are forgotten.
+ *
+ * Return: 0 on success, 2 on usage errors.
+ */
+static int builtin_jobs(ShellState *shell, SimpleCommand *command,
+			bool is_background)
+{
+	(void)is_background;
+	if (command->argc > 1) {
+		fprintf(stderr, "%s: jobs: usage: jobs\n", shell->name);
+		return 2;
+	}
+	jobs_print(shell);
+	return 0;
+}
+
+/**
+ * builtin_fg - Continues a job in the foreground.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed.
+ * @is_background: Unused.
+ *
+ * Return: The exit status of the job, 1 if there is no such job.
+ */
+static int builtin_fg(ShellState *shell, SimpleCommand *command,
+		      bool is_background)
+{
+	char *spec = command->argc > 1 ? command->argv[1] : NULL;
+	Job *job = jobs_find(shell, spec);
+
+	(void)is_background;
+	if (!shell->jobs.monitor) {
+		fprintf(stderr, "%s: fg: no job control\n", shell->name);
+		return 1;
+	}
+	if (!job) {
+		fprintf(stderr, "%s: fg: %s: no such job\n", shell->name,
+			spec ? spec : "current");
+		return 1;
+	}
+	printf("%s\n", job->command ? job->command : "");
+	fflush(stdout);
+	return jobs_foreground(shell, job);
+}
+
+/**
+ * builtin_bg - Continues stopped jobs in the background.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed.
+ * @is_background: Unused.
+ *
+ * Return: 0 on success, 1 if a job could not be found.
+ */
+static int builtin_bg(ShellState *shell, SimpleCommand *command,
+		      bool is_background)
+{
+	int status = 0, i = 1;
+
+	(void)is_background;
+	if (!shell->jobs.monitor) {
+		fprintf(stderr, "%s: bg: no job control\n", shell->name);
+		return 1;
+	}
+	do {
+		char *spec = i < command->argc ? command->argv[i] : NULL;
+		Job *job = jobs_find(shell, spec);
+
+		if (!job) {
+			fprintf(stderr, "%s: bg: %s: no such job\n",
+				shell->name, spec ? spec : "current");
+			status = 1;
+			continue;
+		}
+		jobs_resume(job);
+		printf("[%d] %s &\n", job->id,
+		       job->command ? job->command : "");
+	} while (++i < command->argc);
+	fflush(stdout);
+	return status;
+}
+
+/**
+ * builtin_wait - Waits for background jobs to finish.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed.
+ * @is_background: Unused.
+ *
+ * Without operands every job is waited for. Each operand is a pid or a
+ * job specification; waiting for any process of a job waits for the
+ * whole job.
+ *
+ * Return: The exit status of the last operand's job, 127 if it is not
+ * a job of this shell, and 0 without operands.
+ */
+static int builtin_wait(ShellState *shell, SimpleCommand *command,
+			bool is_background)
+{
+	int status = 0;
+
+	(void)is_background;
+	if (command->argc == 1) {
+		for (int i = 0; i < shell->jobs.top; i++) {
+			if (shell->jobs.slots[i])
+				jobs_wait(shell, shell->jobs.slots[i]);
+		}
+		return 0;
+	}
+	for (int i = 1; i < command->argc; i++) {
+		Job *job = jobs_find(shell, command->argv[i]);
+
+		if (!job) {
+			if (*command->argv[i] == '%')
+				fprintf(stderr, "%s: wait: %s: no such job\n",
+					shell->name, command->argv[i]);
+			status = 127;
+			continue;
+		}
+		status = jobs_wait(shell, job);
+	}
+	return status;
+}
+
+/**
+ * builtin_break - Leaves loops, or goes on with their next round.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed: `break [n]` or `continue [n]`.
+ * @is_background: Unused.
+ *
+ * The n-th enclosing loop is broken out of or continued, the innermost
+ * being the first; n is capped at the number of loops running. Outside
+ * of a loop nothing happens.
+ *
+ * Return: 0 on success, 2 if n is not a positive number.
+ */
+static int builtin_break(ShellState *shell, SimpleCommand *command,
+			 bool is_background)
+{
+	long count = 1;
+	char *end;
+
+	(void)is_background;
+	if (command->argc > 1) {
+		errno = 0;
+		count = strtol(command->argv[1], &end, 10);
+		if (*end || end == command->argv[1] || count <= 0 || errno) {
+			fprintf(stderr, "%s: %d: %s: Illegal number: %s\n",
+				shell->name, shell->line_number,
+				command->argv[0], command->argv[1]);
+			return 2;
+		}
+	}
+	if (!shell->loop_depth)
+		return 0;
+	shell->skip = *command->argv[0] == 'b' ? SKIP_BREAK : SKIP_CONTINUE;
+	shell->skip_count = count < shell->loop_depth ? count :
+							shell->loop_depth;
+	return 0;
+}
+
+/**
+ * builtin_return - Returns from a function.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed: `return [n]`.
+ * @is_background: Unused.
+ *
+ * The call ends with status n, by default the status of the last
+ * command run.
+ *
+ * Return: n, 1 outside of a function, or 2 if n is not a number.
+ */
+static int builtin_return(ShellState *shell, SimpleCommand *command,
+			  bool is_background)
+{
+	long status = shell->status;
+	char *end;
+
+	(void)is_background;
+	if (command->argc > 1) {
+		errno = 0;
+		status = strtol(command->argv[1], &end, 10);
+		if (*end || end == command->argv[1] || status < 0 || errno) {
+			fprintf(stderr, "%s: %d: return: Illegal number: %s\n",
+				shell->name, shell->line_number,
+				command->argv[1]);
+			return 2;
+		}
+	}
+	if (!shell->function_depth) {
+		fprintf(stderr, "%s: %d: return: not in a function\n",
+			shell->name, shell->line_number);
+		return 1;
+	}
+	shell->skip = SKIP_RETURN;
+	return status & 0xff;
+}
+
+/**
+ * builtin_exit - Exits the shell.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed: `exit [n]`.
+ * @is_background: Unused.
+ *
+ * The commands running are unwound and the shell exits with status n,
+ * by default the status of the last command run, cleaning up as at the
+ * end of its input. A forked copy of the shell, as for a pipeline stage
+ * or a command substitution, exits on its own.
+ *
+ * Return: n, or 2 if n is not a number; a non-interactive shell then
+ * exits as well.
+ */
+static int builtin_exit(ShellState *shell, SimpleCommand *command,
+			bool is_background)
+{
+	long status = shell->status;
+	char *end;
+
+	(void)is_background;
+	if (command->argc > 1) {
+		errno = 0;
+		status = strtol(command->argv[1], &end, 10);
+		if (*end || end == command->argv[1] || status < 0 || errno) {
+			fprintf(stderr, "%s: %d: exit: Illegal number: %s\n",
+				shell->name, shell->line_number,
+				command->argv[1]);
+			if (shell->is_interactive_mode)
+				return 2;
+			status = 2;
+		}
+	}
+	shell->skip = SKIP_EXIT;
+	shell->skip_count = status & 0xff;
+	return shell->skip_count;
+}
+
+static builtin_t builtins[] = {
+	{ ":", builtin_true, true },
+	{ "[", builtin_test, true },
+	{ "alias", builtin_alias, false },
+	{ "bg", builtin_bg, false },
+	{ "break", builtin_break, false },
+	{ "cd", builtin_cd, false },
+	{ "continue", builtin_break, false },
+	{ "echo", builtin_echo, true },
+	{ "exit", builtin_exit, false },
+	{ "export", builtin_export, false },
+	{ "false", builtin_false, true },
+	{ "fg", builtin_fg, false },
+	{ "hash", builtin_hash, false },
+	{ "jobs", builtin_jobs, false },
+	{ "printf", builtin_printf, true },
+	{ "pwd", builtin_pwd, true },
+	{ "return", builtin_return, false },
+	{ "test", builtin_test, true },
+	{ "true", builtin_true, true },
+	{ "unalias", builtin_unalias, false },
+	{ "unset", builtin_unset, false },
+	{ "wait", builtin_wait, false },
 };
 
-int (*get_builtin(char *arg))(ShellState *, SimpleCommand *, bool)
+/**
+ * builtins_new - Builds the table the shell dispatches builtins through.
+ *
+ * Entries without an implementation are left out, so their names are
+ * still looked up in PATH.
+ *
+ * Return: Pointer to the table, or NULL on allocation failure.
+ */
+Table *builtins_new(void)
 {
-	builtin_t *builtin = builtins;
+	Table *table = table_new(NULL);
+	if (!table)
+		return NULL;
 
 	for (size_t i = 0; i < ARRAY_SIZE(builtins); i++) {
-		builtin += i;
-		if (!strcmp(builtin->arg, arg))
-			return builtin->func;
+		if (builtins[i].func &&
+		    !table_insert(table, builtins[i].arg, &builtins[i])) {
+			table_free(table);
+			return NULL;
+		}
 	}
-	return NULL;
+	return table;
+}
+
+/**
+ * get_builtin - Finds the builtin implementing a command.
+ * @shell: Pointer to the shell state.
+ * @arg: The command name.
+ *
+ * Return: The builtin's function, or NULL if @arg is not a builtin.
+ */
+int (*get_builtin(ShellState *shell, char *arg))(ShellState *, SimpleCommand *,
+						 bool)
+{
+	TableEntry *entry = table_find(shell->builtins, arg);
+
+	return entry ? ((builtin_t *)entry->value)->func : NULL;
+}
+
+/**
+ * builtin_is_pure - Tells whether a command is a builtin that only reads
+ *                   the shell state.
+ * @shell: Pointer to the shell state.
+ * @arg: The command name.
+ *
+ * Return: true if @arg is such a builtin, not hidden by a function,
+ * false otherwise.
+ */
+bool builtin_is_pure(ShellState *shell, const char *arg)
+{
+	TableEntry *entry = table_find(shell->builtins, arg);
+
+	return entry && ((builtin_t *)entry->value)->pure &&
+	       !function_find(shell, arg);
 }
@@ -0,0 +1,1642 @@
+#include <cache.h>
+#include <arena.h>
+#include <ast.h>
+#include <executor.h>
+#include <jobs.h>
+#include <vars.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC "HSHC"
+#define CACHE_VERSION 14
+#define CACHE_NONE AST_NONE
+/* Largest image worth writing, in bytes per byte of the script. */
+#define CACHE_MAX_GROWTH 2
+
+/*
+ * A compiled script is one file: a header, the code and a string pool.
+ * The code is a stream of LEB128 numbers describing the script's syntax
+ * tree node by node, children first, then its lines and their commands.
+ * A node gives only the fields its type uses; a child is given by how
+ * many nodes back it is, 0 standing for none, and a word by its offset
+ * in the string pool, where every distinct string is stored once. So
+ * the file is position independent and usually smaller than the script.
+ * The header counts what the code decodes into, so the tables can be
+ * allocated up front, and carries a checksum of everything after it, so
+ * a damaged file is parsed again rather than run.
+ */
+typedef struct CacheHeader {
+	char magic[4];
+	uint32_t version;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	uint64_t size;
+	uint64_t hash;
+	uint64_t checksum;
+	uint32_t path;
+	uint32_t line_count;
+	uint32_t root_count;
+	uint32_t node_count;
+	uint32_t word_count;
+	uint32_t ref_count;
+	uint32_t strings_size;
+	uint32_t redirect_count;
+	uint32_t case_count;
+	uint32_t code_size;
+} CacheHeader;
+
+typedef struct CacheLine {
+	uint32_t line_number;
+	uint32_t offset;
+	uint32_t first;
+	uint32_t count;
+} CacheLine;
+
+struct CacheBuilder {
+	bool valid;
+	CacheLine *lines;
+	size_t line_count, line_capacity;
+	NodeIndex *roots;
+	size_t root_count, root_capacity;
+	Node *nodes;
+	size_t node_count, node_capacity;
+	uint32_t case_count;
+	uint32_t *words;
+	size_t word_count, word_capacity;
+	NodeIndex *refs;
+	size_t ref_count, ref_capacity;
+	Redirect *redirects;
+	size_t redirect_count, redirect_capacity;
+	char *strings;
+	size_t strings_size, strings_capacity;
+	uint32_t *interned;
+	size_t interned_count, interned_capacity;
+};
+
+/*
+ * A compiled script being run. The mapping holds the header, code and
+ * strings; the tables the code decodes into, in the in-memory layout of
+ * a syntax tree, are allocated in one block.
+ */
+typedef struct CacheImage {
+	const CacheHeader *header;
+	CacheLine *lines;
+	NodeIndex *roots;
+	Node *nodes;
+	uint32_t *words;
+	NodeIndex *refs;
+	Redirect *redirects;
+	char *strings;
+	void *tables;
+	void *mapped;
+	size_t mapped_size;
+} CacheImage;
+
+/* The code of a compiled script being written. */
+typedef struct CacheCode {
+	unsigned char *bytes;
+	size_t size, capacity;
+	bool valid;
+} CacheCode;
+
+/*
+ * The code of a compiled script being decoded into the tables of an
+ * image, with how far each pool is filled.
+ */
+typedef struct CacheReader {
+	const unsigned char *p, *end;
+	bool valid;
+	CacheImage *image;
+	uint32_t words, refs, redirects, cases;
+} CacheReader;
+
+typedef struct CacheKey {
+	char path[PATH_MAX];
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	uint64_t size;
+	uint64_t hash;
+} CacheKey;
+
+/**
+ * cache_checksum - Folds a buffer into a checksum.
+ * @sum: The checksum of the bytes before the buffer.
+ * @data: The bytes.
+ * @size: Number of bytes.
+ *
+ * The buffer is taken eight bytes at a time, so checking a large image
+ * costs little next to mapping it.
+ *
+ * Return: The checksum, with the buffer folded in.
+ */
+static uint64_t cache_checksum(uint64_t sum, const void *data, size_t size)
+{
+	const unsigned char *p = data;
+	uint64_t word;
+
+	for (; size >= sizeof(word); p += sizeof(word), size -= sizeof(word)) {
+		memcpy(&word, p, sizeof(word));
+		sum = (sum ^ word) * 0x9e3779b97f4a7c15ull;
+		sum ^= sum >> 29;
+	}
+	for (; size; p++, size--)
+		sum = (sum ^ *p) * 1099511628211ull;
+	return sum;
+}
+
+/**
+ * cache_hash - Computes the 64-bit FNV-1a hash of a buffer.
+ * @data: The bytes to hash.
+ * @size: Number of bytes.
+ *
+ * Return: The hash value.
+ */
+static uint64_t cache_hash(const char *data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= (unsigned char)data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/**
+ * cache_reserve - Makes room for more elements in a growable array.
+ * @array: Pointer to the array.
+ * @capacity: Pointer to the number of allocated elements.
+ * @count: Number of elements in use.
+ * @extra: Number of elements needed beyond @count.
+ * @size: Size of one element.
+ *
+ * Return: true on success, false on allocation failure or overflow.
+ */
+static bool cache_reserve(void **array, size_t *capacity, size_t count,
+			  size_t extra, size_t size)
+{
+	size_t needed = count + extra, grown = *capacity ? *capacity : 64;
+
+	if (needed >= CACHE_NONE)
+		return false;
+	if (needed <= *capacity)
+		return true;
+	while (grown < needed)
+		grown *= 2;
+	void *resized = realloc(*array, grown * size);
+	if (!resized)
+		return false;
+	*array = resized;
+	*capacity = grown;
+	return true;
+}
+
+/**
+ * cache_builder_new - Creates an empty builder for a compiled script.
+ *
+ * Return: Pointer to the builder, or NULL on failure.
+ */
+static CacheBuilder *cache_builder_new(void)
+{
+	CacheBuilder *builder = calloc(1, sizeof(CacheBuilder));
+	if (!builder)
+		return NULL;
+
+	builder->valid = true;
+	return builder;
+}
+
+/**
+ * cache_builder_free - Frees a builder and everything it collected.
+ * @builder: The builder to free.
+ */
+static void cache_builder_free(CacheBuilder *builder)
+{
+	free(builder->interned);
+	free(builder->lines);
+	free(builder->roots);
+	free(builder->nodes);
+	free(builder->words);
+	free(builder->refs);
+	free(builder->redirects);
+	free(builder->strings);
+	free(builder);
+}
+
+/**
+ * cache_intern_grow - Doubles the set of interned strings.
+ * @builder: The builder owning the set.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool cache_intern_grow(CacheBuilder *builder)
+{
+	size_t capacity = builder->interned_capacity ?
+				  builder->interned_capacity * 2 :
+				  1024;
+	uint32_t *slots = malloc(capacity * sizeof(uint32_t));
+
+	if (!slots)
+		return false;
+	memset(slots, 0xff, capacity * sizeof(uint32_t));
+	for (size_t i = 0; i < builder->interned_capacity; i++) {
+		uint32_t offset = builder->interned[i];
+		const char *str = builder->strings + offset;
+		size_t slot;
+
+		if (offset == CACHE_NONE)
+			continue;
+		slot = cache_hash(str, strlen(str)) & (capacity - 1);
+		while (slots[slot] != CACHE_NONE)
+			slot = (slot + 1) & (capacity - 1);
+		slots[slot] = offset;
+	}
+	free(builder->interned);
+	builder->interned = slots;
+	builder->interned_capacity = capacity;
+	return true;
+}
+
+/**
+ * cache_intern - Adds a string to the pool once.
+ * @builder: The builder owning the pool.
+ * @str: The string to add, or NULL.
+ *
+ * The strings already in the pool are found through an open-addressed
+ * set of their offsets, so interning allocates nothing per string.
+ *
+ * Return: Offset of the string in the pool, or CACHE_NONE.
+ */
+static uint32_t cache_intern(CacheBuilder *builder, const char *str)
+{
+	size_t length, slot, mask;
+	uint32_t offset;
+
+	if (!str || !builder->valid)
+		return CACHE_NONE;
+	if (builder->interned_count + 1 > builder->interned_capacity / 4 * 3 &&
+	    !cache_intern_grow(builder)) {
+		builder->valid = false;
+		return CACHE_NONE;
+	}
+
+	length = strlen(str) + 1;
+	mask = builder->interned_capacity - 1;
+	slot = cache_hash(str, length - 1) & mask;
+	while (builder->interned[slot] != CACHE_NONE) {
+		offset = builder->interned[slot];
+		if (!strcmp(builder->strings + offset, str))
+			return offset;
+		slot = (slot + 1) & mask;
+	}
+
+	if (!cache_reserve((void **)&builder->strings,
+			   &builder->strings_capacity, builder->strings_size,
+			   length, 1)) {
+		builder->valid = false;
+		return CACHE_NONE;
+	}
+	offset = builder->strings_size;
+	memcpy(builder->strings + offset, str, length);
+	builder->strings_size += length;
+	builder->interned[slot] = offset;
+	builder->interned_count++;
+	return offset;
+}
+
+/**
+ * cache_emit_words - Adds a NULL terminated vector to the word pool.
+ * @builder: The builder to add to.
+ * @words: The vector.
+ * @count: Number of words in @words.
+ *
+ * Return: Index of the first word.
+ */
+static uint32_t cache_emit_words(CacheBuilder *builder, char **words,
+				 uint32_t count)
+{
+	uint32_t first = builder->word_count;
+
+	if (!cache_reserve((void **)&builder->words, &builder->word_capacity,
+			   builder->word_count, count + 1, sizeof(uint32_t))) {
+		builder->valid = false;
+		return CACHE_NONE;
+	}
+	builder->word_count += count + 1;
+	for (uint32_t i = 0; i < count; i++)
+		builder->words[first + i] = cache_intern(builder, words[i]);
+	builder->words[first + count] = CACHE_NONE;
+	return first;
+}
+
+/**
+ * cache_emit_redirects - Adds redirections to the redirection pool.
+ * @builder: The builder to add to.
+ * @redirects: The redirections.
+ * @count: Number of redirections.
+ *
+ * Return: Index of the first redirection.
+ */
+static uint32_t cache_emit_redirects(CacheBuilder *builder,
+				     const Redirect *redirects, uint32_t count)
+{
+	uint32_t first = builder->redirect_count;
+
+	if (!count)
+		return first;
+	if (!cache_reserve((void **)&builder->redirects,
+			   &builder->redirect_capacity, builder->redirect_count,
+			   count, sizeof(Redirect))) {
+		builder->valid = false;
+		return CACHE_NONE;
+	}
+	memcpy(builder->redirects + first, redirects, sizeof(Redirect) * count);
+	builder->redirect_count += count;
+	return first;
+}
+
+static NodeIndex cache_emit(CacheBuilder *builder, const Ast *ast,
+			    NodeIndex index);
+
+/**
+ * cache_emit_refs - Copies the commands listed in the reference pool.
+ * @builder: The builder to add to.
+ * @ast: The syntax tree of the line.
+ * @first: Index of the first reference in @ast.
+ * @count: Number of references.
+ *
+ * Return: Index of the first copied reference.
+ */
+static uint32_t cache_emit_refs(CacheBuilder *builder, const Ast *ast,
+				uint32_t first, uint32_t count)
+{
+	uint32_t refs = builder->ref_count;
+	NodeIndex child;
+
+	if (!cache_reserve((void **)&builder->refs, &builder->ref_capacity,
+			   builder->ref_count, count, sizeof(NodeIndex))) {
+		builder->valid = false;
+		return CACHE_NONE;
+	}
+	builder->ref_count += count;
+	/* Copying a child may move the pool, so it is indexed afterwards. */
+	for (uint32_t i = 0; i < count; i++) {
+		child = cache_emit(builder, ast, ast->refs[first + i]);
+		builder->refs[refs + i] = child;
+	}
+	return refs;
+}
+
+/**
+ * cache_emit_child - Copies an optional child command.
+ * @builder: The builder to add to.
+ * @ast: The syntax tree of the line.
+ * @index: Index of the child in @ast, or AST_NONE.
+ *
+ * Return: Index of the copy, or CACHE_NONE if there is no child.
+ */
+static NodeIndex cache_emit_child(CacheBuilder *builder, const Ast *ast,
+				  NodeIndex index)
+{
+	return index == AST_NONE ? CACHE_NONE :
+				   cache_emit(builder, ast, index);
+}
+
+/**
+ * cache_emit - Copies a command of a line's syntax tree into the builder.
+ * @builder: The builder to add to.
+ * @ast: The syntax tree of the line.
+ * @index: Index of the command's node in @ast.
+ *
+ * Nodes keep their layout; only their indices are rebased. Children are
+ * always stored before their parent.
+ *
+ * Return: Index of the copied node, or CACHE_NONE on failure.
+ */
+static NodeIndex cache_emit(CacheBuilder *builder, const Ast *ast,
+			    NodeIndex index)
+{
+	const Node *source = &ast->nodes[index];
+	Node node = *source;
+	uint32_t count;
+
+	switch (source->type) {
+	case CMD_SIMPLE:
+		node.as.simple.envp = cache_emit_words(
+			builder, ast->words + source->as.simple.envp,
+			source->as.simple.envc);
+		node.as.simple.argv = cache_emit_words(
+			builder, ast->words + source->as.simple.argv,
+			source->as.simple.argc);
+		for (count = 0; ast->words[source->as.simple.targets + count];
+		     count++)
+			;
+		node.as.simple.redirects = cache_emit_redirects(
+			builder, ast->redirects + source->as.simple.redirects,
+			count);
+		node.as.simple.targets = cache_emit_words(
+			builder, ast->words + source->as.simple.targets, count);
+		break;
+	case CMD_PIPE:
+		node.as.pipeline.stages =
+			cache_emit_refs(builder, ast, source->as.pipeline.stages,
+					source->as.pipeline.count);
+		break;
+	case CMD_LIST:
+		node.as.list.items = cache_emit_refs(
+			builder, ast, source->as.list.items,
+			source->as.list.count);
+		break;
+	case CMD_IF:
+	case CMD_WHILE:
+	case CMD_UNTIL:
+		node.as.branch.condition = cache_emit(
+			builder, ast, source->as.branch.condition);
+		node.as.branch.body =
+			cache_emit_child(builder, ast, source->as.branch.body);
+		node.as.branch.otherwise = cache_emit_child(
+			builder, ast, source->as.branch.otherwise);
+		break;
+	case CMD_FOR:
+		node.as.loop.name = cache_emit_words(
+			builder, ast->words + source->as.loop.name, 1);
+		node.as.loop.words =
+			cache_emit_child(builder, ast, source->as.loop.words);
+		node.as.loop.body =
+			cache_emit_child(builder, ast, source->as.loop.body);
+		break;
+	case CMD_CASE:
+		node.slot = builder->case_count < AST_NO_SLOT ?
+				    builder->case_count++ :
+				    AST_NO_SLOT;
+		node.as.cases.word = cache_emit_words(
+			builder, ast->words + source->as.cases.word, 1);
+		node.as.cases.arms = cache_emit_refs(
+			builder, ast, source->as.cases.arms,
+			source->as.cases.count);
+		break;
+	case CMD_ARM:
+		node.as.arm.patterns = cache_emit_words(
+			builder, ast->words + source->as.arm.patterns,
+			source->as.arm.count);
+		node.as.arm.body =
+			cache_emit_child(builder, ast, source->as.arm.body);
+		break;
+	case CMD_FUNCTION:
+		node.as.function.name = cache_emit_words(
+			builder, ast->words + source->as.function.name, 1);
+		node.as.function.body =
+			cache_emit(builder, ast, source->as.function.body);
+		break;
+	default:
+		node.as.binary.left =
+			cache_emit(builder, ast, source->as.binary.left);
+		node.as.binary.right =
+			cache_emit(builder, ast, source->as.binary.right);
+		break;
+	}
+
+	if (!builder->valid ||
+	    !cache_reserve((void **)&builder->nodes, &builder->node_capacity,
+			   builder->node_count, 1, sizeof(Node))) {
+		builder->valid = false;
+		return CACHE_NONE;
+	}
+	builder->nodes[builder->node_count] = node;
+	return builder->node_count++;
+}
+
+/**
+ * cache_record_line - Starts recording the commands of a new line.
+ * @builder: The builder to record into.
+ * @line_number: Number of the line in the script.
+ * @offset: Offset of the line in the script text.
+ */
+void cache_record_line(CacheBuilder *builder, int line_number, size_t offset)
+{
+	if (!builder->valid)
+		return;
+	if (offset > UINT32_MAX) {
+		builder->valid = false;
+		return;
+	}
+	if (builder->line_count &&
+	    builder->lines[builder->line_count - 1].count == 0)
+		builder->line_count--;
+	if (!cache_reserve((void **)&builder->lines, &builder->line_capacity,
+			   builder->line_count, 1, sizeof(CacheLine))) {
+		builder->valid = false;
+		return;
+	}
+	builder->lines[builder->line_count++] =
+		(CacheLine){ .line_number = line_number,
+			     .offset = offset,
+			     .first = builder->root_count,
+			     .count = 0 };
+}
+
+/**
+ * cache_record_command - Records a parsed command of the current line.
+ * @builder: The builder to record into.
+ * @ast: The syntax tree of the line.
+ * @root: Index of the command's node, or AST_NONE for an empty command.
+ */
+void cache_record_command(CacheBuilder *builder, const Ast *ast,
+			  NodeIndex root)
+{
+	if (root == AST_NONE || !builder->valid || !builder->line_count)
+		return;
+	root = cache_emit(builder, ast, root);
+	if (!builder->valid ||
+	    !cache_reserve((void **)&builder->roots, &builder->root_capacity,
+			   builder->root_count, 1, sizeof(uint32_t))) {
+		builder->valid = false;
+		return;
+	}
+	builder->roots[builder->root_count++] = root;
+	builder->lines[builder->line_count - 1].count++;
+}
+
+/**
+ * cache_record_abort - Gives up on compiling the current script.
+ * @builder: The builder to invalidate.
+ *
+ * Scripts with lexical or syntax errors are never cached, so their
+ * diagnostics are always produced by the parser itself.
+ */
+void cache_record_abort(CacheBuilder *builder)
+{
+	builder->valid = false;
+}
+
+/**
+ * cache_directory - Finds the directory compiled scripts are kept in.
+ * @buffer: Receives the path.
+ * @size: Size of @buffer.
+ *
+ * HSH_CACHE_DIR takes precedence over $XDG_CACHE_HOME/hsh and
+ * $HOME/.cache/hsh. The directory is created if needed.
+ *
+ * Return: true if a usable directory was found, false otherwise.
+ */
+static bool cache_directory(char *buffer, size_t size)
+{
+	const char *dir = getenv("HSH_CACHE_DIR");
+	const char *base;
+	int n;
+
+	if (dir && *dir) {
+		n = snprintf(buffer, size, "%s", dir);
+	} else if ((base = getenv("XDG_CACHE_HOME")) && *base) {
+		n = snprintf(buffer, size, "%s/hsh", base);
+	} else if ((base = getenv("HOME")) && *base) {
+		n = snprintf(buffer, size, "%s/.cache", base);
+		if (n > 0 && (size_t)n < size)
+			mkdir(buffer, 0700);
+		n = snprintf(buffer, size, "%s/.cache/hsh", base);
+	} else {
+		return false;
+	}
+	if (n < 0 || (size_t)n >= size)
+		return false;
+	return !mkdir(buffer, 0700) || errno == EEXIST;
+}
+
+/**
+ * cache_make_key - Computes the key a compiled script is stored under.
+ * @path: Path of the script.
+ * @source: Contents of the script.
+ * @key: Receives the key.
+ *
+ * Return: true on success, false if the script cannot be identified.
+ */
+static bool cache_make_key(const char *path, Source *source, CacheKey *key)
+{
+	struct stat sinfo;
+
+	if (!realpath(path, key->path) || stat(key->path, &sinfo) ||
+	    !S_ISREG(sinfo.st_mode))
+		return false;
+	key->mtime_sec = sinfo.st_mtim.tv_sec;
+	key->mtime_nsec = sinfo.st_mtim.tv_nsec;
+	key->size = source->size;
+	key->hash = cache_hash(source->data, source->size);
+	return true;
+}
+
+/**
+ * cache_vector_valid - Checks a NULL terminated vector of the word pool.
+ * @image: The image holding the vector.
+ * @first: Index of the first word.
+ * @count: Number of words before the terminator.
+ *
+ * Return: true if the vector lies within the pool and is terminated.
+ */
+static bool cache_vector_valid(const CacheImage *image, uint32_t first,
+			       uint32_t count)
+{
+	uint32_t words = image->header->word_count;
+
+	if (first > words || count >= words - first)
+		return false;
+	for (uint32_t i = 0; i < count; i++) {
+		if (image->words[first + i] == CACHE_NONE)
+			return false;
+	}
+	return image->words[first + count] == CACHE_NONE;
+}
+
+/**
+ * cache_name_valid - Checks a word that must start with a variable name.
+ * @image: The image holding the word.
+ * @word: Index of the word, already checked by cache_vector_valid().
+ * @assignment: Whether the name must be followed by '=' and a value,
+ *              rather than stand alone.
+ *
+ * Return: true if the word is well formed, false otherwise.
+ */
+static bool cache_name_valid(const CacheImage *image, uint32_t word,
+			     bool assignment)
+{
+	const char *text = image->strings + image->words[word];
+	const char *equals = strchr(text, '=');
+	size_t length = assignment ? (equals ? (size_t)(equals - text) : 0) :
+				     strlen(text);
+
+	return (!assignment || equals) && vars_valid_name(text, length);
+}
+
+/**
+ * cache_redirects_valid - Checks the redirections of a simple command.
+ * @image: The image holding the command.
+ * @node: The command.
+ *
+ * Its targets must be a NULL terminated vector of the word pool, with a
+ * known redirection in the redirection pool for each of them.
+ *
+ * Return: true if the redirections are intact, false otherwise.
+ */
+static bool cache_redirects_valid(const CacheImage *image, const Node *node)
+{
+	uint32_t first = node->as.simple.redirects, count = 0;
+	uint32_t targets = node->as.simple.targets;
+
+	if (targets >= image->header->word_count)
+		return false;
+	while (image->words[targets + count] != CACHE_NONE) {
+		if (++count >= image->header->word_count - targets)
+			return false;
+	}
+	if (first > image->header->redirect_count ||
+	    count > image->header->redirect_count - first)
+		return false;
+	for (uint32_t i = 0; i < count; i++) {
+		if (image->redirects[first + i].type > REDIRECT_DUP ||
+		    image->redirects[first + i].fd > 9)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * cache_child_valid - Checks an optional child command.
+ * @image: The image holding the child.
+ * @child: Index of the child, or CACHE_NONE.
+ * @node: Index of its parent, which it must precede.
+ * @type: Type the child must have, or -1 for any command, which an arm
+ *        of a case command is not.
+ *
+ * Return: true if the child is absent or intact, false otherwise.
+ */
+static bool cache_child_valid(const CacheImage *image, NodeIndex child,
+			      uint32_t node, int type)
+{
+	if (child == CACHE_NONE)
+		return true;
+	if (child >= node)
+		return false;
+	if (type < 0)
+		return image->nodes[child].type != CMD_ARM;
+	return image->nodes[child].type == type;
+}
+
+/**
+ * cache_command_valid - Checks a command that must be present.
+ * @image: The image holding the command.
+ * @child: Index of the command.
+ * @node: Index of its parent, which it must precede.
+ *
+ * Return: true if the command is intact, false otherwise.
+ */
+static bool cache_command_valid(const CacheImage *image, NodeIndex child,
+				uint32_t node)
+{
+	return child != CACHE_NONE && cache_child_valid(image, child, node, -1);
+}
+
+/**
+ * cache_refs_valid - Checks commands listed in the reference pool.
+ * @image: The image holding the references.
+ * @first: Index of the first reference.
+ * @count: Number of references.
+ * @node: Index of the node listing them, which they must precede.
+ * @type: Type every command must have, or -1 for any but CMD_ARM.
+ *
+ * Return: true if the references are intact, false otherwise.
+ */
+static bool cache_refs_valid(const CacheImage *image, uint32_t first,
+			     uint32_t count, uint32_t node, int type)
+{
+	uint32_t refs = image->header->ref_count;
+
+	if (first > refs || count > refs - first)
+		return false;
+	for (uint32_t i = 0; i < count; i++) {
+		if (image->refs[first + i] == CACHE_NONE ||
+		    !cache_child_valid(image, image->refs[first + i], node,
+				       type))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * cache_image_valid - Checks that a mapped image is intact and current.
+ * @image: The image to check.
+ * @key: The key the image must match.
+ *
+ * Every index is bounds checked once here so execution can trust them.
+ * Children must precede their parent, which also rules out cycles, and
+ * have a type their parent can run. Assignments must name a variable.
+ *
+ * Return: true if the image can be executed, false otherwise.
+ */
+static bool cache_image_valid(CacheImage *image, CacheKey *key)
+{
+	const CacheHeader *h = image->header;
+	uint32_t strings = h->strings_size;
+
+	if (h->mtime_sec != key->mtime_sec ||
+	    h->mtime_nsec != key->mtime_nsec || h->size != key->size ||
+	    h->hash != key->hash || h->case_count > AST_NO_SLOT ||
+	    strings == 0 ||
+	    image->strings[strings - 1] != '\0' || h->path >= strings ||
+	    strcmp(image->strings + h->path, key->path))
+		return false;
+
+	for (uint32_t i = 0; i < h->word_count; i++) {
+		if (image->words[i] >= strings && image->words[i] != CACHE_NONE)
+			return false;
+	}
+	for (uint32_t i = 0; i < h->node_count; i++) {
+		const Node *node = &image->nodes[i];
+
+		switch (node->type) {
+		case CMD_SIMPLE:
+			if (!cache_vector_valid(image, node->as.simple.argv,
+						node->as.simple.argc) ||
+			    !cache_vector_valid(image, node->as.simple.envp,
+						node->as.simple.envc) ||
+			    !cache_redirects_valid(image, node))
+				return false;
+			for (uint32_t j = 0; j < node->as.simple.envc; j++) {
+				if (!cache_name_valid(
+					    image, node->as.simple.envp + j,
+					    true))
+					return false;
+			}
+			break;
+		case CMD_PIPE:
+			if (node->as.pipeline.count < 2 ||
+			    !cache_refs_valid(image, node->as.pipeline.stages,
+					      node->as.pipeline.count, i, -1))
+				return false;
+			break;
+		case CMD_LIST:
+			if (!cache_refs_valid(image, node->as.list.items,
+					      node->as.list.count, i, -1))
+				return false;
+			break;
+		case CMD_IF:
+		case CMD_WHILE:
+		case CMD_UNTIL:
+			if (!cache_command_valid(
+				    image, node->as.branch.condition, i) ||
+			    !cache_child_valid(image, node->as.branch.body, i,
+					       -1) ||
+			    !cache_child_valid(image, node->as.branch.otherwise,
+					       i, -1))
+				return false;
+			break;
+		case CMD_FOR:
+			if (!cache_vector_valid(image, node->as.loop.name, 1) ||
+			    !cache_name_valid(image, node->as.loop.name,
+					      false) ||
+			    !cache_child_valid(image, node->as.loop.words, i,
+					       CMD_SIMPLE) ||
+			    !cache_child_valid(image, node->as.loop.body, i, -1))
+				return false;
+			break;
+		case CMD_CASE:
+			if ((node->slot >= h->case_count &&
+			     node->slot != AST_NO_SLOT) ||
+			    !cache_vector_valid(image, node->as.cases.word, 1) ||
+			    !cache_refs_valid(image, node->as.cases.arms,
+					      node->as.cases.count, i, CMD_ARM))
+				return false;
+			break;
+		case CMD_ARM:
+			if (!cache_vector_valid(image, node->as.arm.patterns,
+						node->as.arm.count) ||
+			    !cache_child_valid(image, node->as.arm.body, i, -1))
+				return false;
+			break;
+		case CMD_FUNCTION:
+			if (!cache_vector_valid(image, node->as.function.name,
+						1) ||
+			    !cache_command_valid(image, node->as.function.body,
+						 i))
+				return false;
+			break;
+		case CMD_REDIRECT:
+			if (!cache_command_valid(image, node->as.binary.left,
+						 i) ||
+			    node->as.binary.right >= i ||
+			    image->nodes[node->as.binary.right].type !=
+				    CMD_SIMPLE)
+				return false;
+			break;
+		case CMD_AND:
+		case CMD_OR:
+		case CMD_BACKGROUND:
+			if (!cache_command_valid(image, node->as.binary.left,
+						 i) ||
+			    !cache_command_valid(image, node->as.binary.right,
+						 i))
+				return false;
+			break;
+		default:
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < h->root_count; i++) {
+		if (!cache_command_valid(image, image->roots[i], h->node_count))
+			return false;
+	}
+	for (uint32_t i = 0; i < h->line_count; i++) {
+		const CacheLine *line = &image->lines[i];
+		if (line->first > h->root_count ||
+		    line->count > h->root_count - line->first ||
+		    line->offset > h->size)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * cache_image_size - Computes the size of an image from its header.
+ * @h: The header.
+ *
+ * Return: Size of the whole image in bytes.
+ */
+static size_t cache_image_size(const CacheHeader *h)
+{
+	return sizeof(CacheHeader) + (size_t)h->code_size + h->strings_size;
+}
+
+/**
+ * cache_get - Reads a number from the code of an image.
+ * @r: The reader.
+ *
+ * Return: The number, or 0 after marking @r invalid if the code ends or
+ * the number does not fit in 32 bits.
+ */
+static uint32_t cache_get(CacheReader *r)
+{
+	uint32_t value = 0;
+	unsigned char byte;
+
+	for (unsigned int shift = 0; shift < 32 && r->p < r->end; shift += 7) {
+		byte = *r->p++;
+		value |= (uint32_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			if (shift == 28 && byte > 0xf)
+				break;
+			return value;
+		}
+	}
+	r->valid = false;
+	return 0;
+}
+
+/**
+ * cache_get_child - Reads a reference to an earlier node.
+ * @r: The reader.
+ * @node: Index of the node being read.
+ *
+ * Return: Index of the child, or CACHE_NONE if there is none.
+ */
+static NodeIndex cache_get_child(CacheReader *r, uint32_t node)
+{
+	uint32_t back = cache_get(r);
+
+	if (!back)
+		return CACHE_NONE;
+	if (back > node) {
+		r->valid = false;
+		return CACHE_NONE;
+	}
+	return node - back;
+}
+
+/**
+ * cache_get_words - Reads a vector into the word pool.
+ * @r: The reader.
+ * @count: Number of words, which a terminator follows in the pool.
+ *
+ * Return: Index of the first word.
+ */
+static uint32_t cache_get_words(CacheReader *r, uint32_t count)
+{
+	uint32_t first = r->words;
+
+	if (!r->valid || count >= r->image->header->word_count - first) {
+		r->valid = false;
+		return CACHE_NONE;
+	}
+	for (uint32_t i = 0; i < count; i++)
+		r->image->words[first + i] = cache_get(r);
+	r->image->words[first + count] = CACHE_NONE;
+	r->words += count + 1;
+	return first;
+}
+
+/**
+ * cache_get_refs - Reads references to earlier nodes into the pool.
+ * @r: The reader.
+ * @count: Number of references.
+ * @node: Index of the node being read.
+ *
+ * Return: Index of the first reference.
+ */
+static uint32_t cache_get_refs(CacheReader *r, uint32_t count, uint32_t node)
+{
+	uint32_t first = r->refs;
+
+	if (!r->valid || count > r->image->header->ref_count - first) {
+		r->valid = false;
+		return CACHE_NONE;
+	}
+	for (uint32_t i = 0; i < count; i++)
+		r->image->refs[first + i] = cache_get_child(r, node);
+	r->refs += count;
+	return first;
+}
+
+/**
+ * cache_get_simple - Reads the words and redirections of a simple
+ *                    command.
+ * @r: The reader.
+ * @node: The command.
+ *
+ * Each redirection is one number, its descriptor in the low four bits,
+ * its type in the next four and its flags above; its target follows in
+ * the vector of targets.
+ */
+static void cache_get_simple(CacheReader *r, Node *node)
+{
+	uint32_t count, value;
+	Redirect *redirect;
+
+	node->as.simple.envc = cache_get(r);
+	node->as.simple.argc = cache_get(r);
+	count = cache_get(r);
+	node->as.simple.envp = cache_get_words(r, node->as.simple.envc);
+	node->as.simple.argv = cache_get_words(r, node->as.simple.argc);
+	node->as.simple.redirects = r->redirects;
+	if (!r->valid ||
+	    count > r->image->header->redirect_count - r->redirects) {
+		r->valid = false;
+		return;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		value = cache_get(r);
+		redirect = &r->image->redirects[r->redirects++];
+		redirect->fd = value & 0xf;
+		redirect->type = value >> 4 & 0xf;
+		redirect->flags = value >> 8;
+		if (value >> 16)
+			r->valid = false;
+	}
+	node->as.simple.targets = cache_get_words(r, count);
+}
+
+/**
+ * cache_get_node - Reads a node of the syntax tree.
+ * @r: The reader.
+ * @index: Index of the node.
+ *
+ * A node starts with its type in the low four bits of a number and its
+ * flags above, followed by the fields its type uses.
+ */
+static void cache_get_node(CacheReader *r, uint32_t index)
+{
+	Node *node = &r->image->nodes[index];
+	uint32_t value = cache_get(r);
+
+	memset(node, 0, sizeof(*node));
+	node->type = value & 0xf;
+	node->flags = value >> 4;
+	if (value >> 12)
+		r->valid = false;
+	switch (node->type) {
+	case CMD_SIMPLE:
+		cache_get_simple(r, node);
+		break;
+	case CMD_PIPE:
+		node->as.pipeline.count = cache_get(r);
+		node->as.pipeline.stages =
+			cache_get_refs(r, node->as.pipeline.count, index);
+		break;
+	case CMD_LIST:
+		node->as.list.count = cache_get(r);
+		node->as.list.items =
+			cache_get_refs(r, node->as.list.count, index);
+		break;
+	case CMD_IF:
+	case CMD_WHILE:
+	case CMD_UNTIL:
+		node->as.branch.condition = cache_get_child(r, index);
+		node->as.branch.body = cache_get_child(r, index);
+		node->as.branch.otherwise = cache_get_child(r, index);
+		break;
+	case CMD_FOR:
+		node->as.loop.name = cache_get_words(r, 1);
+		node->as.loop.words = cache_get_child(r, index);
+		node->as.loop.body = cache_get_child(r, index);
+		break;
+	case CMD_CASE:
+		node->slot = r->cases < AST_NO_SLOT ? r->cases++ : AST_NO_SLOT;
+		node->as.cases.word = cache_get_words(r, 1);
+		node->as.cases.count = cache_get(r);
+		node->as.cases.arms =
+			cache_get_refs(r, node->as.cases.count, index);
+		break;
+	case CMD_ARM:
+		node->as.arm.count = cache_get(r);
+		node->as.arm.patterns = cache_get_words(r, node->as.arm.count);
+		node->as.arm.body = cache_get_child(r, index);
+		break;
+	case CMD_FUNCTION:
+		node->as.function.name = cache_get_words(r, 1);
+		node->as.function.body = cache_get_child(r, index);
+		break;
+	default:
+		node->as.binary.left = cache_get_child(r, index);
+		node->as.binary.right = cache_get_child(r, index);
+		break;
+	}
+}
+
+/**
+ * cache_get_lines - Reads the lines of the script and their commands.
+ * @r: The reader.
+ *
+ * A line gives how far its number, its offset and its first command
+ * are from those of the line before, then how many commands it has.
+ */
+static void cache_get_lines(CacheReader *r)
+{
+	const CacheHeader *h = r->image->header;
+	uint32_t number = 0, offset = 0, root = 0, roots = 0;
+	CacheLine *line;
+
+	for (uint32_t i = 0; i < h->line_count && r->valid; i++) {
+		line = &r->image->lines[i];
+		number += cache_get(r);
+		offset += cache_get(r);
+		line->line_number = number;
+		line->offset = offset;
+		line->first = roots;
+		line->count = cache_get(r);
+		if (line->count > h->root_count - roots) {
+			r->valid = false;
+			break;
+		}
+		for (uint32_t j = 0; j < line->count; j++) {
+			root += cache_get(r);
+			r->image->roots[roots++] = root;
+		}
+	}
+	if (roots != h->root_count)
+		r->valid = false;
+}
+
+/**
+ * cache_decode - Decodes the code of a mapped image into its tables.
+ * @image: The image, whose header and strings are set.
+ * @code: The code.
+ *
+ * Every count of the header must be used up exactly by the code, and
+ * none may exceed what the size of the code allows, so a damaged header
+ * cannot make the tables huge.
+ *
+ * Return: true on success, false if the code is malformed or memory ran
+ * out.
+ */
+static bool cache_decode(CacheImage *image, const unsigned char *code)
+{
+	const CacheHeader *h = image->header;
+	uint64_t limit = 2 * (uint64_t)h->code_size;
+	CacheReader r = { .p = code,
+			  .end = code + h->code_size,
+			  .valid = true,
+			  .image = image };
+	char *tables;
+
+	if (h->node_count > limit || h->line_count > limit ||
+	    h->root_count > limit || h->word_count > limit ||
+	    h->ref_count > limit || h->redirect_count > limit)
+		return false;
+	tables = malloc(h->node_count * sizeof(Node) +
+			h->line_count * sizeof(CacheLine) +
+			h->root_count * sizeof(NodeIndex) +
+			h->word_count * sizeof(uint32_t) +
+			h->ref_count * sizeof(NodeIndex) +
+			h->redirect_count * sizeof(Redirect) + 1);
+	if (!tables)
+		return false;
+	image->tables = tables;
+	image->nodes = (Node *)tables;
+	tables += h->node_count * sizeof(Node);
+	image->lines = (CacheLine *)tables;
+	tables += h->line_count * sizeof(CacheLine);
+	image->roots = (NodeIndex *)tables;
+	tables += h->root_count * sizeof(NodeIndex);
+	image->words = (uint32_t *)tables;
+	tables += h->word_count * sizeof(uint32_t);
+	image->refs = (NodeIndex *)tables;
+	tables += h->ref_count * sizeof(NodeIndex);
+	image->redirects = (Redirect *)tables;
+
+	for (uint32_t i = 0; i < h->node_count && r.valid; i++)
+		cache_get_node(&r, i);
+	cache_get_lines(&r);
+	return r.valid && r.p == r.end && r.words == h->word_count &&
+	       r.refs == h->ref_count && r.redirects == h->redirect_count &&
+	       r.cases == h->case_count;
+}
+
+/**
+ * cache_image_close - Releases a compiled script.
+ * @image: The image, from cache_image_open().
+ */
+static void cache_image_close(CacheImage *image)
+{
+	free(image->tables);
+	munmap(image->mapped, image->mapped_size);
+}
+
+/**
+ * cache_image_open - Maps a compiled script if it matches a key.
+ * @file: Path of the cache file.
+ * @key: The key the compiled script must match.
+ * @image: Receives the mapped image.
+ *
+ * Return: true if a valid image was mapped, false otherwise.
+ */
+static bool cache_image_open(const char *file, CacheKey *key,
+			     CacheImage *image)
+{
+	struct stat sinfo;
+	int fd = open(file, O_RDONLY | O_CLOEXEC);
+	const CacheHeader *h;
+	const unsigned char *code;
+	char *base;
+
+	if (fd < 0)
+		return false;
+	if (fstat(fd, &sinfo) || (size_t)sinfo.st_size < sizeof(CacheHeader)) {
+		close(fd);
+		return false;
+	}
+	/* Private writable mapping: argv strings may be modified in place. */
+	base = mmap(NULL, sinfo.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		    fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return false;
+
+	memset(image, 0, sizeof(*image));
+	image->mapped = base;
+	image->mapped_size = sinfo.st_size;
+	image->header = h = (const CacheHeader *)base;
+	if (memcmp(h->magic, CACHE_MAGIC, 4) || h->version != CACHE_VERSION ||
+	    cache_image_size(h) != (size_t)sinfo.st_size) {
+		munmap(base, sinfo.st_size);
+		return false;
+	}
+	code = (const unsigned char *)base + sizeof(CacheHeader);
+	image->strings = base + sizeof(CacheHeader) + h->code_size;
+	if (cache_checksum(cache_checksum(0, code, h->code_size),
+			   image->strings, h->strings_size) != h->checksum ||
+	    !cache_decode(image, code) || !cache_image_valid(image, key)) {
+		cache_image_close(image);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * cache_write_all - Writes a whole buffer to a descriptor.
+ * @fd: The descriptor.
+ * @data: The bytes to write.
+ * @size: Number of bytes.
+ *
+ * Return: true on success, false on failure.
+ */
+static bool cache_write_all(int fd, const void *data, size_t size)
+{
+	const char *p = data;
+
+	while (size) {
+		ssize_t n = write(fd, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+/**
+ * cache_put - Appends a number to the code of an image.
+ * @code: The code.
+ * @value: The number, written seven bits a byte, lowest first, with the
+ *         top bit set on every byte but the last.
+ */
+static void cache_put(CacheCode *code, uint32_t value)
+{
+	if (!code->valid ||
+	    !cache_reserve((void **)&code->bytes, &code->capacity, code->size,
+			   5, 1)) {
+		code->valid = false;
+		return;
+	}
+	do {
+		code->bytes[code->size++] =
+			(value & 0x7f) | (value > 0x7f ? 0x80 : 0);
+		value >>= 7;
+	} while (value);
+}
+
+/**
+ * cache_put_child - Appends a reference to an earlier node.
+ * @code: The code.
+ * @node: Index of the node being written.
+ * @child: Index of the child, or CACHE_NONE.
+ */
+static void cache_put_child(CacheCode *code, uint32_t node, NodeIndex child)
+{
+	cache_put(code, child == CACHE_NONE ? 0 : node - child);
+}
+
+/**
+ * cache_put_words - Appends the words of a vector, without its terminator.
+ * @code: The code.
+ * @builder: The builder holding the vector.
+ * @first: Index of the first word.
+ * @count: Number of words.
+ */
+static void cache_put_words(CacheCode *code, const CacheBuilder *builder,
+			    uint32_t first, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+		cache_put(code, builder->words[first + i]);
+}
+
+/**
+ * cache_put_refs - Appends references to earlier nodes.
+ * @code: The code.
+ * @builder: The builder holding the references.
+ * @first: Index of the first reference.
+ * @count: Number of references.
+ * @node: Index of the node being written.
+ */
+static void cache_put_refs(CacheCode *code, const CacheBuilder *builder,
+			   uint32_t first, uint32_t count, uint32_t node)
+{
+	cache_put(code, count);
+	for (uint32_t i = 0; i < count; i++)
+		cache_put_child(code, node, builder->refs[first + i]);
+}
+
+/**
+ * cache_put_node - Appends a node of the syntax tree, as cache_get_node()
+ *                  reads it.
+ * @code: The code.
+ * @builder: The builder holding the node.
+ * @index: Index of the node.
+ */
+static void cache_put_node(CacheCode *code, const CacheBuilder *builder,
+			   uint32_t index)
+{
+	const Node *node = &builder->nodes[index];
+	const Redirect *redirect;
+	uint32_t count = 0, first;
+
+	cache_put(code, node->type | node->flags << 4);
+	switch (node->type) {
+	case CMD_SIMPLE:
+		while (builder->words[node->as.simple.targets + count] !=
+		       CACHE_NONE)
+			count++;
+		cache_put(code, node->as.simple.envc);
+		cache_put(code, node->as.simple.argc);
+		cache_put(code, count);
+		cache_put_words(code, builder, node->as.simple.envp,
+				node->as.simple.envc);
+		cache_put_words(code, builder, node->as.simple.argv,
+				node->as.simple.argc);
+		first = node->as.simple.redirects;
+		for (uint32_t i = 0; i < count; i++) {
+			redirect = &builder->redirects[first + i];
+			cache_put(code, redirect->fd | redirect->type << 4 |
+						redirect->flags << 8);
+		}
+		cache_put_words(code, builder, node->as.simple.targets, count);
+		break;
+	case CMD_PIPE:
+		cache_put_refs(code, builder, node->as.pipeline.stages,
+			       node->as.pipeline.count, index);
+		break;
+	case CMD_LIST:
+		cache_put_refs(code, builder, node->as.list.items,
+			       node->as.list.count, index);
+		break;
+	case CMD_IF:
+	case CMD_WHILE:
+	case CMD_UNTIL:
+		cache_put_child(code, index, node->as.branch.condition);
+		cache_put_child(code, index, node->as.branch.body);
+		cache_put_child(code, index, node->as.branch.otherwise);
+		break;
+	case CMD_FOR:
+		cache_put_words(code, builder, node->as.loop.name, 1);
+		cache_put_child(code, index, node->as.loop.words);
+		cache_put_child(code, index, node->as.loop.body);
+		break;
+	case CMD_CASE:
+		cache_put_words(code, builder, node->as.cases.word, 1);
+		cache_put_refs(code, builder, node->as.cases.arms,
+			       node->as.cases.count, index);
+		break;
+	case CMD_ARM:
+		cache_put(code, node->as.arm.count);
+		cache_put_words(code, builder, node->as.arm.patterns,
+				node->as.arm.count);
+		cache_put_child(code, index, node->as.arm.body);
+		break;
+	case CMD_FUNCTION:
+		cache_put_words(code, builder, node->as.function.name, 1);
+		cache_put_child(code, index, node->as.function.body);
+		break;
+	default:
+		cache_put_child(code, index, node->as.binary.left);
+		cache_put_child(code, index, node->as.binary.right);
+		break;
+	}
+}
+
+/**
+ * cache_encode - Writes the code of a compiled script.
+ * @builder: The compiled script.
+ * @code: Receives the code.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool cache_encode(const CacheBuilder *builder, CacheCode *code)
+{
+	uint32_t number = 0, offset = 0, root = 0;
+	const CacheLine *line;
+
+	for (uint32_t i = 0; i < builder->node_count; i++)
+		cache_put_node(code, builder, i);
+	for (uint32_t i = 0; i < builder->line_count; i++) {
+		line = &builder->lines[i];
+		cache_put(code, line->line_number - number);
+		cache_put(code, line->offset - offset);
+		cache_put(code, line->count);
+		number = line->line_number;
+		offset = line->offset;
+		for (uint32_t j = 0; j < line->count; j++) {
+			cache_put(code, builder->roots[line->first + j] - root);
+			root = builder->roots[line->first + j];
+		}
+	}
+	return code->valid;
+}
+
+/**
+ * cache_store - Writes a compiled script to the cache.
+ * @builder: The compiled script.
+ * @file: Path of the cache file.
+ * @key: The key of the script.
+ *
+ * The image is written to a temporary file and renamed into place, so
+ * concurrent shells only ever map complete images. An image more than
+ * CACHE_MAX_GROWTH times the size of the script is not written at all:
+ * reading it would cost about as much as parsing the script again.
+ */
+static void cache_store(CacheBuilder *builder, const char *file,
+			CacheKey *key)
+{
+	char temp[PATH_MAX];
+	CacheHeader header = { .magic = CACHE_MAGIC,
+			       .version = CACHE_VERSION,
+			       .mtime_sec = key->mtime_sec,
+			       .mtime_nsec = key->mtime_nsec,
+			       .size = key->size,
+			       .hash = key->hash };
+	CacheCode code = { .valid = true };
+	int fd = -1;
+	bool ok;
+
+	if (builder->line_count &&
+	    builder->lines[builder->line_count - 1].count == 0)
+		builder->line_count--;
+	header.path = cache_intern(builder, key->path);
+	if (builder->valid && cache_encode(builder, &code) &&
+	    sizeof(header) + code.size + builder->strings_size <=
+		    CACHE_MAX_GROWTH * key->size &&
+	    snprintf(temp, sizeof(temp), "%s.%d", file, (int)getpid()) <
+		    (int)sizeof(temp))
+		fd = open(temp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		free(code.bytes);
+		return;
+	}
+
+	header.line_count = builder->line_count;
+	header.root_count = builder->root_count;
+	header.node_count = builder->node_count;
+	header.word_count = builder->word_count;
+	header.ref_count = builder->ref_count;
+	header.redirect_count = builder->redirect_count;
+	header.case_count = builder->case_count;
+	header.code_size = code.size;
+	header.strings_size = builder->strings_size;
+	header.checksum = cache_checksum(cache_checksum(0, code.bytes,
+							code.size),
+					 builder->strings,
+					 builder->strings_size);
+	ok = cache_write_all(fd, &header, sizeof(header)) &&
+	     cache_write_all(fd, code.bytes, code.size) &&
+	     cache_write_all(fd, builder->strings, builder->strings_size);
+	if (close(fd) || !ok || rename(temp, file))
+		unlink(temp);
+	free(code.bytes);
+}
+
+/**
+ * cache_execute - Runs a compiled script.
+ * @shell: Pointer to the shell state.
+ * @image: The mapped image.
+ * @source: Contents of the script.
+ *
+ * The decoded nodes and references are executed as they are; only the
+ * word pool is turned from string offsets into pointers to the mapped
+ * strings. The patterns of the case commands are compiled as they run,
+ * and kept until the end. The image was compiled without aliases, so
+ * once a line defines or removes one the rest of the script is lexed
+ * and parsed from @source instead. The last command may replace the
+ * shell, as in shell_run_source().
+ */
+static void cache_execute(ShellState *shell, CacheImage *image,
+			  Source *source)
+{
+	uint64_t generation = shell->alias_generation;
+	const CacheHeader *h = image->header;
+	Ast ast = { .nodes = image->nodes,
+		    .node_count = h->node_count,
+		    .refs = image->refs,
+		    .ref_count = h->ref_count,
+		    .redirects = image->redirects,
+		    .redirect_count = h->redirect_count,
+		    .word_count = h->word_count,
+		    .case_count = h->case_count };
+
+	ast.words = malloc(sizeof(char *) * (h->word_count + 1));
+	ast.matchers = calloc(h->case_count + 1, sizeof(*ast.matchers));
+	if (!ast.words || !ast.matchers) {
+		free(ast.words);
+		free(ast.matchers);
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+		return;
+	}
+	for (uint32_t i = 0; i < h->word_count; i++)
+		ast.words[i] = image->words[i] == CACHE_NONE ?
+				       NULL :
+				       image->strings + image->words[i];
+
+	for (uint32_t i = 0;
+	     i < h->line_count && !shell->fatal_error && !shell->skip; i++) {
+		const CacheLine *line = &image->lines[i];
+
+		arena_reset(shell->arena);
+		jobs_reap(shell, 0);
+		shell->line_number = line->line_number;
+		for (uint32_t j = 0; j < line->count; j++) {
+			shell->exec_next = shell->exec_final &&
+					   i + 1 == h->line_count &&
+					   j + 1 == line->count;
+			execute(shell, &ast, image->roots[line->first + j]);
+			if (shell->fatal_error || shell->skip)
+				break;
+		}
+		if (shell->alias_generation != generation &&
+		    !shell->fatal_error && !shell->skip &&
+		    i + 1 < h->line_count) {
+			line = &image->lines[i + 1];
+			shell->line_number = line->line_number - 1;
+			shell_run_source(shell, source->data + line->offset,
+					 NULL);
+			break;
+		}
+	}
+	ast_free_matchers(&ast);
+	free(ast.matchers);
+	free(ast.words);
+}
+
+/**
+ * cache_run_script - Runs a script through the compiled-script cache.
+ * @shell: Pointer to the shell state.
+ * @path: Path of the script.
+ * @source: Contents of the script.
+ *
+ * A valid compiled copy is mapped and executed without lexing or
+ * parsing. Otherwise the script runs normally while its syntax trees are
+ * recorded, and the result is stored if the whole script parsed cleanly
+ * and no alias changed while it ran. Aliases already defined would
+ * change how the script parses, so the cache is not used at all then.
+ */
+void cache_run_script(ShellState *shell, const char *path, Source *source)
+{
+	char dir[PATH_MAX], file[PATH_MAX];
+	CacheKey key;
+	CacheImage image;
+	CacheBuilder *builder;
+	uint64_t generation = shell->alias_generation;
+
+	/* The statistics are printed once the script has run. */
+	if (getenv("HSH_CACHE_STATS"))
+		shell->exec_final = false;
+
+	if (shell->aliases->count || !cache_directory(dir, sizeof(dir)) ||
+	    !cache_make_key(path, source, &key) ||
+	    snprintf(file, sizeof(file), "%s/%016llx.hshc", dir,
+		     (unsigned long long)cache_hash(key.path,
+						    strlen(key.path))) >=
+		    (int)sizeof(file)) {
+		shell_run_source(shell, source->data, NULL);
+		return;
+	}
+
+	if (cache_image_open(file, &key, &image)) {
+		shell->cache_hits++;
+		cache_execute(shell, &image, source);
+		cache_image_close(&image);
+		return;
+	}
+
+	shell->cache_misses++;
+	builder = cache_builder_new();
+	if (shell_run_source(shell, source->data, builder) && builder &&
+	    builder->valid && shell->alias_generation == generation)
+		cache_store(builder, file, &key);
+	if (builder)
+		cache_builder_free(builder);
+}
+
+/**
+ * cache_report - Prints the cache counters if HSH_CACHE_STATS is set.
+ * @shell: Pointer to the shell state.
+ */
+void cache_report(ShellState *shell)
+{
+	if (getenv("HSH_CACHE_STATS"))
+		fprintf(stderr, "%s: cache: %lu hits, %lu misses\n",
+			shell->name, shell->cache_hits, shell->cache_misses);
+}
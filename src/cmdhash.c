@@ -0,0 +1,78 @@
+#include <cmdhash.h>
+#include <table.h>
+#include <utils.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * cmdhash_clear - Forgets every remembered command location.
+ * @shell: Pointer to the shell state.
+ */
+void cmdhash_clear(ShellState *shell)
+{
+	table_clear(shell->commands);
+}
+
+/**
+ * cmdhash_sync - Drops the table if PATH changed since it was filled.
+ * @shell: Pointer to the shell state.
+ *
+ * The variable store counts the changes to PATH, so this is a single
+ * comparison. Callers reading the table directly, rather than through
+ * cmdhash_lookup(), call it first so that no stale location shows.
+ */
+void cmdhash_sync(ShellState *shell)
+{
+	if (shell->hashed_generation == shell->vars.path_generation)
+		return;
+	cmdhash_clear(shell);
+	shell->hashed_generation = shell->vars.path_generation;
+}
+
+/**
+ * cmdhash_lookup - Resolves a command name through the command hash table.
+ * @shell: Pointer to the shell state.
+ * @name: The command name to resolve.
+ *
+ * Names containing a slash are returned as they are. Other names are
+ * searched for in PATH once and the result, including a failed search,
+ * is remembered until PATH changes or the entry is forgotten.
+ *
+ * Return: The resolved path, owned by the table, or NULL if not found.
+ */
+const char *cmdhash_lookup(ShellState *shell, const char *name)
+{
+	TableEntry *entry;
+
+	if (strchr(name, '/'))
+		return name;
+
+	cmdhash_sync(shell);
+
+	entry = table_find(shell->commands, name);
+	if (entry)
+		return entry->value;
+
+	uint64_t start = trace_now(shell->trace);
+	char *path = build_path(name, vars_get(&shell->vars, "PATH"));
+
+	trace_span(shell->trace, "build_path", start);
+	if (!table_insert(shell->commands, name, path)) {
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+		free(path);
+		return NULL;
+	}
+	return path;
+}
+
+/**
+ * cmdhash_forget - Drops the remembered location of a single command.
+ * @shell: Pointer to the shell state.
+ * @name: The command name to forget.
+ */
+void cmdhash_forget(ShellState *shell, const char *name)
+{
+	table_remove(shell->commands, name);
+}
@@ -1,176 +1,1338 @@
-#include <command.h>
+#include <ast.h>
+#include <arena.h>
 #include <executor.h>
+#include <match.h>
 #include <utils.h>
-#include <environ.h>
+#include <fnmatch.h>
 #include <stdio.h>
-#include <vec.h>
 #include <shell.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <signal.h>
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <spawn.h>
 #include <stdlib.h>
 #include <builtins.h>
+#include <cmdhash.h>
+#include <expand.h>
+#include <function.h>
+#include <jobs.h>
+#include <redirect.h>
 
+static int execute_node(ShellState *shell, const Ast *ast, NodeIndex index,
+			bool last);
+
+/**
+ * prefix_path - Finds a PATH assignment among a command's prefix assignments.
+ * @envp: NULL terminated list of NAME=value assignments.
+ *
+ * Return: The assigned PATH value, or NULL if PATH is not assigned.
+ */
+static const char *prefix_path(char **envp)
+{
+	for (; *envp; envp++) {
+		if (!strncmp(*envp, "PATH=", 5))
+			return *envp + 5;
+	}
+	return NULL;
+}
+
+/**
+ * spawn_program - Starts a program without duplicating the shell.
+ * @path: Resolved path of the program.
+ * @argv: Argument vector of the program.
+ * @envp: Environment of the program.
+ * @in: Descriptor to install as standard input, or -1.
+ * @out: Descriptor to install as standard output, or -1.
+ * @moves: Redirections applied after @in and @out.
+ * @count: Number of redirections.
+ * @pgid: Process group to join, 0 for a new one, or -1 to stay in the
+ *        shell's.
+ * @pid: Set to the pid of the new process.
+ *
+ * posix_spawn() lets the C library use vfork/CLONE_VM semantics, so the
+ * cost of starting a program does not grow with the size of the shell.
+ * Redirections become file actions run in the child. Failures of
+ * execve() are reported back through the return value.
+ *
+ * Return: 0 on success, an errno value otherwise.
+ */
+static int spawn_program(const char *path, char **argv, char **envp, int in,
+			 int out, const FdAction *moves, size_t count,
+			 pid_t pgid, pid_t *pid)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	sigset_t defaults;
+	int error;
+
+	error = posix_spawnattr_init(&attr);
+	if (error)
+		return error;
+	jobs_signals(&defaults);
+	posix_spawnattr_setsigdefault(&attr, &defaults);
+	if (pgid >= 0)
+		posix_spawnattr_setpgroup(&attr, pgid);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF |
+						(pgid >= 0 ? POSIX_SPAWN_SETPGROUP :
+							     0));
+
+	error = posix_spawn_file_actions_init(&actions);
+	if (error) {
+		posix_spawnattr_destroy(&attr);
+		return error;
+	}
+	if (in >= 0)
+		error = posix_spawn_file_actions_adddup2(&actions, in,
+							 STDIN_FILENO);
+	if (!error && out >= 0)
+		error = posix_spawn_file_actions_adddup2(&actions, out,
+							 STDOUT_FILENO);
+	for (size_t i = 0; !error && i < count; i++) {
+		if (moves[i].source < 0)
+			error = posix_spawn_file_actions_addclose(&actions,
+								  moves[i].fd);
+		else
+			error = posix_spawn_file_actions_adddup2(
+				&actions, moves[i].source, moves[i].fd);
+	}
+	if (!error)
+		error = posix_spawn(pid, path, &actions, &attr, argv, envp);
+	posix_spawn_file_actions_destroy(&actions);
+	posix_spawnattr_destroy(&attr);
+	return error;
+}
+
+/**
+ * exit_status - Converts a status reported by waitpid() to an exit status.
+ * @status: The raw wait status.
+ *
+ * Return: The exit code, or 128 plus the signal number for killed children.
+ */
+int exit_status(int status)
+{
+	if (WIFSIGNALED(status))
+		return 128 + WTERMSIG(status);
+	return WEXITSTATUS(status);
+}
+
+/**
+ * report_program - Reports why the program of a command could not be run.
+ * @shell: Pointer to the shell state.
+ * @out: Descriptor the command's standard output goes to, or -1.
+ * @moves: The command's redirections, from redirect_open().
+ * @count: Number of redirections.
+ * @name: The name of the command.
+ * @message: What went wrong.
+ *
+ * @out and the redirections are applied around the message, so it goes
+ * to the command's own standard error: `nosuchcmd 2>/dev/null` is
+ * silent, and `nosuchcmd 2>&1 | cat` sends it down the pipe.
+ */
+static void report_program(ShellState *shell, int out, FdAction *moves,
+			   size_t count, const char *name, const char *message)
+{
+	FdAction pipe = { .fd = STDOUT_FILENO, .source = out };
+	bool piped, applied;
+
+	fflush(stdout);
+	piped = out >= 0 && redirect_apply(shell, &pipe, 1);
+	applied = count && redirect_apply(shell, moves, count);
+	fprintf(stderr, "%s: %d: %s: %s\n", shell->name, shell->line_number,
+		name, message);
+	if (applied)
+		redirect_restore(moves, count);
+	if (piped)
+		redirect_restore(&pipe, 1);
+}
+
+/**
+ * find_program - Resolves the program a simple command names.
+ * @shell: Pointer to the shell state.
+ * @simple: The command.
+ * @out: Descriptor the command's standard output goes to, or -1.
+ * @moves: The command's redirections, from redirect_open().
+ * @count: Number of redirections.
+ * @owned: Receives the path if it was built for a PATH assigned in front
+ *         of the command, to be freed, otherwise NULL.
+ * @status: Set to the exit status when no program is found.
+ *
+ * Return: The path of the program, or NULL after reporting why not.
+ */
+static const char *find_program(ShellState *shell, SimpleCommand *simple,
+				int out, FdAction *moves, size_t count,
+				char **owned, int *status)
+{
+	const char *path_env = prefix_path(simple->envp);
+	const char *path;
+	uint64_t start;
+
+	*owned = NULL;
+	if (path_env) {
+		start = trace_now(shell->trace);
+		path = *owned = build_path(simple->argv[0], path_env);
+		trace_span(shell->trace, "build_path", start);
+	} else {
+		path = cmdhash_lookup(shell, simple->argv[0]);
+	}
+	if (shell->fatal_error) {
+		*status = 1;
+		return NULL;
+	}
+	if (!path) {
+		report_program(shell, out, moves, count, simple->argv[0],
+			       "not found");
+		*status = 127;
+	}
+	return path;
+}
+
+/**
+ * spawn_simple_command - Starts the program named by a simple command.
+ * @shell: Pointer to the shell state.
+ * @simple: The command to start.
+ * @in: Descriptor to use as standard input, or -1 to inherit it.
+ * @out: Descriptor to use as standard output, or -1 to inherit it.
+ * @pgid: Process group to join, 0 for a new one, or -1 for the shell's.
+ * @status: Set to the exit status when no process could be started.
+ *
+ * Redirections of the command itself take precedence over @in and @out.
+ * They are opened before the program is looked up, so the files they
+ * create exist even when it is not found, as in other shells.
+ *
+ * Return: The pid of the started process, or -1 on failure.
+ */
+static pid_t spawn_simple_command(ShellState *shell, SimpleCommand *simple,
+				  int in, int out, pid_t pgid, int *status)
+{
+	pid_t pid;
+	int error;
+	FdAction stack[REDIRECT_STACK], *moves;
+	size_t count;
+	const char *path;
+	char *owned_path;
+	char *name = simple->argv[0];
+	char **envp;
+	uint64_t start;
+
+	moves = redirect_open(shell, simple, stack, &count);
+	if (!moves) {
+		*status = 2;
+		return -1;
+	}
+	path = find_program(shell, simple, out, moves, count, &owned_path,
+			    status);
+	if (!path) {
+		redirect_release(moves, count, stack);
+		return -1;
+	}
+	envp = *simple->envp ? vars_overlay(&shell->vars, simple->envp) :
+			       vars_environ(&shell->vars);
+	if (!envp) {
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+		redirect_release(moves, count, stack);
+		free(owned_path);
+		*status = 1;
+		return -1;
+	}
+
+	fflush(stdout);
+	start = trace_now(shell->trace);
+	error = spawn_program(path, simple->argv, envp, in, out, moves, count,
+			      pgid, &pid);
+	if (error == ENOENT && !owned_path && path != name) {
+		/* The hashed location went stale: search PATH again. */
+		cmdhash_forget(shell, name);
+		path = cmdhash_lookup(shell, name);
+		if (path)
+			error = spawn_program(path, simple->argv, envp, in, out,
+					      moves, count, pgid, &pid);
+	}
+	trace_span(shell->trace, "exec", start);
+	vars_restore(&shell->vars);
+	free(owned_path);
+	if (error) {
+		report_program(shell, out, moves, count, name,
+			       strerror(error));
+		*status = error == ENOENT ? 127 : 126;
+	}
+	redirect_release(moves, count, stack);
+	return error ? -1 : pid;
+}
+
+/**
+ * exec_simple_command - Replaces the shell with the program a simple
+ *                       command names.
+ * @shell: Pointer to the shell state.
+ * @simple: The command to run.
+ *
+ * The redirections are opened first, as for a spawned program, then
+ * applied to the shell itself and the program is executed in its place,
+ * so the command costs neither a fork nor a wait.
+ * Should execve() fail, the failure is reported while the redirections
+ * are still applied, as for a spawned program, and they are undone.
+ *
+ * Return: Only on failure: 127 or 126 if the program could not be run,
+ * 2 if a redirection failed, 1 on allocation failure.
+ */
+static int exec_simple_command(ShellState *shell, SimpleCommand *simple)
+{
+	FdAction stack[REDIRECT_STACK], *moves;
+	size_t count;
+	const char *path;
+	char *owned_path;
+	char *name = simple->argv[0];
+	char **envp;
+	int status = 2, error;
+
+	moves = redirect_open(shell, simple, stack, &count);
+	if (!moves)
+		return 2;
+	path = find_program(shell, simple, -1, moves, count, &owned_path,
+			    &status);
+	if (!path) {
+		redirect_release(moves, count, stack);
+		return status;
+	}
+	envp = *simple->envp ? vars_overlay(&shell->vars, simple->envp) :
+			       vars_environ(&shell->vars);
+	if (!envp) {
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+		redirect_release(moves, count, stack);
+		free(owned_path);
+		return 1;
+	}
+
+	fflush(stdout);
+	if (redirect_apply(shell, moves, count)) {
+		execve(path, simple->argv, envp);
+		error = errno;
+		if (error == ENOENT && !owned_path && path != name) {
+			/* The hashed location went stale: search PATH again. */
+			cmdhash_forget(shell, name);
+			path = cmdhash_lookup(shell, name);
+			if (path) {
+				execve(path, simple->argv, envp);
+				error = errno;
+			}
+		}
+		fprintf(stderr, "%s: %d: %s: %s\n", shell->name,
+			shell->line_number, name, strerror(error));
+		redirect_restore(moves, count);
+		status = error == ENOENT ? 127 : 126;
+	}
+	vars_restore(&shell->vars);
+	free(owned_path);
+	redirect_release(moves, count, stack);
+	return status;
+}
+
+/**
+ * execute_simple_command - Runs the program a simple command names.
+ * @shell: Pointer to the shell state.
+ * @simple: The command to run.
+ * @last: Whether the shell has nothing left to do after it, in which
+ *        case the program replaces the shell instead of being waited for.
+ *
+ * Return: The exit status of the program.
+ */
 static int execute_simple_command(ShellState *shell, SimpleCommand *simple,
-				  bool is_background)
+				  bool last)
 {
 	pid_t pid;
 	int status = 0;
+	uint64_t start, waited;
 
 	if (simple->argc == 0)
 		return 0;
+	if (last)
+		return exec_simple_command(shell, simple);
 
-	pid = fork();
+	start = trace_now(shell->trace);
+	pid = spawn_simple_command(shell, simple, -1, -1, -1, &status);
+	if (pid < 0)
+		return status;
+	waited = trace_now(shell->trace);
+	timing_wait(shell->timing, pid, &status, 0);
+	trace_span(shell->trace, "waitpid", waited);
+	status = exit_status(status);
+	trace_command(shell->trace, simple->argv[0], start, pid, status);
+	return status;
+}
 
-	if (pid < 0) {
-		fprintf(stderr, "%s: fork failed: %s\n", shell->name,
-			strerror(errno));
-		return -1;
-	} else if (pid > 0) {
-		if (is_background) {
-			printf("[1] %d\n", pid);
-			return 0;
-		} else {
-			waitpid(pid, &status, 0);
-			return status;
-		}
-	} else {
-		int in, out;
-
-		if (simple->input_file) {
-			in = open(simple->input_file, O_RDONLY);
-			if (in < 0) {
-				fprintf(stderr, "%s: %s: %s\n", shell->name,
-					simple->input_file, strerror(errno));
-				shell->fatal_error = true;
-				return 1;
-			}
-			dup2(in, STDIN_FILENO);
-			close(in);
-		}
-		if (simple->output_file) {
-			mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
-			if (simple->append_output) {
-				int flags = O_WRONLY | O_CREAT | O_APPEND;
-				out = open(simple->output_file, flags, mode);
-			} else {
-				int flags = O_WRONLY | O_CREAT | O_TRUNC;
-				out = open(simple->output_file, flags, mode);
-			}
-			if (out < 0) {
-				fprintf(stderr, "%s: %s: %s\n", shell->name,
-					simple->output_file, strerror(errno));
-				shell->fatal_error = true;
-				return 1;
-			}
-			dup2(out, STDOUT_FILENO);
-			close(out);
-		}
-		char **envp = concat(2, simple->envp, environ);
-		if (!envp) {
+/**
+ * execute_builtin_redirected - Runs a builtin with its redirections.
+ * @shell: Pointer to the shell state.
+ * @builtin_func: The builtin to run.
+ * @simple: The command being executed.
+ * @is_background: Whether the command was started with `&`.
+ *
+ * The redirections are applied to the shell itself around the builtin
+ * and undone after, so `echo x >>log` costs a few system calls rather
+ * than a fork.
+ *
+ * Return: The exit status of the builtin, or 2 if a redirection failed.
+ */
+static int execute_builtin_redirected(
+	ShellState *shell, int (*builtin_func)(ShellState *, SimpleCommand *,
+					       bool),
+	SimpleCommand *simple, bool is_background)
+{
+	FdAction stack[REDIRECT_STACK], *moves;
+	size_t count;
+	int status = 2;
+	uint64_t start;
+
+	moves = redirect_open(shell, simple, stack, &count);
+	if (!moves)
+		return 2;
+	fflush(stdout);
+	if (redirect_apply(shell, moves, count)) {
+		start = trace_now(shell->trace);
+		status = builtin_func(shell, simple, is_background);
+		trace_command(shell->trace, simple->argv[0], start, getpid(),
+			      status);
+		fflush(stdout);
+		redirect_restore(moves, count);
+	}
+	redirect_release(moves, count, stack);
+	return status;
+}
+
+/**
+ * execute_assignments - Sets the variables of a command without a name.
+ * @shell: Pointer to the shell state.
+ * @command: The command, made of assignments only.
+ *
+ * Its redirections are still opened, so files are created, and then
+ * closed; a redirection that fails stops the assignments.
+ *
+ * Return: The status of the last command substitution, if any, else 0;
+ * 1 on allocation failure, 2 if a redirection failed.
+ */
+static int execute_assignments(ShellState *shell, SimpleCommand *command)
+{
+	FdAction stack[REDIRECT_STACK], *moves;
+	size_t count;
+
+	if (*command->targets) {
+		moves = redirect_open(shell, command, stack, &count);
+		if (!moves)
+			return 2;
+		redirect_release(moves, count, stack);
+	}
+	for (char **assignment = command->envp; *assignment; assignment++) {
+		if (!vars_set(&shell->vars, *assignment, 0)) {
 			fprintf(stderr, "Error: malloc failed\n");
 			shell->fatal_error = true;
 			return 1;
 		}
-		char *path = build_path(simple->argv[0], getenv("PATH"));
-		if (path)
-			simple->argv[0] = path;
-		execve(simple->argv[0], simple->argv, envp);
-		fprintf(stderr, "%s: %d: %s: %s\n", shell->name,
-			shell->line_number, simple->argv[0], strerror(errno));
-		free(envp);
-		free(path);
+	}
+	return command->subst_status < 0 ? 0 : command->subst_status;
+}
+
+/**
+ * call_function - Runs the body of a function for a call.
+ * @shell: Pointer to the shell state.
+ * @function: The function.
+ * @command: The command calling it, whose arguments become the
+ *           positional parameters for the call.
+ * @last: Whether the shell has nothing left to do after the call.
+ *
+ * The body runs from the syntax tree copied when the function was
+ * defined. The arguments are copied into the line's arena, as the
+ * expansion buffer they may live in is reused by the body. Loops of the
+ * caller are out of reach of `break` and `continue` in the body, and a
+ * `return` ends the call.
+ *
+ * Return: The exit status of the body, or the status given to `return`.
+ */
+static int call_function(ShellState *shell, Function *function,
+			 SimpleCommand *command, bool last)
+{
+	char **params = shell->params, **args;
+	int param_count = shell->param_count, loop_depth = shell->loop_depth;
+	int status;
+
+	args = arena_alloc(shell->arena, sizeof(char *) * command->argc);
+	for (int i = 1; args && i < command->argc; i++) {
+		args[i - 1] = arena_strndup(shell->arena, command->argv[i],
+					    strlen(command->argv[i]));
+		if (!args[i - 1])
+			args = NULL;
+	}
+	if (!args) {
+		fprintf(stderr, "Error: malloc failed\n");
 		shell->fatal_error = true;
 		return 1;
 	}
-	return 0;
+	args[command->argc - 1] = NULL;
+	shell->params = args;
+	shell->param_count = command->argc - 1;
+	shell->loop_depth = 0;
+	shell->function_depth++;
+	function->calls++;
+	shell->exec_next = last;
+	status = execute(shell, &function->ast, function->body);
+	function_release(function);
+	if (shell->skip == SKIP_RETURN) {
+		shell->skip = 0;
+		status = shell->status;
+	}
+	shell->function_depth--;
+	shell->loop_depth = loop_depth;
+	shell->param_count = param_count;
+	shell->params = params;
+	return status;
+}
+
+/**
+ * execute_function - Calls a function with the redirections of the call.
+ * @shell: Pointer to the shell state.
+ * @function: The function.
+ * @command: The command calling it.
+ * @last: Whether the shell has nothing left to do after the call.
+ *
+ * As for a builtin, the redirections are applied to the shell itself
+ * around the call and undone after.
+ *
+ * Return: The exit status of the call, or 2 if a redirection failed.
+ */
+static int execute_function(ShellState *shell, Function *function,
+			    SimpleCommand *command, bool last)
+{
+	FdAction stack[REDIRECT_STACK], *moves;
+	size_t count;
+	int status = 2;
+	uint64_t start = trace_now(shell->trace);
+
+	if (!*command->targets) {
+		status = call_function(shell, function, command, last);
+	} else {
+		moves = redirect_open(shell, command, stack, &count);
+		if (!moves)
+			return 2;
+		fflush(stdout);
+		if (redirect_apply(shell, moves, count)) {
+			status = call_function(shell, function, command,
+					       false);
+			fflush(stdout);
+			redirect_restore(moves, count);
+		}
+		redirect_release(moves, count, stack);
+	}
+	trace_command(shell->trace, command->argv[0], start, getpid(), status);
+	return status;
 }
 
 static int execute_command(ShellState *shell, SimpleCommand *command,
-			   bool is_background)
+			   bool is_background, bool last)
 {
 	int (*builtin_func)(ShellState *, SimpleCommand *, bool);
+	Function *function;
+
 	if (command->argc == 0)
-		// modify shell environment for variable assignment
-		return 0;
-	else if ((builtin_func = get_builtin(command->argv[0])) != NULL)
-		return builtin_func(shell, command, is_background);
-	else
-		return execute_simple_command(shell, command, is_background);
+		return execute_assignments(shell, command);
+
+	function = function_find(shell, command->argv[0]);
+	if (function)
+		return execute_function(shell, function, command, last);
+	builtin_func = get_builtin(shell, command->argv[0]);
+	if (builtin_func && *command->targets)
+		return execute_builtin_redirected(shell, builtin_func, command,
+						  is_background);
+	if (!builtin_func)
+		return execute_simple_command(shell, command, last);
+
+	uint64_t start = trace_now(shell->trace);
+	int status = builtin_func(shell, command, is_background);
+
+	trace_command(shell->trace, command->argv[0], start, getpid(), status);
+	return status;
 }
 
-int execute_pipeline(ShellState *shell, Command *left, Command *right)
+/**
+ * make_pipe - Creates a pipe whose ends are closed on exec.
+ * @shell: Pointer to the shell state.
+ * @fds: Receives the read and write ends.
+ *
+ * Return: true on success, false on failure.
+ */
+static bool make_pipe(ShellState *shell, int fds[2])
 {
-	int pipefd[2], status;
-	if (pipe(pipefd) == -1) {
+	if (pipe(fds) == -1) {
 		fprintf(stderr, "%s: pipe failed: %s\n", shell->name,
 			strerror(errno));
-		return -1;
+		return false;
 	}
-	pid_t left_pid = fork();
-	if (left_pid < 0) {
-		fprintf(stderr, "%s: fork failed: %s\n", shell->name,
-			strerror(errno));
-		return -1;
-	} else if (left_pid == 0) {
-		dup2(pipefd[1], STDOUT_FILENO);
-		close(pipefd[1]);
-		close(pipefd[0]);
-		status = execute(shell, left);
-		exit(status);
-	}
-	pid_t right_pid = fork();
-	if (right_pid < 0) {
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	return true;
+}
+
+/**
+ * job_group - Prepares the first process of a job.
+ * @shell: Pointer to the shell state.
+ * @foreground: Whether the shell waits for the job.
+ * @in: Standard input of the first process; /dev/null is opened into it
+ *      for background jobs without job control, as POSIX asks of
+ *      asynchronous lists.
+ *
+ * Return: The process group for the job: 0 for a new one under job
+ * control, otherwise -1 to stay in the shell's.
+ */
+static pid_t job_group(ShellState *shell, bool foreground, int *in)
+{
+	if (shell->jobs.monitor)
+		return 0;
+	if (!foreground)
+		*in = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	return -1;
+}
+
+/**
+ * fork_stage - Runs a pipeline stage that needs the shell in a child.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the stage.
+ * @index: Index of the stage's node.
+ * @in: Descriptor to use as standard input, or -1 to inherit it.
+ * @out: Descriptor to use as standard output, or -1 to inherit it.
+ * @spare: Read end of the next pipe, closed in the child, or -1.
+ * @pgid: Process group to join, 0 for a new one, or -1 for the shell's.
+ *
+ * The child exits after the stage, so a program the stage ends with is
+ * executed in its place rather than spawned and waited for.
+ *
+ * Return: The pid of the child, or -1 on failure.
+ */
+static pid_t fork_stage(ShellState *shell, const Ast *ast, NodeIndex index,
+			int in, int out, int spare, pid_t pgid)
+{
+	fflush(stdout);
+	uint64_t start = trace_now(shell->trace);
+	pid_t pid = fork();
+
+	if (pid > 0)
+		trace_span(shell->trace, "fork", start);
+	if (pid < 0) {
 		fprintf(stderr, "%s: fork failed: %s\n", shell->name,
 			strerror(errno));
+	} else if (pid == 0) {
+		if (pgid >= 0)
+			setpgid(0, pgid);
+		jobs_forget(shell);
+		if (spare >= 0)
+			close(spare);
+		if (in >= 0) {
+			dup2(in, STDIN_FILENO);
+			close(in);
+		}
+		if (out >= 0) {
+			dup2(out, STDOUT_FILENO);
+			close(out);
+		}
+		int status = execute_node(shell, ast, index, true);
+		fflush(stdout);
+		_exit(shell->skip == SKIP_EXIT ? shell->skip_count : status);
+	} else if (pgid >= 0) {
+		setpgid(pid, pgid ? pgid : pid);
+	}
+	return pid;
+}
+
+/**
+ * stage_label - Names a pipeline stage in traces.
+ * @ast: The syntax tree holding the stage.
+ * @index: Index of the stage's node.
+ *
+ * Return: The command name of a simple command, otherwise a placeholder.
+ */
+static const char *stage_label(const Ast *ast, NodeIndex index)
+{
+	const Node *node = &ast->nodes[index];
+
+	if (node->type == CMD_SIMPLE && node->as.simple.argc)
+		return ast->words[node->as.simple.argv];
+	return "(subshell)";
+}
+
+/**
+ * is_program - Tells whether a command name is run by a program.
+ * @shell: Pointer to the shell state.
+ * @name: The command name.
+ *
+ * Return: true unless @name is a function or a builtin.
+ */
+static bool is_program(ShellState *shell, char *name)
+{
+	return !function_find(shell, name) && !get_builtin(shell, name);
+}
+
+/**
+ * execute_pipeline - Runs every stage of a pipeline concurrently.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the pipeline.
+ * @pipeline: The CMD_PIPE node listing the stages.
+ * @job: Job receiving the stages, or NULL to wait for them here.
+ * @foreground: Whether the shell waits for @job.
+ *
+ * Each stage is started directly from this shell: external commands are
+ * spawned and anything else is forked once. At most one pipe is open
+ * in the shell at any time besides the read end feeding the next stage.
+ *
+ * Return: The exit status of the last stage, or 0 when given a job.
+ */
+static int execute_pipeline(ShellState *shell, const Ast *ast,
+			    const Node *pipeline, Job *job, bool foreground)
+{
+	uint32_t count = pipeline->as.pipeline.count;
+	const NodeIndex *stages = ast->refs + pipeline->as.pipeline.stages;
+	pid_t *pids = malloc(sizeof(pid_t) * count);
+	int in = -1, status = 0;
+	pid_t pgid = -1;
+	uint64_t start = trace_now(shell->trace), waited;
+
+	if (!pids) {
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		int fds[2] = { -1, -1 };
+		const Node *stage = &ast->nodes[stages[i]];
+		SimpleCommand simple;
+		bool expanded;
+
+		if (i + 1 < count && !make_pipe(shell, fds)) {
+			for (; i < count; i++)
+				pids[i] = -1;
+			status = -1;
+			break;
+		}
+		expanded = stage->type == CMD_SIMPLE &&
+			   expand_simple(shell, ast, stage, &simple);
+		if (job && i == 0)
+			pgid = job_group(shell, foreground, &in);
+		if (stage->type == CMD_SIMPLE && !expanded) {
+			pids[i] = -1;
+			status = 2;
+		} else if (expanded && simple.argc > 0 &&
+			   is_program(shell, simple.argv[0])) {
+			pids[i] = spawn_simple_command(shell, &simple, in,
+						       fds[1], pgid, &status);
+		} else if ((pids[i] = fork_stage(shell, ast, stages[i], in,
+						 fds[1], fds[0], pgid)) < 0) {
+			status = -1;
+		}
+		if (pgid == 0 && pids[i] > 0)
+			pgid = pids[i];
+		if (in >= 0)
+			close(in);
+		if (fds[1] >= 0)
+			close(fds[1]);
+		in = fds[0];
+		if (shell->fatal_error) {
+			for (i++; i < count; i++)
+				pids[i] = -1;
+		}
+	}
+	if (in >= 0)
+		close(in);
+
+	for (uint32_t i = 0; job && i < count; i++) {
+		if (pids[i] > 0 && !job_add_process(shell, job, pids[i]))
+			waitpid(pids[i], NULL, 0);
+	}
+	waited = trace_now(shell->trace);
+	for (uint32_t i = 0; !job && i < count; i++) {
+		int raw;
+
+		if (pids[i] < 0)
+			continue;
+		timing_wait(shell->timing, pids[i], &raw, 0);
+		if (i + 1 == count)
+			status = exit_status(raw);
+		if (shell->trace)
+			trace_command(shell->trace,
+				      stage_label(ast, stages[i]), start,
+				      pids[i], exit_status(raw));
+	}
+	if (!job)
+		trace_span(shell->trace, "waitpid", waited);
+	free(pids);
+	return job ? 0 : status;
+}
+
+/**
+ * is_external - Tells whether a node is a simple command run by a program.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the node.
+ * @node: The node.
+ * @simple: Receives the command when @node is a simple command.
+ *
+ * Return: true if @node names a program rather than a function or a
+ * builtin.
+ */
+static bool is_external(ShellState *shell, const Ast *ast, const Node *node,
+			SimpleCommand *simple)
+{
+	if (node->type != CMD_SIMPLE || !expand_simple(shell, ast, node, simple))
+		return false;
+	return simple->argc > 0 && is_program(shell, simple->argv[0]);
+}
+
+/**
+ * execute_capture - Starts a simple command with its output sent to a
+ *                   descriptor.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the command.
+ * @index: Index of the command's node.
+ * @out: Descriptor to use as standard output.
+ * @status: Set to the exit status when no process could be started.
+ *
+ * A program is spawned directly, like a pipeline stage; a builtin runs
+ * in a forked copy of the shell.
+ *
+ * Return: The pid of the started process, or -1 on failure.
+ */
+pid_t execute_capture(ShellState *shell, const Ast *ast, NodeIndex index,
+		      int out, int *status)
+{
+	SimpleCommand simple;
+
+	shell->expansion.node = NULL;
+	if (is_external(shell, ast, &ast->nodes[index], &simple))
+		return spawn_simple_command(shell, &simple, -1, out, -1,
+					    status);
+	if (shell->fatal_error || shell->had_error) {
+		*status = shell->fatal_error ? 1 : 2;
 		return -1;
-	} else if (right_pid == 0) {
-		dup2(pipefd[0], STDIN_FILENO);
-		close(pipefd[0]);
-		close(pipefd[1]);
-		status = execute(shell, right);
-		exit(status);
-	} else {
-		close(pipefd[0]);
-		close(pipefd[1]);
-		waitpid(left_pid, NULL, 0);
-		waitpid(right_pid, &status, 0);
 	}
+	*status = 1;
+	return fork_stage(shell, ast, index, -1, out, -1, -1);
+}
+
+/**
+ * job_spawn - Starts the processes of a job.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the command.
+ * @index: Index of the command's node.
+ * @job: The job receiving the processes.
+ * @foreground: Whether the shell waits for the job.
+ *
+ * External commands and pipelines are started directly, one process
+ * per command; anything else runs in a forked copy of the shell.
+ *
+ * Return: 1, or the status of a command that could not be started.
+ */
+static int job_spawn(ShellState *shell, const Ast *ast, NodeIndex index,
+		     Job *job, bool foreground)
+{
+	const Node *node = &ast->nodes[index];
+	SimpleCommand simple;
+	pid_t pid, pgid;
+	int in = -1, status = 1;
+
+	if (node->type == CMD_PIPE) {
+		execute_pipeline(shell, ast, node, job, foreground);
+		return status;
+	}
+
+	pgid = job_group(shell, foreground, &in);
+	if (is_external(shell, ast, node, &simple))
+		pid = spawn_simple_command(shell, &simple, in, -1, pgid,
+					   &status);
+	else
+		pid = fork_stage(shell, ast, index, in, -1, -1, pgid);
+	if (in >= 0)
+		close(in);
+	if (pid > 0 && !job_add_process(shell, job, pid))
+		waitpid(pid, NULL, 0);
 	return status;
 }
 
-int execute(ShellState *shell, Command *command)
+/**
+ * job_abandon - Gives up on a job after an allocation failure.
+ * @shell: Pointer to the shell state.
+ * @job: The job, or NULL.
+ *
+ * Return: 1.
+ */
+static int job_abandon(ShellState *shell, Job *job)
 {
-	int status;
+	fprintf(stderr, "Error: malloc failed\n");
+	shell->fatal_error = true;
+	if (job)
+		jobs_remove(shell, job);
+	return 1;
+}
+
+/**
+ * execute_job - Starts a command as a job of its own.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the command.
+ * @index: Index of the command's node.
+ * @foreground: true to wait for the job, false to run it in the
+ *              background.
+ *
+ * A background job is left running and its processes are reaped as
+ * their pidfds become readable; when every background slot is taken it
+ * is queued instead, with a copy of its command, and started once one
+ * frees up. A foreground job owns the terminal while the shell waits
+ * for it, and is kept as a stopped job if it is suspended.
+ *
+ * Return: The exit status of a foreground job, otherwise 0, or 1 if no
+ * process could be started.
+ */
+static int execute_job(ShellState *shell, const Ast *ast, NodeIndex index,
+		       bool foreground)
+{
+	char text[256];
+	Job *job;
+	size_t count = ast->nodes[index].type == CMD_PIPE ?
+			       ast->nodes[index].as.pipeline.count :
+			       1;
+	int status = 0;
+
+	ast_format(ast, index, text, sizeof(text));
+	job = job_new(count, strdup(text));
+	if (!job || !job->command)
+		return job_abandon(shell, job);
+
+	if (foreground) {
+		status = job_spawn(shell, ast, index, job, true);
+	} else if (!shell->jobs.queue_head && jobs_claim_slot(shell)) {
+		job->holds_slot = true;
+		status = job_spawn(shell, ast, index, job, false);
+	} else if (!jobs_queue(shell, job, ast, index)) {
+		return job_abandon(shell, job);
+	}
+
+	if (job->state != JOB_QUEUED && !job->remaining) {
+		jobs_remove(shell, job);
+		return status;
+	}
+	if (jobs_add(shell, job, foreground) < 0)
+		return job_abandon(shell, job);
+	return foreground ? jobs_foreground(shell, job) : 0;
+}
+
+/**
+ * execute_queued - Starts a job that waited for a background slot.
+ * @shell: Pointer to the shell state.
+ * @job: The job, whose command is in the job table's queued commands.
+ *
+ * Return: 1, or the status of a command that could not be started.
+ */
+int execute_queued(ShellState *shell, Job *job)
+{
+	shell->expansion.node = NULL;
+	return job_spawn(shell, &shell->jobs.queued, job->root, job, false);
+}
+
+/**
+ * execute_list - Runs the commands of a compound list in turn.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the list.
+ * @node: The CMD_LIST node.
+ * @last: Whether the shell has nothing left to do after the list.
+ *
+ * An error, an interrupt, or a `break` or `continue` stops the list.
+ *
+ * Return: The exit status of the last command run.
+ */
+static int execute_list(ShellState *shell, const Ast *ast, const Node *node,
+			bool last)
+{
+	const NodeIndex *items = ast->refs + node->as.list.items;
+	int status = 0;
+
+	for (uint32_t i = 0; i < node->as.list.count; i++) {
+		shell->exec_next = last && i + 1 == node->as.list.count;
+		status = execute(shell, ast, items[i]);
+		if (shell->skip || shell->had_error || shell->fatal_error ||
+		    jobs_interrupted(false))
+			break;
+	}
+	return status;
+}
+
+/**
+ * execute_if - Runs an if command.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the command.
+ * @node: The CMD_IF node.
+ * @last: Whether the shell has nothing left to do after the command.
+ *
+ * Return: The exit status of the branch taken, or 0 if none was.
+ */
+static int execute_if(ShellState *shell, const Ast *ast, const Node *node,
+		      bool last)
+{
+	int status = execute(shell, ast, node->as.branch.condition);
+	NodeIndex branch = status ? node->as.branch.otherwise :
+				    node->as.branch.body;
+
+	if (shell->skip || shell->had_error || shell->fatal_error)
+		return status;
+	shell->exec_next = last;
+	return execute(shell, ast, branch);
+}
+
+/**
+ * loop_done - Tells whether a loop stops after a command of its own.
+ * @shell: Pointer to the shell state.
+ *
+ * A `break` or `continue` aimed at an enclosing loop stops this one
+ * too; one aimed at this loop is used up here. A `return`, an `exit`,
+ * an error or an interrupt stops every loop.
+ *
+ * Return: true if the loop must stop, false if it goes on.
+ */
+static bool loop_done(ShellState *shell)
+{
+	int skip = shell->skip;
+
+	if (jobs_interrupted(false))
+		shell->had_error = true;
+	if (shell->fatal_error || shell->had_error)
+		return true;
+	if (!skip)
+		return false;
+	if (skip == SKIP_RETURN || skip == SKIP_EXIT ||
+	    --shell->skip_count > 0)
+		return true;
+	shell->skip = 0;
+	return skip == SKIP_BREAK;
+}
 
-	if (command == NULL)
+/**
+ * execute_while - Runs a while or until loop.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the loop.
+ * @node: The CMD_WHILE or CMD_UNTIL node.
+ *
+ * The loop runs from its nodes, parsed once; what each round allocates
+ * in the shell's arena is released before the next.
+ *
+ * Return: The exit status of the last body run, 0 if none was, or 128
+ * plus SIGINT if the loop was interrupted.
+ */
+static int execute_while(ShellState *shell, const Ast *ast, const Node *node)
+{
+	ArenaMark mark = arena_mark(shell->arena);
+	bool until = node->type == CMD_UNTIL;
+	int status = 0, condition;
+
+	shell->loop_depth++;
+	for (;;) {
+		arena_rewind(shell->arena, mark);
+		condition = execute(shell, ast, node->as.branch.condition);
+		if (shell->skip || shell->had_error || shell->fatal_error ||
+		    jobs_interrupted(false)) {
+			if (loop_done(shell))
+				break;
+			continue;
+		}
+		if (!condition == until)
+			break;
+		status = execute(shell, ast, node->as.branch.body);
+		if (loop_done(shell))
+			break;
+	}
+	shell->loop_depth--;
+	return jobs_interrupted(false) ? 128 + SIGINT : status;
+}
+
+/**
+ * for_words - Expands the words a for loop iterates over.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the loop.
+ * @node: The CMD_FOR node.
+ * @count: Receives the number of words.
+ *
+ * The words are copied into the shell's arena, as the expansion buffer
+ * is reused by the body.
+ *
+ * Return: The words, or NULL on failure, after reporting why.
+ */
+static char **for_words(ShellState *shell, const Ast *ast, const Node *node,
+			size_t *count)
+{
+	SimpleCommand simple = { .argc = shell->param_count,
+				 .argv = shell->params };
+	const Node *words = NULL;
+	char **copy;
+
+	if (node->as.loop.words != AST_NONE) {
+		words = &ast->nodes[node->as.loop.words];
+		shell->expansion.node = NULL;
+		if (!expand_simple(shell, ast, words, &simple))
+			return NULL;
+	}
+	copy = arena_alloc(shell->arena, sizeof(char *) * (simple.argc + 1));
+	for (int i = 0; copy && i < simple.argc; i++) {
+		copy[i] = simple.argv[i];
+		if (words && (words->flags & NODE_EXPAND))
+			copy[i] = arena_strndup(shell->arena, simple.argv[i],
+						strlen(simple.argv[i]));
+		if (!copy[i])
+			copy = NULL;
+	}
+	if (!copy) {
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+		return NULL;
+	}
+	*count = simple.argc;
+	return copy;
+}
+
+/**
+ * for_assign - Sets the variable of a for loop.
+ * @shell: Pointer to the shell state.
+ * @name: Name of the variable.
+ * @value: The value.
+ *
+ * Return: true on success, false on allocation failure, after
+ * reporting it.
+ */
+static bool for_assign(ShellState *shell, const char *name, const char *value)
+{
+	size_t length = strlen(name), size = strlen(value);
+	char *assignment = arena_alloc(shell->arena, length + size + 2);
+
+	if (assignment) {
+		memcpy(assignment, name, length);
+		assignment[length] = '=';
+		memcpy(assignment + length + 1, value, size + 1);
+	}
+	if (!assignment || !vars_set(&shell->vars, assignment, 0)) {
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * execute_for - Runs a for loop.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the loop.
+ * @node: The CMD_FOR node.
+ *
+ * The words are expanded once, before the first round.
+ *
+ * Return: The exit status of the last body run, 0 if none was, 128
+ * plus SIGINT if the loop was interrupted, or 2 if the words could not
+ * be expanded.
+ */
+static int execute_for(ShellState *shell, const Ast *ast, const Node *node)
+{
+	const char *name = ast->words[node->as.loop.name];
+	size_t count = 0;
+	char **words = for_words(shell, ast, node, &count);
+	ArenaMark mark = arena_mark(shell->arena);
+	int status = 0;
+
+	if (!words)
+		return shell->fatal_error ? 1 : 2;
+	shell->loop_depth++;
+	for (size_t i = 0; i < count; i++) {
+		arena_rewind(shell->arena, mark);
+		if (!for_assign(shell, name, words[i]))
+			break;
+		status = execute(shell, ast, node->as.loop.body);
+		if (loop_done(shell))
+			break;
+	}
+	shell->loop_depth--;
+	return jobs_interrupted(false) ? 128 + SIGINT : status;
+}
+
+/**
+ * case_select - Finds the arm of a case command a subject selects.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the command.
+ * @node: The CMD_CASE node.
+ * @subject: The expanded word of the command.
+ * @selected: Receives the index of the arm, or the number of arms if no
+ *            pattern matches.
+ *
+ * The compiled patterns find the first arm matching in one pass over
+ * the subject. The patterns left to fnmatch(3) in the arms before it are
+ * then tried in order, each expanded only when reached.
+ *
+ * Return: true on success, false after reporting a failure.
+ */
+static bool case_select(ShellState *shell, const Ast *ast, const Node *node,
+			const char *subject, uint32_t *selected)
+{
+	CaseMatcher *matcher = match_find(ast, node), *owned = NULL;
+	const MatchPending *pending;
+	char *pattern;
+	bool ok;
+
+	if (!matcher)
+		matcher = owned = match_compile(ast, node);
+	ok = matcher && match_first(matcher, subject, selected);
+	if (!ok) {
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+	}
+	for (uint32_t i = 0; ok && i < matcher->pending_count; i++) {
+		pending = &matcher->pending[i];
+		if (pending->arm >= *selected)
+			break;
+		pattern = expand_string(shell, ast->words[pending->word], true);
+		if (!pattern)
+			ok = false;
+		else if (!fnmatch(pattern, subject, 0))
+			*selected = pending->arm;
+	}
+	match_free(owned);
+	return ok;
+}
+
+/**
+ * execute_case - Runs a case command.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the command.
+ * @node: The CMD_CASE node.
+ * @last: Whether the shell has nothing left to do after the command.
+ *
+ * The body of the first arm with a pattern matching runs.
+ *
+ * Return: The exit status of the body run, 0 if none was, or 2 if a
+ * word could not be expanded.
+ */
+static int execute_case(ShellState *shell, const Ast *ast, const Node *node,
+			bool last)
+{
+	const NodeIndex *arms = ast->refs + node->as.cases.arms;
+	char *subject = expand_string(shell, ast->words[node->as.cases.word],
+				      false);
+	uint32_t selected;
+
+	if (!subject || !case_select(shell, ast, node, subject, &selected))
+		return shell->fatal_error ? 1 : 2;
+	if (selected == node->as.cases.count)
 		return 0;
+	shell->exec_next = last;
+	return execute(shell, ast, ast->nodes[arms[selected]].as.arm.body);
+}
 
-	switch (command->type) {
+/**
+ * execute_redirected - Runs a compound command with its redirections.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the command.
+ * @node: The CMD_REDIRECT node.
+ *
+ * As for a builtin, the redirections are applied to the shell itself
+ * around the command and undone after.
+ *
+ * Return: The exit status of the command, or 2 if a redirection failed.
+ */
+static int execute_redirected(ShellState *shell, const Ast *ast,
+			      const Node *node)
+{
+	FdAction stack[REDIRECT_STACK], *moves;
+	SimpleCommand simple;
+	size_t count;
+	int status = 2;
+
+	if (!expand_simple(shell, ast, &ast->nodes[node->as.binary.right],
+			   &simple))
+		return shell->fatal_error ? 1 : 2;
+	moves = redirect_open(shell, &simple, stack, &count);
+	if (!moves)
+		return 2;
+	fflush(stdout);
+	if (redirect_apply(shell, moves, count)) {
+		status = execute(shell, ast, node->as.binary.left);
+		fflush(stdout);
+		redirect_restore(moves, count);
+	}
+	redirect_release(moves, count, stack);
+	return status;
+}
+
+/**
+ * execute_node - Runs a command of a syntax tree in the foreground.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the command.
+ * @index: Index of the command's node.
+ * @last: Whether the shell has nothing left to do after the command, so
+ *        the program it ends with, if any, may replace the shell.
+ *
+ * Return: The exit status of the command.
+ */
+static int execute_node(ShellState *shell, const Ast *ast, NodeIndex index,
+			bool last)
+{
+	const Node *node = &ast->nodes[index];
+	SimpleCommand simple;
+	int status;
+
+	switch (node->type) {
 	case CMD_SIMPLE:
-		status = execute_command(shell, &command->as.command,
-					 command->is_background);
+		if (expand_simple(shell, ast, node, &simple))
+			status = execute_command(shell, &simple, false, last);
+		else
+			status = shell->fatal_error ? 1 : 2;
 		break;
 	case CMD_PIPE:
-		status = execute_pipeline(shell, command->as.binary.left,
-					  command->as.binary.right);
+		status = execute_pipeline(shell, ast, node, NULL, false);
 		break;
 	case CMD_AND:
-		status = execute(shell, command->as.binary.left);
-		if (!status)
-			status = execute(shell, command->as.binary.right);
+		status = execute(shell, ast, node->as.binary.left);
+		if (!status) {
+			shell->exec_next = last;
+			status = execute(shell, ast, node->as.binary.right);
+		}
 		break;
 	case CMD_OR:
-		status = execute(shell, command->as.binary.left);
-		if (status)
-			status = execute(shell, command->as.binary.right);
+		status = execute(shell, ast, node->as.binary.left);
+		if (status) {
+			shell->exec_next = last;
+			status = execute(shell, ast, node->as.binary.right);
+		}
 		break;
 	case CMD_BACKGROUND:
-		fprintf(stderr,
-			"Executor: Background execution not implemented yet.\n");
-		status = 0;
+		execute(shell, ast, node->as.binary.left);
+		shell->exec_next = last;
+		status = execute(shell, ast, node->as.binary.right);
+		break;
+	case CMD_LIST:
+		status = execute_list(shell, ast, node, last);
+		break;
+	case CMD_IF:
+		status = execute_if(shell, ast, node, last);
+		break;
+	case CMD_WHILE:
+	case CMD_UNTIL:
+		status = execute_while(shell, ast, node);
+		break;
+	case CMD_FOR:
+		status = execute_for(shell, ast, node);
+		break;
+	case CMD_CASE:
+		status = execute_case(shell, ast, node, last);
+		break;
+	case CMD_REDIRECT:
+		status = execute_redirected(shell, ast, node);
+		break;
+	case CMD_FUNCTION:
+		status = function_define(shell,
+					 ast->words[node->as.function.name],
+					 ast, node->as.function.body) ?
+				 0 :
+				 1;
 		break;
 	default:
 		fprintf(stderr, "Executor: Unknown command type.\n");
@@ -179,3 +1341,67 @@ int execute(ShellState *shell, Command *command)
 	}
 	return status;
 }
+
+/**
+ * execute - Runs a command of a syntax tree.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the command.
+ * @index: Index of the command's node, or AST_NONE for no command.
+ *
+ * Under job control, programs and pipelines run in the foreground as
+ * jobs of their own so they can be suspended. A command preceded by
+ * `time` has its times reported once it has finished. The status is
+ * kept for $?.
+ *
+ * When shell->exec_next is set, the shell exits after the command: a
+ * program run last then replaces the shell, unless background jobs hold
+ * slots or jobserver tokens, or a trace is still to be written. Nothing
+ * runs while a `break`, `continue`, `return` or `exit` unwinds, and the
+ * commands an `exit` unwinds take the status it was given.
+ *
+ * Return: The exit status of the command.
+ */
+int execute(ShellState *shell, const Ast *ast, NodeIndex index)
+{
+	const Node *node;
+	SimpleCommand simple;
+	Timing timing;
+	int status;
+	bool last = shell->exec_next && !shell->jobs.running &&
+		    !shell->jobs.queue_head && !shell->trace;
+
+	shell->exec_next = false;
+	if (index == AST_NONE)
+		return 0;
+	if (shell->skip)
+		return shell->status;
+	/* A new command: its words are expanded afresh. */
+	shell->expansion.node = NULL;
+	node = &ast->nodes[index];
+	if (node->flags & NODE_BACKGROUND) {
+		shell->status = execute_job(shell, ast, index, false);
+		return shell->status;
+	}
+	if (node->flags & NODE_TIMED) {
+		timing_start(&timing, shell->timing,
+			     node->flags & NODE_TIME_POSIX);
+		shell->timing = &timing;
+	}
+	if (shell->jobs.monitor &&
+	    (node->type == CMD_PIPE || is_external(shell, ast, node, &simple)))
+		status = execute_job(shell, ast, index, true);
+	else if (shell->had_error)
+		status = 2;
+	else
+		status = execute_node(shell, ast, index,
+				      last && !(node->flags & NODE_TIMED));
+	if (node->flags & NODE_TIMED) {
+		shell->timing = timing.outer;
+		timing_report(&timing,
+			      vars_get(&shell->vars, "HSH_TIMEFORMAT"));
+	}
+	if (shell->skip == SKIP_EXIT)
+		status = shell->skip_count;
+	shell->status = status;
+	return status;
+}
@@ -0,0 +1,1064 @@
+#include <expand.h>
+#include <arena.h>
+#include <arith.h>
+#include <scan.h>
+#include <shell.h>
+#include <subst.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vars.h>
+
+#define EXPAND_INITIAL_CAPACITY 256
+#define IFS_WHITE 1
+#define IFS_OTHER 2
+
+/*
+ * State of the expansion of one command. field_start is where the text
+ * of the field being built begins, and in_field tells whether it has
+ * begun at all: an empty field only exists if it was quoted. delimited
+ * is set when the last field was ended by IFS white space, which an
+ * IFS character other than white space right after only confirms.
+ * depth counts the ${...} operands being expanded, whose literal text
+ * is split like the value of a parameter. ifs classifies every byte
+ * once the first field is split. pattern is set while a case pattern
+ * is expanded, whose quoted text only matches itself, and body while a
+ * here-document is, where a backslash does not escape '"'. The first
+ * prefix fields are the assignments in front of the command expanded so
+ * far, whose values the ones after them see.
+ */
+typedef struct Expander {
+	ShellState *shell;
+	Expansion *expansion;
+	size_t field_start;
+	bool split;
+	bool in_field;
+	bool delimited;
+	unsigned int depth;
+	bool pattern;
+	bool body;
+	size_t prefix;
+	bool ifs_ready;
+	unsigned char ifs[256];
+	int status;
+} Expander;
+
+static bool expand_text(Expander *x, const char *p, const char *end,
+			bool quoted);
+
+/**
+ * expand_grow - Makes room for more elements in one of the arrays of an
+ *               expansion.
+ * @array: Pointer to the array.
+ * @capacity: Pointer to the number of allocated elements.
+ * @needed: Number of elements needed.
+ * @size: Size of one element.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool expand_grow(void **array, size_t *capacity, size_t needed,
+			size_t size)
+{
+	size_t grown = *capacity ? *capacity : EXPAND_INITIAL_CAPACITY;
+	void *resized;
+
+	if (needed <= *capacity)
+		return true;
+	while (grown < needed)
+		grown *= 2;
+	resized = realloc(*array, grown * size);
+	if (!resized)
+		return false;
+	*array = resized;
+	*capacity = grown;
+	return true;
+}
+
+/**
+ * expand_oom - Reports an allocation failure.
+ * @x: The expander.
+ *
+ * Return: false.
+ */
+static bool expand_oom(Expander *x)
+{
+	fprintf(stderr, "Error: malloc failed\n");
+	x->shell->fatal_error = true;
+	return false;
+}
+
+/**
+ * expand_bad - Reports a malformed ${...} expansion.
+ * @x: The expander.
+ *
+ * Return: false.
+ */
+static bool expand_bad(Expander *x)
+{
+	fprintf(stderr, "%s: %d: Bad substitution\n", x->shell->name,
+		x->shell->line_number);
+	x->shell->had_error = true;
+	return false;
+}
+
+/**
+ * expand_put - Appends text to the current field as it is.
+ * @x: The expander.
+ * @text: The text.
+ * @length: Length of @text.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool expand_put(Expander *x, const char *text, size_t length)
+{
+	Expansion *e = x->expansion;
+
+	if (!expand_grow((void **)&e->text, &e->text_capacity,
+			 e->length + length, 1))
+		return expand_oom(x);
+	if (length)
+		memcpy(e->text + e->length, text, length);
+	e->length += length;
+	x->in_field = true;
+	x->delimited = false;
+	return true;
+}
+
+/**
+ * expand_quoted - Appends quoted text to the current field.
+ * @x: The expander.
+ * @text: The text.
+ * @length: Length of @text.
+ *
+ * In a case pattern, the pattern characters of the text are escaped.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool expand_quoted(Expander *x, const char *text, size_t length)
+{
+	size_t run;
+
+	if (!x->pattern)
+		return expand_put(x, text, length);
+	while (length) {
+		run = strcspn(text, "*?[]\\");
+		if (run > length)
+			run = length;
+		if (!expand_put(x, text, run))
+			return false;
+		if (run == length)
+			break;
+		if (!expand_put(x, "\\", 1) || !expand_put(x, text + run, 1))
+			return false;
+		text += run + 1;
+		length -= run + 1;
+	}
+	return true;
+}
+
+/**
+ * expand_push - Appends a word to the expanded command.
+ * @x: The expander.
+ * @word: A word used as it is, or NULL for text of the buffer.
+ * @offset: Offset of the text in the buffer, or EXPAND_END to end a
+ *          vector.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool expand_push(Expander *x, char *word, size_t offset)
+{
+	Expansion *e = x->expansion;
+
+	if (!expand_grow((void **)&e->fields, &e->field_capacity,
+			 e->field_count + 1, sizeof(ExpandField)))
+		return expand_oom(x);
+	e->fields[e->field_count].word = word;
+	e->fields[e->field_count].offset = offset;
+	e->field_count++;
+	return true;
+}
+
+/**
+ * expand_end_field - Terminates the current field and starts the next.
+ * @x: The expander.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool expand_end_field(Expander *x)
+{
+	if (!expand_put(x, "", 1) || !expand_push(x, NULL, x->field_start))
+		return false;
+	x->field_start = x->expansion->length;
+	x->in_field = false;
+	return true;
+}
+
+/**
+ * expand_ifs - Classifies the bytes of IFS, once per command.
+ * @x: The expander.
+ */
+static void expand_ifs(Expander *x)
+{
+	const char *ifs;
+
+	if (x->ifs_ready)
+		return;
+	ifs = vars_get(&x->shell->vars, "IFS");
+	if (!ifs)
+		ifs = " \t\n";
+	for (; *ifs; ifs++) {
+		unsigned char c = *ifs;
+
+		x->ifs[c] = c == ' ' || c == '\t' || c == '\n' ? IFS_WHITE :
+								 IFS_OTHER;
+	}
+	x->ifs_ready = true;
+}
+
+/**
+ * expand_split - Appends the result of an unquoted expansion, splitting
+ *                it into fields on IFS.
+ * @x: The expander.
+ * @text: The text.
+ * @length: Length of @text.
+ *
+ * Runs of IFS white space end a field; any other IFS character ends
+ * one too, even an empty one. Text is taken as it is where fields are
+ * not split.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool expand_split(Expander *x, const char *text, size_t length)
+{
+	size_t i = 0, run;
+
+	if (!x->split)
+		return expand_put(x, text, length);
+	expand_ifs(x);
+	while (i < length) {
+		unsigned char c = text[i];
+
+		if (!x->ifs[c]) {
+			for (run = i + 1;
+			     run < length && !x->ifs[(unsigned char)text[run]];
+			     run++)
+				;
+			if (!expand_put(x, text + i, run - i))
+				return false;
+			i = run;
+			continue;
+		}
+		if (x->ifs[c] == IFS_WHITE) {
+			if (x->in_field) {
+				if (!expand_end_field(x))
+					return false;
+				x->delimited = true;
+			}
+		} else {
+			if ((x->in_field || !x->delimited) &&
+			    !expand_end_field(x))
+				return false;
+			x->delimited = false;
+		}
+		i++;
+	}
+	return true;
+}
+
+/**
+ * expand_value - Appends the value of a parameter.
+ * @x: The expander.
+ * @value: The value.
+ * @quoted: Whether the expansion is inside double quotes.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool expand_value(Expander *x, const char *value, bool quoted)
+{
+	if (quoted)
+		return expand_quoted(x, value, strlen(value));
+	return expand_split(x, value, strlen(value));
+}
+
+/**
+ * expand_name_length - Measures the name of a parameter.
+ * @name: The text after the '$' or '{'.
+ * @end: End of the text.
+ * @braced: Whether the name is inside braces, where positional
+ *          parameters may have more than one digit.
+ *
+ * Return: Length of the name, or 0 if there is none.
+ */
+static size_t expand_name_length(const char *name, const char *end,
+				 bool braced)
+{
+	const char *p = name;
+
+	if (p == end)
+		return 0;
+	if (*p >= '0' && *p <= '9') {
+		while (braced && ++p < end && *p >= '0' && *p <= '9')
+			;
+		return braced ? (size_t)(p - name) : 1;
+	}
+	if (strchr("?$#@*!-", *p))
+		return 1;
+	while (p < end && (*p == '_' || (*p >= 'a' && *p <= 'z') ||
+			   (*p >= 'A' && *p <= 'Z') ||
+			   (p > name && *p >= '0' && *p <= '9')))
+		p++;
+	return p - name;
+}
+
+/**
+ * expand_lookup - Finds the value of a parameter.
+ * @x: The expander.
+ * @name: A variable, a positional parameter or one of ?$#-!.
+ * @length: Length of @name.
+ * @number: Receives the text of a numeric value.
+ * @size: Size of @number.
+ *
+ * Return: The value, or NULL if the parameter is not set.
+ */
+static const char *expand_lookup(Expander *x, const char *name,
+				 size_t length, char *number, size_t size)
+{
+	ShellState *shell = x->shell;
+	size_t index = 0;
+
+	if (*name >= '0' && *name <= '9') {
+		for (size_t i = 0; i < length && index <= INT32_MAX; i++)
+			index = index * 10 + (name[i] - '0');
+		if (!index)
+			return shell->name;
+		return index <= (size_t)shell->param_count ?
+			       shell->params[index - 1] :
+			       NULL;
+	}
+	if (length == 1) {
+		switch (*name) {
+		case '?':
+			snprintf(number, size, "%d", shell->status);
+			return number;
+		case '$':
+			snprintf(number, size, "%ld", (long)shell->pid);
+			return number;
+		case '#':
+			snprintf(number, size, "%d", shell->param_count);
+			return number;
+		case '-':
+			return "";
+		case '!':
+			if (!shell->jobs.last_pid)
+				return NULL;
+			snprintf(number, size, "%ld",
+				 (long)shell->jobs.last_pid);
+			return number;
+		}
+	}
+	for (size_t i = x->prefix; i-- > 0;) {
+		const char *assignment = x->expansion->fields[i].word;
+
+		if (!strncmp(assignment, name, length) &&
+		    assignment[length] == '=')
+			return assignment + length + 1;
+	}
+	return vars_get_n(&shell->vars, name, length);
+}
+
+/**
+ * expand_params - Appends the positional parameters, for $@ and $*.
+ * @x: The expander.
+ * @name: '@' or '*'.
+ * @quoted: Whether the expansion is inside double quotes.
+ *
+ * "$@" makes a field of every parameter and "$*" joins them with the
+ * first character of IFS; unquoted, every parameter is split on its
+ * own. Where fields are not split, both join them.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool expand_params(Expander *x, char name, bool quoted)
+{
+	ShellState *shell = x->shell;
+	const char *ifs = vars_get(&shell->vars, "IFS");
+	char separator = name == '*' && ifs ? *ifs : ' ';
+
+	for (int i = 0; i < shell->param_count; i++) {
+		if (i && x->split && !quoted) {
+			if (x->in_field && !expand_end_field(x))
+				return false;
+		} else if (i && x->split && name == '@') {
+			if (!expand_end_field(x))
+				return false;
+		} else if (i && separator && !expand_put(x, &separator, 1)) {
+			return false;
+		}
+		if (!expand_value(x, shell->params[i], quoted))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * expand_named - Appends the value of a parameter given its name.
+ * @x: The expander.
+ * @name: The name.
+ * @length: Length of @name.
+ * @quoted: Whether the expansion is inside double quotes.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool expand_named(Expander *x, const char *name, size_t length,
+			 bool quoted)
+{
+	char number[24];
+	const char *value;
+
+	if (length == 1 && (*name == '@' || *name == '*'))
+		return expand_params(x, *name, quoted);
+	value = expand_lookup(x, name, length, number, sizeof(number));
+	return !value || expand_value(x, value, quoted);
+}
+
+/**
+ * expand_operand - Appends the expansion of the word of a ${name-word}.
+ * @x: The expander.
+ * @word: The word.
+ * @end: End of the word.
+ * @quoted: Whether the expansion is inside double quotes.
+ *
+ * Return: true on success, false on failure.
+ */
+static bool expand_operand(Expander *x, const char *word, const char *end,
+			   bool quoted)
+{
+	bool ok;
+
+	x->depth++;
+	ok = expand_text(x, word, end, quoted);
+	x->depth--;
+	return ok;
+}
+
+/**
+ * expand_assign - Assigns the word of a ${name=word} to the variable.
+ * @x: The expander.
+ * @name: The name of the variable.
+ * @length: Length of @name.
+ * @word: The word.
+ * @end: End of the word.
+ * @quoted: Whether the expansion is inside double quotes.
+ *
+ * The word is expanded at the end of the buffer, without splitting, and
+ * taken out again once it has been assigned.
+ *
+ * Return: true on success, false on failure.
+ */
+static bool expand_assign(Expander *x, const char *name, size_t length,
+			  const char *word, const char *end, bool quoted)
+{
+	Expansion *e = x->expansion;
+	size_t start = e->length;
+	bool split = x->split, in_field = x->in_field;
+	bool delimited = x->delimited, ok;
+	char *assignment;
+
+	if (!vars_valid_name(name, length)) {
+		fprintf(stderr, "%s: %d: %.*s: cannot assign in this way\n",
+			x->shell->name, x->shell->line_number, (int)length,
+			name);
+		x->shell->had_error = true;
+		return false;
+	}
+	x->split = false;
+	ok = expand_text(x, word, end, quoted);
+	x->split = split;
+	x->in_field = in_field;
+	x->delimited = delimited;
+	if (!ok)
+		return false;
+	assignment = arena_alloc(x->shell->arena,
+				 length + e->length - start + 2);
+	if (!assignment)
+		return expand_oom(x);
+	memcpy(assignment, name, length);
+	assignment[length] = '=';
+	memcpy(assignment + length + 1, e->text + start, e->length - start);
+	assignment[length + 1 + e->length - start] = '\0';
+	e->length = start;
+	if (!vars_set(&x->shell->vars, assignment, 0))
+		return expand_oom(x);
+	return true;
+}
+
+/**
+ * expand_unset - Reports a parameter of a ${name?word} that is not set.
+ * @x: The expander.
+ * @name: The name of the parameter.
+ * @length: Length of @name.
+ * @word: The message, used as it is.
+ * @end: End of the message.
+ *
+ * Return: false.
+ */
+static bool expand_unset(Expander *x, const char *name, size_t length,
+			 const char *word, const char *end)
+{
+	if (word == end) {
+		word = "parameter not set";
+		end = word + strlen(word);
+	}
+	fprintf(stderr, "%s: %d: %.*s: %.*s\n", x->shell->name,
+		x->shell->line_number, (int)length, name, (int)(end - word),
+		word);
+	x->shell->had_error = true;
+	return false;
+}
+
+/**
+ * expand_brace - Appends a ${...} expansion.
+ * @x: The expander.
+ * @name: The text between the braces.
+ * @end: End of the text, at the closing brace.
+ * @quoted: Whether the expansion is inside double quotes.
+ *
+ * Handles ${name}, ${#name}, and ${name-word}, ${name=word},
+ * ${name+word} and ${name?word} with or without a ':', which makes
+ * them treat an empty value as unset.
+ *
+ * Return: true on success, false on failure.
+ */
+static bool expand_brace(Expander *x, const char *name, const char *end,
+			 bool quoted)
+{
+	char number[24];
+	const char *op, *value = NULL;
+	size_t length;
+	bool set, colon, counted = *name == '#' && end - name > 1;
+
+	if (counted)
+		name++;
+	length = expand_name_length(name, end, true);
+	if (!length)
+		return expand_bad(x);
+	op = name + length;
+	if (counted) {
+		if (op != end || *name == '@' || *name == '*')
+			return expand_bad(x);
+		value = expand_lookup(x, name, length, number, sizeof(number));
+		length = value ? strlen(value) : 0;
+		snprintf(number, sizeof(number), "%zu", length);
+		return expand_value(x, number, quoted);
+	}
+	if (op == end)
+		return expand_named(x, name, length, quoted);
+
+	colon = *op == ':';
+	op += colon;
+	if (op == end || !strchr("-=+?", *op))
+		return expand_bad(x);
+	if (*name == '@' || *name == '*') {
+		set = x->shell->param_count > 0;
+	} else {
+		value = expand_lookup(x, name, length, number, sizeof(number));
+		set = value && (!colon || *value);
+	}
+
+	switch (*op) {
+	case '+':
+		return !set || expand_operand(x, op + 1, end, quoted);
+	case '-':
+		if (!set)
+			return expand_operand(x, op + 1, end, quoted);
+		break;
+	case '=':
+		if (!set && !expand_assign(x, name, length, op + 1, end, quoted))
+			return false;
+		break;
+	default:
+		if (!set)
+			return expand_unset(x, name, length, op + 1, end);
+		break;
+	}
+	return expand_named(x, name, length, quoted);
+}
+
+/**
+ * expand_substitute - Appends the output of a $(...) command
+ *                     substitution.
+ * @x: The expander.
+ * @p: The '$'.
+ * @end: End of the text holding the substitution.
+ * @quoted: Whether the substitution is inside double quotes.
+ *
+ * Trailing newlines are dropped from the output, which is split like
+ * the value of a parameter.
+ *
+ * Return: Number of bytes of the substitution, or 0 on failure.
+ */
+static size_t expand_substitute(Expander *x, const char *p, const char *end,
+				bool quoted)
+{
+	size_t length = scan_paren(p + 1), size;
+	char *output;
+	int status;
+	bool ok;
+
+	if (!length || p + 1 + length > end)
+		return expand_bad(x);
+	status = subst_capture(x->shell, p + 2, length - 2, &output, &size);
+	if (status < 0)
+		return 0;
+	x->status = status;
+	while (size && output[size - 1] == '\n')
+		size--;
+	ok = quoted ? expand_quoted(x, output, size) :
+		      expand_split(x, output, size);
+	free(output);
+	return ok ? length + 1 : 0;
+}
+
+/**
+ * expand_arith - Appends the value of a $((...)) arithmetic expansion.
+ * @x: The expander.
+ * @p: The '$'.
+ * @end: End of the text holding the expansion.
+ * @quoted: Whether the expansion is inside double quotes.
+ *
+ * The parameters of the expression are expanded at the end of the
+ * buffer, as if inside double quotes, and taken out again once it has
+ * been evaluated.
+ *
+ * Return: Number of bytes of the expansion, or 0 on failure.
+ */
+static size_t expand_arith(Expander *x, const char *p, const char *end,
+			   bool quoted)
+{
+	Expansion *e = x->expansion;
+	size_t length = scan_paren(p + 1), start = e->length;
+	bool split = x->split, in_field = x->in_field;
+	bool delimited = x->delimited, pattern = x->pattern, ok;
+	char number[24];
+	intmax_t value;
+
+	if (!length || p + 1 + length > end || p[length - 1] != ')')
+		return expand_bad(x);
+	x->split = false;
+	x->pattern = false;
+	ok = expand_text(x, p + 3, p + length - 1, true) &&
+	     expand_put(x, "", 1);
+	x->split = split;
+	x->pattern = pattern;
+	x->in_field = in_field;
+	x->delimited = delimited;
+	if (!ok)
+		return 0;
+	ok = arith_eval(x->shell, e->text + start, &value);
+	e->length = start;
+	if (!ok)
+		return 0;
+	snprintf(number, sizeof(number), "%jd", value);
+	return expand_value(x, number, quoted) ? length + 1 : 0;
+}
+
+/**
+ * expand_parameter - Appends the parameter expansion at a '$'.
+ * @x: The expander.
+ * @p: The '$'.
+ * @end: End of the text holding the expansion.
+ * @quoted: Whether the expansion is inside double quotes.
+ *
+ * A '$' that starts no expansion stands for itself, "$((" starts an
+ * arithmetic expansion and "$(" a command substitution.
+ *
+ * Return: Number of bytes of the expansion, or 0 on failure.
+ */
+static size_t expand_parameter(Expander *x, const char *p, const char *end,
+			       bool quoted)
+{
+	const char *name = p + 1;
+	size_t length;
+
+	if (name + 1 < end && name[0] == '(' && name[1] == '(')
+		return expand_arith(x, p, end, quoted);
+	if (name < end && *name == '(')
+		return expand_substitute(x, p, end, quoted);
+	if (name < end && *name == '{') {
+		length = scan_brace(name, quoted);
+		if (!length || name + length > end)
+			return expand_bad(x);
+		if (!expand_brace(x, name + 1, name + length - 1, quoted))
+			return 0;
+		return length + 1;
+	}
+	length = expand_name_length(name, end, false);
+	if (!length)
+		return expand_put(x, "$", 1) ? 1 : 0;
+	if (!expand_named(x, name, length, quoted))
+		return 0;
+	return length + 1;
+}
+
+/**
+ * expand_escape - Appends the character a backslash escapes.
+ * @x: The expander.
+ * @p: The backslash.
+ * @end: End of the text holding it.
+ * @quoted: Whether the backslash is inside double quotes.
+ *
+ * Outside quotes the backslash quotes any character; inside them only
+ * '$', '`', '"', '\\' and newline, and is kept before any other. An
+ * escaped newline is removed with its backslash, and a backslash ending
+ * the text stands for itself.
+ *
+ * Return: Number of bytes consumed, or 0 on allocation failure.
+ */
+static size_t expand_escape(Expander *x, const char *p, const char *end,
+			    bool quoted)
+{
+	const char *escapes = x->body ? "$`\\\n" : SCAN_DQUOTE_ESCAPES;
+
+	if (p + 1 == end || (quoted && !strchr(escapes, p[1])))
+		return expand_quoted(x, "\\", 1) ? 1 : 0;
+	if (p[1] == '\n')
+		return 2;
+	x->in_field = true;
+	x->delimited = false;
+	return expand_quoted(x, p + 1, 1) ? 2 : 0;
+}
+
+/**
+ * expand_text - Expands text, removing its quotes.
+ * @x: The expander.
+ * @p: The text.
+ * @end: End of the text.
+ * @quoted: Whether the text is inside double quotes.
+ *
+ * Return: true on success, false on failure.
+ */
+static bool expand_text(Expander *x, const char *p, const char *end,
+			bool quoted)
+{
+	const char *stops = quoted ? "$\\" : "$'\"\\";
+	const char *close;
+	size_t run;
+
+	while (p < end) {
+		if (*p == '\\') {
+			run = expand_escape(x, p, end, quoted);
+			if (!run)
+				return false;
+			p += run;
+		} else if (*p == '$') {
+			run = expand_parameter(x, p, end, quoted);
+			if (!run)
+				return false;
+			p += run;
+		} else if (!quoted && (*p == '\'' || *p == '"')) {
+			close = *p == '"' ? p + 1 + scan_dquote(p + 1) :
+					    memchr(p + 1, *p, end - p - 1);
+			if (!close || close >= end || *close != *p)
+				return expand_bad(x);
+			/* "$@" with no parameters makes no field at all. */
+			if (!(close - p == 3 && !strncmp(p, "\"$@", 3) &&
+			      !x->shell->param_count))
+				x->in_field = true;
+			x->delimited = false;
+			if (*p == '\'' ? !expand_quoted(x, p + 1, close - p - 1) :
+					  !expand_text(x, p + 1, close, true))
+				return false;
+			p = close + 1;
+		} else {
+			run = strcspn(p, stops);
+			if (run > (size_t)(end - p))
+				run = end - p;
+			if (quoted ? !expand_quoted(x, p, run) :
+			    x->depth ? !expand_split(x, p, run) :
+				       !expand_put(x, p, run))
+				return false;
+			p += run;
+		}
+	}
+	return true;
+}
+
+/**
+ * expand_word - Expands a word into fields.
+ * @x: The expander.
+ * @word: The word.
+ * @split: Whether to split it into fields; otherwise it always makes
+ *         exactly one.
+ *
+ * Words without a '$' have had their quotes removed by the parser and
+ * are used as they are.
+ *
+ * Return: true on success, false on failure.
+ */
+static bool expand_word(Expander *x, char *word, bool split)
+{
+	if (!strchr(word, '$'))
+		return expand_push(x, word, 0);
+	x->split = split;
+	x->in_field = false;
+	x->delimited = false;
+	x->field_start = x->expansion->length;
+	if (!expand_text(x, word, word + strlen(word), false))
+		return false;
+	return split && !x->in_field ? true : expand_end_field(x);
+}
+
+/**
+ * expand_body - Expands the body of a here-document into one field.
+ * @x: The expander.
+ * @body: The body.
+ *
+ * The body is expanded as if inside double quotes, so its quotes are
+ * kept and nothing is split, except that a backslash does not escape
+ * '"'.
+ *
+ * Return: true on success, false on failure.
+ */
+static bool expand_body(Expander *x, char *body)
+{
+	bool ok;
+
+	x->split = false;
+	x->in_field = false;
+	x->delimited = false;
+	x->body = true;
+	x->field_start = x->expansion->length;
+	ok = expand_text(x, body, body + strlen(body), true);
+	x->body = false;
+	return ok && expand_end_field(x);
+}
+
+/**
+ * expand_targets - Expands the targets of a command's redirections.
+ * @x: The expander.
+ * @redirects: The redirections.
+ * @targets: Their NULL terminated targets.
+ *
+ * File names make one field each; the bodies of here-documents are only
+ * expanded when their delimiter was not quoted.
+ *
+ * Return: true on success, false on failure.
+ */
+static bool expand_targets(Expander *x, const Redirect *redirects,
+			   char **targets)
+{
+	bool expanded;
+
+	for (size_t i = 0; targets[i]; i++) {
+		if (redirects[i].type != REDIRECT_HEREDOC)
+			expanded = expand_word(x, targets[i], false);
+		else if (redirects[i].flags & REDIRECT_EXPAND)
+			expanded = expand_body(x, targets[i]);
+		else
+			expanded = expand_push(x, targets[i], 0);
+		if (!expanded)
+			return false;
+	}
+	return expand_push(x, NULL, EXPAND_END);
+}
+
+/**
+ * expand_vector - Expands a NULL terminated vector of words.
+ * @x: The expander.
+ * @words: The words.
+ * @split: Whether to split the words into fields.
+ *
+ * Return: true on success, false on failure.
+ */
+static bool expand_vector(Expander *x, char **words, bool split)
+{
+	for (; *words; words++) {
+		if (!expand_word(x, *words, split))
+			return false;
+	}
+	return expand_push(x, NULL, EXPAND_END);
+}
+
+/**
+ * expand_prefix - Expands the assignments in front of a command.
+ * @x: The expander.
+ * @words: The assignments.
+ *
+ * They are expanded in turn, and each one sees the values of those
+ * before it, so `x=1 y=$x` gives y the value 1. An assignment expanded
+ * into the buffer is copied into the arena when others follow, since
+ * growing the buffer would move it.
+ *
+ * Return: true on success, false on failure.
+ */
+static bool expand_prefix(Expander *x, char **words)
+{
+	Expansion *e = x->expansion;
+	ExpandField *field;
+	const char *text;
+
+	for (; *words; words++) {
+		if (!expand_word(x, *words, false))
+			return false;
+		field = &e->fields[e->field_count - 1];
+		if (words[1] && !field->word) {
+			text = e->text + field->offset;
+			field->word = arena_strndup(x->shell->arena, text,
+						    strlen(text));
+			if (!field->word)
+				return expand_oom(x);
+		}
+		x->prefix = e->field_count;
+	}
+	x->prefix = 0;
+	return expand_push(x, NULL, EXPAND_END);
+}
+
+/**
+ * expand_finish - Points the words of the expanded command at their text.
+ * @x: The expander.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool expand_finish(Expander *x)
+{
+	Expansion *e = x->expansion;
+
+	if (!expand_grow((void **)&e->words, &e->word_capacity,
+			 e->field_count, sizeof(char *)))
+		return expand_oom(x);
+	for (size_t i = 0; i < e->field_count; i++) {
+		ExpandField *field = &e->fields[i];
+
+		if (field->word)
+			e->words[i] = field->word;
+		else if (field->offset == EXPAND_END)
+			e->words[i] = NULL;
+		else
+			e->words[i] = e->text + field->offset;
+	}
+	return true;
+}
+
+/**
+ * expand_command - Expands the words of a simple command.
+ * @shell: Pointer to the shell state.
+ * @simple: The command, pointing into the syntax tree; it is pointed at
+ *          the expanded words.
+ *
+ * Return: true on success, false on failure.
+ */
+static bool expand_command(ShellState *shell, SimpleCommand *simple)
+{
+	Expander x = { .shell = shell,
+		       .expansion = &shell->expansion,
+		       .status = -1 };
+	Expansion *e = x.expansion;
+	size_t argv, argc, targets;
+
+	e->length = 0;
+	e->field_count = 0;
+	if (!expand_prefix(&x, simple->envp))
+		return false;
+	argv = e->field_count;
+	if (!expand_vector(&x, simple->argv, true))
+		return false;
+	argc = e->field_count - argv - 1;
+	targets = e->field_count;
+	if (!expand_targets(&x, simple->redirects, simple->targets) ||
+	    !expand_finish(&x))
+		return false;
+
+	simple->envp = e->words;
+	simple->argv = e->words + argv;
+	simple->argc = argc;
+	simple->targets = e->words + targets;
+	simple->subst_status = x.status;
+	return true;
+}
+
+/**
+ * expand_simple - Describes a simple command node with its words
+ *                 expanded.
+ * @shell: Pointer to the shell state.
+ * @ast: The AST holding the node.
+ * @node: A CMD_SIMPLE node.
+ * @simple: Receives the command's argv, envp and redirections.
+ *
+ * Parameter expansion, command substitution, quote removal and field
+ * splitting are done in a single pass over each word. Commands not
+ * marked NODE_EXPAND point straight into the syntax tree; the words of
+ * the others stay valid until the next command is expanded. Asking for
+ * the command just expanded again returns the same words.
+ *
+ * Return: true on success, false if the command must not run, after
+ * reporting why.
+ */
+bool expand_simple(ShellState *shell, const Ast *ast, const Node *node,
+		   SimpleCommand *simple)
+{
+	Expansion *e = &shell->expansion;
+
+	ast_simple(ast, node, simple);
+	if (!(node->flags & NODE_EXPAND))
+		return true;
+	if (e->node == node) {
+		*simple = e->simple;
+		return true;
+	}
+	if (!expand_command(shell, simple))
+		return false;
+	e->node = node;
+	e->simple = *simple;
+	return true;
+}
+
+/**
+ * expand_string - Expands a word into a single string.
+ * @shell: Pointer to the shell state.
+ * @word: The word, as stored by the parser.
+ * @pattern: Whether the word is a case pattern, whose quoted text is
+ *           escaped rather than only unquoted.
+ *
+ * Nothing is split, as for the word of a case command. Words without a
+ * '$' are used as they are. The expansion buffer is used, so the
+ * command last expanded has to be expanded again.
+ *
+ * Return: The string, in the shell's arena unless it is @word, or NULL
+ * on failure, after reporting why.
+ */
+char *expand_string(ShellState *shell, char *word, bool pattern)
+{
+	Expander x = { .shell = shell,
+		       .expansion = &shell->expansion,
+		       .pattern = pattern,
+		       .status = -1 };
+	Expansion *e = x.expansion;
+	char *string;
+
+	if (!strchr(word, '$'))
+		return word;
+	e->node = NULL;
+	e->length = 0;
+	e->field_count = 0;
+	if (!expand_text(&x, word, word + strlen(word), false))
+		return NULL;
+	string = arena_strndup(shell->arena, e->text ? e->text : "",
+			       e->length);
+	if (!string)
+		expand_oom(&x);
+	return string;
+}
+
+/**
+ * expand_free - Frees the buffers of an expansion.
+ * @expansion: The expansion.
+ */
+void expand_free(Expansion *expansion)
+{
+	free(expansion->text);
+	free(expansion->fields);
+	free(expansion->words);
+	memset(expansion, 0, sizeof(Expansion));
+}
@@ -0,0 +1,108 @@
+#include <function.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * function_destroy - Frees a function and its syntax tree.
+ * @function: The function.
+ */
+static void function_destroy(Function *function)
+{
+	ast_free(&function->ast);
+	arena_free(function->words);
+	free(function);
+}
+
+/**
+ * function_free - Drops a function from the function table.
+ * @value: The function.
+ *
+ * A function still being called is only marked, and freed by the last
+ * call to return.
+ */
+void function_free(void *value)
+{
+	Function *function = value;
+
+	function->removed = true;
+	if (!function->calls)
+		function_destroy(function);
+}
+
+/**
+ * function_define - Defines a function, replacing any of the same name.
+ * @shell: Pointer to the shell state.
+ * @name: The name of the function.
+ * @ast: The syntax tree holding the body.
+ * @body: Index of the body's node in @ast.
+ *
+ * The body is copied out of @ast, which only lasts as long as the line
+ * defining the function.
+ *
+ * Return: true on success, false on allocation failure, after reporting
+ * it.
+ */
+bool function_define(ShellState *shell, const char *name, const Ast *ast,
+		     NodeIndex body)
+{
+	Function *function = calloc(1, sizeof(Function));
+
+	if (function) {
+		function->words = arena_new();
+		function->body = AST_NONE;
+		if (function->words)
+			function->body =
+				ast_copy(&function->ast, ast, body,
+					 function->words);
+	}
+	if (!function || function->body == AST_NONE ||
+	    !table_insert(shell->functions, name, function)) {
+		if (function)
+			function_destroy(function);
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * function_find - Looks up a function.
+ * @shell: Pointer to the shell state.
+ * @name: The name.
+ *
+ * Return: The function, or NULL if there is none of that name.
+ */
+Function *function_find(ShellState *shell, const char *name)
+{
+	TableEntry *entry;
+
+	if (!shell->functions->count)
+		return NULL;
+	entry = table_find(shell->functions, name);
+	return entry ? entry->value : NULL;
+}
+
+/**
+ * function_remove - Removes a function.
+ * @shell: Pointer to the shell state.
+ * @name: The name of the function.
+ *
+ * Return: true if it was removed, false if there was none.
+ */
+bool function_remove(ShellState *shell, const char *name)
+{
+	return table_remove(shell->functions, name);
+}
+
+/**
+ * function_release - Ends a call of a function.
+ * @function: The function, whose calls were counted up for the call.
+ *
+ * Frees the function if it was removed while called.
+ */
+void function_release(Function *function)
+{
+	if (!--function->calls && function->removed)
+		function_destroy(function);
+}
@@ -0,0 +1,28 @@
+#ifndef ALIAS_H
+#define ALIAS_H
+
+#include <shell.h>
+#include <token.h>
+
+/*
+ * An alias keeps its text and the tokens lexed from it when it was
+ * defined, whose text points into value. blank is set when the value
+ * ends in a blank, so the word after it is checked for an alias too;
+ * active guards against an alias being expanded within itself.
+ */
+typedef struct Alias {
+	char *value;
+	size_t length;
+	Token *tokens;
+	size_t count;
+	bool blank;
+	bool active;
+} Alias;
+
+void alias_free(void *value);
+bool alias_define(ShellState *shell, const char *name, const char *value);
+Alias *alias_find(ShellState *shell, const char *name, size_t length);
+bool alias_remove(ShellState *shell, const char *name);
+void alias_clear(ShellState *shell);
+
+#endif /* ALIAS_H */
@@ -0,0 +1,37 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+typedef struct ArenaBlock {
+	struct ArenaBlock *next;
+	size_t capacity;
+	size_t used;
+	max_align_t data[];
+} ArenaBlock;
+
+typedef struct Arena {
+	ArenaBlock *first;
+	ArenaBlock *current;
+	void *last;
+} Arena;
+
+/*
+ * A position in an arena: allocations made after it was taken can be
+ * released together with arena_rewind().
+ */
+typedef struct ArenaMark {
+	ArenaBlock *block;
+	size_t used;
+} ArenaMark;
+
+Arena *arena_new(void);
+void arena_free(Arena *arena);
+void arena_reset(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_grow(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+char *arena_strndup(Arena *arena, const char *str, size_t length);
+ArenaMark arena_mark(const Arena *arena);
+void arena_rewind(Arena *arena, ArenaMark mark);
+
+#endif /* ARENA_H */
@@ -0,0 +1,10 @@
+#ifndef ARITH_H
+#define ARITH_H
+
+#include <shell.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+bool arith_eval(ShellState *shell, const char *text, intmax_t *value);
+
+#endif /* ARITH_H */
@@ -0,0 +1,126 @@
+#ifndef AST_H
+#define AST_H
+
+#include <arena.h>
+#include <command.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AST_NONE UINT32_MAX
+#define AST_NO_SLOT UINT16_MAX
+
+#define NODE_BACKGROUND 0x01
+#define NODE_TIMED 0x04
+#define NODE_TIME_POSIX 0x08
+#define NODE_EXPAND 0x10
+
+typedef uint32_t NodeIndex;
+
+/*
+ * Nodes refer to each other and to their words by 32-bit index only, so
+ * an array of them can be written out and mapped back unchanged.
+ *
+ * Compound commands are parsed once and run from their nodes as often
+ * as they loop. A CMD_LIST runs the items in refs one after the other.
+ * CMD_IF, CMD_WHILE and CMD_UNTIL are branches: elif is an if nested in
+ * otherwise, which loops leave AST_NONE. A CMD_FOR names its variable
+ * with a one word vector, and its words with a CMD_SIMPLE holding them
+ * as arguments, or AST_NONE for "$@". A CMD_CASE has a one word vector
+ * for its word and a CMD_ARM in refs for each of its arms, whose
+ * patterns are a vector; a pattern without a '$' has the pattern
+ * characters it quoted escaped. A CMD_REDIRECT is a binary node
+ * running its left command with the redirections of its right one, a
+ * CMD_SIMPLE without words. A CMD_FUNCTION defines the function named
+ * by its one word vector, whose body is a compound command. The slot of
+ * a CMD_CASE numbers it among those of its tree, for its matcher.
+ */
+typedef struct Node {
+	uint8_t type;
+	uint8_t flags;
+	uint16_t slot;
+	union {
+		struct {
+			uint32_t argv;
+			uint32_t argc;
+			uint32_t envp;
+			uint32_t envc;
+			uint32_t redirects;
+			uint32_t targets;
+		} simple;
+		struct {
+			NodeIndex left;
+			NodeIndex right;
+		} binary;
+		struct {
+			uint32_t stages;
+			uint32_t count;
+		} pipeline;
+		struct {
+			uint32_t items;
+			uint32_t count;
+		} list;
+		struct {
+			NodeIndex condition;
+			NodeIndex body;
+			NodeIndex otherwise;
+		} branch;
+		struct {
+			uint32_t name;
+			NodeIndex words;
+			NodeIndex body;
+		} loop;
+		struct {
+			uint32_t word;
+			uint32_t arms;
+			uint32_t count;
+		} cases;
+		struct {
+			uint32_t patterns;
+			uint32_t count;
+			NodeIndex body;
+		} arm;
+		struct {
+			uint32_t name;
+			NodeIndex body;
+		} function;
+	} as;
+} Node;
+
+/*
+ * words holds the NULL terminated argv, envp and redirection target
+ * vectors of every simple command back to back; redirects holds their
+ * redirections and refs the stage lists of pipelines, the items of
+ * lists and the arms of case commands. matchers holds the compiled
+ * patterns of the case commands by slot, built when they first run.
+ */
+typedef struct Ast {
+	Node *nodes;
+	uint32_t node_count;
+	uint32_t node_capacity;
+	char **words;
+	uint32_t word_count;
+	uint32_t word_capacity;
+	NodeIndex *refs;
+	uint32_t ref_count;
+	uint32_t ref_capacity;
+	Redirect *redirects;
+	uint32_t redirect_count;
+	uint32_t redirect_capacity;
+	struct CaseMatcher **matchers;
+	uint32_t case_count;
+	uint32_t case_capacity;
+} Ast;
+
+void ast_free(Ast *ast);
+void ast_reset(Ast *ast);
+void ast_free_matchers(Ast *ast);
+NodeIndex ast_add_node(Ast *ast, const Node *node);
+uint32_t ast_add_word(Ast *ast, char *word);
+uint32_t ast_add_refs(Ast *ast, const NodeIndex *refs, uint32_t count);
+uint32_t ast_add_redirect(Ast *ast, const Redirect *redirect);
+void ast_simple(const Ast *ast, const Node *node, SimpleCommand *simple);
+NodeIndex ast_copy(Ast *dst, const Ast *src, NodeIndex index,
+		   Arena *arena);
+size_t ast_format(const Ast *ast, NodeIndex index, char *buffer, size_t size);
+
+#endif /* AST_H */
@@ -4,6 +4,14 @@
 #include <shell.h>
 #include <executor.h>
 
-int (*get_builtin(char *))(ShellState *, SimpleCommand *, bool);
+Table *builtins_new(void);
+int (*get_builtin(ShellState *, char *))(ShellState *, SimpleCommand *, bool);
+bool builtin_is_pure(ShellState *shell, const char *arg);
+int builtin_output(ShellState *shell, const char *name, int status);
+
+int builtin_test(ShellState *shell, SimpleCommand *command,
+		 bool is_background);
+int builtin_printf(ShellState *shell, SimpleCommand *command,
+		   bool is_background);
 
 #endif /* BUILTINS_H */
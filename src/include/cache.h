@@ -0,0 +1,18 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <ast.h>
+#include <shell.h>
+#include <source.h>
+
+typedef struct CacheBuilder CacheBuilder;
+
+void cache_run_script(ShellState *shell, const char *path, Source *source);
+void cache_report(ShellState *shell);
+
+void cache_record_line(CacheBuilder *builder, int line_number, size_t offset);
+void cache_record_command(CacheBuilder *builder, const Ast *ast,
+			  NodeIndex root);
+void cache_record_abort(CacheBuilder *builder);
+
+#endif /* CACHE_H */
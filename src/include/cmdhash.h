@@ -0,0 +1,11 @@
+#ifndef CMDHASH_H
+#define CMDHASH_H
+
+#include <shell.h>
+
+const char *cmdhash_lookup(ShellState *shell, const char *name);
+void cmdhash_forget(ShellState *shell, const char *name);
+void cmdhash_clear(ShellState *shell);
+void cmdhash_sync(ShellState *shell);
+
+#endif /* CMDHASH_H */
@@ -2,6 +2,7 @@
 #define COMMAND_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef enum {
 	CMD_SIMPLE,
@@ -9,29 +10,52 @@ typedef enum {
 	CMD_AND,
 	CMD_OR,
 	CMD_BACKGROUND,
+	CMD_LIST,
+	CMD_IF,
+	CMD_WHILE,
+	CMD_UNTIL,
+	CMD_FOR,
+	CMD_CASE,
+	CMD_ARM,
+	CMD_REDIRECT,
+	CMD_FUNCTION,
 } CommandType;
 
+typedef enum {
+	REDIRECT_IN,
+	REDIRECT_OUT,
+	REDIRECT_APPEND,
+	REDIRECT_HEREDOC,
+	REDIRECT_DUP,
+} RedirectType;
+
+#define REDIRECT_EXPAND 0x01
+
+/*
+ * A redirection of a simple command, of descriptor fd. Its target, a
+ * file name, the body of a here-document, or for REDIRECT_DUP the
+ * descriptor to copy or "-", is a word of its own; REDIRECT_EXPAND marks
+ * a here-document whose body still holds expansions.
+ */
+typedef struct Redirect {
+	uint8_t type;
+	uint8_t flags;
+	uint16_t fd;
+} Redirect;
+
+/*
+ * redirects and targets describe the redirections, applied in order:
+ * targets is NULL terminated and holds the target of each of them.
+ * subst_status is the status of the last command substitution made
+ * while expanding the command, or -1 if there was none.
+ */
 typedef struct SimpleCommand {
 	int argc;
 	char **argv;
 	char **envp;
-	char *input_file;
-	char *output_file;
-	bool append_output;
+	const Redirect *redirects;
+	char **targets;
+	int subst_status;
 } SimpleCommand;
 
-typedef struct Command {
-	CommandType type;
-	bool is_background;
-	union {
-		SimpleCommand command;
-		struct {
-			struct Command *left;
-			struct Command *right;
-		} binary;
-	} as;
-} Command;
-
-void command_free(Command *command);
-
 #endif
@@ -1,9 +1,13 @@
 #ifndef EXECUTOR_H
 #define EXECUTOR_H
 
-#include <command.h>
+#include <ast.h>
 #include <shell.h>
 
-int execute(ShellState *shell, Command *command);
+int execute(ShellState *shell, const Ast *ast, NodeIndex index);
+int exit_status(int status);
+int execute_queued(ShellState *shell, Job *job);
+pid_t execute_capture(ShellState *shell, const Ast *ast, NodeIndex index,
+		      int out, int *status);
 
 #endif
@@ -0,0 +1,52 @@
+#ifndef EXPAND_H
+#define EXPAND_H
+
+#include <ast.h>
+#include <command.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ShellState;
+
+#define EXPAND_END SIZE_MAX
+
+/*
+ * A word of an expanded command: either a word of the syntax tree that
+ * needed no expansion, used as it is, or the offset of its text in the
+ * expansion buffer. EXPAND_END ends a vector.
+ */
+typedef struct ExpandField {
+	char *word;
+	size_t offset;
+} ExpandField;
+
+/*
+ * The words of the command being run, after expansion. Their text is
+ * appended to one buffer that is kept from command to command, and
+ * fields only records offsets into it until the command is complete,
+ * so the buffer may move while it grows; words then receives the
+ * pointers. node is the command last expanded and simple its expanded
+ * form, handed out again if the same command asks before the executor
+ * moves on, so command substitutions never run twice; the executor
+ * clears node before each command.
+ */
+typedef struct Expansion {
+	char *text;
+	size_t length;
+	size_t text_capacity;
+	ExpandField *fields;
+	size_t field_count;
+	size_t field_capacity;
+	char **words;
+	size_t word_capacity;
+	const Node *node;
+	SimpleCommand simple;
+} Expansion;
+
+bool expand_simple(struct ShellState *shell, const Ast *ast,
+		   const Node *node, SimpleCommand *simple);
+char *expand_string(struct ShellState *shell, char *word, bool pattern);
+void expand_free(Expansion *expansion);
+
+#endif /* EXPAND_H */
@@ -0,0 +1,30 @@
+#ifndef FUNCTION_H
+#define FUNCTION_H
+
+#include <arena.h>
+#include <ast.h>
+#include <shell.h>
+
+/*
+ * A function keeps a copy of its body's syntax tree, made when it is
+ * defined, with the words' text in an arena of its own; calls run it
+ * from there. calls counts the calls running, so a function redefined
+ * or unset from within itself is only freed once they have returned;
+ * removed marks such a function.
+ */
+typedef struct Function {
+	Ast ast;
+	Arena *words;
+	NodeIndex body;
+	int calls;
+	bool removed;
+} Function;
+
+void function_free(void *value);
+bool function_define(ShellState *shell, const char *name, const Ast *ast,
+		     NodeIndex body);
+Function *function_find(ShellState *shell, const char *name);
+bool function_remove(ShellState *shell, const char *name);
+void function_release(Function *function);
+
+#endif /* FUNCTION_H */
@@ -0,0 +1,105 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <ast.h>
+#include <jobserver.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <table.h>
+
+typedef enum {
+	JOB_QUEUED,
+	JOB_RUNNING,
+	JOB_STOPPED,
+	JOB_DONE,
+} JobState;
+
+struct Job;
+
+typedef struct JobProcess {
+	struct Job *job;
+	pid_t pid;
+	int pidfd;
+	bool done;
+} JobProcess;
+
+/*
+ * A queued job has no processes yet; root indexes its command in the
+ * job table's copy of the queued commands. A job started in the
+ * background holds a slot until all of its processes have exited.
+ */
+typedef struct Job {
+	int id;
+	pid_t pgid;
+	JobState state;
+	int status;
+	bool holds_slot;
+	uint64_t started;
+	size_t count;
+	size_t remaining;
+	char *command;
+	NodeIndex root;
+	struct Job *next;
+	JobProcess processes[];
+} Job;
+
+/*
+ * Jobs are kept in slots indexed by job number. Every running process
+ * is watched through a pidfd registered with epoll, so exits are found
+ * without polling the whole table; processes whose pidfd could not be
+ * opened are counted in unwatched and reaped with waitpid(-1).
+ *
+ * At most max_running background jobs (0 for no limit) run at once;
+ * jobs started beyond that wait in the queue, oldest first. Their
+ * commands are copied into queued, with the words' text in
+ * queued_words; both are emptied whenever the queue drains, so queued
+ * jobs cost no allocation or free of their own.
+ *
+ * last_pid is the pid of the last process of the most recent background
+ * job, for $!; it is 0 until there is one, and while that job is queued.
+ */
+typedef struct JobTable {
+	Job **slots;
+	int capacity;
+	int top;
+	size_t count;
+	int epoll_fd;
+	Table *pids;
+	size_t unwatched;
+	bool monitor;
+	size_t running;
+	size_t max_running;
+	Job *queue_head;
+	Job *queue_tail;
+	Ast queued;
+	Arena *queued_words;
+	Jobserver jobserver;
+	pid_t last_pid;
+} JobTable;
+
+struct ShellState;
+
+void jobs_signals(sigset_t *set);
+bool jobs_interrupted(bool clear);
+bool jobs_init(struct ShellState *shell);
+void jobs_free(struct ShellState *shell);
+void jobs_forget(struct ShellState *shell);
+Job *job_new(size_t count, char *command);
+bool job_add_process(struct ShellState *shell, Job *job, pid_t pid);
+int jobs_add(struct ShellState *shell, Job *job, bool foreground);
+bool jobs_claim_slot(struct ShellState *shell);
+bool jobs_queue(struct ShellState *shell, Job *job, const Ast *ast,
+		NodeIndex index);
+void jobs_reap(struct ShellState *shell, int timeout);
+void jobs_notify(struct ShellState *shell);
+void jobs_print(struct ShellState *shell);
+bool jobs_wait_input(struct ShellState *shell, int fd);
+int jobs_wait(struct ShellState *shell, Job *job);
+void jobs_resume(Job *job);
+int jobs_foreground(struct ShellState *shell, Job *job);
+Job *jobs_find(struct ShellState *shell, const char *spec);
+void jobs_remove(struct ShellState *shell, Job *job);
+
+#endif /* JOBS_H */
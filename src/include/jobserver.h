@@ -0,0 +1,27 @@
+#ifndef JOBSERVER_H
+#define JOBSERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A GNU make jobserver is a pipe holding one byte per job slot that is
+ * free across every process sharing it. Each running job beyond the
+ * first needs a byte, which is written back once the job has finished.
+ */
+typedef struct Jobserver {
+	int read_fd;
+	int write_fd;
+	bool watched;
+	char *tokens;
+	size_t token_count;
+	size_t token_capacity;
+} Jobserver;
+
+void jobserver_init(Jobserver *server);
+void jobserver_free(Jobserver *server);
+bool jobserver_active(const Jobserver *server);
+bool jobserver_acquire(Jobserver *server);
+void jobserver_release(Jobserver *server);
+
+#endif /* JOBSERVER_H */
@@ -10,9 +10,18 @@ typedef struct Lexer {
 	size_t cursor;
 	Token *tokens;
 	Token *last;
+	Token *heredoc;
+	Token *clause;
 	ShellState *shell;
+	int depth;
+	bool command;
+	bool pattern;
+	bool body;
+	bool alias_next;
+	bool aliases;
 } Lexer;
 
 Token *tokenize(ShellState *shell, const char *input);
+Token *tokenize_line(ShellState *shell, const char *input, size_t *length);
 
 #endif
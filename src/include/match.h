@@ -0,0 +1,59 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+#include <ast.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+struct MatchItem;
+struct MatchSet;
+struct MatchLiteral;
+struct MatchState;
+
+/*
+ * A pattern of a case command that is left to fnmatch(3) when the
+ * command runs: one with a '$', or one using bracket syntax the matcher
+ * does not compile.
+ */
+typedef struct MatchPending {
+	uint32_t arm;
+	uint32_t word;
+} MatchPending;
+
+/*
+ * The patterns of a case command, compiled the first time it runs and
+ * kept in the syntax tree's matchers under the node's slot. Patterns
+ * without pattern characters are looked up in a hash table of literals;
+ * the others are positions of one automaton, whose deterministic states
+ * are built from them as subjects reach them, so that a subject is
+ * matched against every arm in one pass over it. pending lists, in
+ * order, the patterns matched at run time instead.
+ */
+typedef struct CaseMatcher {
+	const Node *node;
+	uint32_t arm_count;
+	struct MatchLiteral *literals;
+	uint32_t literal_count;
+	uint32_t *buckets;
+	uint32_t bucket_mask;
+	char *text;
+	struct MatchItem *items;
+	uint32_t item_count;
+	uint32_t first_glob;
+	struct MatchSet *sets;
+	uint32_t set_count;
+	struct MatchState *states;
+	uint32_t state_count;
+	uint32_t state_capacity;
+	uint64_t *bits;
+	uint32_t *slots;
+	MatchPending *pending;
+	uint32_t pending_count;
+} CaseMatcher;
+
+CaseMatcher *match_compile(const Ast *ast, const Node *node);
+CaseMatcher *match_find(const Ast *ast, const Node *node);
+bool match_first(CaseMatcher *matcher, const char *subject, uint32_t *arm);
+void match_free(CaseMatcher *matcher);
+
+#endif /* MATCH_H */
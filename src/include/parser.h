@@ -1,7 +1,7 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-#include <command.h>
+#include <ast.h>
 #include <shell.h>
 #include <token.h>
 
@@ -9,8 +9,9 @@ typedef struct Parser {
 	Token *current;
 	Token *prev;
 	ShellState *shell;
+	Ast *ast;
 } Parser;
 
-Command *parse(ShellState *shell, Token *tokens);
+NodeIndex parse(ShellState *shell, Token *tokens);
 
 #endif
@@ -0,0 +1,31 @@
+#ifndef REDIRECT_H
+#define REDIRECT_H
+
+#include <command.h>
+#include <shell.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Redirections a command can have without allocating. */
+#define REDIRECT_STACK 8
+
+/*
+ * A redirection ready to be applied: fd becomes a copy of source, or is
+ * closed when source is -1. owned marks a source the shell opened for
+ * it, and saved holds a copy of what fd was before, -1 if it was closed.
+ */
+typedef struct FdAction {
+	int fd;
+	int source;
+	int saved;
+	bool owned;
+} FdAction;
+
+int redirect_private(int fd);
+FdAction *redirect_open(ShellState *shell, const SimpleCommand *simple,
+			FdAction *stack, size_t *count);
+bool redirect_apply(ShellState *shell, FdAction *actions, size_t count);
+void redirect_restore(FdAction *actions, size_t count);
+void redirect_release(FdAction *actions, size_t count, FdAction *stack);
+
+#endif /* REDIRECT_H */
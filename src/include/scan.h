@@ -0,0 +1,24 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CC_BLANK 0x01
+#define CC_DELIM 0x02
+#define CC_QUOTE 0x04
+#define CC_EQUALS 0x08
+#define CC_DOLLAR 0x10
+#define CC_WORD_STOP (CC_DELIM | CC_QUOTE | CC_EQUALS | CC_DOLLAR)
+
+/* The characters a backslash escapes inside double quotes. */
+#define SCAN_DQUOTE_ESCAPES "$`\"\\\n"
+
+extern const unsigned char char_class[256];
+
+size_t scan_word_run(const char *str);
+size_t scan_brace(const char *str, bool quoted);
+size_t scan_paren(const char *str);
+size_t scan_dquote(const char *str);
+
+#endif /* SCAN_H */
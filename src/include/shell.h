@@ -3,17 +3,95 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <table.h>
+#include <arena.h>
+#include <ast.h>
+#include <expand.h>
+#include <jobs.h>
+#include <timing.h>
+#include <trace.h>
+#include <vars.h>
+#include <sys/types.h>
+
+/*
+ * What the line last lexed spans past its first line: lines counts the
+ * lines of its here-document bodies and delimiters, those inside its
+ * compound commands and those joined by a backslash. delimiter, if set,
+ * is the delimiter of a here-document the input ended inside of,
+ * stripped of its tabs when strip is set, depth the number of compound
+ * commands left open, and joined is set when the input ended right
+ * after a backslash and newline.
+ */
+typedef struct Pending {
+	int lines;
+	const char *delimiter;
+	size_t length;
+	bool strip;
+	int depth;
+	bool joined;
+} Pending;
+
+/*
+ * What a `break`, `continue`, `return` or `exit` asks of the commands it
+ * is in.
+ */
+#define SKIP_BREAK 1
+#define SKIP_CONTINUE 2
+#define SKIP_RETURN 3
+#define SKIP_EXIT 4
 
 typedef struct ShellState {
 	bool fatal_error;
 	bool is_interactive_mode;
 	bool had_error;
+	/*
+	 * exec_final is set when the shell exits once its script or -c
+	 * string has run; exec_next then marks the command execute() runs
+	 * next as the last one, so a program it names may replace the shell.
+	 */
+	bool exec_final;
+	bool exec_next;
 	char *name;
+	char **params;
+	int param_count;
+	int status;
+	pid_t pid;
 	int line_number;
+	Pending pending;
+	/*
+	 * loop_depth counts the loops running in the current function, and
+	 * function_depth the functions being called; skip, once set by
+	 * `break` or `continue`, unwinds the commands up to the
+	 * skip_count-th loop out, or for `return`, up to the function.
+	 * `exit` unwinds everything, with skip_count holding its status.
+	 */
+	int loop_depth;
+	int function_depth;
+	int skip;
+	int skip_count;
+	Table *commands;
+	Table *builtins;
+	Table *aliases;
+	Table *functions;
+	uint64_t alias_generation;
+	uint64_t hashed_generation;
+	Vars vars;
+	Arena *arena;
+	Ast ast;
+	Expansion expansion;
+	JobTable jobs;
+	Trace *trace;
+	Timing *timing;
+	unsigned long cache_hits;
+	unsigned long cache_misses;
 } ShellState;
 
+struct CacheBuilder;
+
 ShellState *shell_init(char *name, bool is_interactive);
 void shell_free(ShellState *shell);
 void shell_repl(ShellState *shell, FILE *stream);
+bool shell_run_source(ShellState *shell, const char *text,
+		      struct CacheBuilder *builder);
 
 #endif
@@ -0,0 +1,17 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <shell.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct Source {
+	char *data;
+	size_t size;
+	size_t mapped;
+} Source;
+
+bool source_open(ShellState *shell, const char *path, Source *source);
+void source_close(Source *source);
+
+#endif /* SOURCE_H */
@@ -0,0 +1,10 @@
+#ifndef SUBST_H
+#define SUBST_H
+
+#include <shell.h>
+#include <stddef.h>
+
+int subst_capture(ShellState *shell, const char *body, size_t length,
+		  char **output, size_t *size);
+
+#endif /* SUBST_H */
@@ -0,0 +1,31 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct TableEntry {
+	char *key;
+	void *value;
+	uint32_t hash;
+	struct TableEntry *next;
+} TableEntry;
+
+typedef struct Table {
+	TableEntry **buckets;
+	size_t capacity;
+	size_t count;
+	void (*free_value)(void *);
+} Table;
+
+Table *table_new(void (*free_value)(void *));
+void table_free(Table *table);
+void table_clear(Table *table);
+TableEntry *table_find(Table *table, const char *key);
+TableEntry *table_find_n(Table *table, const char *key, size_t length);
+TableEntry *table_insert(Table *table, const char *key, void *value);
+bool table_remove(Table *table, const char *key);
+void table_each(Table *table, void (*fn)(TableEntry *, void *), void *ctx);
+
+#endif /* TABLE_H */
@@ -0,0 +1,30 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <time.h>
+
+/*
+ * One pipeline run under the `time` reserved word. Every child reaped
+ * while it runs is waited for with wait4(), and its resource usage is
+ * added to children; the shell's own usage, spent in builtins, is the
+ * difference from self. Timings nest, and a child counts towards every
+ * timing it was reaped under.
+ */
+typedef struct Timing {
+	struct timespec start;
+	struct rusage self;
+	struct rusage children;
+	size_t processes;
+	bool posix;
+	struct Timing *outer;
+} Timing;
+
+void timing_start(Timing *timing, Timing *outer, bool posix);
+pid_t timing_wait(Timing *timing, pid_t pid, int *raw, int options);
+void timing_report(const Timing *timing, const char *format);
+
+#endif /* TIMING_H */
@@ -3,6 +3,12 @@
 
 #include <shell.h>
 
+/*
+ * TOKEN_EOL ends a line. Inside a compound command a newline only
+ * separates commands, as TOKEN_NEWLINE, and the line goes on until the
+ * command is closed. Reserved words get token types of their own where
+ * they are recognized, and are words anywhere else.
+ */
 typedef enum TokenType {
 	TOKEN_WORD,
 	TOKEN_ASSIGNMENT_WORD,
@@ -14,16 +20,43 @@ typedef enum TokenType {
 	TOKEN_REDIRECT_IN,
 	TOKEN_REDIRECT_OUT,
 	TOKEN_REDIRECT_APPEND,
+	TOKEN_HEREDOC,
+	TOKEN_DUP_IN,
+	TOKEN_DUP_OUT,
+	TOKEN_DSEMI,
+	TOKEN_LPAREN,
+	TOKEN_RPAREN,
+	TOKEN_NEWLINE,
+	TOKEN_IF,
+	TOKEN_THEN,
+	TOKEN_ELSE,
+	TOKEN_ELIF,
+	TOKEN_FI,
+	TOKEN_WHILE,
+	TOKEN_UNTIL,
+	TOKEN_FOR,
+	TOKEN_IN,
+	TOKEN_DO,
+	TOKEN_DONE,
+	TOKEN_CASE,
+	TOKEN_ESAC,
+	TOKEN_LBRACE,
+	TOKEN_RBRACE,
 	TOKEN_EOL,
 } TokenType;
 
 typedef struct Token {
 	TokenType type;
-	char *lexeme;
+	const char *text;
+	size_t length;
+	bool quoted;
+	bool expand;
 	struct Token *next;
 } Token;
 
-void token_free_list(Token *head);
+char *token_lexeme(ShellState *shell, const Token *token);
+char *token_pattern(ShellState *shell, const Token *token);
+
 Token **token_split_by_semicolon(ShellState *shell, Token *tokens);
 
 #endif
@@ -0,0 +1,44 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define TRACE_EVENTS 65536
+#define TRACE_LABEL_SIZE 32
+
+/*
+ * One span: a shell phase when name is set, otherwise a command, named
+ * by label, with the pid that ran it and its exit status.
+ */
+typedef struct TraceEvent {
+	const char *name;
+	uint64_t start;
+	uint64_t duration;
+	int32_t pid;
+	int32_t status;
+	char label[TRACE_LABEL_SIZE];
+} TraceEvent;
+
+/*
+ * Events go to a ring allocated up front, so recording one is a clock
+ * read and a copy; count keeps growing past capacity as the oldest
+ * events are overwritten. The ring is written out once, at exit.
+ */
+typedef struct Trace {
+	TraceEvent *events;
+	size_t capacity;
+	size_t count;
+	uint64_t epoch;
+	pid_t pid;
+	char *path;
+} Trace;
+
+Trace *trace_new(void);
+void trace_free(Trace *trace);
+uint64_t trace_now(const Trace *trace);
+void trace_span(Trace *trace, const char *name, uint64_t start);
+void trace_command(Trace *trace, const char *label, uint64_t start,
+		   pid_t pid, int status);
+
+#endif /* TRACE_H */
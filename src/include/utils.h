@@ -3,6 +3,6 @@
 
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof(arr[0]))
 
-char *build_path(char *path, char *path_env);
+char *build_path(const char *path, const char *path_env);
 
 #endif
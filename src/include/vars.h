@@ -0,0 +1,66 @@
+#ifndef VARS_H
+#define VARS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <table.h>
+
+#define VAR_EXPORT 0x01
+
+/*
+ * A variable holds its NAME=value string whole, so exporting it costs
+ * no copy; value points just past the '='. A variable exported before
+ * it was set has no string. slot is its index in the exported
+ * environment, or VARS_NO_SLOT.
+ */
+typedef struct Var {
+	char *assignment;
+	const char *value;
+	unsigned int flags;
+	size_t slot;
+} Var;
+
+#define VARS_NO_SLOT SIZE_MAX
+
+/*
+ * A change made to the environment for the length of one command.
+ */
+typedef struct VarOverride {
+	size_t slot;
+	char *saved;
+} VarOverride;
+
+/*
+ * Shell variables, keyed by name. envp is the environment handed to
+ * programs: it is rebuilt only when an exported variable has changed
+ * since, as told by generation moving past built. Assignments in front
+ * of a command are patched into envp and taken out again afterwards,
+ * recorded in overrides. path_generation moves whenever PATH does.
+ */
+typedef struct Vars {
+	Table *table;
+	uint64_t generation;
+	uint64_t built;
+	uint64_t path_generation;
+	char **envp;
+	size_t envc;
+	size_t env_capacity;
+	VarOverride *overrides;
+	size_t override_count;
+	size_t override_capacity;
+} Vars;
+
+bool vars_init(Vars *vars, char **env);
+void vars_free(Vars *vars);
+bool vars_valid_name(const char *name, size_t length);
+const char *vars_get(Vars *vars, const char *name);
+const char *vars_get_n(Vars *vars, const char *name, size_t length);
+bool vars_set(Vars *vars, const char *assignment, unsigned int flags);
+bool vars_export(Vars *vars, const char *name);
+void vars_unset(Vars *vars, const char *name);
+char **vars_environ(Vars *vars);
+char **vars_overlay(Vars *vars, char **assignments);
+void vars_restore(Vars *vars);
+
+#endif /* VARS_H */
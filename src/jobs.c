@@ -0,0 +1,940 @@
+#include <jobs.h>
+#include <executor.h>
+#include <redirect.h>
+#include <shell.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define JOBS_EVENTS 64
+
+/* Set when an interrupt reached the shell or its foreground job. */
+static volatile sig_atomic_t jobs_interrupt;
+
+/**
+ * jobs_on_interrupt - Notes a SIGINT sent to the shell.
+ * @sig: The signal.
+ *
+ * The line is ended as the terminal echoed ^C on it.
+ */
+static void jobs_on_interrupt(int sig)
+{
+	int saved = errno;
+	ssize_t n;
+
+	(void)sig;
+	jobs_interrupt = 1;
+	n = write(STDOUT_FILENO, "\n", 1);
+	(void)n;
+	errno = saved;
+}
+
+/**
+ * jobs_interrupted - Tells whether an interrupt arrived since the flag
+ *                    was last cleared.
+ * @clear: Whether to clear the flag.
+ *
+ * Return: true if there was an interrupt.
+ */
+bool jobs_interrupted(bool clear)
+{
+	bool interrupted = jobs_interrupt;
+
+	if (clear)
+		jobs_interrupt = 0;
+	return interrupted;
+}
+
+/**
+ * jobs_signals - Lists the signals ignored by a shell with job control.
+ * @set: Receives the signals, which started programs reset to default.
+ */
+void jobs_signals(sigset_t *set)
+{
+	sigemptyset(set);
+	sigaddset(set, SIGINT);
+	sigaddset(set, SIGQUIT);
+	sigaddset(set, SIGTSTP);
+	sigaddset(set, SIGTTIN);
+	sigaddset(set, SIGTTOU);
+}
+
+/**
+ * jobs_max_running - Reads the limit on concurrent background jobs.
+ * @shell: Pointer to the shell state.
+ *
+ * HSH_MAXJOBS holds the limit; unset, empty or 0 means no limit.
+ */
+static void jobs_max_running(ShellState *shell)
+{
+	const char *value = getenv("HSH_MAXJOBS");
+	char *end;
+	long max;
+
+	if (!value || !*value)
+		return;
+	errno = 0;
+	max = strtol(value, &end, 10);
+	if (*end || max < 0 || errno) {
+		fprintf(stderr, "%s: HSH_MAXJOBS: %s: invalid number\n",
+			shell->name, value);
+		return;
+	}
+	shell->jobs.max_running = max;
+}
+
+/**
+ * jobs_init - Sets up an empty job table.
+ * @shell: Pointer to the shell state.
+ *
+ * An interactive shell on a terminal turns on job control: every job
+ * gets a process group of its own, and the shell leads its own group and
+ * ignores the terminal's job control signals, so it can hand the
+ * terminal to a job and take it back; SIGINT is only noted, so that a
+ * loop made of builtins can still be interrupted. The soft
+ * descriptor limit is raised so each running job can hold a pidfd.
+ * Background jobs are limited by HSH_MAXJOBS and by the jobserver of a
+ * parent make.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+bool jobs_init(ShellState *shell)
+{
+	JobTable *jobs = &shell->jobs;
+	struct rlimit limit;
+
+	memset(jobs, 0, sizeof(JobTable));
+	jobs->epoll_fd = -1;
+	jobs->pids = table_new(NULL);
+	if (!jobs->pids)
+		return false;
+
+	jobs->monitor = shell->is_interactive_mode && isatty(STDIN_FILENO);
+	if (jobs->monitor) {
+		struct sigaction action = { .sa_handler = jobs_on_interrupt,
+					    .sa_flags = SA_RESTART };
+		sigset_t set;
+
+		jobs_signals(&set);
+		for (int sig = 1; sig < NSIG; sig++) {
+			if (sigismember(&set, sig) == 1)
+				signal(sig, SIG_IGN);
+		}
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGINT, &action, NULL);
+		setpgid(0, 0);
+		tcsetpgrp(STDIN_FILENO, getpgrp());
+	}
+	if (!getrlimit(RLIMIT_NOFILE, &limit) &&
+	    limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+	jobs_max_running(shell);
+	jobserver_init(&jobs->jobserver);
+	return true;
+}
+
+/**
+ * jobs_free - Frees the job table without touching the jobs' processes.
+ * @shell: Pointer to the shell state.
+ */
+void jobs_free(ShellState *shell)
+{
+	JobTable *jobs = &shell->jobs;
+
+	for (int i = 0; i < jobs->top; i++) {
+		Job *job = jobs->slots[i];
+
+		if (!job)
+			continue;
+		for (size_t j = 0; j < job->count; j++) {
+			if (job->processes[j].pidfd >= 0)
+				close(job->processes[j].pidfd);
+		}
+		free(job->command);
+		free(job);
+	}
+	free(jobs->slots);
+	ast_free(&jobs->queued);
+	arena_free(jobs->queued_words);
+	jobserver_free(&jobs->jobserver);
+	if (jobs->epoll_fd >= 0)
+		close(jobs->epoll_fd);
+	table_free(jobs->pids);
+	memset(jobs, 0, sizeof(JobTable));
+	jobs->epoll_fd = -1;
+}
+
+/**
+ * jobs_forget - Detaches a forked child from the shell's job table.
+ * @shell: Pointer to the shell state.
+ *
+ * The epoll instance is shared with the parent, so the child drops it
+ * and creates its own if it starts jobs. The parent's jobs stay listed
+ * but cannot be waited for, and job control is off in the child, which
+ * takes the default action for the job control signals again. The
+ * parent's slots and jobserver tokens stay the parent's.
+ */
+void jobs_forget(ShellState *shell)
+{
+	if (shell->jobs.monitor) {
+		sigset_t set;
+
+		jobs_signals(&set);
+		for (int sig = 1; sig < NSIG; sig++) {
+			if (sigismember(&set, sig) == 1)
+				signal(sig, SIG_DFL);
+		}
+	}
+	if (shell->jobs.epoll_fd >= 0)
+		close(shell->jobs.epoll_fd);
+	shell->jobs.epoll_fd = -1;
+	shell->jobs.monitor = false;
+	shell->jobs.running = 0;
+	shell->jobs.queue_head = NULL;
+	shell->jobs.queue_tail = NULL;
+	shell->jobs.jobserver.token_count = 0;
+	shell->jobs.jobserver.watched = false;
+}
+
+/**
+ * job_new - Allocates a job for a number of processes.
+ * @count: Maximum number of processes in the job.
+ * @command: Text describing the job, owned by the job, or NULL.
+ *
+ * Return: Pointer to the job, or NULL on allocation failure.
+ */
+Job *job_new(size_t count, char *command)
+{
+	Job *job = calloc(1, sizeof(Job) + count * sizeof(JobProcess));
+	if (!job) {
+		free(command);
+		return NULL;
+	}
+	job->command = command;
+	job->count = count;
+	job->pgid = -1;
+	job->state = JOB_RUNNING;
+	return job;
+}
+
+/**
+ * jobs_pid_key - Formats a pid as a key of the pid table.
+ * @pid: The pid.
+ * @key: Receives the key.
+ * @size: Size of @key.
+ */
+static void jobs_pid_key(pid_t pid, char *key, size_t size)
+{
+	snprintf(key, size, "%d", (int)pid);
+}
+
+/**
+ * jobs_epoll - Creates the epoll instance of the job table if needed.
+ * @jobs: The job table.
+ *
+ * It and the pidfds registered with it are kept above the descriptors
+ * redirections can name.
+ *
+ * Return: true if the table has one.
+ */
+static bool jobs_epoll(JobTable *jobs)
+{
+	if (jobs->epoll_fd < 0)
+		jobs->epoll_fd = redirect_private(epoll_create1(EPOLL_CLOEXEC));
+	return jobs->epoll_fd >= 0;
+}
+
+/**
+ * job_add_process - Adds a started process to a job.
+ * @shell: Pointer to the shell state.
+ * @job: The job, not yet in the table.
+ * @pid: Pid of the process.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+bool job_add_process(ShellState *shell, Job *job, pid_t pid)
+{
+	JobTable *jobs = &shell->jobs;
+	JobProcess *process = &job->processes[job->remaining];
+	struct epoll_event event = { .events = EPOLLIN };
+	char key[16];
+
+	process->job = job;
+	process->pid = pid;
+	process->pidfd = -1;
+	jobs_pid_key(pid, key, sizeof(key));
+	if (!table_insert(jobs->pids, key, process))
+		return false;
+	if (!job->remaining)
+		job->started = trace_now(shell->trace);
+	job->remaining++;
+	if (job->pgid < 0)
+		job->pgid = jobs->monitor ? pid : 0;
+
+	if (jobs_epoll(jobs))
+		process->pidfd = redirect_private(
+			(int)syscall(SYS_pidfd_open, pid, 0));
+	event.data.ptr = process;
+	if (process->pidfd >= 0 && epoll_ctl(jobs->epoll_fd, EPOLL_CTL_ADD,
+					     process->pidfd, &event)) {
+		close(process->pidfd);
+		process->pidfd = -1;
+	}
+	if (process->pidfd < 0)
+		jobs->unwatched++;
+	return true;
+}
+
+/**
+ * jobs_unwatch - Stops watching a process and closes its pidfd.
+ * @jobs: The job table.
+ * @process: The process.
+ *
+ * Forked copies of the shell inherit the pidfd, so closing it alone
+ * would leave it registered, reporting the exit forever.
+ */
+static void jobs_unwatch(JobTable *jobs, JobProcess *process)
+{
+	if (jobs->epoll_fd >= 0)
+		epoll_ctl(jobs->epoll_fd, EPOLL_CTL_DEL, process->pidfd, NULL);
+	close(process->pidfd);
+	process->pidfd = -1;
+}
+
+/**
+ * jobs_add - Enters a job into the table.
+ * @shell: Pointer to the shell state.
+ * @job: The job, with all of its processes added.
+ * @foreground: true for a job the shell is about to wait for, which is
+ *              not announced.
+ *
+ * The job gets the lowest number above every job still in the table.
+ * The last process of a background job becomes $!.
+ *
+ * Return: The job number, or -1 on allocation failure.
+ */
+int jobs_add(ShellState *shell, Job *job, bool foreground)
+{
+	JobTable *jobs = &shell->jobs;
+
+	if (jobs->top == jobs->capacity) {
+		int capacity = jobs->capacity ? jobs->capacity * 2 : 16;
+		Job **slots = realloc(jobs->slots, sizeof(Job *) * capacity);
+		if (!slots)
+			return -1;
+		jobs->slots = slots;
+		jobs->capacity = capacity;
+	}
+	job->id = ++jobs->top;
+	if (job->state != JOB_QUEUED) {
+		job->count = job->remaining;
+		job->state = job->remaining ? JOB_RUNNING : JOB_DONE;
+	}
+	jobs->slots[job->id - 1] = job;
+	jobs->count++;
+	if (!foreground && job->state == JOB_RUNNING)
+		jobs->last_pid = job->processes[job->count - 1].pid;
+	if (jobs->monitor && !foreground && job->state == JOB_RUNNING) {
+		printf("[%d] %d\n", job->id, (int)jobs->last_pid);
+		fflush(stdout);
+	}
+	return job->id;
+}
+
+/**
+ * jobs_watch_jobserver - Starts or stops waiting for a jobserver token.
+ * @shell: Pointer to the shell state.
+ * @watch: true to wake up when a token may be free.
+ */
+static void jobs_watch_jobserver(ShellState *shell, bool watch)
+{
+	JobTable *jobs = &shell->jobs;
+	Jobserver *server = &jobs->jobserver;
+	struct epoll_event event = { .events = EPOLLIN, .data.ptr = server };
+
+	if (watch == server->watched || !jobserver_active(server))
+		return;
+	if (!jobs_epoll(jobs))
+		return;
+	if (!epoll_ctl(jobs->epoll_fd, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL,
+		       server->read_fd, &event))
+		server->watched = watch;
+}
+
+/**
+ * jobs_claim_slot - Takes a slot for a background job if one is free.
+ * @shell: Pointer to the shell state.
+ *
+ * The first running job uses the slot every jobserver client has of
+ * its own; each further one needs a token. When no token is free the
+ * jobserver is watched so queued jobs start as soon as one is.
+ *
+ * Return: true if the job may start now, false if it must be queued.
+ */
+bool jobs_claim_slot(ShellState *shell)
+{
+	JobTable *jobs = &shell->jobs;
+
+	if (jobs->max_running && jobs->running >= jobs->max_running)
+		return false;
+	if (jobs->running && jobserver_active(&jobs->jobserver) &&
+	    !jobserver_acquire(&jobs->jobserver)) {
+		jobs_watch_jobserver(shell, true);
+		return false;
+	}
+	jobs->running++;
+	return true;
+}
+
+/**
+ * jobs_release_slot - Frees the slot held by a finished job.
+ * @shell: Pointer to the shell state.
+ * @job: The job.
+ */
+static void jobs_release_slot(ShellState *shell, Job *job)
+{
+	JobTable *jobs = &shell->jobs;
+
+	if (!job->holds_slot)
+		return;
+	job->holds_slot = false;
+	jobs->running--;
+	if (jobs->jobserver.token_count >
+	    (jobs->running ? jobs->running - 1 : 0))
+		jobserver_release(&jobs->jobserver);
+}
+
+/**
+ * jobs_queue - Makes a job wait for a background slot.
+ * @shell: Pointer to the shell state.
+ * @job: The job, not yet in the table.
+ * @ast: The syntax tree holding the job's command.
+ * @index: Index of the command's node.
+ *
+ * The command is copied, since @ast is gone by the time the job starts.
+ * $! is unset until then, as the job has no process yet.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+bool jobs_queue(ShellState *shell, Job *job, const Ast *ast, NodeIndex index)
+{
+	JobTable *jobs = &shell->jobs;
+
+	if (!jobs->queued_words && !(jobs->queued_words = arena_new()))
+		return false;
+	job->root = ast_copy(&jobs->queued, ast, index, jobs->queued_words);
+	if (job->root == AST_NONE)
+		return false;
+
+	job->state = JOB_QUEUED;
+	jobs->last_pid = 0;
+	if (jobs->queue_tail)
+		jobs->queue_tail->next = job;
+	else
+		jobs->queue_head = job;
+	jobs->queue_tail = job;
+	return true;
+}
+
+/**
+ * jobs_start_queued - Starts queued jobs while slots are free.
+ * @shell: Pointer to the shell state.
+ *
+ * Jobs start in the order they were queued, and none starts directly
+ * while some are queued, so the last one to leave the queue is the most
+ * recent background job and its last process becomes $!.
+ */
+static void jobs_start_queued(ShellState *shell)
+{
+	JobTable *jobs = &shell->jobs;
+
+	while (jobs->queue_head && jobs_claim_slot(shell)) {
+		Job *job = jobs->queue_head;
+		int status;
+
+		jobs->queue_head = job->next;
+		if (!jobs->queue_head)
+			jobs->queue_tail = NULL;
+		job->next = NULL;
+		job->holds_slot = true;
+		job->state = JOB_RUNNING;
+		status = execute_queued(shell, job);
+		job->count = job->remaining;
+		if (!jobs->queue_head && job->remaining)
+			jobs->last_pid = job->processes[job->remaining - 1].pid;
+		if (!job->remaining) {
+			job->status = status;
+			job->state = JOB_DONE;
+			jobs_release_slot(shell, job);
+		}
+	}
+	if (!jobs->queue_head) {
+		jobs_watch_jobserver(shell, false);
+		ast_reset(&jobs->queued);
+		if (jobs->queued_words)
+			arena_reset(jobs->queued_words);
+	}
+}
+
+/**
+ * jobs_exited - Records that a process of a job has terminated.
+ * @shell: Pointer to the shell state.
+ * @process: The process.
+ * @raw: Its status as reported by waitpid().
+ */
+static void jobs_exited(ShellState *shell, JobProcess *process, int raw)
+{
+	Job *job = process->job;
+
+	if (process->done)
+		return;
+	process->done = true;
+	if (process->pidfd >= 0)
+		jobs_unwatch(&shell->jobs, process);
+	else
+		shell->jobs.unwatched--;
+	if (process == &job->processes[job->count - 1])
+		job->status = exit_status(raw);
+	trace_command(shell->trace, job->command ? job->command : "",
+		      job->started, process->pid, exit_status(raw));
+	if (--job->remaining == 0) {
+		job->state = JOB_DONE;
+		jobs_release_slot(shell, job);
+	}
+}
+
+/**
+ * jobs_collect - Reaps one process of a job if it has terminated.
+ * @shell: Pointer to the shell state.
+ * @process: The process.
+ * @options: Options for waitpid(), such as WNOHANG.
+ *
+ * Under `time` the process's resource usage is added to the timing.
+ *
+ * Return: true if the process stopped, false otherwise.
+ */
+static bool jobs_collect(ShellState *shell, JobProcess *process, int options)
+{
+	int raw;
+	pid_t pid;
+
+	do {
+		pid = timing_wait(shell->timing, process->pid, &raw,
+				  options);
+	} while (pid < 0 && errno == EINTR);
+
+	if (pid < 0)
+		jobs_exited(shell, process, 127 << 8);
+	else if (pid > 0 && WIFSTOPPED(raw))
+		return true;
+	else if (pid > 0)
+		jobs_exited(shell, process, raw);
+	return false;
+}
+
+/**
+ * jobs_reap_unwatched - Reaps terminated children found with waitpid(-1).
+ * @shell: Pointer to the shell state.
+ * @block: true to wait for the first child to terminate.
+ *
+ * Used only while some process could not be given a pidfd.
+ */
+static void jobs_reap_unwatched(ShellState *shell, bool block)
+{
+	char key[16];
+	int raw;
+	pid_t pid;
+
+	while ((pid = timing_wait(shell->timing, -1, &raw,
+				   block ? 0 : WNOHANG)) > 0 ||
+	       (pid < 0 && errno == EINTR)) {
+		if (pid < 0)
+			continue;
+		block = false;
+		jobs_pid_key(pid, key, sizeof(key));
+		TableEntry *entry = table_find(shell->jobs.pids, key);
+		if (entry)
+			jobs_exited(shell, entry->value, raw);
+	}
+}
+
+/**
+ * jobs_dispatch - Handles the events returned by epoll_wait().
+ * @shell: Pointer to the shell state.
+ * @events: The events.
+ * @count: Number of events.
+ *
+ * Queued jobs are started if that freed a slot; an event on the
+ * jobserver only means a token may be free.
+ *
+ * Return: true if the descriptor registered without a process, the
+ * shell's input, became readable.
+ */
+static bool jobs_dispatch(ShellState *shell, struct epoll_event *events,
+			  int count)
+{
+	bool input = false;
+
+	for (int i = 0; i < count; i++) {
+		if (!events[i].data.ptr)
+			input = true;
+		else if (events[i].data.ptr != &shell->jobs.jobserver)
+			jobs_collect(shell, events[i].data.ptr, WNOHANG);
+	}
+	jobs_start_queued(shell);
+	return input;
+}
+
+/**
+ * jobs_reap - Collects the background processes that have terminated.
+ * @shell: Pointer to the shell state.
+ * @timeout: Milliseconds to wait for an exit, 0 to only check, -1 to
+ *           wait until one happens.
+ *
+ * Only the processes that actually exited are visited.
+ */
+void jobs_reap(ShellState *shell, int timeout)
+{
+	JobTable *jobs = &shell->jobs;
+	struct epoll_event events[JOBS_EVENTS];
+	int n;
+
+	if (!jobs->count)
+		return;
+	if (jobs->epoll_fd < 0) {
+		jobs_reap_unwatched(shell, timeout && jobs->unwatched);
+		jobs_start_queued(shell);
+		return;
+	}
+	if (jobs->unwatched)
+		jobs_reap_unwatched(shell, false);
+	do {
+		n = epoll_wait(jobs->epoll_fd, events, JOBS_EVENTS, timeout);
+		if (n > 0)
+			jobs_dispatch(shell, events, n);
+		timeout = 0;
+	} while (n == JOBS_EVENTS);
+}
+
+/**
+ * jobs_wait_input - Waits for input while reaping background jobs.
+ * @shell: Pointer to the shell state.
+ * @fd: The descriptor input is read from.
+ *
+ * Return: true once @fd is readable, false if it cannot be watched.
+ */
+bool jobs_wait_input(ShellState *shell, int fd)
+{
+	JobTable *jobs = &shell->jobs;
+	struct epoll_event events[JOBS_EVENTS];
+	struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+	bool ready = false;
+
+	if (!jobs_epoll(jobs) ||
+	    (epoll_ctl(jobs->epoll_fd, EPOLL_CTL_ADD, fd, &event) &&
+	     errno != EEXIST))
+		return false;
+
+	while (!ready) {
+		int n = epoll_wait(jobs->epoll_fd, events, JOBS_EVENTS, -1);
+		if (n < 0 && errno != EINTR)
+			break;
+		if (n > 0)
+			ready = jobs_dispatch(shell, events, n);
+		if (jobs->unwatched) {
+			jobs_reap_unwatched(shell, false);
+			jobs_start_queued(shell);
+		}
+	}
+	epoll_ctl(jobs->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+	return ready;
+}
+
+/**
+ * jobs_state_name - Describes the state of a job for reports.
+ * @job: The job.
+ * @buffer: Scratch space for the description.
+ * @size: Size of @buffer.
+ *
+ * Return: The description.
+ */
+static const char *jobs_state_name(Job *job, char *buffer, size_t size)
+{
+	if (job->state == JOB_QUEUED)
+		return "Queued";
+	if (job->state == JOB_RUNNING)
+		return "Running";
+	if (job->state == JOB_STOPPED)
+		return "Stopped";
+	if (!job->status)
+		return "Done";
+	snprintf(buffer, size, "Done(%d)", job->status);
+	return buffer;
+}
+
+/**
+ * jobs_report - Prints one line describing a job.
+ * @shell: Pointer to the shell state.
+ * @job: The job.
+ */
+static void jobs_report(ShellState *shell, Job *job)
+{
+	JobTable *jobs = &shell->jobs;
+	char state[32];
+	char mark = ' ';
+
+	if (job->id == jobs->top)
+		mark = '+';
+	else
+		for (int i = jobs->top - 1; i > 0; i--) {
+			if (jobs->slots[i - 1]) {
+				mark = i == job->id ? '-' : ' ';
+				break;
+			}
+		}
+	printf("[%d]%c  %-24s%s\n", job->id, mark,
+	       jobs_state_name(job, state, sizeof(state)),
+	       job->command ? job->command : "");
+}
+
+/**
+ * jobs_list - Prints every job, forgetting those that have finished.
+ * @shell: Pointer to the shell state.
+ * @done_only: true to print only the jobs that have finished.
+ */
+static void jobs_list(ShellState *shell, bool done_only)
+{
+	JobTable *jobs = &shell->jobs;
+
+	jobs_reap(shell, 0);
+	for (int i = 0; i < jobs->top; i++) {
+		Job *job = jobs->slots[i];
+
+		if (!job || (done_only && job->state != JOB_DONE))
+			continue;
+		jobs_report(shell, job);
+		if (job->state == JOB_DONE)
+			jobs_remove(shell, job);
+	}
+	fflush(stdout);
+}
+
+/**
+ * jobs_notify - Reports finished jobs before an interactive prompt.
+ * @shell: Pointer to the shell state.
+ *
+ * A non-interactive shell keeps finished jobs until they are waited for.
+ */
+void jobs_notify(ShellState *shell)
+{
+	jobs_reap(shell, 0);
+	if (shell->jobs.monitor)
+		jobs_list(shell, true);
+}
+
+/**
+ * jobs_print - Implements the listing done by the `jobs` builtin.
+ * @shell: Pointer to the shell state.
+ */
+void jobs_print(ShellState *shell)
+{
+	jobs_list(shell, false);
+}
+
+/**
+ * jobs_wait - Waits for every process of a job to terminate.
+ * @shell: Pointer to the shell state.
+ * @job: The job, removed from the table once it has finished.
+ *
+ * Return: The exit status of the job's last process.
+ */
+int jobs_wait(ShellState *shell, Job *job)
+{
+	JobTable *jobs = &shell->jobs;
+	int status;
+
+	while (job->state != JOB_DONE) {
+		if (job->state == JOB_STOPPED)
+			return 128 + SIGTSTP;
+		if (job->state == JOB_QUEUED ||
+		    (jobs->epoll_fd >= 0 && !jobs->unwatched)) {
+			jobs_reap(shell, -1);
+			continue;
+		}
+		for (size_t i = 0; i < job->count; i++) {
+			if (!job->processes[i].done)
+				jobs_collect(shell, &job->processes[i], 0);
+		}
+	}
+	status = job->status;
+	jobs_remove(shell, job);
+	return status;
+}
+
+/**
+ * jobs_resume - Continues every process of a job.
+ * @job: The job.
+ */
+void jobs_resume(Job *job)
+{
+	if (job->state == JOB_QUEUED)
+		return;
+	if (job->pgid > 0)
+		killpg(job->pgid, SIGCONT);
+	else
+		for (size_t i = 0; i < job->count; i++) {
+			if (!job->processes[i].done)
+				kill(job->processes[i].pid, SIGCONT);
+		}
+	if (job->state == JOB_STOPPED)
+		job->state = JOB_RUNNING;
+}
+
+/**
+ * jobs_foreground - Continues a job in the foreground and waits for it.
+ * @shell: Pointer to the shell state.
+ * @job: The job.
+ *
+ * Under job control the terminal is handed to the job's process group
+ * for as long as it runs, and a job that stops again is kept. A job
+ * killed by the terminal's interrupt counts as an interrupt of the
+ * shell, which only the job received.
+ *
+ * Return: The exit status of the job, or 128 plus the stop signal.
+ */
+int jobs_foreground(ShellState *shell, Job *job)
+{
+	bool monitor = shell->jobs.monitor && job->pgid > 0;
+	bool stopped = false;
+	int status;
+
+	if (monitor)
+		tcsetpgrp(STDIN_FILENO, job->pgid);
+	jobs_resume(job);
+
+	uint64_t waited = trace_now(shell->trace);
+
+	for (size_t i = 0; i < job->count && !stopped; i++) {
+		if (!job->processes[i].done)
+			stopped = jobs_collect(shell, &job->processes[i],
+					       monitor ? WUNTRACED : 0);
+	}
+	trace_span(shell->trace, "waitpid", waited);
+	if (monitor)
+		tcsetpgrp(STDIN_FILENO, getpgrp());
+	if (stopped) {
+		job->state = JOB_STOPPED;
+		putchar('\n');
+		jobs_report(shell, job);
+		fflush(stdout);
+		return 128 + SIGTSTP;
+	}
+	status = jobs_wait(shell, job);
+	if (monitor && status == 128 + SIGINT) {
+		putchar('\n');
+		jobs_interrupt = 1;
+	}
+	return status;
+}
+
+/**
+ * jobs_find - Looks up a job by a job specification or pid.
+ * @shell: Pointer to the shell state.
+ * @spec: `%n`, `%+`, `%%`, `%-`, `%prefix` or a pid; NULL for the
+ *        current job.
+ *
+ * Return: The job, or NULL if there is no such job.
+ */
+Job *jobs_find(ShellState *shell, const char *spec)
+{
+	JobTable *jobs = &shell->jobs;
+	char *end;
+	long n;
+
+	if (!spec || !strcmp(spec, "%") || !strcmp(spec, "%%") ||
+	    !strcmp(spec, "%+"))
+		return jobs->top ? jobs->slots[jobs->top - 1] : NULL;
+	if (!strcmp(spec, "%-")) {
+		for (int i = jobs->top - 1; i > 0; i--) {
+			if (jobs->slots[i - 1])
+				return jobs->slots[i - 1];
+		}
+		return NULL;
+	}
+	if (*spec != '%') {
+		TableEntry *entry = table_find(jobs->pids, spec);
+		return entry ? ((JobProcess *)entry->value)->job : NULL;
+	}
+
+	n = strtol(spec + 1, &end, 10);
+	if (end != spec + 1 && !*end)
+		return n > 0 && n <= jobs->top ? jobs->slots[n - 1] : NULL;
+	for (int i = jobs->top; i > 0; i--) {
+		Job *job = jobs->slots[i - 1];
+		if (job && job->command &&
+		    !strncmp(job->command, spec + 1, strlen(spec + 1)))
+			return job;
+	}
+	return NULL;
+}
+
+/**
+ * jobs_remove - Removes a job from the table and frees it.
+ * @shell: Pointer to the shell state.
+ * @job: The job; it may also be one that was never added.
+ */
+void jobs_remove(ShellState *shell, Job *job)
+{
+	JobTable *jobs = &shell->jobs;
+	char key[16];
+
+	if (job->id) {
+		jobs->slots[job->id - 1] = NULL;
+		jobs->count--;
+		while (jobs->top > 0 && !jobs->slots[jobs->top - 1])
+			jobs->top--;
+	} else {
+		job->count = job->remaining;
+	}
+	if (job->state == JOB_QUEUED) {
+		Job **link = &jobs->queue_head;
+
+		while (*link && *link != job)
+			link = &(*link)->next;
+		if (*link)
+			*link = job->next;
+		if (jobs->queue_tail == job) {
+			jobs->queue_tail = NULL;
+			for (Job *j = jobs->queue_head; j; j = j->next)
+				jobs->queue_tail = j;
+		}
+		job->count = 0;
+	}
+	jobs_release_slot(shell, job);
+
+	for (size_t i = 0; i < job->count; i++) {
+		JobProcess *process = &job->processes[i];
+		TableEntry *entry;
+
+		if (!process->done && process->pidfd >= 0)
+			jobs_unwatch(jobs, process);
+		else if (!process->done)
+			jobs->unwatched--;
+		jobs_pid_key(process->pid, key, sizeof(key));
+		entry = table_find(jobs->pids, key);
+		if (entry && entry->value == process)
+			table_remove(jobs->pids, key);
+	}
+	free(job->command);
+	free(job);
+}
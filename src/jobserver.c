@@ -0,0 +1,191 @@
+#include <jobserver.h>
+#include <redirect.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * jobserver_is_pipe - Tells whether a descriptor is an open pipe or FIFO.
+ * @fd: The descriptor.
+ *
+ * make closes the jobserver descriptors for commands it does not know
+ * to be recursive, and the numbers may then be reused by anything.
+ *
+ * Return: true if @fd refers to a pipe or FIFO.
+ */
+static bool jobserver_is_pipe(int fd)
+{
+	struct stat st;
+
+	return fd >= 0 && !fstat(fd, &st) && S_ISFIFO(st.st_mode);
+}
+
+/**
+ * jobserver_open_fds - Connects to a jobserver given by inherited pipes.
+ * @server: The jobserver.
+ * @auth: The "R,W" descriptor pair from MAKEFLAGS.
+ *
+ * The read end is opened again through /proc so that it can be made
+ * non-blocking without changing the descriptor make and the other
+ * clients share.
+ */
+static void jobserver_open_fds(Jobserver *server, const char *auth)
+{
+	char path[32];
+	int r, w;
+
+	if (sscanf(auth, "%d,%d", &r, &w) != 2 || !jobserver_is_pipe(r) ||
+	    !jobserver_is_pipe(w))
+		return;
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", r);
+	server->read_fd = redirect_private(
+		open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC));
+	if (server->read_fd >= 0)
+		server->write_fd = w;
+}
+
+/**
+ * jobserver_open_fifo - Connects to a jobserver given by a named FIFO.
+ * @server: The jobserver.
+ * @path: Path of the FIFO, terminated by a space or NUL.
+ */
+static void jobserver_open_fifo(Jobserver *server, const char *path)
+{
+	char *name = strndup(path, strcspn(path, " "));
+
+	if (!name)
+		return;
+	server->read_fd = redirect_private(
+		open(name, O_RDWR | O_NONBLOCK | O_CLOEXEC));
+	if (server->read_fd >= 0 && !jobserver_is_pipe(server->read_fd)) {
+		close(server->read_fd);
+		server->read_fd = -1;
+	}
+	server->write_fd = server->read_fd;
+	free(name);
+}
+
+/**
+ * jobserver_init - Joins the jobserver of a parent make, if there is one.
+ * @server: The jobserver to set up.
+ *
+ * MAKEFLAGS carries --jobserver-auth=R,W (or --jobserver-fds=R,W before
+ * make 4.2) for a pipe, or --jobserver-auth=fifo:PATH since make 4.4.
+ * When neither is usable the jobserver stays inactive.
+ */
+void jobserver_init(Jobserver *server)
+{
+	const char *flags = getenv("MAKEFLAGS");
+	const char *auth = NULL;
+	static const char *const options[] = { "--jobserver-auth=",
+					       "--jobserver-fds=" };
+
+	memset(server, 0, sizeof(Jobserver));
+	server->read_fd = -1;
+	server->write_fd = -1;
+	if (!flags)
+		return;
+
+	for (size_t i = 0; i < sizeof(options) / sizeof(*options); i++) {
+		for (const char *s = flags; (s = strstr(s, options[i]));
+		     s++)
+			auth = s + strlen(options[i]);
+		if (auth)
+			break;
+	}
+	if (!auth)
+		return;
+	if (!strncmp(auth, "fifo:", 5))
+		jobserver_open_fifo(server, auth + 5);
+	else
+		jobserver_open_fds(server, auth);
+}
+
+/**
+ * jobserver_free - Gives back every held token and leaves the jobserver.
+ * @server: The jobserver.
+ */
+void jobserver_free(Jobserver *server)
+{
+	while (server->token_count)
+		jobserver_release(server);
+	if (server->read_fd >= 0)
+		close(server->read_fd);
+	free(server->tokens);
+	memset(server, 0, sizeof(Jobserver));
+	server->read_fd = -1;
+	server->write_fd = -1;
+}
+
+/**
+ * jobserver_active - Tells whether the shell is a jobserver client.
+ * @server: The jobserver.
+ *
+ * Return: true if slots must be taken from the jobserver.
+ */
+bool jobserver_active(const Jobserver *server)
+{
+	return server->read_fd >= 0;
+}
+
+/**
+ * jobserver_acquire - Takes a token without blocking.
+ * @server: The jobserver.
+ *
+ * A jobserver that fails with anything but EAGAIN is left, so that
+ * the shell falls back to running without it.
+ *
+ * Return: true if a token was taken, false if none is free right now.
+ */
+bool jobserver_acquire(Jobserver *server)
+{
+	ssize_t n;
+	char token;
+
+	if (server->token_count == server->token_capacity) {
+		size_t capacity = server->token_capacity ?
+					  server->token_capacity * 2 :
+					  16;
+		char *tokens = realloc(server->tokens, capacity);
+
+		if (!tokens)
+			return false;
+		server->tokens = tokens;
+		server->token_capacity = capacity;
+	}
+
+	do {
+		n = read(server->read_fd, &token, 1);
+	} while (n < 0 && errno == EINTR);
+	if (n == 1) {
+		server->tokens[server->token_count++] = token;
+		return true;
+	}
+	if (n < 0 && errno == EAGAIN)
+		return false;
+	jobserver_free(server);
+	return true;
+}
+
+/**
+ * jobserver_release - Gives back the most recently taken token.
+ * @server: The jobserver.
+ *
+ * make expects the byte it handed out back, so the bytes are kept.
+ */
+void jobserver_release(Jobserver *server)
+{
+	ssize_t n;
+
+	if (!server->token_count)
+		return;
+	server->token_count--;
+	do {
+		n = write(server->write_fd, &server->tokens[server->token_count],
+			  1);
+	} while (n < 0 && errno == EINTR);
+}
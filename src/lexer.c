@@ -1,9 +1,12 @@
 #include <lexer.h>
-#include <stdarg.h>
+#include <alias.h>
+#include <arena.h>
+#include <scan.h>
 #include <stdbool.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
+#include <utils.h>
+#include <vars.h>
 /**
  * lexer_at_end - Checks if the lexer has reached the end of the source.
  * @lex: Pointer to the Lexer structure.
@@ -33,7 +36,7 @@ static char lexer_advance(Lexer *lex)
  */
 static char lexer_peek(Lexer *lex)
 {
-	return lexer_at_end(lex) ? '\0' : lex->source[lex->cursor];
+	return lex->source[lex->cursor];
 }
 /**
  * lexer_skip_blanks - Skips whitespace characters in the source.
@@ -41,18 +44,8 @@ static char lexer_peek(Lexer *lex)
  */
 static void lexer_skip_blanks(Lexer *lex)
 {
-	for (;;) {
-		char c = lexer_peek(lex);
-		switch (c) {
-		case ' ':
-		case '\r':
-		case '\t':
-			lexer_advance(lex);
-			break;
-		default:
-			return;
-		}
-	}
+	while (char_class[(unsigned char)lexer_peek(lex)] & CC_BLANK)
+		lex->cursor++;
 }
 /**
  * lexer_match - Matches the current character with the expected one.
@@ -67,227 +60,663 @@ static bool lexer_match(Lexer *lex, char expected)
 	lex->cursor++;
 	return true;
 }
+
+/**
+ * lexer_link - Links a token at the end of the lexer's token list.
+ * @lex: Pointer to the Lexer structure.
+ * @token: The token.
+ *
+ * Also tracks whether the next word is in command position, where it
+ * may be an alias or a reserved word: at the start, after an operator
+ * or a reserved word, and after the assignments in front of a command
+ * or a `time` reserved word; the first here-document whose body is
+ * still to be read; how deep compound commands nest; and whether the
+ * next word is a case pattern, which is never in command position. The
+ * `()` of a function definition opens a level of its own until its body
+ * starts, so the body may begin on a later line.
+ */
+static void lexer_link(Lexer *lex, Token *token)
+{
+	Token *prev = lex->last;
+
+	token->next = NULL;
+	if (prev == NULL)
+		lex->tokens = token;
+	else
+		prev->next = token;
+	lex->last = token;
+	lex->alias_next = false;
+	if (lex->clause && lex->clause->next && lex->clause->next != token)
+		lex->clause = NULL;
+	if (lex->body && token->type != TOKEN_NEWLINE) {
+		lex->body = false;
+		lex->depth--;
+	}
+
+	switch (token->type) {
+	case TOKEN_ASSIGNMENT_WORD:
+		break;
+	case TOKEN_FOR:
+	case TOKEN_CASE:
+		lex->clause = token;
+		lex->command = false;
+		lex->depth++;
+		break;
+	case TOKEN_IF:
+	case TOKEN_WHILE:
+	case TOKEN_UNTIL:
+	case TOKEN_LBRACE:
+		lex->command = true;
+		lex->depth++;
+		break;
+	case TOKEN_FI:
+	case TOKEN_DONE:
+	case TOKEN_ESAC:
+	case TOKEN_RBRACE:
+		lex->pattern = false;
+		lex->command = true;
+		if (lex->depth)
+			lex->depth--;
+		break;
+	case TOKEN_IN:
+		lex->pattern = lex->clause && lex->clause->type == TOKEN_CASE;
+		lex->command = false;
+		break;
+	case TOKEN_DSEMI:
+		lex->pattern = true;
+		break;
+	case TOKEN_RPAREN:
+		if (!lex->pattern && prev && prev->type == TOKEN_LPAREN) {
+			lex->body = true;
+			lex->depth++;
+		}
+		lex->pattern = false;
+		lex->command = true;
+		break;
+	case TOKEN_WORD:
+		lex->command = lex->command && !token->quoted &&
+			       token->length == 4 &&
+			       !strncmp(token->text, "time", 4);
+		break;
+	case TOKEN_HEREDOC:
+		if (!lex->heredoc)
+			lex->heredoc = token;
+		lex->command = false;
+		break;
+	case TOKEN_REDIRECT_IN:
+	case TOKEN_REDIRECT_OUT:
+	case TOKEN_REDIRECT_APPEND:
+	case TOKEN_DUP_IN:
+	case TOKEN_DUP_OUT:
+		lex->command = false;
+		break;
+	default:
+		lex->command = true;
+		break;
+	}
+	if (lex->pattern)
+		lex->command = false;
+}
+
 /**
  * lexer_append_token - Appends a new token to the lexer's token list.
  * @lex: Pointer to the Lexer structure.
  * @type: The type of the token to append.
- * @lexeme: The lexeme of the token to append.
+ * @quoted: Whether the token text contains quotes to be removed.
+ *
+ * The token refers to the source text between lex->start and lex->cursor
+ * instead of holding a copy of it.
+ *
+ * Return: The new token, or NULL on allocation failure.
  */
-static void lexer_append_token(Lexer *lex, TokenType type, char *lexeme)
+static Token *lexer_append_token(Lexer *lex, TokenType type, bool quoted)
 {
-	Token *token = malloc(sizeof(Token));
+	Token *token = arena_alloc(lex->shell->arena, sizeof(Token));
 	if (!token) {
 		fprintf(stderr, "Error: malloc failed\n");
 		lex->shell->fatal_error = true;
-		return;
+		return NULL;
 	}
 	token->type = type;
-	token->lexeme = lexeme;
-	token->next = NULL;
+	token->text = &lex->source[lex->start];
+	token->length = lex->cursor - lex->start;
+	token->quoted = quoted;
+	token->expand = false;
+	lexer_link(lex, token);
+	return token;
+}
 
-	if (lex->last == NULL) {
-		lex->tokens = token;
-		lex->last = token;
-	} else {
-		lex->last->next = token;
-		lex->last = token;
+/**
+ * lexer_alias - Finds the alias a word stands for.
+ * @lex: Pointer to the Lexer structure.
+ * @word: The word.
+ *
+ * Only unquoted words in command position, or right after an alias
+ * ending in a blank, are replaced, and never by an alias that is being
+ * expanded already.
+ *
+ * Return: The alias, or NULL if the word is to be kept.
+ */
+static Alias *lexer_alias(Lexer *lex, const Token *word)
+{
+	Alias *alias;
+
+	if (!lex->aliases || word->type != TOKEN_WORD || word->quoted ||
+	    word->expand || !(lex->command || lex->alias_next))
+		return NULL;
+	alias = alias_find(lex->shell, word->text, word->length);
+	return alias && !alias->active ? alias : NULL;
+}
+
+/**
+ * lexer_splice - Appends the tokens of an alias in place of a word.
+ * @lex: Pointer to the Lexer structure.
+ * @alias: The alias.
+ *
+ * The tokens were lexed when the alias was defined, so they are only
+ * copied, with their text, into the line's arena; the line then does
+ * not depend on the alias staying defined while it runs. Words of the
+ * alias in command position are expanded in turn.
+ */
+static void lexer_splice(Lexer *lex, Alias *alias)
+{
+	char *text = arena_strndup(lex->shell->arena, alias->value,
+				   alias->length);
+	Alias *nested;
+	Token *copy;
+
+	if (!text) {
+		fprintf(stderr, "Error: malloc failed\n");
+		lex->shell->fatal_error = true;
+		return;
+	}
+	alias->active = true;
+	for (size_t i = 0; i < alias->count; i++) {
+		nested = lexer_alias(lex, &alias->tokens[i]);
+		if (nested) {
+			lexer_splice(lex, nested);
+			continue;
+		}
+		copy = arena_alloc(lex->shell->arena, sizeof(Token));
+		if (!copy) {
+			fprintf(stderr, "Error: malloc failed\n");
+			lex->shell->fatal_error = true;
+			break;
+		}
+		*copy = alias->tokens[i];
+		copy->text = text + (alias->tokens[i].text - alias->value);
+		lexer_link(lex, copy);
 	}
+	alias->active = false;
+	if (alias->blank)
+		lex->alias_next = true;
 }
 
+/*
+ * The reserved words recognized in command position, with their tokens.
+ */
+static const struct {
+	const char *word;
+	TokenType type;
+} reserved_words[] = {
+	{ "if", TOKEN_IF },	  { "then", TOKEN_THEN },   { "else", TOKEN_ELSE },
+	{ "elif", TOKEN_ELIF },	  { "fi", TOKEN_FI },	    { "while", TOKEN_WHILE },
+	{ "until", TOKEN_UNTIL }, { "for", TOKEN_FOR },	    { "do", TOKEN_DO },
+	{ "done", TOKEN_DONE },	  { "case", TOKEN_CASE },   { "esac", TOKEN_ESAC },
+	{ "{", TOKEN_LBRACE },	  { "}", TOKEN_RBRACE },
+};
+
 /**
- * is_valid_identifier - Checks if a string is a valid identifier.
- * @str: The string to check.
- * @length: The length of the string.
- * Return: true if valid, false otherwise.
+ * lexer_is - Checks if a word is spelled a given way.
+ * @word: The word.
+ * @text: The spelling.
+ * Return: true if @word is @text, false otherwise.
  */
-static bool is_valid_identifier(char *str, size_t length)
+static bool lexer_is(const Token *word, const char *text)
 {
-	if (!(str[0] == '_' || (str[0] >= 'a' && str[0] <= 'z') ||
-	      (str[0] >= 'A' && str[0] <= 'Z')))
-		return false;
+	return word->length == strlen(text) &&
+	       !strncmp(word->text, text, word->length);
+}
 
-	for (size_t i = 1; i < length; i++) {
-		if (!(str[i] == '_' || (str[i] >= 'a' && str[i] <= 'z') ||
-		      (str[i] >= 'A' && str[i] <= 'Z') ||
-		      (str[i] >= '0' && str[i] <= '9')))
-			return false;
+/**
+ * lexer_reserved - Finds the reserved word a word stands for.
+ * @lex: Pointer to the Lexer structure.
+ * @word: The word, not yet linked.
+ *
+ * Only unquoted words without expansions are reserved, and only where
+ * the grammar expects one: in command position unless assignments come
+ * first, `in` and `do` right after the name of a for or case, and
+ * `esac` in place of a case pattern.
+ *
+ * Return: The token type of the reserved word, or the word's own type.
+ */
+static TokenType lexer_reserved(Lexer *lex, const Token *word)
+{
+	const Token *last = lex->last;
+
+	if (word->type != TOKEN_WORD || word->quoted || word->expand)
+		return word->type;
+	if (lex->pattern)
+		return last && (last->type == TOKEN_IN ||
+				last->type == TOKEN_DSEMI ||
+				last->type == TOKEN_NEWLINE) &&
+				       lexer_is(word, "esac") ?
+			       TOKEN_ESAC :
+			       TOKEN_WORD;
+	if (lex->clause && last && lex->clause->next == last) {
+		if (lexer_is(word, "in"))
+			return TOKEN_IN;
+		if (lex->clause->type == TOKEN_FOR && lexer_is(word, "do"))
+			return TOKEN_DO;
+		return TOKEN_WORD;
 	}
-	return true;
+	if (!lex->command || (last && last->type == TOKEN_ASSIGNMENT_WORD))
+		return TOKEN_WORD;
+	for (size_t i = 0; i < ARRAY_SIZE(reserved_words); i++) {
+		if (lexer_is(word, reserved_words[i].word))
+			return reserved_words[i].type;
+	}
+	return TOKEN_WORD;
 }
 
 /**
  * is_word_delimiter - Checks if a character is a word delimiter.
  * @c: The character to check.
- * Return: true if it is a delimiter, false otherwise.
+ * Return: true if it is a delimiter or NUL, false otherwise.
  */
 static bool is_word_delimiter(char c)
 {
-	return strchr(" \r\t\n;|&<>#", c) != NULL;
+	return char_class[(unsigned char)c] & CC_DELIM;
 }
 
 /**
- * append_substr - Appends a formatted substring to a dynamic string.
- * @string: Pointer to the dynamic string.
- * @length: Pointer to the current length of the string.
- * @capacity: Pointer to the current capacity of the string.
- * @format: The format string.
- * @...: Additional arguments for formatting.
+ * lexer_scan_parameter - Skips a parameter expansion or command
+ *                        substitution inside a word.
+ * @lex: Pointer to the Lexer structure, at the '$'.
+ *
+ * A ${...} expansion or $(...) substitution is skipped whole, blanks
+ * and all. Of the others only the character after the '$' is skipped
+ * when it names a special parameter, so $# is not taken for a comment;
+ * the rest of a name is an ordinary run of word characters.
+ *
+ * Return: true on success, false if a brace or parenthesis is not
+ * closed.
  */
-static void append_substr(char **string, size_t *length, size_t *capacity,
-			  const char *format, ...)
+static bool lexer_scan_parameter(Lexer *lex)
 {
-	va_list args;
-	char buffer[2];
-	int needed;
-
-	va_start(args, format);
-	needed = vsnprintf(buffer, sizeof(buffer), format, args);
-	va_end(args);
-
-	if (*length + needed + 1 > *capacity) {
-		*capacity = (*length + needed + 1) * 2;
-		*string = realloc(*string, *capacity);
-		if (!*string) {
-			fprintf(stderr, "Error: realloc failed\n");
-			return;
+	const char *name = &lex->source[lex->cursor + 1];
+	size_t length;
+
+	if (*name == '{' || *name == '(') {
+		length = *name == '{' ? scan_brace(name, false) :
+					scan_paren(name);
+		if (!length) {
+			fprintf(stderr, "Error: Unterminated %s.\n",
+				*name == '{' ? "parameter expansion" :
+					       "command substitution");
+			lex->shell->had_error = true;
+			lex->cursor += 1 + strcspn(name, "\n");
+			return false;
 		}
+		lex->cursor += 1 + length;
+	} else if (*name && strchr("#?$@*!-0123456789", *name)) {
+		lex->cursor += 2;
+	} else {
+		lex->cursor++;
 	}
-
-	va_start(args, format);
-	vsnprintf(*string + *length, needed + 1, format, args);
-	va_end(args);
-	*length += needed;
+	return true;
 }
 
 /**
  * lexer_handle_word - Handles the lexing of a word token.
  * @lex: Pointer to the Lexer structure.
+ *
+ * The word is only scanned: quotes are checked for termination and the
+ * token records whether quote removal is needed once it is materialized,
+ * and whether it holds a '$' to be expanded when it is run. A backslash
+ * quotes the character after it, which is skipped even if it is a
+ * delimiter or a quote; an escaped '$' still marks the word for
+ * expansion, which removes the backslash. A backslash before a newline
+ * joins the next line to the word. A word naming an alias is replaced
+ * by the alias's tokens, unless it is a reserved word there. Runs of
+ * plain characters are skipped in bulk by scan_word_run().
  */
 static void lexer_handle_word(Lexer *lex)
 {
-	char *string = strdup("");
-	size_t length = 0;
-	size_t capacity = 0;
-	bool has_quotes_before_equal = false, found_equals = false;
+	size_t equ_pos = 0, content = 0, start;
+	bool quoted = false, has_quotes_before_equal = false;
+	bool found_equals = false, expand = false, joined = false;
+	Token *token, word;
+	Alias *alias;
 
-	if (!string) {
-		fprintf(stderr, "Error: malloc failed\n");
-		lex->shell->fatal_error = true;
-		return;
-	}
+	for (;;) {
+		size_t run = scan_word_run(&lex->source[lex->cursor]);
+		lex->cursor += run;
+		content += run;
 
-	while (!lexer_at_end(lex) && !is_word_delimiter(lexer_peek(lex))) {
-		if (lexer_peek(lex) == '\'' || lexer_peek(lex) == '"') {
-			lex->start = lex->cursor;
-			char quote = lexer_advance(lex);
-			while (!lexer_at_end(lex) && lexer_peek(lex) != quote)
-				lexer_advance(lex);
-
-			if (lexer_at_end(lex)) {
-				fprintf(stderr,
-					"Error: Unterminated string.\n");
-				lex->shell->had_error = true;
-				free(string);
+		char c = lexer_peek(lex);
+		if (is_word_delimiter(c))
+			break;
+		if (c == '=') {
+			if (!found_equals) {
+				found_equals = true;
+				equ_pos = lex->cursor - lex->start;
+			}
+			lexer_advance(lex);
+			content++;
+			continue;
+		}
+		if (c == '$') {
+			start = lex->cursor;
+			if (!lexer_scan_parameter(lex))
 				return;
+			expand = true;
+			content += lex->cursor - start;
+			continue;
+		}
+		if (c == '\\') {
+			c = lex->source[lex->cursor + 1];
+			lex->cursor += 1 + (c != '\0');
+			if (c == '\n') {
+				joined = true;
+				if (lex->aliases)
+					lex->shell->pending.lines++;
+				if (!lexer_peek(lex))
+					lex->shell->pending.joined = true;
+				continue;
 			}
-
 			if (!found_equals)
 				has_quotes_before_equal = true;
-			lexer_advance(lex);
+			quoted = true;
+			expand = expand || c == '$';
+			content++;
+			continue;
+		}
 
-			size_t str_length = lex->cursor - lex->start - 2;
-			char *substr = malloc(str_length + 1);
-			if (!substr) {
-				fprintf(stderr, "Error: malloc failed\n");
-				lex->shell->fatal_error = true;
-				free(string);
-				return;
-			}
+		const char *open = &lex->source[lex->cursor + 1];
+		const char *close = open + (c == '"' ? scan_dquote(open) :
+						       strcspn(open, "'\n"));
+		if (*close != c) {
+			fprintf(stderr, "Error: Unterminated string.\n");
+			lex->shell->had_error = true;
+			lex->cursor = close - lex->source;
+			return;
+		}
 
-			strncpy(substr, &lex->source[lex->start + 1],
-				str_length);
-			substr[str_length] = '\0';
-			append_substr(&string, &length, &capacity, "%s",
-				      substr);
-			free(substr);
-		} else {
-			if (lexer_peek(lex) == '=' && !found_equals)
-				found_equals = true;
-			append_substr(&string, &length, &capacity, "%c",
-				      lexer_advance(lex));
+		if (!found_equals)
+			has_quotes_before_equal = true;
+		quoted = true;
+		if (memchr(open, '$', close - open))
+			expand = true;
+		content += close - open;
+		lex->cursor = close - lex->source + 1;
+	}
+
+	if (content == 0 && !quoted)
+		return;
+	word.type = TOKEN_WORD;
+	if (found_equals && !has_quotes_before_equal && equ_pos > 0 &&
+	    vars_valid_name(&lex->source[lex->start], equ_pos))
+		word.type = TOKEN_ASSIGNMENT_WORD;
+	word.text = &lex->source[lex->start];
+	word.length = lex->cursor - lex->start;
+	word.quoted = quoted || joined;
+	word.expand = expand;
+	word.type = lexer_reserved(lex, &word);
+	alias = lexer_alias(lex, &word);
+	if (alias) {
+		lexer_splice(lex, alias);
+		return;
+	}
+	token = lexer_append_token(lex, word.type, word.quoted);
+	if (token)
+		token->expand = expand;
+}
+
+/**
+ * lexer_strip_tabs - Copies the body of a <<- here-document without the
+ *                    tabs leading its lines.
+ * @lex: Pointer to the Lexer structure.
+ * @body: The body.
+ * @length: Length of @body.
+ * @stripped: Set to the length of the copy.
+ *
+ * Return: The copy in the shell's arena, or NULL on allocation failure.
+ */
+static char *lexer_strip_tabs(Lexer *lex, const char *body, size_t length,
+			      size_t *stripped)
+{
+	char *copy = arena_alloc(lex->shell->arena, length + 1);
+	size_t n = 0;
+	bool line_start = true;
+
+	if (!copy) {
+		fprintf(stderr, "Error: malloc failed\n");
+		lex->shell->fatal_error = true;
+		return NULL;
+	}
+	for (size_t i = 0; i < length; i++) {
+		if (line_start && body[i] == '\t')
+			continue;
+		copy[n++] = body[i];
+		line_start = body[i] == '\n';
+	}
+	copy[n] = '\0';
+	*stripped = n;
+	return copy;
+}
+
+/**
+ * lexer_heredoc_body - Reads the body of a here-document.
+ * @lex: Pointer to the Lexer structure, at the start of the body.
+ * @op: The << or <<- operator.
+ * @word: The delimiter, made to hold the body instead.
+ *
+ * The body is every line up to one that is the delimiter, with its
+ * quotes removed, and is taken in place from the source; only a <<-
+ * body is copied, once, to strip its tabs. Its text is expanded when
+ * the command runs, unless the delimiter was quoted. A body running to
+ * the end of the input is recorded in shell->pending, so the caller
+ * may read more of it.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool lexer_heredoc_body(Lexer *lex, const Token *op, Token *word)
+{
+	Pending *pending = &lex->shell->pending;
+	const char *body = &lex->source[lex->cursor], *line = body, *p;
+	Token unquoted = *word;
+	const char *delimiter = word->text;
+	size_t length = word->length;
+	bool strip = op->length == 3;
+
+	if (word->quoted) {
+		unquoted.expand = false;
+		delimiter = token_lexeme(lex->shell, &unquoted);
+		if (!delimiter)
+			return false;
+		length = strlen(delimiter);
+	}
+	for (;;) {
+		p = line;
+		while (strip && *p == '\t')
+			p++;
+		if (!strncmp(p, delimiter, length) &&
+		    (p[length] == '\n' || p[length] == '\0'))
+			break;
+		p += strcspn(p, "\n");
+		if (!*p) {
+			pending->delimiter = delimiter;
+			pending->length = length;
+			pending->strip = strip;
+			line = p;
+			break;
 		}
+		line = p + 1;
+		pending->lines++;
+	}
+
+	word->type = TOKEN_WORD;
+	word->text = body;
+	word->length = line - body;
+	word->expand = !word->quoted && (memchr(body, '$', word->length) ||
+					 memchr(body, '\\', word->length));
+	word->quoted = false;
+	if (strip && !(word->text = lexer_strip_tabs(lex, body, word->length,
+						     &word->length)))
+		return false;
+
+	if (*line) {
+		pending->lines++;
+		line = p + length;
+		if (*line)
+			line++;
 	}
+	lex->cursor = line - lex->source;
+	return true;
+}
 
-	if (strcmp(string, "") != 0) {
-		size_t equ_pos = strcspn(string, "=");
-		if (strchr(string, '=') && !has_quotes_before_equal &&
-		    equ_pos > 0 && is_valid_identifier(string, equ_pos)) {
-			lexer_append_token(lex, TOKEN_ASSIGNMENT_WORD, string);
+/**
+ * lexer_read_heredocs - Reads the bodies of the pending here-documents.
+ * @lex: Pointer to the Lexer structure, after the newline ending the
+ *       line of their operators.
+ *
+ * The bodies follow one another in the order of their operators. An
+ * operator without a delimiter is left for the parser to report.
+ */
+static void lexer_read_heredocs(Lexer *lex)
+{
+	for (Token *op = lex->heredoc; op; op = op->next) {
+		if (op->type != TOKEN_HEREDOC || !op->next ||
+		    (op->next->type != TOKEN_WORD &&
+		     op->next->type != TOKEN_ASSIGNMENT_WORD))
+			continue;
+		if (!lexer_heredoc_body(lex, op, op->next))
 			return;
+	}
+	lex->heredoc = NULL;
+}
+
+/**
+ * lexer_scan_redirect - Scans a redirection operator.
+ * @lex: Pointer to the Lexer structure, at the '<' or '>', past the io
+ *       number if there is one.
+ *
+ * The token's text starts at lex->start, so it includes the io number.
+ */
+static void lexer_scan_redirect(Lexer *lex)
+{
+	if (lexer_advance(lex) == '<') {
+		if (lexer_match(lex, '<')) {
+			lexer_match(lex, '-');
+			lexer_append_token(lex, TOKEN_HEREDOC, false);
+		} else if (lexer_match(lex, '&')) {
+			lexer_append_token(lex, TOKEN_DUP_IN, false);
+		} else {
+			lexer_append_token(lex, TOKEN_REDIRECT_IN, false);
 		}
-		lexer_append_token(lex, TOKEN_WORD, string);
+	} else if (lexer_match(lex, '>')) {
+		lexer_append_token(lex, TOKEN_REDIRECT_APPEND, false);
+	} else if (lexer_match(lex, '&')) {
+		lexer_append_token(lex, TOKEN_DUP_OUT, false);
 	} else {
-		free(string);
+		lexer_append_token(lex, TOKEN_REDIRECT_OUT, false);
 	}
 }
 
 /**
  * lexer_scan_token - Scans and appends the next token from the source.
  * @lex: Pointer to the Lexer structure.
+ *
+ * A single digit right before a '<' or '>' is the io number of the
+ * redirection rather than a word.
  */
 static void lexer_scan_token(Lexer *lex)
 {
 	char c = lexer_peek(lex);
+	char next = lex->source[lex->cursor + (c != '\0')];
 
 	switch (c) {
 	case ';':
 		lexer_advance(lex);
-		lexer_append_token(lex, TOKEN_SEMICOLON, ";");
+		if (lexer_match(lex, ';'))
+			lexer_append_token(lex, TOKEN_DSEMI, false);
+		else
+			lexer_append_token(lex, TOKEN_SEMICOLON, false);
+		break;
+	case '(':
+		lexer_advance(lex);
+		lexer_append_token(lex, TOKEN_LPAREN, false);
 		break;
-	case '<':
+	case ')':
 		lexer_advance(lex);
-		lexer_append_token(lex, TOKEN_REDIRECT_IN, "<");
+		lexer_append_token(lex, TOKEN_RPAREN, false);
 		break;
+	case '<':
 	case '>':
-		lexer_advance(lex);
-		if (lexer_match(lex, '>'))
-			lexer_append_token(lex, TOKEN_REDIRECT_APPEND, ">>");
-		else
-			lexer_append_token(lex, TOKEN_REDIRECT_OUT, ">");
+		lexer_scan_redirect(lex);
 		break;
 	case '&':
 		lexer_advance(lex);
 		if (lexer_match(lex, '&'))
-			lexer_append_token(lex, TOKEN_AND, "&&");
+			lexer_append_token(lex, TOKEN_AND, false);
 		else
-			lexer_append_token(lex, TOKEN_BACKGROUND, "&");
+			lexer_append_token(lex, TOKEN_BACKGROUND, false);
 		break;
 	case '|':
 		lexer_advance(lex);
 		if (lexer_match(lex, '|'))
-			lexer_append_token(lex, TOKEN_OR, "||");
+			lexer_append_token(lex, TOKEN_OR, false);
 		else
-			lexer_append_token(lex, TOKEN_PIPE, "|");
+			lexer_append_token(lex, TOKEN_PIPE, false);
 		break;
 	case '\n':
 		lexer_advance(lex);
-		lexer_append_token(lex, TOKEN_EOL, "\n");
+		/* A compound command goes on over its newlines. */
+		if (lex->depth && lex->aliases)
+			lex->shell->pending.lines++;
+		lexer_append_token(lex, lex->depth ? TOKEN_NEWLINE : TOKEN_EOL,
+				   false);
+		/* Alias values keep theirs for the line they end up in. */
+		if (lex->heredoc && lex->aliases)
+			lexer_read_heredocs(lex);
 		break;
 	case '#':
-		lexer_advance(lex);
-		while (lexer_peek(lex) != '\n' && !lexer_at_end(lex))
-			lexer_advance(lex);
+		lex->cursor += strcspn(&lex->source[lex->cursor], "\n");
 		break;
 	default:
-		lexer_handle_word(lex);
+		if (c >= '0' && c <= '9' && (next == '<' || next == '>')) {
+			lexer_advance(lex);
+			lexer_scan_redirect(lex);
+		} else {
+			lexer_handle_word(lex);
+		}
 		break;
 	}
 }
+/**
+ * lexer_run - Tokenizes the source of a lexer.
+ * @lex: Pointer to the Lexer structure.
+ * @single_line: Whether to stop after the first end-of-line token.
+ */
+static void lexer_run(Lexer *lex, bool single_line)
+{
+	while (!lexer_at_end(lex)) {
+		lexer_skip_blanks(lex);
+		lex->start = lex->cursor;
+		lexer_scan_token(lex);
+		if (single_line && lex->last && lex->last->type == TOKEN_EOL)
+			break;
+	}
+}
+
 /**
  * tokenize - Tokenizes the input string into a linked list of tokens.
  * @shell: Pointer to the shell state.
  * @input: The input string to tokenize.
  *
+ * Aliases are not expanded, so this also lexes their values.
+ *
  * Return: Pointer to the head of the token list.
  */
 Token *tokenize(ShellState *shell, const char *input)
@@ -297,13 +726,55 @@ Token *tokenize(ShellState *shell, const char *input)
 		      .cursor = 0,
 		      .tokens = NULL,
 		      .last = NULL,
-		      .shell = shell };
+		      .heredoc = NULL,
+		      .clause = NULL,
+		      .shell = shell,
+		      .depth = 0,
+		      .command = true,
+		      .pattern = false,
+		      .body = false,
+		      .alias_next = false,
+		      .aliases = false };
 
-	while (!lexer_at_end(&lex)) {
-		lexer_skip_blanks(&lex);
-		lex.start = lex.cursor;
-		lexer_scan_token(&lex);
-	}
+	lexer_run(&lex, false);
+	return lex.tokens;
+}
+
+/**
+ * tokenize_line - Tokenizes the first line of a larger input buffer.
+ * @shell: Pointer to the shell state.
+ * @input: The input to tokenize, NUL terminated after its last line.
+ * @length: Set to the number of bytes consumed, including the newline.
+ *
+ * Words in command position that name an alias are replaced by the
+ * alias's tokens. The bodies of the line's here-documents follow it
+ * and are consumed with it, as are the lines of a compound command
+ * begun on it; shell->pending describes them.
+ *
+ * Return: Pointer to the head of the token list.
+ */
+Token *tokenize_line(ShellState *shell, const char *input, size_t *length)
+{
+	Lexer lex = { .source = input,
+		      .start = 0,
+		      .cursor = 0,
+		      .tokens = NULL,
+		      .last = NULL,
+		      .heredoc = NULL,
+		      .clause = NULL,
+		      .shell = shell,
+		      .depth = 0,
+		      .command = true,
+		      .pattern = false,
+		      .body = false,
+		      .alias_next = false,
+		      .aliases = true };
 
+	memset(&shell->pending, 0, sizeof(Pending));
+	lexer_run(&lex, true);
+	if (lex.heredoc)
+		lexer_read_heredocs(&lex);
+	shell->pending.depth = lex.depth;
+	*length = lex.cursor;
 	return lex.tokens;
 }
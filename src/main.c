@@ -1,16 +1,56 @@
 #include <shell.h>
+#include <cache.h>
+#include <source.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
-int main(int argc, char **argv)
+/**
+ * run_string - Runs the command string given with -c.
+ * @shell: Pointer to the shell state.
+ * @argc: Number of arguments after the string.
+ * @argv: The arguments after the string: $0, then the positional
+ *        parameters.
+ * @text: The command string.
+ *
+ * Nothing runs after the string, so its last command may replace the
+ * shell.
+ */
+static void run_string(ShellState *shell, int argc, char **argv, char *text)
 {
-	if (argc > 2) {
-		fprintf(stderr, "Usage: %s [filename]\n", argv[0]);
-		return 127;
+	if (argc > 0) {
+		shell->name = argv[0];
+		shell->params = argv + 1;
+		shell->param_count = argc - 1;
 	}
+	shell->exec_final = true;
+	shell_run_source(shell, text, NULL);
+}
 
-	char *name = argc == 1 ? argv[0] : argv[1];
-	bool is_interactive = (argc == 1 && isatty(STDIN_FILENO));
+int main(int argc, char **argv)
+{
+	bool use_cache = true;
+	char *command = NULL, *name;
+
+	if (argc > 1 && !strcmp(argv[1], "--no-cache")) {
+		use_cache = false;
+		argv[1] = argv[0];
+		argc--;
+		argv++;
+	}
+	name = argc > 1 ? argv[1] : argv[0];
+	if (argc > 1 && !strcmp(argv[1], "-c")) {
+		if (argc == 2) {
+			fprintf(stderr, "%s: -c requires an argument\n",
+				argv[0]);
+			return 2;
+		}
+		name = argv[0];
+		command = argv[2];
+		argc -= 2;
+		argv += 2;
+	}
+	bool is_interactive = (argc == 1 && !command && isatty(STDIN_FILENO));
 
 	ShellState *shell = shell_init(name, is_interactive);
 
@@ -19,21 +59,30 @@ int main(int argc, char **argv)
 		return 127;
 	}
 
-	if (argc == 2) {
-		FILE *stream = fopen(argv[1], "r");
-		if (!stream) {
-			fprintf(stderr, "Error: cannot open file %s\n",
-				argv[1]);
+	if (command) {
+		run_string(shell, argc - 1, argv + 1, command);
+	} else if (argc >= 2) {
+		Source source;
+
+		shell->params = argv + 2;
+		shell->param_count = argc - 2;
+
+		if (!source_open(shell, argv[1], &source)) {
 			shell_free(shell);
 			return 127;
 		}
-		shell_repl(shell, stream);
-		fclose(stream);
+		shell->exec_final = true;
+		if (use_cache)
+			cache_run_script(shell, argv[1], &source);
+		else
+			shell_run_source(shell, source.data, NULL);
+		source_close(&source);
+		cache_report(shell);
 	} else {
 		shell_repl(shell, stdin);
 	}
 
-	int exit_code = shell->fatal_error ? 2 : 0;
+	int exit_code = shell->fatal_error ? 2 : shell->status;
 	shell_free(shell);
 	return exit_code;
 }
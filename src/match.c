@@ -0,0 +1,665 @@
+#include <match.h>
+#include <utils.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MATCH_NONE UINT32_MAX
+#define MATCH_INITIAL_STATES 8
+#define MATCH_MAX_STATES 1024
+#define MATCH_SLOTS (MATCH_MAX_STATES * 2)
+
+enum { MATCH_BYTE, MATCH_ANY, MATCH_SET, MATCH_STAR, MATCH_ACCEPT };
+
+/*
+ * A position of the automaton: a byte, any byte, a bracket expression
+ * whose bytes are in sets at value, a '*', or the end of a pattern of
+ * the arm at value. The positions of a pattern follow each other, and
+ * the patterns come in the order of their arms.
+ */
+typedef struct MatchItem {
+	uint8_t kind;
+	uint8_t byte;
+	uint32_t value;
+} MatchItem;
+
+typedef struct MatchSet {
+	uint8_t bits[32];
+} MatchSet;
+
+typedef struct MatchLiteral {
+	const char *text;
+	size_t length;
+	uint32_t arm;
+} MatchLiteral;
+
+/*
+ * A deterministic state, whose set of positions is in bits at its index.
+ * next holds, for each byte, 1 + the index of the state it leads to, or
+ * 0 until a subject has taken it; arm is the first arm whose pattern
+ * ends in the state, and a dead state has no position left.
+ */
+typedef struct MatchState {
+	uint16_t next[256];
+	uint32_t arm;
+	bool dead;
+} MatchState;
+
+static const struct {
+	const char *name;
+	int (*is)(int c);
+} match_classes[] = {
+	{ "alnum", isalnum }, { "alpha", isalpha }, { "blank", isblank },
+	{ "cntrl", iscntrl }, { "digit", isdigit }, { "graph", isgraph },
+	{ "lower", islower }, { "print", isprint }, { "punct", ispunct },
+	{ "space", isspace }, { "upper", isupper }, { "xdigit", isxdigit },
+};
+
+/**
+ * match_class - Adds the bytes of a character class to a set.
+ * @set: The set.
+ * @name: Name of the class, as in [:name:].
+ * @length: Length of @name.
+ *
+ * Return: true on success, false if there is no such class.
+ */
+static bool match_class(MatchSet *set, const char *name, size_t length)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(match_classes); i++) {
+		if (strlen(match_classes[i].name) != length ||
+		    strncmp(match_classes[i].name, name, length))
+			continue;
+		for (int c = 1; c < 128; c++) {
+			if (match_classes[i].is(c))
+				set->bits[c >> 3] |= 1 << (c & 7);
+		}
+		return true;
+	}
+	return false;
+}
+
+/**
+ * match_bracket - Compiles a bracket expression.
+ * @p: The expression, past its '['.
+ * @set: Receives the bytes it matches.
+ *
+ * Ranges run over byte values, as in the C locale. Collating symbols,
+ * equivalence classes and reversed ranges are not compiled.
+ *
+ * Return: Length of the expression up to and including its ']', or 0
+ * if it is not compiled.
+ */
+static size_t match_bracket(const char *p, MatchSet *set)
+{
+	const char *start = p, *end;
+	bool negate = *p == '!' || *p == '^';
+	int low, high;
+
+	memset(set, 0, sizeof(MatchSet));
+	p += negate;
+	do {
+		if (!*p || (*p == '[' && (p[1] == '.' || p[1] == '=')))
+			return 0;
+		if (*p == '[' && p[1] == ':') {
+			end = strstr(p + 2, ":]");
+			if (!end || !match_class(set, p + 2, end - p - 2))
+				return 0;
+			p = end + 2;
+			continue;
+		}
+		if (*p == '\\' && !*++p)
+			return 0;
+		low = high = (unsigned char)*p++;
+		if (*p == '-' && p[1] && p[1] != ']') {
+			p++;
+			if (*p == '[' || (*p == '\\' && !*++p))
+				return 0;
+			high = (unsigned char)*p++;
+			if (high < low)
+				return 0;
+		}
+		for (int c = low; c <= high; c++)
+			set->bits[c >> 3] |= 1 << (c & 7);
+	} while (*p != ']');
+	if (negate) {
+		for (size_t i = 0; i < sizeof(set->bits); i++)
+			set->bits[i] = ~set->bits[i];
+	}
+	return p + 1 - start;
+}
+
+/**
+ * match_parse - Compiles a pattern into positions of the automaton.
+ * @matcher: The matcher, whose sets receive the bracket expressions.
+ * @pattern: The pattern, without a '$'.
+ * @items: Receives the positions, at most one per byte of @pattern.
+ * @count: Receives the number of positions.
+ *
+ * Return: true on success, false if the pattern is not compiled.
+ */
+static bool match_parse(CaseMatcher *matcher, const char *pattern,
+			MatchItem *items, uint32_t *count)
+{
+	MatchSet *sets = matcher->sets;
+	uint32_t n = 0;
+	size_t length;
+
+	for (const char *p = pattern; *p; n++) {
+		MatchItem *item = &items[n];
+
+		switch (*p) {
+		case '*':
+			while (*p == '*')
+				p++;
+			item->kind = MATCH_STAR;
+			break;
+		case '?':
+			p++;
+			item->kind = MATCH_ANY;
+			break;
+		case '[':
+			item->kind = MATCH_SET;
+			item->value = matcher->set_count;
+			length = match_bracket(p + 1, &sets[item->value]);
+			if (!length)
+				return false;
+			p += 1 + length;
+			matcher->set_count++;
+			break;
+		case '\\':
+			if (!*++p)
+				return false;
+			/* fall through */
+		default:
+			item->kind = MATCH_BYTE;
+			item->byte = *p++;
+			break;
+		}
+	}
+	*count = n;
+	return true;
+}
+
+/**
+ * match_hash - Computes the 32-bit FNV-1a hash of a string.
+ * @text: The bytes to hash.
+ * @length: Number of bytes.
+ *
+ * Return: The hash value.
+ */
+static uint32_t match_hash(const char *text, size_t length)
+{
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char)text[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * match_index - Builds the hash table of the literal patterns.
+ * @matcher: The matcher.
+ *
+ * A literal repeated keeps the first arm it appears in.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool match_index(CaseMatcher *matcher)
+{
+	uint32_t count = matcher->literal_count, capacity = 1, at, i, j;
+	const MatchLiteral *literal, *other;
+
+	if (!count)
+		return true;
+	while (capacity < count * 2)
+		capacity *= 2;
+	matcher->buckets = calloc(capacity, sizeof(uint32_t));
+	if (!matcher->buckets)
+		return false;
+	matcher->bucket_mask = capacity - 1;
+	for (i = 0; i < count; i++) {
+		literal = &matcher->literals[i];
+		at = match_hash(literal->text, literal->length) &
+		     matcher->bucket_mask;
+		while ((j = matcher->buckets[at])) {
+			other = &matcher->literals[j - 1];
+			if (other->length == literal->length &&
+			    !memcmp(other->text, literal->text, other->length))
+				break;
+			at = (at + 1) & matcher->bucket_mask;
+		}
+		if (!j)
+			matcher->buckets[at] = i + 1;
+	}
+	return true;
+}
+
+/**
+ * match_literal - Looks a subject up among the literal patterns.
+ * @matcher: The matcher.
+ * @subject: The subject.
+ * @length: Length of @subject.
+ *
+ * Return: The arm of the literal equal to @subject, or MATCH_NONE.
+ */
+static uint32_t match_literal(const CaseMatcher *matcher, const char *subject,
+			      size_t length)
+{
+	const MatchLiteral *literal;
+	uint32_t at, i;
+
+	if (!matcher->buckets)
+		return MATCH_NONE;
+	at = match_hash(subject, length) & matcher->bucket_mask;
+	while ((i = matcher->buckets[at])) {
+		literal = &matcher->literals[i - 1];
+		if (literal->length == length &&
+		    !memcmp(literal->text, subject, length))
+			return literal->arm;
+		at = (at + 1) & matcher->bucket_mask;
+	}
+	return MATCH_NONE;
+}
+
+/**
+ * match_words - Tells the size of a set of positions.
+ * @matcher: The matcher.
+ *
+ * Return: Number of 64-bit words in a set.
+ */
+static uint32_t match_words(const CaseMatcher *matcher)
+{
+	return (matcher->item_count + 63) / 64;
+}
+
+/**
+ * match_reach - Adds a position to a set, with the one past it if it is
+ *               a '*', which may match nothing.
+ * @matcher: The matcher.
+ * @set: The set.
+ * @at: The position.
+ */
+static void match_reach(const CaseMatcher *matcher, uint64_t *set,
+			uint32_t at)
+{
+	set[at / 64] |= 1ull << (at % 64);
+	if (matcher->items[at].kind == MATCH_STAR)
+		set[(at + 1) / 64] |= 1ull << ((at + 1) % 64);
+}
+
+/**
+ * match_grow - Makes room for the set of one more state.
+ * @matcher: The matcher.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool match_grow(CaseMatcher *matcher)
+{
+	size_t words = match_words(matcher);
+	uint32_t capacity = matcher->state_capacity * 2;
+	MatchState *states;
+	uint64_t *bits;
+
+	if (matcher->state_count < matcher->state_capacity)
+		return true;
+	if (!capacity)
+		capacity = MATCH_INITIAL_STATES;
+	if (capacity > MATCH_MAX_STATES)
+		capacity = MATCH_MAX_STATES + 1;
+	states = realloc(matcher->states, capacity * sizeof(MatchState));
+	if (!states)
+		return false;
+	matcher->states = states;
+	bits = realloc(matcher->bits, capacity * words * sizeof(uint64_t));
+	if (!bits)
+		return false;
+	matcher->bits = bits;
+	matcher->state_capacity = capacity;
+	return true;
+}
+
+/**
+ * match_lookup - Finds the state of a set of positions.
+ * @matcher: The matcher.
+ * @set: The set.
+ * @slot: Receives the slot of the hash table where the state is, or
+ *        would go.
+ *
+ * Return: Index of the state, or MATCH_NONE if there is none yet.
+ */
+static uint32_t match_lookup(const CaseMatcher *matcher, const uint64_t *set,
+			     uint32_t *slot)
+{
+	size_t words = match_words(matcher);
+	uint64_t hash = 14695981039346656037ull;
+	uint32_t at, i;
+
+	for (size_t w = 0; w < words; w++) {
+		hash ^= set[w];
+		hash *= 1099511628211ull;
+	}
+	at = (hash ^ hash >> 32) & (MATCH_SLOTS - 1);
+	while ((i = matcher->slots[at])) {
+		if (!memcmp(matcher->bits + (i - 1) * words, set,
+			    words * sizeof(uint64_t)))
+			return i - 1;
+		at = (at + 1) & (MATCH_SLOTS - 1);
+	}
+	*slot = at;
+	return MATCH_NONE;
+}
+
+/**
+ * match_add - Adds the state whose set was built past the last one.
+ * @matcher: The matcher.
+ * @slot: Its slot in the hash table, from match_lookup().
+ *
+ * Return: Index of the new state.
+ */
+static uint32_t match_add(CaseMatcher *matcher, uint32_t slot)
+{
+	size_t words = match_words(matcher);
+	const uint64_t *set = matcher->bits + matcher->state_count * words;
+	MatchState *state = &matcher->states[matcher->state_count];
+	uint32_t at;
+
+	memset(state->next, 0, sizeof(state->next));
+	state->arm = MATCH_NONE;
+	state->dead = true;
+	for (size_t w = 0; w < words; w++) {
+		for (uint64_t b = set[w]; b; b &= b - 1) {
+			state->dead = false;
+			at = w * 64 + __builtin_ctzll(b);
+			if (matcher->items[at].kind == MATCH_ACCEPT) {
+				state->arm = matcher->items[at].value;
+				goto found;
+			}
+		}
+	}
+found:
+	matcher->slots[slot] = matcher->state_count + 1;
+	return matcher->state_count++;
+}
+
+/**
+ * match_flush - Drops every state but the start one.
+ * @matcher: The matcher, full, with a set built past its last state.
+ *
+ * The set built is moved past the start state.
+ */
+static void match_flush(CaseMatcher *matcher)
+{
+	size_t words = match_words(matcher);
+	uint32_t slot;
+
+	memmove(matcher->bits + words,
+		matcher->bits + matcher->state_count * words,
+		words * sizeof(uint64_t));
+	memset(matcher->slots, 0, MATCH_SLOTS * sizeof(uint32_t));
+	memset(matcher->states[0].next, 0, sizeof(matcher->states[0].next));
+	matcher->state_count = 0;
+	match_lookup(matcher, matcher->bits, &slot);
+	match_add(matcher, slot);
+}
+
+/**
+ * match_step - Builds the state a byte leads to from another.
+ * @matcher: The matcher.
+ * @from: Index of the state.
+ * @c: The byte.
+ *
+ * Once MATCH_MAX_STATES are built they are all dropped but the start
+ * state, so subjects that keep reaching new states cost a bounded
+ * amount of memory.
+ *
+ * Return: Index of the state reached, or MATCH_NONE on allocation
+ * failure.
+ */
+static uint32_t match_step(CaseMatcher *matcher, uint32_t from,
+			   unsigned char c)
+{
+	size_t words = match_words(matcher);
+	const uint64_t *bits;
+	const MatchItem *item;
+	uint64_t *set;
+	uint32_t at, to, slot;
+
+	if (!match_grow(matcher))
+		return MATCH_NONE;
+	bits = matcher->bits + from * words;
+	set = matcher->bits + matcher->state_count * words;
+	memset(set, 0, words * sizeof(uint64_t));
+	for (size_t w = 0; w < words; w++) {
+		for (uint64_t b = bits[w]; b; b &= b - 1) {
+			at = w * 64 + __builtin_ctzll(b);
+			item = &matcher->items[at];
+			if (item->kind == MATCH_STAR ||
+			    (item->kind == MATCH_BYTE && item->byte == c) ||
+			    item->kind == MATCH_ANY ||
+			    (item->kind == MATCH_SET &&
+			     matcher->sets[item->value].bits[c >> 3] &
+				     1 << (c & 7)))
+				match_reach(matcher, set,
+					    at + (item->kind != MATCH_STAR));
+		}
+	}
+	to = match_lookup(matcher, set, &slot);
+	if (to == MATCH_NONE && matcher->state_count == MATCH_MAX_STATES) {
+		match_flush(matcher);
+		to = match_lookup(matcher, matcher->bits + words, &slot);
+		return to == MATCH_NONE ? match_add(matcher, slot) : to;
+	}
+	if (to == MATCH_NONE)
+		to = match_add(matcher, slot);
+	matcher->states[from].next[c] = to + 1;
+	return to;
+}
+
+/**
+ * match_start - Builds the start state of the automaton.
+ * @matcher: The matcher, its positions compiled.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool match_start(CaseMatcher *matcher)
+{
+	uint32_t slot;
+
+	matcher->slots = calloc(MATCH_SLOTS, sizeof(uint32_t));
+	if (!matcher->slots || !match_grow(matcher))
+		return false;
+	memset(matcher->bits, 0, match_words(matcher) * sizeof(uint64_t));
+	for (uint32_t i = 0; i < matcher->item_count; i++) {
+		if (!i || matcher->items[i - 1].kind == MATCH_ACCEPT)
+			match_reach(matcher, matcher->bits, i);
+	}
+	match_lookup(matcher, matcher->bits, &slot);
+	match_add(matcher, slot);
+	return true;
+}
+
+/**
+ * match_pattern - Adds a pattern to a matcher.
+ * @matcher: The matcher, its arrays allocated for all the patterns.
+ * @word: The pattern.
+ * @arm: Index of the arm it belongs to.
+ * @index: Index of @word in the syntax tree's words.
+ * @used: Number of bytes of the matcher's text used so far, updated.
+ *
+ * A pattern that is not compiled is left pending.
+ */
+static void match_pattern(CaseMatcher *matcher, const char *word,
+			  uint32_t arm, uint32_t index, size_t *used)
+{
+	MatchItem *items = matcher->items + matcher->item_count;
+	MatchPending *pending;
+	MatchLiteral *literal;
+	uint32_t n, k;
+
+	if (strchr(word, '$') || !match_parse(matcher, word, items, &n)) {
+		pending = &matcher->pending[matcher->pending_count++];
+		pending->arm = arm;
+		pending->word = index;
+		return;
+	}
+	for (k = 0; k < n && items[k].kind == MATCH_BYTE; k++)
+		matcher->text[*used + k] = items[k].byte;
+	if (k == n) {
+		matcher->text[*used + n] = '\0';
+		literal = &matcher->literals[matcher->literal_count++];
+		literal->text = matcher->text + *used;
+		literal->length = n;
+		literal->arm = arm;
+		*used += n + 1;
+		return;
+	}
+	items[n].kind = MATCH_ACCEPT;
+	items[n].value = arm;
+	matcher->item_count += n + 1;
+	if (matcher->first_glob == MATCH_NONE)
+		matcher->first_glob = arm;
+}
+
+/**
+ * match_compile - Compiles the patterns of a case command.
+ * @ast: The syntax tree holding the command.
+ * @node: The CMD_CASE node.
+ *
+ * Return: The matcher, or NULL on allocation failure.
+ */
+CaseMatcher *match_compile(const Ast *ast, const Node *node)
+{
+	const NodeIndex *arms = ast->refs + node->as.cases.arms;
+	CaseMatcher *matcher = calloc(1, sizeof(CaseMatcher));
+	size_t size = 0, patterns = 0, brackets = 0, used = 0;
+	const Node *arm;
+	const char *word;
+
+	if (!matcher)
+		return NULL;
+	matcher->node = node;
+	matcher->arm_count = node->as.cases.count;
+	matcher->first_glob = MATCH_NONE;
+	for (uint32_t i = 0; i < node->as.cases.count; i++) {
+		arm = &ast->nodes[arms[i]];
+		for (uint32_t j = 0; j < arm->as.arm.count; j++) {
+			word = ast->words[arm->as.arm.patterns + j];
+			size += strlen(word) + 1;
+			for (const char *p = word; (p = strchr(p, '[')); p++)
+				brackets++;
+			patterns++;
+		}
+	}
+	if (!patterns)
+		return matcher;
+	matcher->items = malloc(size * sizeof(MatchItem));
+	matcher->text = malloc(size);
+	matcher->literals = malloc(patterns * sizeof(MatchLiteral));
+	matcher->pending = malloc(patterns * sizeof(MatchPending));
+	matcher->sets = malloc((brackets + 1) * sizeof(MatchSet));
+	if (!matcher->items || !matcher->text || !matcher->literals ||
+	    !matcher->pending || !matcher->sets)
+		goto fail;
+
+	for (uint32_t i = 0; i < node->as.cases.count; i++) {
+		arm = &ast->nodes[arms[i]];
+		for (uint32_t j = 0; j < arm->as.arm.count; j++)
+			match_pattern(matcher,
+				      ast->words[arm->as.arm.patterns + j], i,
+				      arm->as.arm.patterns + j, &used);
+	}
+	if (match_index(matcher) &&
+	    (!matcher->item_count || match_start(matcher)))
+		return matcher;
+fail:
+	match_free(matcher);
+	return NULL;
+}
+
+/**
+ * match_find - Gets the matcher of a case command, compiling it the
+ *              first time.
+ * @ast: The syntax tree holding the command.
+ * @node: The CMD_CASE node.
+ *
+ * The matcher is kept in @ast under the node's slot, for as long as the
+ * node lasts.
+ *
+ * Return: The matcher, or NULL if the node has no slot or on allocation
+ * failure.
+ */
+CaseMatcher *match_find(const Ast *ast, const Node *node)
+{
+	CaseMatcher **matcher;
+
+	if (node->slot >= ast->case_count)
+		return NULL;
+	matcher = &ast->matchers[node->slot];
+	if (*matcher && (*matcher)->node == node)
+		return *matcher;
+	match_free(*matcher);
+	*matcher = match_compile(ast, node);
+	return *matcher;
+}
+
+/**
+ * match_first - Finds the first arm a subject matches a compiled
+ *               pattern of.
+ * @matcher: The matcher.
+ * @subject: The subject.
+ * @arm: Receives the index of the arm, or the number of arms if none
+ *       matches.
+ *
+ * The automaton is only run when a pattern before the literal found, if
+ * any, is not a literal.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+bool match_first(CaseMatcher *matcher, const char *subject, uint32_t *arm)
+{
+	uint32_t best = match_literal(matcher, subject, strlen(subject));
+	uint32_t state = 0, next;
+	const MatchState *states;
+
+	if (best == MATCH_NONE)
+		best = matcher->arm_count;
+	if (matcher->first_glob < best) {
+		for (const unsigned char *p = (const unsigned char *)subject;
+		     *p; p++) {
+			states = matcher->states;
+			if (states[state].dead)
+				break;
+			next = states[state].next[*p];
+			state = next ? next - 1u :
+				       match_step(matcher, state, *p);
+			if (state == MATCH_NONE)
+				return false;
+		}
+		if (matcher->states[state].arm < best)
+			best = matcher->states[state].arm;
+	}
+	*arm = best;
+	return true;
+}
+
+/**
+ * match_free - Frees a matcher.
+ * @matcher: The matcher, or NULL.
+ */
+void match_free(CaseMatcher *matcher)
+{
+	if (!matcher)
+		return;
+	free(matcher->literals);
+	free(matcher->buckets);
+	free(matcher->text);
+	free(matcher->items);
+	free(matcher->sets);
+	free(matcher->states);
+	free(matcher->bits);
+	free(matcher->slots);
+	free(matcher->pending);
+	free(matcher);
+}
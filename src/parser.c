@@ -1,8 +1,11 @@
 #include <token.h>
 #include <parser.h>
+#include <arena.h>
 #include <stdarg.h>
 #include <stdio.h>
-#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vars.h>
 
 /**
  * parser_peek - Returns the current token.
@@ -71,251 +74,997 @@ static bool parser_match(Parser *p, int n, ...)
 	return false;
 }
 /**
- * parse_simple_command - Parses a simple command.
+ * parser_alloc - Allocates scratch memory from the shell's arena.
+ * @p: Pointer to the Parser structure.
+ * @size: Number of bytes to allocate.
+ *
+ * Return: Pointer to the memory, or NULL on failure.
+ */
+static void *parser_alloc(Parser *p, size_t size)
+{
+	void *ptr = arena_alloc(p->shell->arena, size);
+	if (!ptr) {
+		fprintf(stderr, "Error: malloc failed\n");
+		p->shell->fatal_error = true;
+	}
+	return ptr;
+}
+
+/**
+ * parser_failed - Tells whether parsing has failed.
  * @p: Pointer to the Parser structure.
+ * Return: true after a syntax error or allocation failure.
+ */
+static bool parser_failed(Parser *p)
+{
+	return p->shell->had_error || p->shell->fatal_error;
+}
+
+/**
+ * parser_unexpected - Reports a token the grammar does not allow there.
+ * @p: Pointer to the Parser structure.
+ * @token: The token.
+ * @expecting: What was expected instead, or NULL.
+ *
+ * Newlines only end a line outside compound commands, so running into
+ * the end of the line inside one is running into the end of the input.
+ * Words are not quoted back, as in other shells.
  *
- * Return: Pointer to the parsed Command structure, or NULL on failure.
+ * Return: AST_NONE.
  */
-static Command *parse_simple_command(Parser *p)
+static NodeIndex parser_unexpected(Parser *p, const Token *token,
+				   const char *expecting)
 {
-	SimpleCommand *simple = malloc(sizeof(SimpleCommand));
-	int envc = 0, capacity = 2;
+	p->shell->had_error = true;
+	fprintf(stderr, "%s: %d: Syntax error: ", p->shell->name,
+		p->shell->line_number);
+	if (token->type == TOKEN_EOL)
+		fprintf(stderr, "end of file unexpected");
+	else if (token->type == TOKEN_NEWLINE)
+		fprintf(stderr, "newline unexpected");
+	else if (token->type == TOKEN_WORD ||
+		 token->type == TOKEN_ASSIGNMENT_WORD)
+		fprintf(stderr, "word unexpected");
+	else
+		fprintf(stderr, "\"%.*s\" unexpected", (int)token->length,
+			token->text);
+	if (expecting)
+		fprintf(stderr, " (expecting \"%s\")", expecting);
+	fputc('\n', stderr);
+	return AST_NONE;
+}
 
-	if (!simple) {
+/**
+ * parser_expect - Consumes a token the grammar requires.
+ * @p: Pointer to the Parser structure.
+ * @type: The type of the token.
+ * @text: The token as written, for the error message.
+ *
+ * Return: true if the current token had @type, false after reporting it.
+ */
+static bool parser_expect(Parser *p, TokenType type, const char *text)
+{
+	if (parser_match(p, 1, type))
+		return true;
+	parser_unexpected(p, parser_peek(p), text);
+	return false;
+}
+
+/**
+ * parser_skip_newlines - Skips the newlines separating the commands of a
+ *                        compound command.
+ * @p: Pointer to the Parser structure.
+ */
+static void parser_skip_newlines(Parser *p)
+{
+	while (parser_match(p, 1, TOKEN_NEWLINE))
+		;
+}
+
+/**
+ * parser_collect - Appends a node to a growing array of nodes.
+ * @p: Pointer to the Parser structure.
+ * @items: The array, in the shell's arena, or NULL to start one.
+ * @count: Number of nodes in the array, incremented.
+ * @capacity: Allocated length of the array.
+ * @item: The node to append.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool parser_collect(Parser *p, NodeIndex **items, uint32_t *count,
+			   uint32_t *capacity, NodeIndex item)
+{
+	NodeIndex *grown;
+
+	if (!*items) {
+		*items = parser_alloc(p, sizeof(NodeIndex) * 4);
+		if (!*items)
+			return false;
+		*capacity = 4;
+	} else if (*count == *capacity) {
+		grown = arena_grow(p->shell->arena, *items,
+				   sizeof(NodeIndex) * *capacity,
+				   sizeof(NodeIndex) * *capacity * 2);
+		if (!grown) {
+			fprintf(stderr, "Error: malloc failed\n");
+			p->shell->fatal_error = true;
+			return false;
+		}
+		*items = grown;
+		*capacity *= 2;
+	}
+	(*items)[(*count)++] = item;
+	return true;
+}
+
+/**
+ * parser_add_refs - Stores an array of nodes in the reference pool.
+ * @p: Pointer to the Parser structure.
+ * @items: The nodes.
+ * @count: Number of nodes.
+ *
+ * Return: Index of the first reference, or AST_NONE on failure.
+ */
+static uint32_t parser_add_refs(Parser *p, const NodeIndex *items,
+				uint32_t count)
+{
+	uint32_t index = ast_add_refs(p->ast, items, count);
+
+	if (index == AST_NONE) {
+		fprintf(stderr, "Error: malloc failed\n");
 		p->shell->fatal_error = true;
-		return NULL;
 	}
+	return index;
+}
 
-	simple->argc = 0;
-	simple->argv = malloc(sizeof(char *) * capacity);
-	simple->envp = malloc(sizeof(char *) * capacity);
-	simple->input_file = NULL;
-	simple->output_file = NULL;
-	simple->append_output = false;
+/**
+ * parser_push - Appends the text of a word token to the word pool.
+ * @p: Pointer to the Parser structure.
+ * @token: The word token to append, or NULL to end a vector.
+ * @node: The command the word belongs to; it is marked NODE_EXPAND when
+ *        the word has to be expanded before the command runs.
+ *
+ * Return: Index of the word in the pool, or AST_NONE on failure.
+ */
+static uint32_t parser_push(Parser *p, Token *token, Node *node)
+{
+	char *word = NULL;
+	uint32_t index;
 
-	if (!simple->argv || !simple->envp) {
+	if (token) {
+		word = token_lexeme(p->shell, token);
+		if (!word)
+			return AST_NONE;
+		if (token->expand)
+			node->flags |= NODE_EXPAND;
+	}
+	index = ast_add_word(p->ast, word);
+	if (index == AST_NONE) {
+		fprintf(stderr, "Error: malloc failed\n");
 		p->shell->fatal_error = true;
-		free(simple->argv);
-		free(simple->envp);
-		free(simple);
-		return NULL;
 	}
+	return index;
+}
 
-	while (parser_match(p, 1, TOKEN_ASSIGNMENT_WORD)) {
-		if (envc + 1 >= capacity) {
-			capacity *= 2;
-			char **new_envp = realloc(simple->envp,
-						  capacity * sizeof(char *));
-			if (!new_envp) {
-				p->shell->fatal_error = true;
-				free(simple->envp);
-				free(simple->argv);
-				free(simple);
-				return NULL;
-			}
-			simple->envp = new_envp;
+/**
+ * parser_push_pattern - Appends a case pattern to the word pool.
+ * @p: Pointer to the Parser structure.
+ * @token: The pattern's word token.
+ * @node: The arm the pattern belongs to.
+ *
+ * A pattern with a '$' is stored as written and expanded when the case
+ * command runs; any other has its quoted pattern characters escaped.
+ *
+ * Return: Index of the pattern in the pool, or AST_NONE on failure.
+ */
+static uint32_t parser_push_pattern(Parser *p, Token *token, Node *node)
+{
+	char *pattern;
+	uint32_t index;
+
+	if (token->expand)
+		return parser_push(p, token, node);
+	pattern = token_pattern(p->shell, token);
+	if (!pattern)
+		return AST_NONE;
+	index = ast_add_word(p->ast, pattern);
+	if (index == AST_NONE) {
+		fprintf(stderr, "Error: malloc failed\n");
+		p->shell->fatal_error = true;
+	}
+	return index;
+}
+
+/**
+ * parser_add_node - Appends a node to the syntax tree.
+ * @p: Pointer to the Parser structure.
+ * @node: The node to append.
+ *
+ * Return: Index of the new node, or AST_NONE on failure.
+ */
+static NodeIndex parser_add_node(Parser *p, const Node *node)
+{
+	NodeIndex index = ast_add_node(p->ast, node);
+	if (index == AST_NONE) {
+		fprintf(stderr, "Error: malloc failed\n");
+		p->shell->fatal_error = true;
+	}
+	return index;
+}
+
+/**
+ * parser_new_binary - Creates a command joining two commands.
+ * @p: Pointer to the Parser structure.
+ * @type: The type of the new command.
+ * @left: The left operand.
+ * @right: The right operand.
+ *
+ * Return: Index of the new node, or AST_NONE on failure.
+ */
+static NodeIndex parser_new_binary(Parser *p, CommandType type,
+				   NodeIndex left, NodeIndex right)
+{
+	Node parent = { .type = type,
+			.as.binary = { .left = left, .right = right } };
+
+	return parser_add_node(p, &parent);
+}
+
+/**
+ * parser_is_redirect - Checks if a token is a redirection operator.
+ * @token: The token.
+ * Return: true if @token starts a redirection, false otherwise.
+ */
+static bool parser_is_redirect(const Token *token)
+{
+	switch (token->type) {
+	case TOKEN_REDIRECT_IN:
+	case TOKEN_REDIRECT_OUT:
+	case TOKEN_REDIRECT_APPEND:
+	case TOKEN_HEREDOC:
+	case TOKEN_DUP_IN:
+	case TOKEN_DUP_OUT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * parse_redirect - Consumes a redirection operator and its target.
+ * @p: Pointer to the Parser structure, at the operator.
+ *
+ * Return: true on success, false after reporting a missing target.
+ */
+static bool parse_redirect(Parser *p)
+{
+	Token *op = parser_advance(p);
+
+	p->prev = op;
+	if (!parser_match(p, 1, TOKEN_WORD)) {
+		p->shell->had_error = true;
+		fprintf(stderr,
+			"%s: %d: Syntax error: "
+			"expected filename after '%.*s'\n",
+			p->shell->name, p->shell->line_number,
+			(int)op->length, op->text);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * parse_redirects - Stores the redirections of a simple command.
+ * @p: Pointer to the Parser structure.
+ * @first: The first token after the assignments.
+ * @node: The command; its redirections and their targets are set.
+ *
+ * The redirections go to the redirection pool in order, and their
+ * targets to a NULL terminated vector of the word pool. A redirection
+ * applies to its io number, or else to standard input for '<'
+ * operators and standard output for '>' ones. The target of a
+ * here-document is its body, which the lexer put in place of the
+ * delimiter.
+ *
+ * Return: true on success, false on failure.
+ */
+static bool parse_redirects(Parser *p, Token *first, Node *node)
+{
+	Redirect redirect;
+	const char *op;
+
+	node->as.simple.redirects = p->ast->redirect_count;
+	node->as.simple.targets = p->ast->word_count;
+	for (Token *token = first; token != p->current; token = token->next) {
+		redirect.flags = 0;
+		switch (token->type) {
+		case TOKEN_REDIRECT_IN:
+			redirect.type = REDIRECT_IN;
+			break;
+		case TOKEN_HEREDOC:
+			redirect.type = REDIRECT_HEREDOC;
+			if (token->next->expand)
+				redirect.flags = REDIRECT_EXPAND;
+			break;
+		case TOKEN_REDIRECT_OUT:
+			redirect.type = REDIRECT_OUT;
+			break;
+		case TOKEN_REDIRECT_APPEND:
+			redirect.type = REDIRECT_APPEND;
+			break;
+		case TOKEN_DUP_IN:
+		case TOKEN_DUP_OUT:
+			redirect.type = REDIRECT_DUP;
+			break;
+		default:
+			continue;
+		}
+		op = token->text;
+		if (*op >= '0' && *op <= '9')
+			redirect.fd = *op - '0';
+		else
+			redirect.fd = *op == '<' ? STDIN_FILENO : STDOUT_FILENO;
+		token = token->next;
+		if (ast_add_redirect(p->ast, &redirect) == AST_NONE) {
+			fprintf(stderr, "Error: malloc failed\n");
+			p->shell->fatal_error = true;
+			return false;
 		}
-		simple->envp[envc++] = parser_previous(p)->lexeme;
+		if (parser_push(p, token, node) == AST_NONE)
+			return false;
 	}
-	simple->envp[envc] = NULL;
+	return parser_push(p, NULL, node) != AST_NONE;
+}
+
+/**
+ * parse_simple_command - Parses a simple command.
+ * @p: Pointer to the Parser structure.
+ *
+ * The assignments and the arguments are stored as two NULL terminated
+ * vectors in the word pool, followed by the redirection targets. Words
+ * with a '$' are stored as written, quotes included, and expanded when
+ * the command runs.
+ *
+ * Return: Index of the parsed node, or AST_NONE on failure.
+ */
+static NodeIndex parse_simple_command(Parser *p)
+{
+	Node node = { .type = CMD_SIMPLE };
+	Token *first;
 
-	capacity = 2;
+	node.as.simple.envp = p->ast->word_count;
+	while (parser_match(p, 1, TOKEN_ASSIGNMENT_WORD)) {
+		if (parser_push(p, parser_previous(p), &node) == AST_NONE)
+			return AST_NONE;
+		node.as.simple.envc++;
+	}
+	if (parser_push(p, NULL, &node) == AST_NONE)
+		return AST_NONE;
+
+	node.as.simple.argv = p->ast->word_count;
+	first = parser_peek(p);
 	if (parser_match(p, 1, TOKEN_WORD)) {
-		if (simple->argc + 1 >= capacity) {
-			capacity *= 2;
-			char **new_argv = realloc(simple->argv,
-						  sizeof(char *) * capacity);
-			if (!new_argv) {
-				p->shell->fatal_error = true;
-				free(simple->argv);
-				free(simple->envp);
-				free(simple);
-				return NULL;
-			}
-			simple->argv = new_argv;
-		}
-		simple->argv[simple->argc++] = parser_previous(p)->lexeme;
-		simple->argv[simple->argc] = NULL;
-	} else if (parser_is_eol(p)) {
-		free(simple->argv);
-		free(simple->envp);
-		free(simple);
-		return NULL;
-	} else if ((parser_peek(p)->type == TOKEN_AND ||
-		    parser_peek(p)->type == TOKEN_OR ||
-		    parser_peek(p)->type == TOKEN_PIPE) &&
-		   parser_previous(p) != NULL &&
-		   parser_previous(p)->type == TOKEN_ASSIGNMENT_WORD) {
-	} else {
-		p->shell->had_error = true;
-		printf("%s: %d: Syntax error: \"%s\" unexpected\n",
-		       p->shell->name, p->shell->line_number,
-		       (parser_previous(p) ? parser_previous(p) :
-					     parser_peek(p))
-			       ->lexeme);
-		free(simple->argv);
-		free(simple->envp);
-		free(simple);
-		return NULL;
+		if (parser_push(p, parser_previous(p), &node) == AST_NONE)
+			return AST_NONE;
+		node.as.simple.argc++;
+	} else if (parser_is_redirect(parser_peek(p))) {
+	} else if (parser_is_eol(p) && !node.as.simple.envc) {
+		return AST_NONE;
+	} else if (!node.as.simple.envc) {
+		return parser_unexpected(p, parser_peek(p), NULL);
 	}
 
 	while (true) {
 		if (parser_match(p, 2, TOKEN_WORD, TOKEN_ASSIGNMENT_WORD)) {
-			if (simple->argc + 1 >= capacity) {
-				capacity *= 2;
-				char **new_argv =
-					realloc(simple->argv,
-						sizeof(char *) * capacity);
-				if (!new_argv) {
-					p->shell->fatal_error = true;
-					free(simple->argv);
-					free(simple->envp);
-					free(simple);
-					return NULL;
-				}
-				simple->argv = new_argv;
-			}
-			simple->argv[simple->argc++] =
-				parser_previous(p)->lexeme;
-			simple->argv[simple->argc] = NULL;
-
-		} else if (parser_match(p, 3, TOKEN_REDIRECT_IN,
-					TOKEN_REDIRECT_OUT,
-					TOKEN_REDIRECT_APPEND)) {
-			Token *op = parser_previous(p);
-
-			if (!parser_match(p, 1, TOKEN_WORD)) {
-				fprintf(stderr,
-					"%s: %d: Syntax error: "
-					"expected filename after '%s'\n",
-					p->shell->name, p->shell->line_number,
-					op->lexeme);
-				free(simple->argv);
-				free(simple->envp);
-				free(simple);
-				return NULL;
-			}
-
-			Token *filename = parser_previous(p);
-
-			switch (op->type) {
-			case TOKEN_REDIRECT_IN:
-				simple->input_file = filename->lexeme;
-				break;
-			case TOKEN_REDIRECT_OUT:
-				simple->output_file = filename->lexeme;
-				simple->append_output = false;
-				break;
-			case TOKEN_REDIRECT_APPEND:
-				simple->output_file = filename->lexeme;
-				simple->append_output = true;
-				break;
-			default:
-				break;
-			}
+			if (parser_push(p, parser_previous(p), &node) ==
+			    AST_NONE)
+				return AST_NONE;
+			node.as.simple.argc++;
+		} else if (parser_is_redirect(parser_peek(p))) {
+			if (!parse_redirect(p))
+				return AST_NONE;
 		} else {
 			break;
 		}
 	}
+	if (parser_push(p, NULL, &node) == AST_NONE ||
+	    !parse_redirects(p, first, &node))
+		return AST_NONE;
+	return parser_add_node(p, &node);
+}
+/**
+ * parser_is_word - Checks if a token is a given unquoted word.
+ * @token: The token.
+ * @word: The word.
+ * Return: true if @token is @word, false otherwise.
+ */
+static bool parser_is_word(const Token *token, const char *word)
+{
+	return token->type == TOKEN_WORD && !token->quoted &&
+	       token->length == strlen(word) &&
+	       !strncmp(token->text, word, token->length);
+}
 
-	Command *cmd = malloc(sizeof(Command));
-	if (!cmd) {
-		p->shell->fatal_error = true;
-		free(simple->argv);
-		free(simple->envp);
-		free(simple);
-		return NULL;
+/**
+ * parser_starts_compound - Checks if a token begins a compound command.
+ * @token: The token.
+ * Return: true if @token is if, while, until, for, case or {.
+ */
+static bool parser_starts_compound(const Token *token)
+{
+	switch (token->type) {
+	case TOKEN_LBRACE:
+	case TOKEN_IF:
+	case TOKEN_WHILE:
+	case TOKEN_UNTIL:
+	case TOKEN_FOR:
+	case TOKEN_CASE:
+		return true;
+	default:
+		return false;
 	}
+}
 
-	cmd->type = CMD_SIMPLE;
-	cmd->as.command = *simple;
-	cmd->is_background = false;
-	free(simple);
-	return cmd;
+/**
+ * parser_starts_command - Checks if a token can begin a command.
+ * @token: The token.
+ * Return: true if @token is a word, an assignment or begins a compound
+ * command, false otherwise.
+ */
+static bool parser_starts_command(const Token *token)
+{
+	return token->type == TOKEN_WORD ||
+	       token->type == TOKEN_ASSIGNMENT_WORD ||
+	       parser_starts_compound(token);
 }
+
+/**
+ * parser_ends_list - Checks if a token ends the commands of a part of a
+ *                    compound command.
+ * @token: The token.
+ * Return: true if @token closes the part, false otherwise.
+ */
+static bool parser_ends_list(const Token *token)
+{
+	switch (token->type) {
+	case TOKEN_THEN:
+	case TOKEN_ELSE:
+	case TOKEN_ELIF:
+	case TOKEN_FI:
+	case TOKEN_DO:
+	case TOKEN_DONE:
+	case TOKEN_ESAC:
+	case TOKEN_RBRACE:
+	case TOKEN_DSEMI:
+	case TOKEN_EOL:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static NodeIndex parse_logical_list(Parser *p);
+
+/**
+ * parse_compound_list - Parses the commands of a part of a compound
+ *                       command.
+ * @p: Pointer to the Parser structure.
+ *
+ * The commands are separated by ';', '&' or newlines, and the list ends
+ * before the reserved word closing the part. More than one command make
+ * a CMD_LIST.
+ *
+ * Return: Index of the parsed node, or AST_NONE on failure, and without
+ * reporting anything when the input ends first, as the caller knows
+ * what it expected.
+ */
+static NodeIndex parse_compound_list(Parser *p)
+{
+	Node list = { .type = CMD_LIST };
+	NodeIndex *items = NULL, item;
+	uint32_t count = 0, capacity = 0;
+
+	parser_skip_newlines(p);
+	if (parser_is_eol(p))
+		return AST_NONE;
+	for (;;) {
+		if (!parser_starts_command(parser_peek(p)) &&
+		    !parser_is_redirect(parser_peek(p)))
+			return parser_unexpected(p, parser_peek(p), NULL);
+		item = parse_logical_list(p);
+		if (item == AST_NONE ||
+		    !parser_collect(p, &items, &count, &capacity, item))
+			return AST_NONE;
+		if (parser_match(p, 1, TOKEN_BACKGROUND))
+			p->ast->nodes[item].flags |= NODE_BACKGROUND;
+		else if (!parser_match(p, 2, TOKEN_SEMICOLON, TOKEN_NEWLINE))
+			break;
+		parser_skip_newlines(p);
+		if (parser_ends_list(parser_peek(p)))
+			break;
+	}
+	if (count == 1)
+		return items[0];
+	list.as.list.count = count;
+	list.as.list.items = parser_add_refs(p, items, count);
+	if (list.as.list.items == AST_NONE)
+		return AST_NONE;
+	return parser_add_node(p, &list);
+}
+
+/**
+ * parse_if_clause - Parses the condition and branches of an if or elif.
+ * @p: Pointer to the Parser structure, past the if or elif.
+ *
+ * Return: Index of the parsed node, or AST_NONE on failure.
+ */
+static NodeIndex parse_if_clause(Parser *p)
+{
+	Node node = { .type = CMD_IF, .as.branch.otherwise = AST_NONE };
+
+	node.as.branch.condition = parse_compound_list(p);
+	if (parser_failed(p) || !parser_expect(p, TOKEN_THEN, "then"))
+		return AST_NONE;
+	node.as.branch.body = parse_compound_list(p);
+	if (parser_failed(p))
+		return AST_NONE;
+	if (parser_match(p, 1, TOKEN_ELIF)) {
+		node.as.branch.otherwise = parse_if_clause(p);
+		if (node.as.branch.otherwise == AST_NONE)
+			return AST_NONE;
+	} else if (parser_match(p, 1, TOKEN_ELSE)) {
+		node.as.branch.otherwise = parse_compound_list(p);
+		if (parser_failed(p))
+			return AST_NONE;
+	}
+	return parser_add_node(p, &node);
+}
+
+/**
+ * parse_if - Parses an if command.
+ * @p: Pointer to the Parser structure, at the if.
+ *
+ * Return: Index of the parsed node, or AST_NONE on failure.
+ */
+static NodeIndex parse_if(Parser *p)
+{
+	NodeIndex node;
+
+	parser_advance(p);
+	node = parse_if_clause(p);
+	if (node == AST_NONE || !parser_expect(p, TOKEN_FI, "fi"))
+		return AST_NONE;
+	return node;
+}
+
+/**
+ * parse_do_group - Parses the body of a loop, from do to done.
+ * @p: Pointer to the Parser structure.
+ *
+ * Return: Index of the body, or AST_NONE on failure.
+ */
+static NodeIndex parse_do_group(Parser *p)
+{
+	NodeIndex body;
+
+	if (!parser_expect(p, TOKEN_DO, "do"))
+		return AST_NONE;
+	body = parse_compound_list(p);
+	if (parser_failed(p) || !parser_expect(p, TOKEN_DONE, "done"))
+		return AST_NONE;
+	return body;
+}
+
+/**
+ * parse_while - Parses a while or until loop.
+ * @p: Pointer to the Parser structure, at the while or until.
+ *
+ * Return: Index of the parsed node, or AST_NONE on failure.
+ */
+static NodeIndex parse_while(Parser *p)
+{
+	Node node = { .type = parser_advance(p)->type == TOKEN_WHILE ?
+				      CMD_WHILE :
+				      CMD_UNTIL,
+		      .as.branch.otherwise = AST_NONE };
+
+	node.as.branch.condition = parse_compound_list(p);
+	if (parser_failed(p))
+		return AST_NONE;
+	node.as.branch.body = parse_do_group(p);
+	if (node.as.branch.body == AST_NONE)
+		return AST_NONE;
+	return parser_add_node(p, &node);
+}
+
+/**
+ * parse_for_words - Parses the words a for loop runs over.
+ * @p: Pointer to the Parser structure, past the in.
+ *
+ * The words become the arguments of a CMD_SIMPLE of their own, which is
+ * expanded as any command is.
+ *
+ * Return: Index of the parsed node, or AST_NONE on failure.
+ */
+static NodeIndex parse_for_words(Parser *p)
+{
+	Node node = { .type = CMD_SIMPLE };
+
+	node.as.simple.envp = p->ast->word_count;
+	if (parser_push(p, NULL, &node) == AST_NONE)
+		return AST_NONE;
+	node.as.simple.argv = p->ast->word_count;
+	while (parser_match(p, 2, TOKEN_WORD, TOKEN_ASSIGNMENT_WORD)) {
+		if (parser_push(p, parser_previous(p), &node) == AST_NONE)
+			return AST_NONE;
+		node.as.simple.argc++;
+	}
+	if (parser_push(p, NULL, &node) == AST_NONE ||
+	    !parse_redirects(p, parser_peek(p), &node))
+		return AST_NONE;
+	return parser_add_node(p, &node);
+}
+
+/**
+ * parse_for - Parses a for loop.
+ * @p: Pointer to the Parser structure, at the for.
+ *
+ * Without an in, the loop runs over the positional parameters.
+ *
+ * Return: Index of the parsed node, or AST_NONE on failure.
+ */
+static NodeIndex parse_for(Parser *p)
+{
+	Node node = { .type = CMD_FOR, .as.loop.words = AST_NONE };
+	Token *name;
+
+	parser_advance(p);
+	name = parser_peek(p);
+	if (name->type != TOKEN_WORD || name->quoted || name->expand ||
+	    !vars_valid_name(name->text, name->length)) {
+		p->shell->had_error = true;
+		fprintf(stderr, "%s: %d: Syntax error: Bad for loop variable\n",
+			p->shell->name, p->shell->line_number);
+		return AST_NONE;
+	}
+	parser_advance(p);
+	node.as.loop.name = parser_push(p, name, &node);
+	if (node.as.loop.name == AST_NONE ||
+	    parser_push(p, NULL, &node) == AST_NONE)
+		return AST_NONE;
+	if (parser_match(p, 1, TOKEN_IN)) {
+		node.as.loop.words = parse_for_words(p);
+		if (node.as.loop.words == AST_NONE)
+			return AST_NONE;
+		if (!parser_match(p, 2, TOKEN_SEMICOLON, TOKEN_NEWLINE))
+			return parser_unexpected(p, parser_peek(p), "do");
+	} else {
+		parser_match(p, 1, TOKEN_SEMICOLON);
+	}
+	parser_skip_newlines(p);
+	node.as.loop.body = parse_do_group(p);
+	if (node.as.loop.body == AST_NONE)
+		return AST_NONE;
+	return parser_add_node(p, &node);
+}
+
+/**
+ * parse_case_arm - Parses the patterns and commands of an arm of a case.
+ * @p: Pointer to the Parser structure, at the arm.
+ *
+ * Return: Index of the parsed CMD_ARM node, or AST_NONE on failure.
+ */
+static NodeIndex parse_case_arm(Parser *p)
+{
+	Node node = { .type = CMD_ARM, .as.arm.body = AST_NONE };
+	Token *pattern;
+
+	parser_match(p, 1, TOKEN_LPAREN);
+	node.as.arm.patterns = p->ast->word_count;
+	do {
+		pattern = parser_peek(p);
+		if (!parser_match(p, 2, TOKEN_WORD, TOKEN_ASSIGNMENT_WORD))
+			return parser_unexpected(p, pattern, NULL);
+		if (parser_push_pattern(p, pattern, &node) == AST_NONE)
+			return AST_NONE;
+		node.as.arm.count++;
+	} while (parser_match(p, 1, TOKEN_PIPE));
+	if (parser_push(p, NULL, &node) == AST_NONE ||
+	    !parser_expect(p, TOKEN_RPAREN, ")"))
+		return AST_NONE;
+	parser_skip_newlines(p);
+	if (parser_peek(p)->type != TOKEN_DSEMI &&
+	    parser_peek(p)->type != TOKEN_ESAC) {
+		node.as.arm.body = parse_compound_list(p);
+		if (parser_failed(p))
+			return AST_NONE;
+	}
+	return parser_add_node(p, &node);
+}
+
+/**
+ * parse_case - Parses a case command.
+ * @p: Pointer to the Parser structure, at the case.
+ *
+ * Return: Index of the parsed node, or AST_NONE on failure.
+ */
+static NodeIndex parse_case(Parser *p)
+{
+	Node node = { .type = CMD_CASE };
+	NodeIndex *arms = NULL, arm;
+	uint32_t capacity = 0;
+	Token *word;
+
+	parser_advance(p);
+	word = parser_peek(p);
+	if (!parser_match(p, 2, TOKEN_WORD, TOKEN_ASSIGNMENT_WORD))
+		return parser_unexpected(p, word, NULL);
+	node.as.cases.word = parser_push(p, word, &node);
+	if (node.as.cases.word == AST_NONE ||
+	    parser_push(p, NULL, &node) == AST_NONE ||
+	    !parser_expect(p, TOKEN_IN, "in"))
+		return AST_NONE;
+	parser_skip_newlines(p);
+	while (!parser_match(p, 1, TOKEN_ESAC)) {
+		if (parser_is_eol(p))
+			return parser_unexpected(p, parser_peek(p), "esac");
+		arm = parse_case_arm(p);
+		if (arm == AST_NONE || !parser_collect(p, &arms,
+						       &node.as.cases.count,
+						       &capacity, arm))
+			return AST_NONE;
+		if (!parser_match(p, 1, TOKEN_DSEMI) &&
+		    parser_peek(p)->type != TOKEN_ESAC)
+			return parser_unexpected(p, parser_peek(p), ";;");
+		parser_skip_newlines(p);
+	}
+	node.as.cases.arms = node.as.cases.count ?
+				     parser_add_refs(p, arms,
+						     node.as.cases.count) :
+				     p->ast->ref_count;
+	if (node.as.cases.arms == AST_NONE)
+		return AST_NONE;
+	return parser_add_node(p, &node);
+}
+
+/**
+ * parse_compound_redirects - Parses the redirections after a compound
+ *                            command.
+ * @p: Pointer to the Parser structure, at the first redirection.
+ * @body: The compound command.
+ *
+ * The redirections are kept by a CMD_SIMPLE without words, which a
+ * CMD_REDIRECT pairs with the command.
+ *
+ * Return: Index of the CMD_REDIRECT node, or AST_NONE on failure.
+ */
+static NodeIndex parse_compound_redirects(Parser *p, NodeIndex body)
+{
+	Node node = { .type = CMD_SIMPLE };
+	Token *first = parser_peek(p);
+	NodeIndex redirects;
+
+	node.as.simple.envp = p->ast->word_count;
+	if (parser_push(p, NULL, &node) == AST_NONE)
+		return AST_NONE;
+	node.as.simple.argv = p->ast->word_count;
+	if (parser_push(p, NULL, &node) == AST_NONE)
+		return AST_NONE;
+	while (parser_is_redirect(parser_peek(p))) {
+		if (!parse_redirect(p))
+			return AST_NONE;
+	}
+	if (!parse_redirects(p, first, &node))
+		return AST_NONE;
+	redirects = parser_add_node(p, &node);
+	if (redirects == AST_NONE)
+		return AST_NONE;
+	return parser_new_binary(p, CMD_REDIRECT, body, redirects);
+}
+
+/**
+ * parse_brace_group - Parses the commands between { and }.
+ * @p: Pointer to the Parser structure, at the {.
+ *
+ * The group runs in the shell itself and needs no node of its own.
+ *
+ * Return: Index of its commands, or AST_NONE on failure.
+ */
+static NodeIndex parse_brace_group(Parser *p)
+{
+	NodeIndex body;
+
+	parser_advance(p);
+	body = parse_compound_list(p);
+	if (parser_failed(p) || !parser_expect(p, TOKEN_RBRACE, "}"))
+		return AST_NONE;
+	return body;
+}
+
+static NodeIndex parse_unit(Parser *p);
+
+/**
+ * parse_function - Parses a function definition.
+ * @p: Pointer to the Parser structure, at the function's name.
+ *
+ * The body is a compound command, with its redirections, which may
+ * start on a later line.
+ *
+ * Return: Index of the parsed CMD_FUNCTION node, or AST_NONE on failure.
+ */
+static NodeIndex parse_function(Parser *p)
+{
+	Node node = { .type = CMD_FUNCTION };
+	Token *name = parser_advance(p);
+
+	if (name->quoted || name->expand ||
+	    !vars_valid_name(name->text, name->length)) {
+		p->shell->had_error = true;
+		fprintf(stderr, "%s: %d: Syntax error: Bad function name\n",
+			p->shell->name, p->shell->line_number);
+		return AST_NONE;
+	}
+	parser_advance(p);
+	if (!parser_expect(p, TOKEN_RPAREN, ")"))
+		return AST_NONE;
+	parser_skip_newlines(p);
+	if (!parser_starts_compound(parser_peek(p)))
+		return parser_unexpected(p, parser_peek(p), NULL);
+	node.as.function.name = parser_push(p, name, &node);
+	if (node.as.function.name == AST_NONE ||
+	    parser_push(p, NULL, &node) == AST_NONE)
+		return AST_NONE;
+	node.as.function.body = parse_unit(p);
+	if (node.as.function.body == AST_NONE)
+		return AST_NONE;
+	return parser_add_node(p, &node);
+}
+
+/**
+ * parse_unit - Parses a simple or compound command, or a function
+ *              definition.
+ * @p: Pointer to the Parser structure.
+ *
+ * Return: Index of the parsed node, or AST_NONE on failure or when
+ * there is no command.
+ */
+static NodeIndex parse_unit(Parser *p)
+{
+	NodeIndex node;
+
+	switch (parser_peek(p)->type) {
+	case TOKEN_IF:
+		node = parse_if(p);
+		break;
+	case TOKEN_WHILE:
+	case TOKEN_UNTIL:
+		node = parse_while(p);
+		break;
+	case TOKEN_FOR:
+		node = parse_for(p);
+		break;
+	case TOKEN_CASE:
+		node = parse_case(p);
+		break;
+	case TOKEN_LBRACE:
+		node = parse_brace_group(p);
+		break;
+	default:
+		if (parser_peek(p)->type == TOKEN_WORD &&
+		    parser_peek(p)->next->type == TOKEN_LPAREN)
+			return parse_function(p);
+		return parse_simple_command(p);
+	}
+	if (node == AST_NONE || !parser_is_redirect(parser_peek(p)))
+		return node;
+	return parse_compound_redirects(p, node);
+}
+
+/**
+ * parse_time - Parses the `time` reserved word in front of a pipeline.
+ * @p: Pointer to the Parser structure.
+ *
+ * `time` and its -p option are only taken as such when a command
+ * follows, so a lone `time` still runs the program of that name.
+ *
+ * Return: The flags to set on the pipeline, 0 if it is not timed.
+ */
+static uint8_t parse_time(Parser *p)
+{
+	Token *token = parser_peek(p);
+	uint8_t flags = NODE_TIMED;
+
+	if (!parser_is_word(token, "time"))
+		return 0;
+	token = token->next;
+	if (parser_is_word(token, "-p")) {
+		flags |= NODE_TIME_POSIX;
+		token = token->next;
+	}
+	if (!parser_starts_command(token))
+		return 0;
+	while (parser_peek(p) != token)
+		parser_match(p, 1, TOKEN_WORD);
+	return flags;
+}
+
 /**
  * parse_pipeline - Parses a pipeline of commands connected by pipe operators.
  * @p: Pointer to the Parser structure.
  *
- * Return: Pointer to the parsed Command structure, or NULL on failure.
+ * All stages of a pipeline are collected into a single CMD_PIPE node so
+ * the executor can start them side by side. A pipeline preceded by
+ * `time` carries NODE_TIMED.
+ *
+ * Return: Index of the parsed node, or AST_NONE on failure.
  */
-static Command *parse_pipeline(Parser *p)
+static NodeIndex parse_pipeline(Parser *p)
 {
-	Command *cmd = parse_simple_command(p);
-	if (cmd)
-		cmd->is_background = false;
-	else if (p->shell->had_error)
-		return NULL;
+	uint8_t flags = parse_time(p);
+	NodeIndex cmd = parse_unit(p);
+	Node pipeline = { .type = CMD_PIPE, .flags = flags };
+	NodeIndex *stages = NULL;
+	uint32_t count = 0, capacity = 0;
+
+	if (cmd != AST_NONE && parser_peek(p)->type != TOKEN_PIPE)
+		p->ast->nodes[cmd].flags |= flags;
+	if (cmd == AST_NONE || parser_peek(p)->type != TOKEN_PIPE)
+		return cmd;
+	if (!parser_collect(p, &stages, &count, &capacity, cmd))
+		return AST_NONE;
 
 	while (parser_match(p, 1, TOKEN_PIPE)) {
+		parser_skip_newlines(p);
 		if (parser_is_eol(p)) {
 			p->shell->had_error = true;
 			printf("%s: %d: Syntax error: end of line unexpected\n",
 			       p->shell->name, p->shell->line_number);
-			command_free(cmd);
-			return NULL;
-		}
-		Command *right = parse_simple_command(p);
-		if (!right) {
-			command_free(cmd);
-			return NULL;
+			return AST_NONE;
 		}
-		Command *parent = malloc(sizeof(Command));
-		if (!parent) {
-			command_free(cmd);
-			command_free(right);
-			return NULL;
-		}
-		parent->as.binary.left = cmd;
-		parent->type = CMD_PIPE;
-		parent->as.binary.right = right;
-		cmd = parent;
-		cmd->is_background = false;
+		NodeIndex right = parse_unit(p);
+		if (right == AST_NONE ||
+		    !parser_collect(p, &stages, &count, &capacity, right))
+			return AST_NONE;
 	}
-	return cmd;
+
+	pipeline.as.pipeline.count = count;
+	pipeline.as.pipeline.stages = parser_add_refs(p, stages, count);
+	if (pipeline.as.pipeline.stages == AST_NONE)
+		return AST_NONE;
+	return parser_add_node(p, &pipeline);
 }
 /**
  * parse_logical_list - Parses a logical list of commands connected by
  *                      AND/OR operators.
  * @p: Pointer to the Parser structure.
  *
- * Return: Pointer to the parsed Command structure, or NULL on failure.
+ * Return: Index of the parsed node, or AST_NONE on failure.
  */
-static Command *parse_logical_list(Parser *p)
+static NodeIndex parse_logical_list(Parser *p)
 {
-	Command *cmd = parse_pipeline(p);
-	if (cmd)
-		cmd->is_background = false;
-	else if (p->shell->had_error)
-		return NULL;
+	NodeIndex cmd = parse_pipeline(p);
+	if (cmd == AST_NONE &&
+	    (p->shell->had_error || p->shell->fatal_error))
+		return AST_NONE;
 
 	while (parser_match(p, 2, TOKEN_AND, TOKEN_OR)) {
+		CommandType parent_type =
+			parser_previous(p)->type == TOKEN_AND ? CMD_AND :
+								CMD_OR;
+
+		parser_skip_newlines(p);
 		if (parser_is_eol(p)) {
 			p->shell->had_error = true;
 			printf("%s: %d: Syntax error: end of line unexpected\n",
 			       p->shell->name, p->shell->line_number);
-			command_free(cmd);
-			return NULL;
+			return AST_NONE;
 		}
-		CommandType parent_type =
-			parser_previous(p)->type == TOKEN_AND ? CMD_AND :
-								CMD_OR;
-		Command *right = parse_pipeline(p);
-		if (!right) {
-			command_free(cmd);
-			return NULL;
-		}
-		Command *parent = malloc(sizeof(Command));
-		if (!parent) {
-			command_free(cmd);
-			command_free(right);
-			return NULL;
-		}
-		parent->type = parent_type;
-		parent->as.binary.left = cmd;
-		parent->as.binary.right = right;
-		cmd = parent;
-		cmd->is_background = false;
+		NodeIndex right = parse_pipeline(p);
+		if (right == AST_NONE)
+			return AST_NONE;
+		cmd = parser_new_binary(p, parent_type, cmd, right);
+		if (cmd == AST_NONE)
+			return AST_NONE;
 	}
 	return cmd;
 }
@@ -323,53 +1072,48 @@ static Command *parse_logical_list(Parser *p)
  * parse_command - Parses a command, handling background execution.
  * @p: Pointer to the Parser structure.
  *
- * Return: Pointer to the parsed Command structure, or NULL on failure.
+ * Return: Index of the parsed node, or AST_NONE on failure.
  */
-static Command *parse_command(Parser *p)
+static NodeIndex parse_command(Parser *p)
 {
-	Command *cmd = parse_logical_list(p);
-	if (p->shell->had_error) {
-		command_free(cmd);
-		return NULL;
-	}
+	NodeIndex cmd = parse_logical_list(p);
+	if (p->shell->had_error || p->shell->fatal_error || cmd == AST_NONE)
+		return AST_NONE;
 
+	NodeIndex last = cmd;
 	while (parser_match(p, 1, TOKEN_BACKGROUND)) {
-		cmd->is_background = true;
-		if (p->shell->had_error) {
-			command_free(cmd);
-			return NULL;
-		}
+		p->ast->nodes[last].flags |= NODE_BACKGROUND;
 		if (parser_is_eol(p))
 			return cmd;
 
-		Command *right = parse_logical_list(p);
-		if (p->shell->had_error || !right) {
-			command_free(cmd);
-			command_free(right);
-			return NULL;
-		}
-		Command *parent = malloc(sizeof(Command));
-		if (p->shell->had_error || !parent) {
-			command_free(parent);
-			command_free(cmd);
-			command_free(right);
-			return NULL;
-		}
-		parent->as.binary.left = cmd;
-		parent->type = CMD_BACKGROUND;
-		parent->as.binary.right = right;
-		cmd = parent;
+		last = parse_logical_list(p);
+		if (p->shell->had_error || last == AST_NONE)
+			return AST_NONE;
+		cmd = parser_new_binary(p, CMD_BACKGROUND, cmd, last);
+		if (cmd == AST_NONE)
+			return AST_NONE;
 	}
 	return cmd;
 }
 /**
- * parse - Parses a list of tokens into a command structure.
+ * parse - Parses a list of tokens into the shell's syntax tree.
  * @shell: Pointer to the shell state.
  * @tokens: Pointer to the head of the token list.
- * Return: Pointer to the parsed Command structure, or NULL on failure.
+ *
+ * Nodes are appended to shell->ast, which is emptied before each line.
+ * Tokens left over once the command is complete are a syntax error.
+ *
+ * Return: Index of the root node, or AST_NONE if there is no command.
  */
-Command *parse(ShellState *shell, Token *tokens)
+NodeIndex parse(ShellState *shell, Token *tokens)
 {
-	Parser p = { .current = tokens, .prev = NULL, .shell = shell };
-	return parse_command(&p);
+	Parser p = { .current = tokens,
+		     .prev = NULL,
+		     .shell = shell,
+		     .ast = &shell->ast };
+	NodeIndex root = parse_command(&p);
+
+	if (!parser_failed(&p) && !parser_is_eol(&p))
+		return parser_unexpected(&p, parser_peek(&p), NULL);
+	return root;
 }
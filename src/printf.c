@@ -0,0 +1,314 @@
+#include <builtins.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct PrintfState {
+	ShellState *shell;
+	char **args;
+	int count;
+	int next;
+	int status;
+	bool stop;
+} PrintfState;
+
+/**
+ * printf_arg - Takes the next operand.
+ * @p: The formatting state.
+ *
+ * Return: The operand, or an empty string once they run out.
+ */
+static char *printf_arg(PrintfState *p)
+{
+	return p->next < p->count ? p->args[p->next++] : "";
+}
+
+/**
+ * printf_check - Reports an operand that was not fully numeric.
+ * @p: The formatting state.
+ * @arg: The operand.
+ * @end: Where conversion of @arg stopped.
+ */
+static void printf_check(PrintfState *p, const char *arg, const char *end)
+{
+	if (end == arg && *arg) {
+		fprintf(stderr, "%s: printf: %s: expected numeric value\n",
+			p->shell->name, arg);
+		p->status = 1;
+	} else if (*end || errno == ERANGE) {
+		fprintf(stderr, "%s: printf: %s: %s\n", p->shell->name, arg,
+			*end ? "not completely converted" : strerror(ERANGE));
+		p->status = 1;
+	}
+}
+
+/**
+ * printf_signed - Converts the next operand to a signed integer.
+ * @p: The formatting state.
+ *
+ * A leading quote yields the value of the following character.
+ *
+ * Return: The converted value.
+ */
+static intmax_t printf_signed(PrintfState *p)
+{
+	char *arg = printf_arg(p), *end;
+	intmax_t value;
+
+	if (*arg == '\'' || *arg == '"')
+		return (unsigned char)arg[1];
+	errno = 0;
+	value = strtoimax(arg, &end, 0);
+	printf_check(p, arg, end);
+	return value;
+}
+
+/**
+ * printf_unsigned - Converts the next operand to an unsigned integer.
+ * @p: The formatting state.
+ *
+ * Return: The converted value.
+ */
+static uintmax_t printf_unsigned(PrintfState *p)
+{
+	char *arg = printf_arg(p), *end;
+	uintmax_t value;
+
+	if (*arg == '\'' || *arg == '"')
+		return (unsigned char)arg[1];
+	errno = 0;
+	value = strtoumax(arg, &end, 0);
+	printf_check(p, arg, end);
+	return value;
+}
+
+/**
+ * printf_float - Converts the next operand to a floating point number.
+ * @p: The formatting state.
+ *
+ * Return: The converted value.
+ */
+static long double printf_float(PrintfState *p)
+{
+	char *arg = printf_arg(p), *end;
+	long double value;
+
+	if (*arg == '\'' || *arg == '"')
+		return (unsigned char)arg[1];
+	errno = 0;
+	value = strtold(arg, &end);
+	printf_check(p, arg, end);
+	return value;
+}
+
+/**
+ * printf_escape - Writes the character a backslash escape stands for.
+ * @p: The formatting state.
+ * @s: The text following the backslash.
+ * @in_arg: true inside a %b operand, where octal escapes start with 0.
+ *
+ * `\c` sets p->stop so no further output is produced.
+ *
+ * Return: Number of characters of @s consumed.
+ */
+static size_t printf_escape(PrintfState *p, const char *s, bool in_arg)
+{
+	static const char from[] = "\\abfnrtv\"'";
+	static const char to[] = "\\\a\b\f\n\r\t\v\"'";
+	const char *match;
+	size_t i = 0, limit = 3;
+	int value = 0;
+
+	if (*s && (match = strchr(from, *s))) {
+		putchar(to[match - from]);
+		return 1;
+	}
+	if (*s == 'c') {
+		p->stop = true;
+		return 1;
+	}
+	if (in_arg && *s == '0') {
+		i++;
+		limit++;
+	}
+	if (*s >= '0' && *s <= '7') {
+		for (; i < limit && s[i] >= '0' && s[i] <= '7'; i++)
+			value = value * 8 + s[i] - '0';
+		putchar(value);
+		return i;
+	}
+	putchar('\\');
+	return 0;
+}
+
+/**
+ * printf_b - Writes an operand with its backslash escapes expanded.
+ * @p: The formatting state.
+ * @arg: The operand.
+ */
+static void printf_b(PrintfState *p, const char *arg)
+{
+	while (*arg && !p->stop) {
+		if (*arg == '\\') {
+			arg++;
+			arg += printf_escape(p, arg, true);
+		} else {
+			putchar(*arg++);
+		}
+	}
+}
+
+/**
+ * printf_conversion - Formats one operand according to a conversion.
+ * @p: The formatting state.
+ * @spec: The conversion, starting at the '%'.
+ *
+ * Return: Number of characters of @spec consumed.
+ */
+static size_t printf_conversion(PrintfState *p, const char *spec)
+{
+	char format[64];
+	size_t i = 1, n = 1;
+	int width = 0, precision = 0;
+	bool has_width = false, has_precision = false;
+
+	format[0] = '%';
+	while (spec[i] && strchr("-+ #0", spec[i])) {
+		if (n < 8)
+			format[n++] = spec[i];
+		i++;
+	}
+	if (spec[i] == '*') {
+		width = (int)printf_signed(p);
+		has_width = true;
+		i++;
+		/* A negative width is taken as the '-' flag and its size. */
+		if (width < 0) {
+			format[n++] = '-';
+			width = width == INT_MIN ? INT_MAX : -width;
+		}
+	} else {
+		for (; spec[i] >= '0' && spec[i] <= '9'; i++)
+			width = width * 10 + spec[i] - '0';
+		has_width = width > 0;
+	}
+	if (spec[i] == '.') {
+		has_precision = true;
+		if (spec[++i] == '*') {
+			/* A negative precision is taken as if omitted. */
+			precision = (int)printf_signed(p);
+			has_precision = precision >= 0;
+			i++;
+		} else {
+			for (; spec[i] >= '0' && spec[i] <= '9'; i++)
+				precision = precision * 10 + spec[i] - '0';
+		}
+	}
+	if (has_width)
+		n += snprintf(format + n, sizeof(format) - n, "%d", width);
+	if (has_precision)
+		n += snprintf(format + n, sizeof(format) - n, ".%d", precision);
+
+	switch (spec[i]) {
+	case 'd':
+	case 'i':
+		strcpy(format + n, "jd");
+		printf(format, printf_signed(p));
+		break;
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+		format[n++] = 'j';
+		format[n++] = spec[i];
+		format[n] = '\0';
+		printf(format, printf_unsigned(p));
+		break;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		format[n++] = 'L';
+		format[n++] = spec[i];
+		format[n] = '\0';
+		printf(format, printf_float(p));
+		break;
+	case 'c':
+		strcpy(format + n, "c");
+		printf(format, *printf_arg(p));
+		break;
+	case 's':
+		strcpy(format + n, "s");
+		printf(format, printf_arg(p));
+		break;
+	case 'b':
+		printf_b(p, printf_arg(p));
+		break;
+	case '%':
+		putchar('%');
+		break;
+	default:
+		fprintf(stderr, "%s: printf: %%%c: invalid directive\n",
+			p->shell->name, spec[i]);
+		p->status = 1;
+		p->stop = true;
+		return spec[i] ? i + 1 : i;
+	}
+	return i + 1;
+}
+
+/**
+ * builtin_printf - Writes formatted output.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed.
+ * @is_background: Unused.
+ *
+ * The format is reused until every operand has been consumed.
+ *
+ * Return: 0 on success, 1 if an operand was invalid or the output could
+ * not be written, 2 on usage errors.
+ */
+int builtin_printf(ShellState *shell, SimpleCommand *command,
+		   bool is_background)
+{
+	PrintfState p = { .shell = shell };
+	int first = 1;
+	const char *format;
+
+	(void)is_background;
+	if (first < command->argc && !strcmp(command->argv[first], "--"))
+		first++;
+	if (first >= command->argc) {
+		fprintf(stderr, "%s: printf: usage: printf format [arg ...]\n",
+			shell->name);
+		return 2;
+	}
+	format = command->argv[first];
+	p.args = command->argv + first + 1;
+	p.count = command->argc - first - 1;
+
+	do {
+		int consumed = p.next;
+
+		for (const char *s = format; *s && !p.stop;) {
+			if (*s == '\\') {
+				s++;
+				s += printf_escape(&p, s, false);
+			} else if (*s == '%') {
+				s += printf_conversion(&p, s);
+			} else {
+				putchar(*s++);
+			}
+		}
+		if (p.next == consumed)
+			break;
+	} while (p.next < p.count && !p.stop);
+	return builtin_output(shell, "printf", p.status);
+}
@@ -0,0 +1,322 @@
+#include <redirect.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/memfd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+/* Largest here-document body written into a pipe rather than a memfd. */
+#define HEREDOC_PIPE_SIZE 65536
+
+/*
+ * Descriptors the shell keeps for itself while redirecting start here;
+ * io numbers are single digits, so a redirection never reaches them.
+ */
+#define REDIRECT_SAVE_FD 10
+
+/**
+ * redirect_heredoc - Makes a descriptor to read the body of a here-document.
+ * @shell: Pointer to the shell state.
+ * @body: The body.
+ *
+ * A body that fits in a pipe is written into one and the write end
+ * closed, so the reader gets it without a file; the write end is made
+ * non-blocking so a pipe smaller than expected fails instead of
+ * blocking the shell. Any other body goes into an anonymous memfd,
+ * rewound for reading. Either way it is written once, in one call.
+ *
+ * Return: The close-on-exec read descriptor, or -1 on failure.
+ */
+static int redirect_heredoc(ShellState *shell, const char *body)
+{
+	size_t length = strlen(body), written = 0;
+	ssize_t n;
+	int fds[2], fd;
+
+	if (length <= HEREDOC_PIPE_SIZE && pipe(fds) == 0) {
+		fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+		fcntl(fds[1], F_SETFL, O_NONBLOCK);
+		n = write(fds[1], body, length);
+		close(fds[1]);
+		if (n == (ssize_t)length)
+			return fds[0];
+		close(fds[0]);
+	}
+
+	fd = (int)syscall(SYS_memfd_create, "here-document", MFD_CLOEXEC);
+	if (fd < 0) {
+		fprintf(stderr, "%s: here-document: %s\n", shell->name,
+			strerror(errno));
+		return -1;
+	}
+	while (written < length) {
+		n = write(fd, body + written, length - written);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			fprintf(stderr, "%s: here-document: %s\n",
+				shell->name, strerror(errno));
+			close(fd);
+			return -1;
+		}
+		written += n;
+	}
+	lseek(fd, 0, SEEK_SET);
+	return fd;
+}
+
+/**
+ * redirect_file - Opens the file a redirection names.
+ * @shell: Pointer to the shell state.
+ * @redirect: The redirection.
+ * @target: The file name.
+ *
+ * Return: The close-on-exec descriptor, or -1 on failure.
+ */
+static int redirect_file(ShellState *shell, const Redirect *redirect,
+			 const char *target)
+{
+	mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+	int fd;
+
+	switch (redirect->type) {
+	case REDIRECT_IN:
+		fd = open(target, O_RDONLY | O_CLOEXEC);
+		break;
+	case REDIRECT_APPEND:
+		fd = open(target, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+			  mode);
+		break;
+	default:
+		fd = open(target, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			  mode);
+		break;
+	}
+	if (fd < 0)
+		fprintf(stderr, "%s: %s: %s\n", shell->name, target,
+			strerror(errno));
+	return fd;
+}
+
+/**
+ * redirect_private - Moves a descriptor the shell keeps for itself out of
+ *                    reach of redirections.
+ * @fd: The descriptor, or -1.
+ *
+ * It is copied close-on-exec to REDIRECT_SAVE_FD or above, where no io
+ * number reaches, so a redirection of a builtin never replaces it and
+ * `2>&3` never copies it.
+ *
+ * Return: The moved descriptor, or -1 if @fd was -1 or could not be
+ * moved, in which case it is closed.
+ */
+int redirect_private(int fd)
+{
+	int moved;
+
+	if (fd < 0 || fd >= REDIRECT_SAVE_FD)
+		return fd;
+	moved = fcntl(fd, F_DUPFD_CLOEXEC, REDIRECT_SAVE_FD);
+	close(fd);
+	return moved;
+}
+
+/**
+ * redirect_dup - Resolves the descriptor a n>&m or n<&m copies.
+ * @shell: Pointer to the shell state.
+ * @actions: The redirections before this one.
+ * @count: Number of them.
+ * @target: m, or "-" to close n.
+ * @source: Set to m, or to -1 for "-".
+ *
+ * m is a single digit, like io numbers; anything else is a syntax
+ * error. It must be open once the redirections before it are applied:
+ * the last of them on m decides, and otherwise the shell's own
+ * descriptor. Descriptors the shell opened for itself, such as the
+ * files and pipes of other redirections and pipeline stages, are
+ * close-on-exec and do not count: only those it inherited or had
+ * redirected onto them do.
+ *
+ * Return: true on success, false if m is not a descriptor or not open.
+ */
+static bool redirect_dup(ShellState *shell, const FdAction *actions,
+			 size_t count, const char *target, int *source)
+{
+	int flags;
+	bool valid;
+
+	if (!strcmp(target, "-")) {
+		*source = -1;
+		return true;
+	}
+	if (target[0] < '0' || target[0] > '9' || target[1]) {
+		fprintf(stderr, "%s: %d: Syntax error: Bad fd number\n",
+			shell->name, shell->line_number);
+		shell->had_error = true;
+		return false;
+	}
+	*source = target[0] - '0';
+	flags = fcntl(*source, F_GETFD);
+	valid = flags != -1 && !(flags & FD_CLOEXEC);
+	for (size_t i = 0; i < count; i++) {
+		if (actions[i].fd == *source)
+			valid = actions[i].source >= 0;
+	}
+	if (valid)
+		return true;
+	fprintf(stderr, "%s: %d: %s: Bad file descriptor\n", shell->name,
+		shell->line_number, target);
+	return false;
+}
+
+/**
+ * redirect_release - Closes the descriptors opened for redirections.
+ * @actions: The redirections.
+ * @count: Number of redirections.
+ * @stack: The buffer given to redirect_open().
+ */
+void redirect_release(FdAction *actions, size_t count, FdAction *stack)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (actions[i].owned)
+			close(actions[i].source);
+	}
+	if (actions != stack)
+		free(actions);
+}
+
+/**
+ * redirect_open - Opens everything the redirections of a command need.
+ * @shell: Pointer to the shell state.
+ * @simple: The command, with its targets expanded.
+ * @stack: Room for REDIRECT_STACK redirections, used when they fit.
+ * @count: Set to the number of redirections.
+ *
+ * Files are opened and here-documents written in order, so every file
+ * named is created even if a later one fails. A descriptor opened that
+ * some redirection of the command also targets is moved out of the way,
+ * so applying the redirections in order never overwrites a source
+ * before it is used.
+ *
+ * Return: The redirections, @stack or allocated, or NULL on failure
+ * after reporting it.
+ */
+FdAction *redirect_open(ShellState *shell, const SimpleCommand *simple,
+			FdAction *stack, size_t *count)
+{
+	FdAction *actions = stack, *action;
+	const Redirect *redirect;
+	size_t n = 0;
+	int moved;
+
+	while (simple->targets[n])
+		n++;
+	*count = 0;
+	if (n > REDIRECT_STACK && !(actions = malloc(sizeof(FdAction) * n))) {
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+		return NULL;
+	}
+	for (size_t i = 0; i < n; i++) {
+		redirect = &simple->redirects[i];
+		action = &actions[i];
+		action->fd = redirect->fd;
+		action->saved = -1;
+		action->owned = redirect->type != REDIRECT_DUP;
+		if (redirect->type == REDIRECT_DUP) {
+			if (!redirect_dup(shell, actions, i, simple->targets[i],
+					  &action->source))
+				break;
+		} else {
+			action->source =
+				redirect->type == REDIRECT_HEREDOC ?
+					redirect_heredoc(shell,
+							 simple->targets[i]) :
+					redirect_file(shell, redirect,
+						      simple->targets[i]);
+			if (action->source < 0)
+				break;
+		}
+		*count = i + 1;
+	}
+	if (*count < n) {
+		redirect_release(actions, *count, stack);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = 0; actions[i].owned && j < n; j++) {
+			if (actions[j].fd != actions[i].source)
+				continue;
+			moved = fcntl(actions[i].source, F_DUPFD_CLOEXEC,
+				      REDIRECT_SAVE_FD);
+			if (moved < 0)
+				break;
+			close(actions[i].source);
+			actions[i].source = moved;
+			break;
+		}
+	}
+	return actions;
+}
+
+/**
+ * redirect_apply - Applies redirections to the shell itself.
+ * @shell: Pointer to the shell state.
+ * @actions: The redirections, from redirect_open().
+ * @count: Number of redirections.
+ *
+ * Each descriptor is first copied with F_DUPFD_CLOEXEC, above those a
+ * redirection can name, so redirect_restore() can put it back: a
+ * builtin then runs redirected without a fork.
+ *
+ * Return: true on success, false if a descriptor could not be saved or
+ * copied, after putting back those already changed.
+ */
+bool redirect_apply(ShellState *shell, FdAction *actions, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		FdAction *action = &actions[i];
+
+		action->saved = fcntl(action->fd, F_DUPFD_CLOEXEC,
+				      REDIRECT_SAVE_FD);
+		if (action->saved < 0 && errno != EBADF) {
+			fprintf(stderr, "%s: %d: %d: %s\n", shell->name,
+				shell->line_number, action->fd,
+				strerror(errno));
+			redirect_restore(actions, i);
+			return false;
+		}
+		if (action->source < 0)
+			close(action->fd);
+		else if (action->source != action->fd)
+			dup2(action->source, action->fd);
+	}
+	return true;
+}
+
+/**
+ * redirect_restore - Undoes redirect_apply().
+ * @actions: The applied redirections.
+ * @count: Number of redirections.
+ *
+ * The descriptors are put back in reverse order, so one redirected
+ * twice ends up as it was before the first.
+ */
+void redirect_restore(FdAction *actions, size_t count)
+{
+	while (count--) {
+		FdAction *action = &actions[count];
+
+		if (action->saved < 0) {
+			close(action->fd);
+		} else {
+			dup2(action->saved, action->fd);
+			close(action->saved);
+		}
+	}
+}
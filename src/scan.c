@@ -0,0 +1,289 @@
+#include <scan.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define SCAN_SCALAR_PREFIX 16
+
+/*
+ * Character classes used by the lexer. NUL counts as a delimiter so a
+ * scan always stops at the end of the input.
+ */
+const unsigned char char_class[256] = {
+	['\0'] = CC_DELIM,	      [' '] = CC_BLANK | CC_DELIM,
+	['\t'] = CC_BLANK | CC_DELIM, ['\r'] = CC_BLANK | CC_DELIM,
+	['\n'] = CC_DELIM,	      [';'] = CC_DELIM,
+	['|'] = CC_DELIM,	      ['&'] = CC_DELIM,
+	['<'] = CC_DELIM,	      ['>'] = CC_DELIM,
+	['#'] = CC_DELIM,	      ['('] = CC_DELIM,
+	[')'] = CC_DELIM,	      ['\''] = CC_QUOTE,
+	['"'] = CC_QUOTE,	      ['\\'] = CC_QUOTE,
+	['='] = CC_EQUALS,	      ['$'] = CC_DOLLAR,
+};
+
+/**
+ * scan_scalar - Finds the next word stop character one byte at a time.
+ * @str: The string to scan.
+ *
+ * Return: Number of bytes before the first delimiter, quote, '=' or '$'.
+ */
+static size_t scan_scalar(const char *str)
+{
+	const unsigned char *s = (const unsigned char *)str;
+	size_t i = 0;
+
+	while (!(char_class[s[i]] & CC_WORD_STOP))
+		i++;
+	return i;
+}
+
+#if defined(__x86_64__)
+/*
+ * The vector kernels only issue aligned loads, which never cross a page
+ * boundary, so reading past the terminating NUL is safe. Bytes before
+ * the start of the string in the first block are shifted out of the mask.
+ */
+
+/**
+ * stop_mask_sse2 - Computes a bitmask of word stop bytes in a 16 byte block.
+ * @v: The block to classify.
+ *
+ * Return: Bit i is set when byte i is a delimiter, quote, '=' or '$'.
+ */
+static unsigned stop_mask_sse2(__m128i v)
+{
+	__m128i m = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(';')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('|')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('&')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('<')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('>')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('#')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('(')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(')')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('=')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('$')));
+	return (unsigned)_mm_movemask_epi8(m);
+}
+
+/**
+ * scan_sse2 - Finds the next word stop character 16 bytes at a time.
+ * @str: The string to scan.
+ *
+ * Return: Number of bytes before the first delimiter, quote, '=' or '$'.
+ */
+static size_t scan_sse2(const char *str)
+{
+	size_t misalign = (uintptr_t)str & 15;
+	const char *p = str - misalign;
+	unsigned mask = stop_mask_sse2(_mm_load_si128((const __m128i *)p));
+
+	mask >>= misalign;
+	if (mask)
+		return __builtin_ctz(mask);
+	for (p += 16;; p += 16) {
+		mask = stop_mask_sse2(_mm_load_si128((const __m128i *)p));
+		if (mask)
+			return (size_t)(p - str) + __builtin_ctz(mask);
+	}
+}
+
+/**
+ * stop_mask_avx2 - Computes a bitmask of word stop bytes in a 32 byte block.
+ * @v: The block to classify.
+ *
+ * Return: Bit i is set when byte i is a delimiter, quote, '=' or '$'.
+ */
+__attribute__((target("avx2"))) static unsigned stop_mask_avx2(__m256i v)
+{
+	__m256i m = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(';')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('|')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('&')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('<')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('>')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('#')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('(')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(')')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('=')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('$')));
+	return (unsigned)_mm256_movemask_epi8(m);
+}
+
+/**
+ * scan_avx2 - Finds the next word stop character 32 bytes at a time.
+ * @str: The string to scan.
+ *
+ * Return: Number of bytes before the first delimiter, quote, '=' or '$'.
+ */
+__attribute__((target("avx2"))) static size_t scan_avx2(const char *str)
+{
+	size_t misalign = (uintptr_t)str & 31;
+	const char *p = str - misalign;
+	unsigned mask = stop_mask_avx2(_mm256_load_si256((const __m256i *)p));
+
+	mask >>= misalign;
+	if (mask)
+		return __builtin_ctz(mask);
+	for (p += 32;; p += 32) {
+		mask = stop_mask_avx2(_mm256_load_si256((const __m256i *)p));
+		if (mask)
+			return (size_t)(p - str) + __builtin_ctz(mask);
+	}
+}
+#endif
+
+static size_t scan_resolve(const char *str);
+
+static size_t (*scan_impl)(const char *) = scan_resolve;
+
+/**
+ * scan_resolve - Picks the fastest kernel the CPU supports, then scans.
+ * @str: The string to scan.
+ *
+ * Return: Number of bytes before the first delimiter, quote, '=' or '$'.
+ */
+static size_t scan_resolve(const char *str)
+{
+	scan_impl = scan_scalar;
+#if defined(__x86_64__)
+	scan_impl = scan_sse2;
+	if (__builtin_cpu_supports("avx2"))
+		scan_impl = scan_avx2;
+#endif
+	return scan_impl(str);
+}
+
+/**
+ * scan_word_run - Measures the run of plain word characters at a position.
+ * @str: The NUL terminated string to scan.
+ *
+ * Short runs, which are the common case, are finished with table lookups
+ * before a vector kernel is worth starting.
+ *
+ * Return: Number of bytes before the first delimiter, quote, '=' or '$'.
+ */
+size_t scan_word_run(const char *str)
+{
+	const unsigned char *s = (const unsigned char *)str;
+
+	for (size_t i = 0; i < SCAN_SCALAR_PREFIX; i++) {
+		if (char_class[s[i]] & CC_WORD_STOP)
+			return i;
+	}
+	return SCAN_SCALAR_PREFIX + scan_impl(str + SCAN_SCALAR_PREFIX);
+}
+
+/**
+ * scan_brace - Measures the braces of a ${...} parameter expansion.
+ * @str: The NUL terminated text, starting at the '{'.
+ * @quoted: Whether the expansion is inside double quotes, where single
+ *          quotes are plain characters.
+ *
+ * Nested expansions, quoted strings and characters escaped with a
+ * backslash are skipped, so a '}' inside them does not end the
+ * expansion. The text never spans lines.
+ *
+ * Return: Number of bytes up to and including the matching '}', or 0 if
+ * there is none.
+ */
+size_t scan_brace(const char *str, bool quoted)
+{
+	size_t depth = 1;
+
+	for (const char *p = str + 1; *p && *p != '\n'; p++) {
+		if (*p == '\\' && p[1] && p[1] != '\n') {
+			p++;
+		} else if (!quoted && (*p == '\'' || *p == '"')) {
+			p += 1 + (*p == '"' ? scan_dquote(p + 1) :
+					      strcspn(p + 1, "'\n"));
+			if (*p != '\'' && *p != '"')
+				return 0;
+		} else if (*p == '$' && p[1] == '{') {
+			depth++;
+			p++;
+		} else if (*p == '}' && !--depth) {
+			return p - str + 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * scan_paren - Measures the parentheses of a $(...) command substitution.
+ * @str: The NUL terminated text, starting at the '('.
+ *
+ * The body is a command of its own, so its quoted strings and escaped
+ * characters are skipped whatever quotes the substitution is in, and
+ * nested parentheses are matched. The text never spans lines.
+ *
+ * Return: Number of bytes up to and including the matching ')', or 0 if
+ * there is none.
+ */
+size_t scan_paren(const char *str)
+{
+	size_t depth = 1;
+
+	for (const char *p = str + 1; *p && *p != '\n'; p++) {
+		if (*p == '\\' && p[1] && p[1] != '\n') {
+			p++;
+		} else if (*p == '\'' || *p == '"') {
+			p += 1 + (*p == '"' ? scan_dquote(p + 1) :
+					      strcspn(p + 1, "'\n"));
+			if (*p != '\'' && *p != '"')
+				return 0;
+		} else if (*p == '(') {
+			depth++;
+		} else if (*p == ')' && !--depth) {
+			return p - str + 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * scan_dquote - Measures the text of a double-quoted string.
+ * @str: The NUL terminated text after the opening '"'.
+ *
+ * Command substitutions and characters escaped with a backslash are
+ * skipped, so quotes inside them do not end the string.
+ *
+ * Return: Number of bytes before the closing '"', or before the newline
+ * or NUL that ends the text if the string is not closed.
+ */
+size_t scan_dquote(const char *str)
+{
+	const char *p = str;
+	size_t length;
+
+	for (;;) {
+		p += strcspn(p, "\"\n$\\");
+		if (*p == '\\' && p[1] && p[1] != '\n')
+			p += 2;
+		else if (*p != '$')
+			return p - str;
+		else if (p[1] == '(' && (length = scan_paren(p + 1)))
+			p += 1 + length;
+		else
+			p++;
+	}
+}
@@ -1,11 +1,17 @@
 #include <shell.h>
+#include <alias.h>
+#include <builtins.h>
+#include <cache.h>
 #include <command.h>
+#include <environ.h>
 #include <executor.h>
+#include <function.h>
 #include <lexer.h>
 #include <parser.h>
 #include <token.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 /**
  * shell_init - Initializes the shell state.
  * @name: Name of the shell executable.
@@ -22,8 +28,44 @@ ShellState *shell_init(char *name, bool is_interactive)
 	shell->fatal_error = false;
 	shell->had_error = false;
 	shell->is_interactive_mode = is_interactive;
+	shell->exec_final = false;
+	shell->exec_next = false;
+	shell->loop_depth = 0;
+	shell->function_depth = 0;
+	shell->skip = 0;
+	shell->skip_count = 0;
 	shell->line_number = 0;
 	shell->name = name;
+	shell->params = NULL;
+	shell->param_count = 0;
+	shell->status = 0;
+	shell->pid = getpid();
+	shell->hashed_generation = 0;
+	shell->cache_hits = 0;
+	shell->cache_misses = 0;
+	shell->trace = trace_new();
+	shell->timing = NULL;
+	memset(&shell->ast, 0, sizeof(Ast));
+	memset(&shell->expansion, 0, sizeof(Expansion));
+	shell->commands = table_new(free);
+	shell->builtins = builtins_new();
+	shell->aliases = table_new(alias_free);
+	shell->functions = table_new(function_free);
+	shell->alias_generation = 0;
+	shell->arena = arena_new();
+	if (!vars_init(&shell->vars, environ) || !shell->commands ||
+	    !shell->builtins || !shell->aliases || !shell->functions ||
+	    !shell->arena || !jobs_init(shell)) {
+		vars_free(&shell->vars);
+		table_free(shell->commands);
+		table_free(shell->builtins);
+		table_free(shell->aliases);
+		table_free(shell->functions);
+		arena_free(shell->arena);
+		trace_free(shell->trace);
+		free(shell);
+		return NULL;
+	}
 	return shell;
 }
 /**
@@ -32,87 +74,289 @@ ShellState *shell_init(char *name, bool is_interactive)
  */
 void shell_free(ShellState *shell)
 {
+	table_free(shell->commands);
+	table_free(shell->builtins);
+	table_free(shell->aliases);
+	table_free(shell->functions);
+	arena_free(shell->arena);
+	ast_free(&shell->ast);
+	expand_free(&shell->expansion);
+	jobs_free(shell);
+	trace_free(shell->trace);
+	vars_free(&shell->vars);
 	free(shell);
 }
 
+/**
+ * shell_lex - Tokenizes the first line of an input.
+ * @shell: Pointer to the ShellState structure.
+ * @input: The input, NUL terminated after its last line.
+ * @length: Set to the number of bytes of @input consumed, including the
+ *          bodies of the line's here-documents.
+ *
+ * Tokens and words of a line are allocated from the shell's arena, which
+ * is reset in one step before the next line is read. The syntax tree of
+ * the line is built in shell->ast, whose arrays are reused line to line.
+ *
+ * Return: Pointer to the head of the token list.
+ */
+static Token *shell_lex(ShellState *shell, const char *input, size_t *length)
+{
+	ast_reset(&shell->ast);
+	jobs_reap(shell, 0);
+
+	uint64_t start = trace_now(shell->trace);
+	Token *tokens = tokenize_line(shell, input, length);
+
+	trace_span(shell->trace, "tokenize", start);
+	return tokens;
+}
+
+/**
+ * shell_eval - Parses and executes the tokens of a line.
+ * @shell: Pointer to the ShellState structure.
+ * @tokens: The tokens, from shell_lex().
+ * @builder: Records the parsed commands for the script cache, or NULL.
+ * @last: Whether the line ends the input of a shell that exits after it.
+ *
+ * A syntax error makes the status 2. An error, or an interrupt, stops
+ * the rest of the line. After an `exit` the rest of the line is still
+ * parsed, so that a recording covers it, but nothing more runs.
+ *
+ * Return: true if more input should be read, false otherwise.
+ */
+static bool shell_eval(ShellState *shell, Token *tokens,
+		       CacheBuilder *builder, bool last)
+{
+	uint64_t start;
+
+	if (shell->fatal_error)
+		return false;
+	if (shell->had_error) {
+		shell->had_error = false;
+		shell->status = 2;
+		if (builder)
+			cache_record_abort(builder);
+		return true;
+	}
+
+	Token **commands = token_split_by_semicolon(shell, tokens);
+	if (shell->fatal_error)
+		return false;
+
+	for (Token **ptr = commands; *ptr; ptr++) {
+		start = trace_now(shell->trace);
+		NodeIndex root = parse(shell, *ptr);
+
+		trace_span(shell->trace, "parse", start);
+		if (!shell->fatal_error && !shell->had_error) {
+			if (builder)
+				cache_record_command(builder, &shell->ast, root);
+			shell->exec_next = last && !ptr[1];
+			execute(shell, &shell->ast, root);
+		} else {
+			shell->status = 2;
+			if (builder)
+				cache_record_abort(builder);
+		}
+
+		if (shell->fatal_error || shell->had_error)
+			break;
+	}
+	if (shell->fatal_error)
+		return false;
+	if (shell->had_error) {
+		shell->had_error = false;
+		return shell->is_interactive_mode && !shell->skip;
+	}
+	return !shell->skip;
+}
+
+/**
+ * shell_append - Appends a line read to the input being lexed.
+ * @shell: Pointer to the ShellState structure.
+ * @input: The input, allocated with malloc(), grown as needed.
+ * @capacity: Allocated size of @input.
+ * @length: Length of @input, updated.
+ * @line: The line to append.
+ * @size: Length of @line.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool shell_append(ShellState *shell, char **input, size_t *capacity,
+			 size_t *length, const char *line, size_t size)
+{
+	size_t grown = *capacity ? *capacity : 128;
+	char *resized;
+
+	while (grown <= *length + size)
+		grown *= 2;
+	if (grown != *capacity) {
+		resized = realloc(*input, grown);
+		if (!resized) {
+			fprintf(stderr, "Error: malloc failed\n");
+			shell->fatal_error = true;
+			return false;
+		}
+		*input = resized;
+		*capacity = grown;
+	}
+	memcpy(*input + *length, line, size + 1);
+	*length += size;
+	return true;
+}
+
+/**
+ * shell_continue - Reads the rest of a line that goes on past its end.
+ * @shell: Pointer to the ShellState structure.
+ * @stream: Input stream to read from.
+ * @input: The line read with getline(), which the lines read are
+ *         appended to.
+ * @capacity: Allocated size of @input.
+ * @tokens: The tokens of the line, lexed again once more of it is read.
+ *
+ * While a here-document is open, lines are appended until one is its
+ * delimiter, and only then is the line lexed again, so a body is not
+ * lexed over for every line of it; a line with several here-documents
+ * takes as many rounds. While a compound command is open, or the line
+ * ends in a backslash, the line is lexed again after every line, which
+ * tells whether it is complete. An
+ * interactive shell prompts for each line with "> ".
+ *
+ * Return: The tokens of the whole line.
+ */
+static Token *shell_continue(ShellState *shell, FILE *stream, char **input,
+			     size_t *capacity, Token *tokens)
+{
+	size_t length = strlen(*input), n = 0, size = 0;
+	char *line = NULL, *delimiter = NULL, *p;
+	ssize_t nread = 0;
+	bool strip = false;
+
+	while (nread >= 0 &&
+	       (shell->pending.delimiter || shell->pending.depth ||
+		shell->pending.joined) &&
+	       !shell->had_error && !shell->fatal_error) {
+		if (shell->pending.delimiter) {
+			size = shell->pending.length;
+			strip = shell->pending.strip;
+			delimiter = strndup(shell->pending.delimiter, size);
+			if (!delimiter) {
+				fprintf(stderr, "Error: malloc failed\n");
+				shell->fatal_error = true;
+				break;
+			}
+		}
+		for (;;) {
+			if (shell->is_interactive_mode) {
+				fprintf(stdout, "> ");
+				fflush(stdout);
+			}
+			nread = getline(&line, &n, stream);
+			if (nread < 0 ||
+			    !shell_append(shell, input, capacity, &length, line,
+					  nread) ||
+			    !delimiter)
+				break;
+			for (p = line; strip && *p == '\t'; p++)
+				;
+			if (!strncmp(p, delimiter, size) &&
+			    (p[size] == '\n' || p[size] == '\0'))
+				break;
+		}
+		free(delimiter);
+		delimiter = NULL;
+		if (!shell->fatal_error)
+			tokens = shell_lex(shell, *input, &size);
+	}
+	free(line);
+	return tokens;
+}
+
 /**
  * shell_repl - Runs the Read-Eval-Print Loop (REPL) for the shell.
  * @shell: Pointer to the ShellState structure.
  * @stream: Input stream to read commands from.
+ *
+ * An interactive shell reads its input unbuffered and waits for it
+ * together with the exits of background jobs, so finished jobs are
+ * reaped while the prompt is shown rather than one line later.
  */
 void shell_repl(ShellState *shell, FILE *stream)
 {
 	char *line = NULL;
-	size_t n = 0;
+	size_t n = 0, length;
 	ssize_t nread = 0;
+	Token *tokens;
+	int lines;
 
+	if (shell->is_interactive_mode)
+		setvbuf(stream, NULL, _IONBF, 0);
 	while (true) {
-start:
+		arena_reset(shell->arena);
 		shell->line_number++;
-		if (shell->is_interactive_mode)
+		if (shell->is_interactive_mode) {
+			jobs_notify(shell);
 			fprintf(stdout, "$ ");
+			fflush(stdout);
+			if (shell->jobs.count)
+				jobs_wait_input(shell, fileno(stream));
+		}
 
 		nread = getline(&line, &n, stream);
-		if (nread < 0) {
-			free(line);
+		if (nread < 0)
 			break;
-		}
-
-		Token *tokens = tokenize(shell, line);
-		free(line);
-		line = NULL;
+		tokens = shell_lex(shell, line, &length);
+		if (shell->pending.delimiter || shell->pending.depth ||
+		    shell->pending.joined)
+			tokens = shell_continue(shell, stream, &line, &n,
+						tokens);
+		lines = shell->pending.lines;
+		jobs_interrupted(true);
+		if (!shell_eval(shell, tokens, NULL, false))
+			break;
+		shell->line_number += lines;
+	}
+	free(line);
 
-		if (shell->fatal_error) {
-			token_free_list(tokens);
-			return;
-		}
-		if (shell->had_error) {
-			token_free_list(tokens);
-			shell->had_error = false;
-			continue;
-		}
+	if (shell->is_interactive_mode && !shell->fatal_error && !shell->skip)
+		putchar('\n');
+}
 
-		Token **commands = token_split_by_semicolon(shell, tokens);
-		if (shell->fatal_error) {
-			Token **runner = commands;
-			while (*runner) {
-				token_free_list(*runner);
-				runner++;
-			}
-			free(commands);
-			return;
-		}
+/**
+ * shell_run_source - Runs a script held entirely in memory.
+ * @shell: Pointer to the ShellState structure.
+ * @text: The NUL terminated script text.
+ * @builder: Records the parsed commands for the script cache, or NULL.
+ *
+ * The lexer works directly on @text one line at a time, so no line is
+ * copied or allocated separately. Unless it is being recorded, the last
+ * command of the text may replace the shell when shell->exec_final is set.
+ *
+ * Return: true if the whole script was read, false if it stopped early,
+ * including at an `exit` before its last line.
+ */
+bool shell_run_source(ShellState *shell, const char *text,
+		      CacheBuilder *builder)
+{
+	const char *start = text;
+	size_t length;
+	Token *tokens;
+	int lines;
 
-		Token **ptr = commands;
-		for (; *ptr; ptr++) {
-			Command *command = parse(shell, *ptr);
-			execute(shell, command);
-			command_free(command);
-
-			if (shell->fatal_error) {
-				while (*ptr) {
-					token_free_list(*ptr);
-					ptr++;
-				}
-				free(commands);
-				return;
-			}
-			if (shell->had_error) {
-				shell->had_error = false;
-				while (*ptr) {
-					token_free_list(*ptr);
-					ptr++;
-				}
-				free(commands);
-				if (shell->is_interactive_mode)
-					goto start;
-				return;
-			}
-			token_free_list(*ptr);
-		}
-		free(commands);
+	while (*text) {
+		arena_reset(shell->arena);
+		shell->line_number++;
+		if (builder)
+			cache_record_line(builder, shell->line_number,
+					  text - start);
+		tokens = shell_lex(shell, text, &length);
+		lines = shell->pending.lines;
+		if (!shell_eval(shell, tokens, builder,
+				shell->exec_final && !builder && !text[length]))
+			return shell->skip && !text[length];
+		shell->line_number += lines;
+		text += length;
 	}
-
-	if (shell->is_interactive_mode)
-		putchar('\n');
+	return true;
 }
@@ -0,0 +1,134 @@
+#include <source.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SOURCE_READ_CHUNK 65536
+
+/**
+ * source_map - Maps a regular file followed by at least one zero byte.
+ * @fd: Descriptor of the file.
+ * @size: Size of the file.
+ * @source: Receives the mapping.
+ *
+ * A zeroed anonymous region one byte larger than the file is reserved and
+ * the file is mapped over its start, so the text is NUL terminated even
+ * when its size is a multiple of the page size.
+ *
+ * Return: true on success, false on failure.
+ */
+static bool source_map(int fd, size_t size, Source *source)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t mapped = (size + 1 + page - 1) / page * page;
+	void *region = mmap(NULL, mapped, PROT_READ,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (region == MAP_FAILED)
+		return false;
+	if (mmap(region, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+	    MAP_FAILED) {
+		munmap(region, mapped);
+		return false;
+	}
+	madvise(region, mapped, MADV_SEQUENTIAL);
+	source->data = region;
+	source->size = size;
+	source->mapped = mapped;
+	return true;
+}
+
+/**
+ * source_read - Reads a whole file into a NUL terminated heap buffer.
+ * @fd: Descriptor of the file.
+ * @source: Receives the buffer.
+ *
+ * Used for pipes, terminals and other files that cannot be mapped.
+ *
+ * Return: true on success, false on failure with errno set.
+ */
+static bool source_read(int fd, Source *source)
+{
+	size_t size = 0, capacity = SOURCE_READ_CHUNK;
+	char *data = malloc(capacity + 1);
+
+	if (!data)
+		return false;
+	for (;;) {
+		ssize_t n = read(fd, data + size, capacity - size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			free(data);
+			return false;
+		}
+		if (n == 0)
+			break;
+		size += n;
+		if (size == capacity) {
+			char *grown = realloc(data, capacity * 2 + 1);
+			if (!grown) {
+				free(data);
+				return false;
+			}
+			data = grown;
+			capacity *= 2;
+		}
+	}
+	data[size] = '\0';
+	source->data = data;
+	source->size = size;
+	source->mapped = 0;
+	return true;
+}
+
+/**
+ * source_open - Loads a script so it can be lexed in place.
+ * @shell: Pointer to the shell state.
+ * @path: Path of the script.
+ * @source: Receives the script text.
+ *
+ * Non-empty regular files are mapped; anything else is read in one go.
+ *
+ * Return: true on success, false if the script could not be loaded.
+ */
+bool source_open(ShellState *shell, const char *path, Source *source)
+{
+	struct stat sinfo;
+	bool loaded;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		fprintf(stderr, "Error: cannot open file %s\n", path);
+		return false;
+	}
+	if (fstat(fd, &sinfo) == 0 && S_ISREG(sinfo.st_mode) &&
+	    sinfo.st_size > 0)
+		loaded = source_map(fd, sinfo.st_size, source) ||
+			 source_read(fd, source);
+	else
+		loaded = source_read(fd, source);
+	if (!loaded)
+		fprintf(stderr, "%s: %s: %s\n", shell->name, path,
+			strerror(errno));
+	close(fd);
+	return loaded;
+}
+
+/**
+ * source_close - Releases a script loaded by source_open().
+ * @source: The script to release.
+ */
+void source_close(Source *source)
+{
+	if (source->mapped)
+		munmap(source->data, source->mapped);
+	else
+		free(source->data);
+	source->data = NULL;
+}
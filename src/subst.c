@@ -0,0 +1,359 @@
+#include <subst.h>
+#include <arena.h>
+#include <builtins.h>
+#include <executor.h>
+#include <jobs.h>
+#include <lexer.h>
+#include <parser.h>
+#include <token.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SUBST_READ_SIZE 65536
+
+/**
+ * subst_oom - Reports an allocation failure.
+ * @shell: Pointer to the shell state.
+ *
+ * Return: -1.
+ */
+static int subst_oom(ShellState *shell)
+{
+	fprintf(stderr, "Error: malloc failed\n");
+	shell->fatal_error = true;
+	return -1;
+}
+
+/**
+ * subst_parse - Parses the body of a command substitution.
+ * @shell: Pointer to the shell state, whose syntax tree is empty.
+ * @text: The body, NUL terminated.
+ * @roots: Receives the root of every command, in the shell's arena.
+ * @count: Receives the number of commands.
+ *
+ * Return: true on success, false on a syntax error or allocation
+ * failure, after reporting it.
+ */
+static bool subst_parse(ShellState *shell, const char *text, NodeIndex **roots,
+			size_t *count)
+{
+	size_t length, total = 0;
+	Token *tokens = tokenize_line(shell, text, &length);
+	Token **commands;
+
+	if (shell->had_error || shell->fatal_error)
+		return false;
+	commands = token_split_by_semicolon(shell, tokens);
+	if (!commands)
+		return false;
+	while (commands[total])
+		total++;
+	*roots = arena_alloc(shell->arena, sizeof(NodeIndex) * (total + 1));
+	if (!*roots) {
+		subst_oom(shell);
+		return false;
+	}
+	for (size_t i = 0; i < total; i++) {
+		(*roots)[i] = parse(shell, commands[i]);
+		if (shell->had_error || shell->fatal_error)
+			return false;
+	}
+	*count = total;
+	return true;
+}
+
+/**
+ * subst_assigns - Tells whether words may assign to a variable.
+ * @words: NULL terminated words, before expansion.
+ *
+ * Only ${name=word} and ${name:=word} assign while they are expanded;
+ * any word with both a "${" and a '=' is taken for one.
+ *
+ * Return: true if a word may assign, false otherwise.
+ */
+static bool subst_assigns(char **words)
+{
+	for (; *words; words++) {
+		if (strstr(*words, "${") && strchr(*words, '='))
+			return true;
+	}
+	return false;
+}
+
+/**
+ * subst_is_pure - Tells whether a command can run in the shell itself.
+ * @shell: Pointer to the shell state.
+ * @ast: The syntax tree holding the command.
+ * @index: Index of the command's node.
+ *
+ * That is the case of pure builtins named literally, without
+ * assignments or redirections, alone or joined by && and ||: running
+ * them leaves nothing behind but their status and output.
+ *
+ * Return: true if the command can run in the shell, false otherwise.
+ */
+static bool subst_is_pure(ShellState *shell, const Ast *ast, NodeIndex index)
+{
+	const Node *node;
+	SimpleCommand simple;
+
+	if (index == AST_NONE)
+		return true;
+	node = &ast->nodes[index];
+	if (node->flags & NODE_BACKGROUND)
+		return false;
+	switch (node->type) {
+	case CMD_SIMPLE:
+		ast_simple(ast, node, &simple);
+		return simple.argc > 0 && !*simple.envp && !*simple.targets &&
+		       !strchr(simple.argv[0], '$') &&
+		       !subst_assigns(simple.argv) &&
+		       builtin_is_pure(shell, simple.argv[0]);
+	case CMD_AND:
+	case CMD_OR:
+		return subst_is_pure(shell, ast, node->as.binary.left) &&
+		       subst_is_pure(shell, ast, node->as.binary.right);
+	default:
+		return false;
+	}
+}
+
+/**
+ * subst_is_simple - Tells whether a substitution is one simple command
+ *                   that can be started without a subshell.
+ * @ast: The syntax tree holding the commands.
+ * @roots: The commands.
+ * @count: Number of commands.
+ *
+ * Expanding its words in the shell must not assign to a variable.
+ *
+ * Return: true if the command can be started directly, false otherwise.
+ */
+static bool subst_is_simple(const Ast *ast, const NodeIndex *roots,
+			    size_t count)
+{
+	const Node *node;
+	SimpleCommand simple;
+
+	if (count != 1 || roots[0] == AST_NONE)
+		return false;
+	node = &ast->nodes[roots[0]];
+	if (node->type != CMD_SIMPLE ||
+	    (node->flags & (NODE_BACKGROUND | NODE_TIMED)))
+		return false;
+	ast_simple(ast, node, &simple);
+	return !subst_assigns(simple.envp) && !subst_assigns(simple.argv);
+}
+
+/**
+ * subst_run - Runs the commands of a substitution one after the other.
+ * @shell: Pointer to the shell state.
+ * @roots: The commands.
+ * @count: Number of commands.
+ *
+ * As in a subshell, an error stops the commands and makes the status 2.
+ *
+ * Return: The status of the last command run.
+ */
+static int subst_run(ShellState *shell, const NodeIndex *roots, size_t count)
+{
+	int status = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		status = execute(shell, &shell->ast, roots[i]);
+		if (shell->fatal_error)
+			return 1;
+		if (shell->had_error)
+			return 2;
+	}
+	return status;
+}
+
+/**
+ * subst_in_process - Runs a substitution of pure builtins in the shell.
+ * @shell: Pointer to the shell state.
+ * @roots: The commands.
+ * @count: Number of commands.
+ * @output: Receives the output, allocated with malloc().
+ * @size: Receives the size of the output.
+ *
+ * Standard output is swapped for a memory stream while the builtins run,
+ * so nothing is forked, piped or copied through the kernel.
+ *
+ * Return: The status of the commands, or -1 on allocation failure.
+ */
+static int subst_in_process(ShellState *shell, const NodeIndex *roots,
+			    size_t count, char **output, size_t *size)
+{
+	FILE *saved = stdout, *capture = open_memstream(output, size);
+	int status;
+
+	if (!capture)
+		return subst_oom(shell);
+	stdout = capture;
+	status = subst_run(shell, roots, count);
+	stdout = saved;
+	if (fclose(capture)) {
+		free(*output);
+		return subst_oom(shell);
+	}
+	return status;
+}
+
+/**
+ * subst_read - Reads everything a substitution writes to its pipe.
+ * @shell: Pointer to the shell state.
+ * @fd: The read end of the pipe.
+ * @output: Receives the output, allocated with malloc().
+ * @size: Receives the size of the output.
+ *
+ * Reads go straight into the buffer, at least SUBST_READ_SIZE bytes at
+ * a time, and the buffer doubles as it fills.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool subst_read(ShellState *shell, int fd, char **output, size_t *size)
+{
+	char *buffer = NULL, *grown;
+	size_t length = 0, capacity = 0;
+	ssize_t n;
+
+	for (;;) {
+		if (capacity - length < SUBST_READ_SIZE) {
+			capacity = capacity ? capacity * 2 : SUBST_READ_SIZE;
+			grown = realloc(buffer, capacity);
+			if (!grown) {
+				free(buffer);
+				subst_oom(shell);
+				return false;
+			}
+			buffer = grown;
+		}
+		n = read(fd, buffer + length, capacity - length);
+		if (n > 0)
+			length += n;
+		else if (n == 0 || errno != EINTR)
+			break;
+	}
+	*output = buffer;
+	*size = length;
+	return true;
+}
+
+/**
+ * subst_fork - Runs a substitution in a child process.
+ * @shell: Pointer to the shell state.
+ * @roots: The commands.
+ * @count: Number of commands.
+ * @output: Receives the output, allocated with malloc().
+ * @size: Receives the size of the output.
+ *
+ * A single program is spawned straight onto the pipe, as a pipeline
+ * stage would be; anything else runs in a forked subshell.
+ *
+ * Return: The exit status of the child, or -1 if it could not run.
+ */
+static int subst_fork(ShellState *shell, const NodeIndex *roots, size_t count,
+		      char **output, size_t *size)
+{
+	int fds[2], raw, status = 0;
+	uint64_t start;
+	pid_t pid;
+	bool captured;
+
+	if (pipe(fds) == -1) {
+		fprintf(stderr, "%s: pipe failed: %s\n", shell->name,
+			strerror(errno));
+		return -1;
+	}
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	if (subst_is_simple(&shell->ast, roots, count)) {
+		pid = execute_capture(shell, &shell->ast, roots[0], fds[1],
+				      &status);
+	} else {
+		fflush(stdout);
+		start = trace_now(shell->trace);
+		pid = fork();
+		if (pid == 0) {
+			jobs_forget(shell);
+			close(fds[0]);
+			dup2(fds[1], STDOUT_FILENO);
+			close(fds[1]);
+			raw = subst_run(shell, roots, count);
+			fflush(stdout);
+			_exit(raw);
+		}
+		trace_span(shell->trace, "fork", start);
+		if (pid < 0) {
+			fprintf(stderr, "%s: fork failed: %s\n", shell->name,
+				strerror(errno));
+			status = 1;
+		}
+	}
+	close(fds[1]);
+	captured = subst_read(shell, fds[0], output, size);
+	close(fds[0]);
+	if (pid < 0)
+		return captured ? status : -1;
+	start = trace_now(shell->trace);
+	timing_wait(shell->timing, pid, &raw, 0);
+	trace_span(shell->trace, "waitpid", start);
+	return captured ? exit_status(raw) : -1;
+}
+
+/**
+ * subst_capture - Runs the body of a $(...) and collects its output.
+ * @shell: Pointer to the shell state.
+ * @body: The text between the parentheses.
+ * @length: Length of @body.
+ * @output: Receives the output, allocated with malloc().
+ * @size: Receives the size of the output.
+ *
+ * The body is parsed into a syntax tree of its own; the shell's tree and
+ * expansion buffers, which the command being expanded still uses, are
+ * set aside meanwhile and restored after. A body made only of pure
+ * builtins then runs in the shell, with its output captured in memory;
+ * anything else runs in a forked subshell writing to a pipe. Either way
+ * an error in the body only affects its status, and $? is left as it
+ * was for the rest of the command.
+ *
+ * Return: The status of the body, or -1 if it could not run, after
+ * reporting why.
+ */
+int subst_capture(ShellState *shell, const char *body, size_t length,
+		  char **output, size_t *size)
+{
+	char *text = arena_strndup(shell->arena, body, length);
+	Ast ast = shell->ast;
+	Expansion expansion = shell->expansion;
+	NodeIndex *roots;
+	size_t count;
+	int status = -1, saved = shell->status;
+	bool pure = true;
+
+	if (!text)
+		return subst_oom(shell);
+	memset(&shell->ast, 0, sizeof(Ast));
+	memset(&shell->expansion, 0, sizeof(Expansion));
+	if (subst_parse(shell, text, &roots, &count)) {
+		for (size_t i = 0; pure && i < count; i++)
+			pure = subst_is_pure(shell, &shell->ast, roots[i]);
+		if (pure)
+			status = subst_in_process(shell, roots, count, output,
+						  size);
+		else
+			status = subst_fork(shell, roots, count, output, size);
+		shell->had_error = false;
+	}
+	ast_free(&shell->ast);
+	expand_free(&shell->expansion);
+	shell->ast = ast;
+	shell->expansion = expansion;
+	shell->status = saved;
+	return status;
+}
@@ -0,0 +1,231 @@
+#include <table.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TABLE_INITIAL_CAPACITY 64
+
+/**
+ * table_hash - Computes the FNV-1a hash of a string.
+ * @key: The string to hash.
+ * @length: Length of @key.
+ *
+ * Return: The 32-bit hash value.
+ */
+static uint32_t table_hash(const char *key, size_t length)
+{
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char)key[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * table_new - Creates an empty hash table.
+ * @free_value: Function used to release values, or NULL.
+ *
+ * Return: Pointer to the new table, or NULL on failure.
+ */
+Table *table_new(void (*free_value)(void *))
+{
+	Table *table = malloc(sizeof(Table));
+	if (!table)
+		return NULL;
+
+	table->buckets = calloc(TABLE_INITIAL_CAPACITY, sizeof(TableEntry *));
+	if (!table->buckets) {
+		free(table);
+		return NULL;
+	}
+	table->capacity = TABLE_INITIAL_CAPACITY;
+	table->count = 0;
+	table->free_value = free_value;
+	return table;
+}
+
+/**
+ * table_entry_free - Frees a single entry along with its key and value.
+ * @table: The table owning the entry.
+ * @entry: The entry to free.
+ */
+static void table_entry_free(Table *table, TableEntry *entry)
+{
+	if (table->free_value)
+		table->free_value(entry->value);
+	free(entry->key);
+	free(entry);
+}
+
+/**
+ * table_clear - Removes every entry from the table.
+ * @table: The table to clear.
+ */
+void table_clear(Table *table)
+{
+	for (size_t i = 0; i < table->capacity; i++) {
+		TableEntry *entry = table->buckets[i];
+		while (entry) {
+			TableEntry *next = entry->next;
+			table_entry_free(table, entry);
+			entry = next;
+		}
+		table->buckets[i] = NULL;
+	}
+	table->count = 0;
+}
+
+/**
+ * table_free - Frees the table and all of its entries.
+ * @table: The table to free.
+ */
+void table_free(Table *table)
+{
+	if (!table)
+		return;
+	table_clear(table);
+	free(table->buckets);
+	free(table);
+}
+
+/**
+ * table_find - Looks up an entry by key.
+ * @table: The table to search.
+ * @key: The key to look for.
+ *
+ * Return: The matching entry, or NULL if the key is absent.
+ */
+TableEntry *table_find(Table *table, const char *key)
+{
+	return table_find_n(table, key, strlen(key));
+}
+
+/**
+ * table_find_n - Looks up an entry by a key that is not NUL terminated.
+ * @table: The table to search.
+ * @key: The key to look for.
+ * @length: Length of @key.
+ *
+ * Return: The matching entry, or NULL if the key is absent.
+ */
+TableEntry *table_find_n(Table *table, const char *key, size_t length)
+{
+	uint32_t hash = table_hash(key, length);
+	TableEntry *entry = table->buckets[hash & (table->capacity - 1)];
+
+	for (; entry; entry = entry->next) {
+		if (entry->hash == hash && !strncmp(entry->key, key, length) &&
+		    !entry->key[length])
+			return entry;
+	}
+	return NULL;
+}
+
+/**
+ * table_grow - Doubles the bucket array and rehashes every entry.
+ * @table: The table to grow.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool table_grow(Table *table)
+{
+	size_t capacity = table->capacity * 2;
+	TableEntry **buckets = calloc(capacity, sizeof(TableEntry *));
+	if (!buckets)
+		return false;
+
+	for (size_t i = 0; i < table->capacity; i++) {
+		TableEntry *entry = table->buckets[i];
+		while (entry) {
+			TableEntry *next = entry->next;
+			size_t index = entry->hash & (capacity - 1);
+			entry->next = buckets[index];
+			buckets[index] = entry;
+			entry = next;
+		}
+	}
+	free(table->buckets);
+	table->buckets = buckets;
+	table->capacity = capacity;
+	return true;
+}
+
+/**
+ * table_insert - Inserts or replaces the value stored under a key.
+ * @table: The table to insert into.
+ * @key: The key, copied by the table.
+ * @value: The value to store.
+ *
+ * Return: The entry holding the value, or NULL on allocation failure.
+ */
+TableEntry *table_insert(Table *table, const char *key, void *value)
+{
+	TableEntry *entry = table_find(table, key);
+
+	if (entry) {
+		if (table->free_value && entry->value != value)
+			table->free_value(entry->value);
+		entry->value = value;
+		return entry;
+	}
+
+	if (table->count + 1 > table->capacity / 4 * 3 && !table_grow(table))
+		return NULL;
+
+	entry = malloc(sizeof(TableEntry));
+	if (!entry)
+		return NULL;
+	entry->key = strdup(key);
+	if (!entry->key) {
+		free(entry);
+		return NULL;
+	}
+	entry->value = value;
+	entry->hash = table_hash(key, strlen(key));
+
+	size_t index = entry->hash & (table->capacity - 1);
+	entry->next = table->buckets[index];
+	table->buckets[index] = entry;
+	table->count++;
+	return entry;
+}
+
+/**
+ * table_remove - Removes the entry stored under a key.
+ * @table: The table to remove from.
+ * @key: The key to remove.
+ *
+ * Return: true if an entry was removed, false if the key was absent.
+ */
+bool table_remove(Table *table, const char *key)
+{
+	uint32_t hash = table_hash(key, strlen(key));
+	TableEntry **link = &table->buckets[hash & (table->capacity - 1)];
+
+	for (; *link; link = &(*link)->next) {
+		TableEntry *entry = *link;
+		if (entry->hash == hash && !strcmp(entry->key, key)) {
+			*link = entry->next;
+			table_entry_free(table, entry);
+			table->count--;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * table_each - Calls a function on every entry of the table.
+ * @table: The table to walk.
+ * @fn: The function to call with each entry.
+ * @ctx: Opaque pointer passed through to @fn.
+ */
+void table_each(Table *table, void (*fn)(TableEntry *, void *), void *ctx)
+{
+	for (size_t i = 0; i < table->capacity; i++) {
+		for (TableEntry *entry = table->buckets[i]; entry;
+		     entry = entry->next)
+			fn(entry, ctx);
+	}
+}
@@ -0,0 +1,422 @@
+#include <builtins.h>
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct TestState {
+	ShellState *shell;
+	char **argv;
+	int argc;
+	int pos;
+	bool failed;
+} TestState;
+
+static bool test_expr(TestState *t);
+
+/**
+ * test_error - Reports a malformed expression.
+ * @t: The evaluation state.
+ * @message: Description of the problem.
+ * @arg: The offending argument, or NULL.
+ *
+ * Return: false, so callers can return the result directly.
+ */
+static bool test_error(TestState *t, const char *message, const char *arg)
+{
+	if (!t->failed) {
+		if (arg)
+			fprintf(stderr, "%s: test: %s: %s\n", t->shell->name,
+				arg, message);
+		else
+			fprintf(stderr, "%s: test: %s\n", t->shell->name,
+				message);
+	}
+	t->failed = true;
+	return false;
+}
+
+/**
+ * test_number - Parses an integer operand.
+ * @t: The evaluation state.
+ * @arg: The operand.
+ * @value: Receives the value.
+ *
+ * Return: true on success, false if @arg is not an integer.
+ */
+static bool test_number(TestState *t, const char *arg, intmax_t *value)
+{
+	char *end;
+
+	while (isblank((unsigned char)*arg))
+		arg++;
+	errno = 0;
+	*value = strtoimax(arg, &end, 10);
+	while (isblank((unsigned char)*end))
+		end++;
+	if (end == arg || *end || errno)
+		return test_error(t, "bad number", arg);
+	return true;
+}
+
+/**
+ * test_unary_op - Checks whether an argument is a unary primary.
+ * @op: The argument.
+ *
+ * Return: true if @op is a unary primary, false otherwise.
+ */
+static bool test_unary_op(const char *op)
+{
+	return op[0] == '-' && op[1] && !op[2] &&
+	       strchr("bcdefghLnprsStuwxz", op[1]);
+}
+
+/**
+ * test_binary_op - Checks whether an argument is a binary primary.
+ * @op: The argument.
+ *
+ * Return: true if @op is a binary primary, false otherwise.
+ */
+static bool test_binary_op(const char *op)
+{
+	static const char *const ops[] = { "=",   "!=",  "<",   ">",
+					   "-eq", "-ne", "-gt", "-ge",
+					   "-lt", "-le", "-nt", "-ot",
+					   "-ef" };
+
+	for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+		if (!strcmp(op, ops[i]))
+			return true;
+	}
+	return false;
+}
+
+/**
+ * test_unary - Evaluates a unary primary.
+ * @t: The evaluation state.
+ * @op: The primary, such as "-f".
+ * @arg: Its operand.
+ *
+ * Return: The truth value of the primary.
+ */
+static bool test_unary(TestState *t, const char *op, const char *arg)
+{
+	struct stat sinfo;
+	intmax_t fd;
+
+	switch (op[1]) {
+	case 'n':
+		return *arg != '\0';
+	case 'z':
+		return *arg == '\0';
+	case 't':
+		return test_number(t, arg, &fd) && fd >= 0 &&
+		       fd <= INT32_MAX && isatty((int)fd);
+	case 'r':
+		return !access(arg, R_OK);
+	case 'w':
+		return !access(arg, W_OK);
+	case 'x':
+		return !access(arg, X_OK);
+	case 'h':
+	case 'L':
+		return !lstat(arg, &sinfo) && S_ISLNK(sinfo.st_mode);
+	}
+
+	if (stat(arg, &sinfo))
+		return false;
+	switch (op[1]) {
+	case 'b':
+		return S_ISBLK(sinfo.st_mode);
+	case 'c':
+		return S_ISCHR(sinfo.st_mode);
+	case 'd':
+		return S_ISDIR(sinfo.st_mode);
+	case 'e':
+		return true;
+	case 'f':
+		return S_ISREG(sinfo.st_mode);
+	case 'g':
+		return sinfo.st_mode & S_ISGID;
+	case 'p':
+		return S_ISFIFO(sinfo.st_mode);
+	case 's':
+		return sinfo.st_size > 0;
+	case 'S':
+		return S_ISSOCK(sinfo.st_mode);
+	case 'u':
+		return sinfo.st_mode & S_ISUID;
+	}
+	return false;
+}
+
+/**
+ * test_newer - Compares the modification times of two files.
+ * @left: Path of the first file.
+ * @right: Path of the second file.
+ *
+ * A missing file is older than any existing one.
+ *
+ * Return: true if @left is newer than @right.
+ */
+static bool test_newer(const char *left, const char *right)
+{
+	struct stat l, r;
+
+	if (stat(left, &l))
+		return false;
+	if (stat(right, &r))
+		return true;
+	if (l.st_mtim.tv_sec != r.st_mtim.tv_sec)
+		return l.st_mtim.tv_sec > r.st_mtim.tv_sec;
+	return l.st_mtim.tv_nsec > r.st_mtim.tv_nsec;
+}
+
+/**
+ * test_binary - Evaluates a binary primary.
+ * @t: The evaluation state.
+ * @left: The left operand.
+ * @op: The primary, such as "-eq".
+ * @right: The right operand.
+ *
+ * Return: The truth value of the primary.
+ */
+static bool test_binary(TestState *t, const char *left, const char *op,
+			const char *right)
+{
+	intmax_t a, b;
+	struct stat l, r;
+
+	if (!strcmp(op, "="))
+		return !strcmp(left, right);
+	if (!strcmp(op, "!="))
+		return strcmp(left, right) != 0;
+	if (!strcmp(op, "<"))
+		return strcmp(left, right) < 0;
+	if (!strcmp(op, ">"))
+		return strcmp(left, right) > 0;
+	if (!strcmp(op, "-nt"))
+		return test_newer(left, right);
+	if (!strcmp(op, "-ot"))
+		return test_newer(right, left);
+	if (!strcmp(op, "-ef"))
+		return !stat(left, &l) && !stat(right, &r) &&
+		       l.st_dev == r.st_dev && l.st_ino == r.st_ino;
+
+	if (!test_number(t, left, &a) || !test_number(t, right, &b))
+		return false;
+	switch (op[1] << 8 | op[2]) {
+	case 'e' << 8 | 'q':
+		return a == b;
+	case 'n' << 8 | 'e':
+		return a != b;
+	case 'g' << 8 | 't':
+		return a > b;
+	case 'g' << 8 | 'e':
+		return a >= b;
+	case 'l' << 8 | 't':
+		return a < b;
+	default:
+		return a <= b;
+	}
+}
+
+/**
+ * test_peek - Returns an argument relative to the current position.
+ * @t: The evaluation state.
+ * @offset: Distance from the current position.
+ *
+ * Return: The argument, or NULL past the end.
+ */
+static const char *test_peek(TestState *t, int offset)
+{
+	return t->pos + offset < t->argc ? t->argv[t->pos + offset] : NULL;
+}
+
+/**
+ * test_primary - Evaluates a primary or a parenthesized expression.
+ * @t: The evaluation state.
+ *
+ * Return: The truth value of the primary.
+ */
+static bool test_primary(TestState *t)
+{
+	const char *arg = test_peek(t, 0), *next = test_peek(t, 1);
+	bool result;
+
+	if (!arg)
+		return test_error(t, "argument expected", NULL);
+
+	if (next && test_binary_op(next) && test_peek(t, 2)) {
+		t->pos += 3;
+		return test_binary(t, arg, next, t->argv[t->pos - 1]);
+	}
+	if (!strcmp(arg, "(")) {
+		t->pos++;
+		result = test_expr(t);
+		if (!test_peek(t, 0) || strcmp(test_peek(t, 0), ")"))
+			return test_error(t, "closing paren expected", NULL);
+		t->pos++;
+		return result;
+	}
+	if (test_unary_op(arg) && next) {
+		t->pos += 2;
+		return test_unary(t, arg, next);
+	}
+	t->pos++;
+	return *arg != '\0';
+}
+
+/**
+ * test_not - Evaluates a possibly negated primary.
+ * @t: The evaluation state.
+ *
+ * Return: The truth value of the expression.
+ */
+static bool test_not(TestState *t)
+{
+	const char *arg = test_peek(t, 0);
+
+	if (arg && !strcmp(arg, "!") && test_peek(t, 1)) {
+		t->pos++;
+		return !test_not(t);
+	}
+	return test_primary(t);
+}
+
+/**
+ * test_and - Evaluates primaries joined by -a.
+ * @t: The evaluation state.
+ *
+ * Return: The truth value of the expression.
+ */
+static bool test_and(TestState *t)
+{
+	bool result = test_not(t);
+
+	while (test_peek(t, 0) && !strcmp(test_peek(t, 0), "-a")) {
+		t->pos++;
+		result = test_not(t) && result;
+	}
+	return result;
+}
+
+/**
+ * test_expr - Evaluates expressions joined by -o.
+ * @t: The evaluation state.
+ *
+ * Return: The truth value of the expression.
+ */
+static bool test_expr(TestState *t)
+{
+	bool result = test_and(t);
+
+	while (test_peek(t, 0) && !strcmp(test_peek(t, 0), "-o")) {
+		t->pos++;
+		result = test_and(t) || result;
+	}
+	return result;
+}
+
+/**
+ * test_eval - Evaluates arguments using the POSIX argument-count rules.
+ * @t: The evaluation state.
+ * @argc: Number of arguments left to evaluate.
+ *
+ * Up to four arguments are disambiguated by count, as POSIX requires,
+ * so that operands such as "!" or "-n" are taken as strings where they
+ * must be. Longer expressions fall back to the precedence parser.
+ *
+ * Return: The truth value of the expression.
+ */
+static bool test_eval(TestState *t, int argc)
+{
+	const char *a = test_peek(t, 0), *b = test_peek(t, 1),
+		   *c = test_peek(t, 2);
+
+	switch (argc) {
+	case 0:
+		return false;
+	case 1:
+		t->pos++;
+		return *a != '\0';
+	case 2:
+		if (!strcmp(a, "!")) {
+			t->pos++;
+			return !test_eval(t, 1);
+		}
+		if (test_unary_op(a)) {
+			t->pos += 2;
+			return test_unary(t, a, b);
+		}
+		break;
+	case 3:
+		if (test_binary_op(b)) {
+			t->pos += 3;
+			return test_binary(t, a, b, c);
+		}
+		if (!strcmp(a, "!")) {
+			t->pos++;
+			return !test_eval(t, 2);
+		}
+		if (!strcmp(a, "(") && !strcmp(c, ")")) {
+			t->pos++;
+			bool result = test_eval(t, 1);
+			t->pos++;
+			return result;
+		}
+		break;
+	case 4:
+		if (!strcmp(a, "!")) {
+			t->pos++;
+			return !test_eval(t, 3);
+		}
+		if (!strcmp(a, "(") && !strcmp(test_peek(t, 3), ")")) {
+			t->pos++;
+			bool result = test_eval(t, 2);
+			t->pos++;
+			return result;
+		}
+		break;
+	}
+	return test_expr(t);
+}
+
+/**
+ * builtin_test - Evaluates a conditional expression.
+ * @shell: Pointer to the shell state.
+ * @command: The command being executed.
+ * @is_background: Unused.
+ *
+ * Invoked as `[`, the last argument must be `]`.
+ *
+ * Return: 0 if the expression is true, 1 if false, 2 on error.
+ */
+int builtin_test(ShellState *shell, SimpleCommand *command,
+		 bool is_background)
+{
+	TestState t = { .shell = shell,
+			.argv = command->argv + 1,
+			.argc = command->argc - 1 };
+	bool result;
+
+	(void)is_background;
+	if (!strcmp(command->argv[0], "[")) {
+		if (t.argc == 0 || strcmp(t.argv[t.argc - 1], "]")) {
+			fprintf(stderr, "%s: [: missing ]\n", shell->name);
+			return 2;
+		}
+		t.argc--;
+	}
+
+	result = test_eval(&t, t.argc);
+	if (!t.failed && t.pos < t.argc)
+		test_error(&t, "unexpected operator", t.argv[t.pos]);
+	if (t.failed)
+		return 2;
+	return result ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+#include <timing.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+/**
+ * timing_seconds - Converts a timeval to seconds.
+ * @tv: The time.
+ *
+ * Return: The time in seconds.
+ */
+static double timing_seconds(const struct timeval *tv)
+{
+	return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+/**
+ * timing_start - Starts timing a pipeline.
+ * @timing: The timing to start.
+ * @outer: The timing the pipeline runs under, or NULL.
+ * @posix: true to report in the format of `time -p`.
+ */
+void timing_start(Timing *timing, Timing *outer, bool posix)
+{
+	memset(timing, 0, sizeof(Timing));
+	timing->posix = posix;
+	timing->outer = outer;
+	getrusage(RUSAGE_SELF, &timing->self);
+	clock_gettime(CLOCK_MONOTONIC, &timing->start);
+}
+
+/**
+ * timing_wait - Waits for a child, adding its usage to the timings.
+ * @timing: The innermost running timing, or NULL.
+ * @pid: The child, or -1 for any child.
+ * @raw: Receives the status as reported by waitpid(), or NULL.
+ * @options: Options for waitpid(), such as WNOHANG or WUNTRACED.
+ *
+ * Without a timing this is waitpid(). A child that only stopped is
+ * counted once it terminates.
+ *
+ * Return: The pid of the child, 0, or -1 as waitpid() returns.
+ */
+pid_t timing_wait(Timing *timing, pid_t pid, int *raw, int options)
+{
+	struct rusage usage;
+	int status;
+	pid_t waited;
+
+	if (!timing)
+		return waitpid(pid, raw, options);
+	waited = wait4(pid, &status, options, &usage);
+	if (waited <= 0)
+		return waited;
+	if (raw)
+		*raw = status;
+	if (WIFSTOPPED(status))
+		return waited;
+	for (; timing; timing = timing->outer) {
+		timeradd(&timing->children.ru_utime, &usage.ru_utime,
+			 &timing->children.ru_utime);
+		timeradd(&timing->children.ru_stime, &usage.ru_stime,
+			 &timing->children.ru_stime);
+		if (usage.ru_maxrss > timing->children.ru_maxrss)
+			timing->children.ru_maxrss = usage.ru_maxrss;
+		timing->processes++;
+	}
+	return waited;
+}
+
+/**
+ * timing_print_seconds - Prints a time as minutes and seconds.
+ * @name: Label of the time.
+ * @seconds: The time.
+ */
+static void timing_print_seconds(const char *name, double seconds)
+{
+	int minutes = seconds / 60;
+
+	fprintf(stderr, "%s\t%dm%.3fs\n", name, minutes,
+		seconds - minutes * 60);
+}
+
+/**
+ * timing_report - Reports the times of a finished pipeline on stderr.
+ * @timing: The timing.
+ * @format: The value of HSH_TIMEFORMAT, or NULL.
+ *
+ * `time -p` gets the three lines POSIX specifies, whatever @format
+ * says. Otherwise the times are given in minutes and seconds together
+ * with the largest resident set of any process, or as one JSON object
+ * when @format is "json". A pipeline of builtins starts no process, and
+ * the shell's own peak covers its whole life, so how much the pipeline
+ * raised it is given instead: as "+Nk", or as maxrss_growth in JSON.
+ * Standard output is flushed first so the report follows what the
+ * pipeline printed.
+ */
+void timing_report(const Timing *timing, const char *format)
+{
+	struct timespec now;
+	struct rusage self;
+	struct timeval user, sys;
+	double real;
+	long maxrss = timing->children.ru_maxrss;
+	bool json = format && !strcmp(format, "json");
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	getrusage(RUSAGE_SELF, &self);
+	real = (now.tv_sec - timing->start.tv_sec) +
+	       (now.tv_nsec - timing->start.tv_nsec) / 1e9;
+	timersub(&self.ru_utime, &timing->self.ru_utime, &user);
+	timersub(&self.ru_stime, &timing->self.ru_stime, &sys);
+	timeradd(&user, &timing->children.ru_utime, &user);
+	timeradd(&sys, &timing->children.ru_stime, &sys);
+	if (!timing->processes)
+		maxrss = self.ru_maxrss - timing->self.ru_maxrss;
+
+	fflush(stdout);
+	if (timing->posix) {
+		fprintf(stderr, "real %.2f\nuser %.2f\nsys %.2f\n", real,
+			timing_seconds(&user), timing_seconds(&sys));
+	} else if (json) {
+		fprintf(stderr,
+			"{\"real\":%.6f,\"user\":%.6f,\"sys\":%.6f,"
+			"\"%s\":%ld,\"processes\":%zu}\n",
+			real, timing_seconds(&user), timing_seconds(&sys),
+			timing->processes ? "maxrss" : "maxrss_growth",
+			maxrss, timing->processes);
+	} else {
+		fputc('\n', stderr);
+		timing_print_seconds("real", real);
+		timing_print_seconds("user", timing_seconds(&user));
+		timing_print_seconds("sys", timing_seconds(&sys));
+		fprintf(stderr, timing->processes ? "maxrss\t%ldk\n" :
+						     "maxrss\t+%ldk\n",
+			maxrss);
+	}
+}
@@ -1,21 +1,161 @@
 #include <token.h>
-#include <stdlib.h>
+#include <arena.h>
+#include <scan.h>
+#include <stdio.h>
+#include <string.h>
+
 /**
- * token_free_list - Frees a linked list of tokens.
- * @head: Pointer to the head of the token list.
+ * token_new_eol - Allocates an end-of-line token from the shell's arena.
+ * @shell: Pointer to the shell state.
+ *
+ * Return: Pointer to the new token, or NULL on memory allocation failure.
  */
-void token_free_list(Token *head)
+static Token *token_new_eol(ShellState *shell)
 {
-	Token *current = head;
-	Token *next;
+	Token *node = arena_alloc(shell->arena, sizeof(Token));
+	if (!node) {
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+		return NULL;
+	}
+	node->type = TOKEN_EOL;
+	node->text = "\n";
+	node->length = 1;
+	node->quoted = false;
+	node->expand = false;
+	node->next = NULL;
+	return node;
+}
 
-	while (current != NULL) {
-		next = current->next;
-		if (current->type == TOKEN_WORD ||
-		    current->type == TOKEN_ASSIGNMENT_WORD)
-			free(current->lexeme);
-		free(current);
-		current = next;
+/**
+ * token_lexeme - Materializes the text of a token as a string.
+ * @shell: Pointer to the shell state.
+ * @token: The token whose text is copied.
+ *
+ * Tokens only reference their source text, so this is the single place a
+ * word is copied. Quote characters are removed from quoted words, except
+ * from words with a '$', which keep their quotes for expand_simple(). A
+ * backslash outside single quotes is removed and the character after it
+ * kept as it is, except inside double quotes, where it only escapes '$',
+ * '`', '"', '\\' and newline; an escaped newline is removed too.
+ *
+ * Return: The NUL terminated text in the shell's arena, or NULL on failure.
+ */
+char *token_lexeme(ShellState *shell, const Token *token)
+{
+	char *lexeme = arena_alloc(shell->arena, token->length + 1);
+	size_t n = 0;
+	char quote = '\0';
+
+	if (!lexeme) {
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+		return NULL;
+	}
+	if (!token->quoted || token->expand) {
+		memcpy(lexeme, token->text, token->length);
+		lexeme[token->length] = '\0';
+		return lexeme;
+	}
+
+	for (size_t i = 0; i < token->length; i++) {
+		char c = token->text[i];
+
+		if (c == '\\' && quote != '\'' && i + 1 < token->length) {
+			c = token->text[++i];
+			if (quote && !strchr(SCAN_DQUOTE_ESCAPES, c))
+				lexeme[n++] = '\\';
+			if (c != '\n')
+				lexeme[n++] = c;
+		} else if (quote) {
+			if (c == quote)
+				quote = '\0';
+			else
+				lexeme[n++] = c;
+		} else if (c == '\'' || c == '"') {
+			quote = c;
+		} else {
+			lexeme[n++] = c;
+		}
+	}
+	lexeme[n] = '\0';
+	return lexeme;
+}
+
+/**
+ * token_pattern - Materializes the text of a case pattern.
+ * @shell: Pointer to the shell state.
+ * @token: The pattern's word token, without a '$'.
+ *
+ * As token_lexeme(), except that the pattern characters of quoted or
+ * escaped text are escaped with a backslash, so they only match
+ * themselves.
+ *
+ * Return: The NUL terminated text in the shell's arena, or NULL on failure.
+ */
+char *token_pattern(ShellState *shell, const Token *token)
+{
+	char *pattern = arena_alloc(shell->arena, token->length * 2 + 1);
+	size_t n = 0;
+	char quote = '\0';
+
+	if (!pattern) {
+		fprintf(stderr, "Error: malloc failed\n");
+		shell->fatal_error = true;
+		return NULL;
+	}
+	for (size_t i = 0; i < token->length; i++) {
+		char c = token->text[i];
+
+		if (c == '\\' && quote != '\'' && i + 1 < token->length) {
+			c = token->text[++i];
+			if (quote && !strchr(SCAN_DQUOTE_ESCAPES, c)) {
+				pattern[n++] = '\\';
+				pattern[n++] = '\\';
+			}
+			if (c == '\n')
+				continue;
+			if (strchr("*?[]\\", c))
+				pattern[n++] = '\\';
+			pattern[n++] = c;
+		} else if (quote && c == quote) {
+			quote = '\0';
+		} else if (!quote && (c == '\'' || c == '"')) {
+			quote = c;
+		} else {
+			if (quote && strchr("*?[]\\", c))
+				pattern[n++] = '\\';
+			pattern[n++] = c;
+		}
+	}
+	pattern[n] = '\0';
+	return pattern;
+}
+
+/**
+ * token_nesting - Tells how a token changes the nesting of compound
+ *                 commands.
+ * @token: The token.
+ *
+ * Return: 1 if it opens a compound command, -1 if it closes one, else 0.
+ */
+static int token_nesting(const Token *token)
+{
+	switch (token->type) {
+	case TOKEN_IF:
+	case TOKEN_WHILE:
+	case TOKEN_UNTIL:
+	case TOKEN_FOR:
+	case TOKEN_CASE:
+	case TOKEN_LBRACE:
+		return 1;
+	case TOKEN_FI:
+	case TOKEN_DONE:
+	case TOKEN_ESAC:
+	case TOKEN_RBRACE:
+		return -1;
+	default:
+		return 0;
 	}
 }
 
@@ -25,66 +165,61 @@ void token_free_list(Token *head)
  * @shell: Pointer to the shell state.
  * @tokens: Pointer to the head of the token list.
  *
+ * Semicolons inside a compound command separate its own commands and are
+ * left for the parser, so a compound command is parsed whole. Every list
+ * is terminated by an EOL token. All memory comes from the shell's
+ * arena, so nothing needs to be freed by the caller.
+ *
  * Return: An array of pointers to the heads of the split token lists.
  *         The array is NULL-terminated. Returns NULL on memory allocation failure.
  */
 Token **token_split_by_semicolon(ShellState *shell, Token *tokens)
 {
 	Token **commands;
-	Token *current = tokens, *prev = NULL, *next = NULL, *start = tokens;
-	Token *node = malloc(sizeof(Token));
-	size_t count = 0, index = 0;
+	Token *current, *prev = NULL, *next, *start = tokens, *node;
+	size_t count = 1, index = 0;
+	int depth = 0;
 
-	if (!node) {
-		shell->fatal_error = true;
-		return NULL;
-	}
-
-	count++;
-	while (current) {
-		if (current->type == TOKEN_SEMICOLON)
+	for (current = tokens; current; current = current->next) {
+		depth += token_nesting(current);
+		if (depth < 0)
+			depth = 0;
+		if (current->type == TOKEN_SEMICOLON && !depth)
 			count++;
-		current = current->next;
 	}
 
-	commands = malloc(sizeof(Token *) * (count + 1));
+	commands = arena_alloc(shell->arena, sizeof(Token *) * (count + 1));
 	if (!commands) {
+		fprintf(stderr, "Error: malloc failed\n");
 		shell->fatal_error = true;
-		free(node);
 		return NULL;
 	}
 
-	current = tokens;
-	start = current;
-	while (current) {
+	for (current = tokens; current; current = next) {
 		next = current->next;
-		if (current->type == TOKEN_SEMICOLON) {
-			node->type = TOKEN_EOL;
-			node->lexeme = "\n";
-			node->next = NULL;
-			if (!prev) {
-				commands[index++] = node;
-			} else {
-				prev->next = node;
-				commands[index++] = start;
-			}
-			start = next;
-			node = malloc(sizeof(Token));
-			if (!node) {
-				shell->fatal_error = true;
-				commands[index] = NULL;
-				return commands;
-			}
+		depth += token_nesting(current);
+		if (depth < 0)
+			depth = 0;
+		if (current->type != TOKEN_SEMICOLON || depth) {
+			prev = current;
+			continue;
+		}
+		node = token_new_eol(shell);
+		if (!node)
+			return NULL;
+		if (!prev) {
+			commands[index++] = node;
+		} else {
+			prev->next = node;
+			commands[index++] = start;
 		}
-		prev = current->type == TOKEN_SEMICOLON ? NULL : current;
-		if (current->type == TOKEN_SEMICOLON)
-			free(current);
-		current = next;
+		start = next;
+		prev = NULL;
 	}
 
-	node->type = TOKEN_EOL;
-	node->lexeme = "\n";
-	node->next = NULL;
+	node = token_new_eol(shell);
+	if (!node)
+		return NULL;
 	if (!prev) {
 		commands[index++] = node;
 	} else {
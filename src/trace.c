@@ -0,0 +1,204 @@
+#include <trace.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * trace_clock - Reads the monotonic clock.
+ *
+ * Return: The time in nanoseconds.
+ */
+static uint64_t trace_clock(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * trace_new - Starts tracing if HSH_TRACE names an output file.
+ *
+ * Return: The tracer, or NULL if tracing is off or could not be set up.
+ */
+Trace *trace_new(void)
+{
+	const char *path = getenv("HSH_TRACE");
+	Trace *trace;
+
+	if (!path || !*path)
+		return NULL;
+	trace = calloc(1, sizeof(Trace));
+	if (!trace)
+		return NULL;
+	trace->events = malloc(sizeof(TraceEvent) * TRACE_EVENTS);
+	trace->path = strdup(path);
+	if (!trace->events || !trace->path) {
+		fprintf(stderr, "Error: malloc failed\n");
+		free(trace->events);
+		free(trace->path);
+		free(trace);
+		return NULL;
+	}
+	trace->capacity = TRACE_EVENTS;
+	trace->pid = getpid();
+	trace->epoch = trace_clock();
+	return trace;
+}
+
+/**
+ * trace_now - Reads the clock for the start of a span.
+ * @trace: The tracer, or NULL.
+ *
+ * Return: The time in nanoseconds, or 0 when tracing is off.
+ */
+uint64_t trace_now(const Trace *trace)
+{
+	return trace ? trace_clock() : 0;
+}
+
+/**
+ * trace_record - Claims the next slot of the ring.
+ * @trace: The tracer.
+ * @start: When the span started.
+ *
+ * Return: The event to fill in, with its times set.
+ */
+static TraceEvent *trace_record(Trace *trace, uint64_t start)
+{
+	TraceEvent *event = &trace->events[trace->count++ % trace->capacity];
+
+	event->start = start;
+	event->duration = trace_clock() - start;
+	return event;
+}
+
+/**
+ * trace_span - Records a shell phase that ends now.
+ * @trace: The tracer, or NULL.
+ * @name: Name of the phase, a string that outlives the tracer.
+ * @start: When the phase started, from trace_now().
+ */
+void trace_span(Trace *trace, const char *name, uint64_t start)
+{
+	TraceEvent *event;
+
+	if (!trace)
+		return;
+	event = trace_record(trace, start);
+	event->name = name;
+	event->pid = trace->pid;
+	event->status = 0;
+}
+
+/**
+ * trace_command - Records a command that finished now.
+ * @trace: The tracer, or NULL.
+ * @label: Text naming the command, truncated to fit the event.
+ * @start: When the command was started, from trace_now().
+ * @pid: Process that ran the command.
+ * @status: Exit status of the command.
+ */
+void trace_command(Trace *trace, const char *label, uint64_t start,
+		   pid_t pid, int status)
+{
+	TraceEvent *event;
+
+	if (!trace)
+		return;
+	event = trace_record(trace, start);
+	event->name = NULL;
+	event->pid = pid;
+	event->status = status;
+	strncpy(event->label, label, TRACE_LABEL_SIZE - 1);
+	event->label[TRACE_LABEL_SIZE - 1] = '\0';
+}
+
+/**
+ * trace_write_string - Writes a JSON string literal.
+ * @file: The output file.
+ * @str: The string.
+ */
+static void trace_write_string(FILE *file, const char *str)
+{
+	putc('"', file);
+	for (; *str; str++) {
+		unsigned char c = *str;
+
+		if (c == '"' || c == '\\')
+			fprintf(file, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(file, "\\u%04x", c);
+		else
+			putc(c, file);
+	}
+	putc('"', file);
+}
+
+/**
+ * trace_write - Writes the ring as Chrome trace-event JSON.
+ * @trace: The tracer.
+ * @file: The output file.
+ *
+ * Every event is a complete ("X") event on the shell's track, with
+ * times in microseconds since the tracer started.
+ */
+static void trace_write(Trace *trace, FILE *file)
+{
+	size_t kept = trace->count < trace->capacity ? trace->count :
+						       trace->capacity;
+
+	fprintf(file,
+		"{\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":%zu},"
+		"\"traceEvents\":[\n"
+		"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+		"\"args\":{\"name\":\"hsh\"}}",
+		trace->count - kept, (int)trace->pid);
+	for (size_t i = trace->count - kept; i < trace->count; i++) {
+		TraceEvent *event = &trace->events[i % trace->capacity];
+
+		fputs(",\n{\"name\":", file);
+		trace_write_string(file, event->name ? event->name :
+						       event->label);
+		fprintf(file,
+			",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,"
+			"\"dur\":%.3f,\"pid\":%d,\"tid\":%d",
+			event->name ? "shell" : "command",
+			(event->start - trace->epoch) / 1e3,
+			event->duration / 1e3, (int)trace->pid,
+			(int)trace->pid);
+		if (!event->name)
+			fprintf(file, ",\"args\":{\"pid\":%d,\"status\":%d}",
+				(int)event->pid, (int)event->status);
+		putc('}', file);
+	}
+	fputs("\n]}\n", file);
+}
+
+/**
+ * trace_free - Writes out the recorded events and stops tracing.
+ * @trace: The tracer, or NULL.
+ *
+ * Forked copies of the shell share the tracer but never write it.
+ */
+void trace_free(Trace *trace)
+{
+	FILE *file;
+
+	if (!trace)
+		return;
+	if (getpid() == trace->pid) {
+		file = fopen(trace->path, "w");
+		if (file) {
+			trace_write(trace, file);
+			fclose(file);
+		} else {
+			perror(trace->path);
+		}
+	}
+	free(trace->events);
+	free(trace->path);
+	free(trace);
+}
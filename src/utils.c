@@ -5,25 +5,60 @@
 #include <sys/stat.h>
 #include <stdio.h>
 #include <stddef.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <unistd.h>
 
-char *build_path(char *path, char *path_env)
+/**
+ * is_executable - Checks if a path names an executable regular file.
+ * @path: The path to check.
+ *
+ * Return: true if the file can be executed, false otherwise.
+ */
+static bool is_executable(const char *path)
 {
 	struct stat sinfo;
-	if (!stat(path, &sinfo))
+
+	return !stat(path, &sinfo) && S_ISREG(sinfo.st_mode) &&
+	       !access(path, X_OK);
+}
+
+/**
+ * build_path - Resolves a command name against a PATH string.
+ * @path: The command name to resolve.
+ * @path_env: Colon separated list of directories, or NULL.
+ *
+ * Names containing a slash are not searched for. Every candidate is
+ * assembled in a stack buffer so only the final result is allocated.
+ *
+ * Return: Newly allocated resolved path, or NULL if nothing was found.
+ */
+char *build_path(const char *path, const char *path_env)
+{
+	char joined[PATH_MAX];
+	size_t path_length = strlen(path);
+
+	if (strchr(path, '/'))
 		return strdup(path);
-	char **path_list = split(path_env, ':');
-	for (char **traverser = path_list; *traverser; traverser++) {
-		size_t total_length = strlen(*traverser) + strlen(path);
-		char *joined = malloc(
-			(total_length + 1 + 1) *
-			sizeof(char)); // 1 for null byte and 1 for the '/' character
-		snprintf(joined, total_length + 2, "%s/%s", *traverser, path);
-		if (!stat(joined, &sinfo)) {
-			freevec(path_list);
-			return joined;
+	if (!path_env || path_length == 0)
+		return NULL;
+
+	for (const char *dir = path_env;; dir++) {
+		size_t dir_length = strcspn(dir, ":");
+		const char *prefix = dir_length ? dir : ".";
+		size_t prefix_length = dir_length ? dir_length : 1;
+
+		if (prefix_length + path_length + 2 <= sizeof(joined)) {
+			memcpy(joined, prefix, prefix_length);
+			joined[prefix_length] = '/';
+			memcpy(joined + prefix_length + 1, path,
+			       path_length + 1);
+			if (is_executable(joined))
+				return strdup(joined);
 		}
-		free(joined);
+		dir += dir_length;
+		if (*dir == '\0')
+			break;
 	}
-	freevec(path_list);
-	return strdup(path);
+	return NULL;
 }
@@ -0,0 +1,400 @@
+#include <vars.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VARS_INITIAL_CAPACITY 64
+
+/**
+ * var_free - Frees a variable.
+ * @value: The variable.
+ */
+static void var_free(void *value)
+{
+	Var *var = value;
+
+	free(var->assignment);
+	free(var);
+}
+
+/**
+ * vars_valid_name - Checks if a string is a valid variable name.
+ * @name: The string to check.
+ * @length: The length of the string.
+ *
+ * Return: true if valid, false otherwise.
+ */
+bool vars_valid_name(const char *name, size_t length)
+{
+	if (!length || !(name[0] == '_' || (name[0] >= 'a' && name[0] <= 'z') ||
+			 (name[0] >= 'A' && name[0] <= 'Z')))
+		return false;
+
+	for (size_t i = 1; i < length; i++) {
+		if (!(name[i] == '_' || (name[i] >= 'a' && name[i] <= 'z') ||
+		      (name[i] >= 'A' && name[i] <= 'Z') ||
+		      (name[i] >= '0' && name[i] <= '9')))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * vars_init - Creates the variables of an environment, all exported.
+ * @vars: The variable store to set up.
+ * @env: The environment, such as environ.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+bool vars_init(Vars *vars, char **env)
+{
+	memset(vars, 0, sizeof(Vars));
+	vars->table = table_new(var_free);
+	if (!vars->table)
+		return false;
+	vars->generation = 1;
+	for (; env && *env; env++) {
+		if (strchr(*env, '=') && !vars_set(vars, *env, VAR_EXPORT)) {
+			vars_free(vars);
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * vars_free - Frees every variable and the exported environment.
+ * @vars: The variable store.
+ */
+void vars_free(Vars *vars)
+{
+	table_free(vars->table);
+	free(vars->envp);
+	free(vars->overrides);
+	memset(vars, 0, sizeof(Vars));
+}
+
+/**
+ * vars_get - Looks up the value of a variable.
+ * @vars: The variable store.
+ * @name: Name of the variable.
+ *
+ * Return: The value, or NULL if the variable is not set.
+ */
+const char *vars_get(Vars *vars, const char *name)
+{
+	TableEntry *entry = table_find(vars->table, name);
+
+	return entry ? ((Var *)entry->value)->value : NULL;
+}
+
+/**
+ * vars_get_n - Looks up the value of a variable named by part of a string.
+ * @vars: The variable store.
+ * @name: Name of the variable, not necessarily NUL terminated.
+ * @length: Length of @name.
+ *
+ * Return: The value, or NULL if the variable is not set.
+ */
+const char *vars_get_n(Vars *vars, const char *name, size_t length)
+{
+	TableEntry *entry = table_find_n(vars->table, name, length);
+
+	return entry ? ((Var *)entry->value)->value : NULL;
+}
+
+/**
+ * vars_changed - Brings the exported environment up to date with a
+ *                variable that was just set, exported or unset.
+ * @vars: The variable store.
+ * @var: The variable.
+ * @name: Its name.
+ *
+ * A new value of a variable that already has a slot in an up to date
+ * environment is stored there directly; anything else forces a rebuild.
+ */
+static void vars_changed(Vars *vars, Var *var, const char *name)
+{
+	if (!strcmp(name, "PATH"))
+		vars->path_generation++;
+	if (!(var->flags & VAR_EXPORT))
+		return;
+	if (var->assignment && var->slot != VARS_NO_SLOT &&
+	    vars->built == vars->generation)
+		vars->envp[var->slot] = var->assignment;
+	else
+		vars->generation++;
+}
+
+/**
+ * vars_find_or_add - Looks up a variable, creating it unset if needed.
+ * @vars: The variable store.
+ * @name: Name of the variable.
+ *
+ * Return: The variable, or NULL on allocation failure.
+ */
+static Var *vars_find_or_add(Vars *vars, const char *name)
+{
+	TableEntry *entry = table_find(vars->table, name);
+	Var *var;
+
+	if (entry)
+		return entry->value;
+	var = calloc(1, sizeof(Var));
+	if (!var)
+		return NULL;
+	var->slot = VARS_NO_SLOT;
+	if (!table_insert(vars->table, name, var)) {
+		free(var);
+		return NULL;
+	}
+	return var;
+}
+
+/**
+ * vars_set - Sets a variable from a NAME=value assignment.
+ * @vars: The variable store.
+ * @assignment: The assignment, copied.
+ * @flags: Flags to add to the variable, such as VAR_EXPORT.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+bool vars_set(Vars *vars, const char *assignment, unsigned int flags)
+{
+	char *copy = strdup(assignment);
+	char *equals;
+	Var *var;
+
+	if (!copy)
+		return false;
+	equals = strchr(copy, '=');
+	*equals = '\0';
+	var = vars_find_or_add(vars, copy);
+	if (!var) {
+		free(copy);
+		return false;
+	}
+	free(var->assignment);
+	var->assignment = copy;
+	var->value = equals + 1;
+	var->flags |= flags;
+	vars_changed(vars, var, copy);
+	*equals = '=';
+	return true;
+}
+
+/**
+ * vars_export - Marks a variable for the environment of programs.
+ * @vars: The variable store.
+ * @name: Name of the variable; it is created unset if needed, and
+ *        enters the environment once it is given a value.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+bool vars_export(Vars *vars, const char *name)
+{
+	Var *var = vars_find_or_add(vars, name);
+
+	if (!var)
+		return false;
+	if (var->flags & VAR_EXPORT)
+		return true;
+	var->flags |= VAR_EXPORT;
+	if (var->assignment)
+		vars->generation++;
+	return true;
+}
+
+/**
+ * vars_unset - Removes a variable.
+ * @vars: The variable store.
+ * @name: Name of the variable.
+ */
+void vars_unset(Vars *vars, const char *name)
+{
+	TableEntry *entry = table_find(vars->table, name);
+	Var *var;
+
+	if (!entry)
+		return;
+	var = entry->value;
+	if (var->slot != VARS_NO_SLOT)
+		vars->generation++;
+	if (!strcmp(name, "PATH"))
+		vars->path_generation++;
+	table_remove(vars->table, name);
+}
+
+/**
+ * vars_reserve - Makes room in the exported environment.
+ * @vars: The variable store.
+ * @count: Number of entries needed, not counting the NULL terminator.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool vars_reserve(Vars *vars, size_t count)
+{
+	size_t capacity = vars->env_capacity ? vars->env_capacity :
+					       VARS_INITIAL_CAPACITY;
+	char **envp;
+
+	if (count < vars->env_capacity)
+		return true;
+	while (capacity <= count)
+		capacity *= 2;
+	envp = realloc(vars->envp, sizeof(char *) * capacity);
+	if (!envp)
+		return false;
+	vars->envp = envp;
+	vars->env_capacity = capacity;
+	return true;
+}
+
+/**
+ * vars_add_exported - Gives an exported variable its slot.
+ * @entry: The variable's table entry.
+ * @ctx: The variable store.
+ */
+static void vars_add_exported(TableEntry *entry, void *ctx)
+{
+	Vars *vars = ctx;
+	Var *var = entry->value;
+
+	var->slot = VARS_NO_SLOT;
+	if (!(var->flags & VAR_EXPORT) || !var->assignment)
+		return;
+	var->slot = vars->envc;
+	vars->envp[vars->envc++] = var->assignment;
+}
+
+/**
+ * vars_environ - Returns the environment for programs.
+ * @vars: The variable store.
+ *
+ * The vector is only rebuilt when an exported variable was added,
+ * removed or exported since the last call.
+ *
+ * Return: The NULL terminated environment, owned by @vars, or NULL on
+ * allocation failure.
+ */
+char **vars_environ(Vars *vars)
+{
+	if (vars->built == vars->generation)
+		return vars->envp;
+	if (!vars_reserve(vars, vars->table->count))
+		return NULL;
+	vars->envc = 0;
+	table_each(vars->table, vars_add_exported, vars);
+	vars->envp[vars->envc] = NULL;
+	vars->built = vars->generation;
+	return vars->envp;
+}
+
+/**
+ * vars_override - Puts an assignment into the environment for a while.
+ * @vars: The variable store.
+ * @slot: Slot to store the assignment in; envc or beyond appends it.
+ * @assignment: The assignment.
+ *
+ * Return: true on success, false on allocation failure.
+ */
+static bool vars_override(Vars *vars, size_t slot, char *assignment)
+{
+	VarOverride *overrides = vars->overrides;
+
+	if (vars->override_count == vars->override_capacity) {
+		size_t capacity = vars->override_capacity ?
+					  vars->override_capacity * 2 :
+					  8;
+
+		overrides = realloc(overrides, sizeof(VarOverride) * capacity);
+		if (!overrides)
+			return false;
+		vars->overrides = overrides;
+		vars->override_capacity = capacity;
+	}
+	if (slot >= vars->envc && !vars_reserve(vars, slot + 1))
+		return false;
+	overrides[vars->override_count].slot = slot;
+	overrides[vars->override_count].saved =
+		slot < vars->envc ? vars->envp[slot] : NULL;
+	vars->override_count++;
+	vars->envp[slot] = assignment;
+	return true;
+}
+
+/**
+ * vars_appended - Finds where an overlay puts a variable without a slot.
+ * @vars: The variable store.
+ * @name: The name of the variable.
+ * @length: Length of @name.
+ *
+ * Return: The slot of an assignment to the same variable the overlay
+ * already appended, otherwise the end of the environment.
+ */
+static size_t vars_appended(Vars *vars, const char *name, size_t length)
+{
+	size_t i = vars->envc;
+
+	for (; vars->envp[i]; i++) {
+		if (!strncmp(vars->envp[i], name, length) &&
+		    vars->envp[i][length] == '=')
+			break;
+	}
+	return i;
+}
+
+/**
+ * vars_overlay - Returns the environment for a program run with
+ *                assignments in front of it.
+ * @vars: The variable store.
+ * @assignments: NULL terminated NAME=value assignments, which must
+ *               stay valid until vars_restore().
+ *
+ * Only the entries named by @assignments are replaced or appended, in
+ * place; vars_restore() must be called once the program has started.
+ *
+ * Return: The NULL terminated environment, owned by @vars, or NULL on
+ * allocation failure.
+ */
+char **vars_overlay(Vars *vars, char **assignments)
+{
+	if (!vars_environ(vars))
+		return NULL;
+	for (; *assignments; assignments++) {
+		char *assignment = *assignments;
+		size_t length = strchr(assignment, '=') - assignment;
+		TableEntry *entry =
+			table_find_n(vars->table, assignment, length);
+		size_t slot = entry ? ((Var *)entry->value)->slot :
+				      VARS_NO_SLOT;
+		bool append = false;
+
+		if (slot == VARS_NO_SLOT) {
+			slot = vars_appended(vars, assignment, length);
+			append = !vars->envp[slot];
+		}
+		if (!vars_override(vars, slot, assignment)) {
+			vars_restore(vars);
+			return NULL;
+		}
+		if (append)
+			vars->envp[slot + 1] = NULL;
+	}
+	return vars->envp;
+}
+
+/**
+ * vars_restore - Takes the assignments of vars_overlay() out again.
+ * @vars: The variable store.
+ */
+void vars_restore(Vars *vars)
+{
+	while (vars->override_count) {
+		VarOverride *override = &vars->overrides[--vars->override_count];
+
+		if (override->slot < vars->envc)
+			vars->envp[override->slot] = override->saved;
+	}
+	if (vars->envp)
+		vars->envp[vars->envc] = NULL;
+}
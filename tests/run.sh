@@ -0,0 +1,89 @@
+#!/bin/sh
+# run.sh - Runs the regression tests of hsh.
+#
+# Usage: tests/run.sh
+# Every test runs a script with `hsh -c` and compares what it prints on
+# standard output and standard error, followed by a `status N` line, with
+# the expected text. The shell under test is taken from $HSH (default:
+# ./hsh). The exit status is the number of failed tests.
+
+HSH=${HSH:-./hsh}
+failed=0
+total=0
+
+# check - Runs one test.
+# $1: Name of the test; $2: the script; $3: the expected output.
+check()
+{
+	total=$((total + 1))
+	actual=$("$HSH" -c "$2" hsh 2>&1; echo "status $?")
+	if [ "$actual" != "$3" ]; then
+		failed=$((failed + 1))
+		printf 'FAIL %s\n--- expected\n%s\n--- actual\n%s\n' \
+		       "$1" "$3" "$actual"
+	fi
+}
+
+check 'backslash before $' 'echo \$HOME' '$HOME
+status 0'
+check 'backslash before a quote in double quotes' 'echo "a\"b"' 'a"b
+status 0'
+check 'backslash in double quotes before other characters' \
+      'echo "a\b" "\\" "\$x"' 'a\b \ $x
+status 0'
+check 'backslash in the script of -c' 'FOO=bar; echo \$FOO \\$FOO' \
+      '$FOO \bar
+status 0'
+check 'backslash before an operator' 'test a \< b; echo $?' '0
+status 0'
+check 'backslash before a blank' 'printf "[%s]\n" a\ b' '[a b]
+status 0'
+check 'backslash in a case pattern' \
+      'case ab in a\*) echo no;; a?) echo yes;; esac' 'yes
+status 0'
+check 'backslash in a command substitution' \
+      'echo "$(echo "\"q\"")"' '"q"
+status 0'
+check 'line continuation' 'echo a\
+b' 'ab
+status 0'
+check 'assignments are expanded in turn' 'x=1 y=$x; echo $y' '1
+status 0'
+check 'an assignment sees the one before it' 'x=1; x=2 y=$x; echo $y' '2
+status 0'
+check 'prefix assignments of a program are expanded in turn' \
+      'x=5; x=1 y=$x env | grep "^y="' 'y=1
+status 0'
+check 'not found goes to the redirected standard error' \
+      'nosuchcmd 2>/dev/null; echo $?' '127
+status 0'
+check 'not found of the last command is redirected' \
+      'nosuchcmd 2>/dev/null' 'status 127'
+check 'not found goes down the pipe of 2>&1' \
+      'nosuchcmd 2>&1 >/dev/null | sed "s/^/err: /"' \
+      'err: hsh: 1: nosuchcmd: not found
+status 0'
+check 'the shell'"'"'s own descriptors cannot be copied' \
+      'sleep 0 & echo x | cat 2>&3; echo $?; wait' \
+      'hsh: 1: 3: Bad file descriptor
+2
+status 0'
+check 'a descriptor redirected in a compound command can be copied' \
+      '{ echo x >&4; } 4>&1' 'x
+status 0'
+check 'printf with a negative * precision' 'printf "%.*s\n" -1 abc' 'abc
+status 0'
+check 'printf with a negative * width' 'printf "%*s|\n" -5 ab' 'ab   |
+status 0'
+check 'time -p wins over HSH_TIMEFORMAT' \
+      'HSH_TIMEFORMAT=json; { time -p true; } 2>&1 | sed "s/ .*//"' 'real
+user
+sys
+status 0'
+check 'time of builtins reports the growth of the resident set' \
+      'HSH_TIMEFORMAT=json; { time true; } 2>&1 | grep -c maxrss_growth' \
+      '1
+status 0'
+
+echo "$((total - failed)) of $total tests passed"
+exit "$failed"